@@ -4,215 +4,284 @@ import { Platform } from "./baseplatform";
 
 export interface CodeAnalyzer {
   showLoopTimingForPC(pc:number);
-  pc2minclocks : {[key:number]:number};
-  pc2maxclocks : {[key:number]:number};
+  analyzeProgram() : void;
+  pc2minclocks : Int32Array; // -1 if not reached
+  pc2maxclocks : Int32Array;
   MAX_CLOCKS : number;
 }
 
-/// VCS TIMING ANALYSIS
-
-// [taken, not taken]
-const BRANCH_CONSTRAINTS = [
-  [{N:0},{N:1}],
-  [{N:1},{N:0}],
-  [{V:0},{V:1}],
-  [{V:1},{V:0}],
-  [{C:0},{C:1}],
-  [{C:1},{C:0}],
-  [{Z:0},{Z:1}],
-  [{Z:1},{Z:0}]
-];
+// Clocks since the last sync point (e.g. WSYNC on the VCS), as a [min,max]
+// range at the start of each instruction. A worklist holds the addresses
+// whose range just widened; processing one widens its successors, until
+// nothing changes. Ranges only widen and are capped at MAX_CLOCKS, so it
+// always ends, and each address is typically visited a handful of times.
+//
+// Subroutines are summarized, not inlined: a call widens the callee's
+// entry, and each return of the callee widens the return address of every
+// call site seen so far. Ranges are kept per PC and per subroutine the code
+// is running in, so code shared between routines (or reached by a JMP tail
+// call) returns only to the callers of the routine it was entered through.
+// pc2minclocks and pc2maxclocks are the union over all subroutines.
 
-function constraintEquals(a,b) {
-  if (a == null || b == null)
-    return null;
-  for (var n in a) {
-    if (b[n] !== 'undefined')
-      return a[n] == b[n];
-  }
-  for (var n in b) {
-    if (a[n] !== 'undefined')
-      return a[n] == b[n];
-  }
-  return null;
+// instructions that change the clock range regardless of where they start,
+// e.g. STA WSYNC; operand is the byte or word after the opcode
+export interface TimingQuirk {
+  opcode : number;
+  operand : number;
+  minClocks : number; // clocks after the instruction
+  maxClocks : number;
 }
 
-abstract class CodeAnalyzer6502 implements CodeAnalyzer {
-  pc2minclocks = {};
-  pc2maxclocks = {};
+// clock range at pc, when reached while running in one subroutine
+interface TimingState {
+  pc : number;
+  owner : number; // subroutine entry point, or -2 for top-level code
+  minclocks : number;
+  maxclocks : number;
+  constraint : number;
+  queued : boolean;
+  widened : number; // times maxclocks went up
+}
+
+export const MAX_WORK = 0x100000; // instructions processed before giving up
+
+const NO_CONSTRAINT = 0;
+const TOP_LEVEL = -2;
+
+export abstract class CodeAnalyzerBase implements CodeAnalyzer {
+  pc2minclocks = new Int32Array(0x10000);
+  pc2maxclocks = new Int32Array(0x10000);
   START_CLOCKS : number;
   MAX_CLOCKS : number;
   WRAP_CLOCKS : boolean;
-  jsrresult = {};
+  WIDEN_AFTER : number = Infinity; // times a state's max can go up before it jumps to MAX_CLOCKS
   platform : Platform;
-  MAX_CYCLES : number = 2000;
-  
+  quirks = new Map<number,TimingQuirk>(); // (opcode | operand<<8) -> quirk
+  states = new Map<number,TimingState>();  // (owner+2)*0x10000 + pc -> state
+  worklist : TimingState[] = [];           // each state is in it at most once
+  head : number = 0;
+  returnSites = new Map<number,{addr:number, owner:number}[]>(); // subroutine -> return addresses
+  exitMin = new Map<number,number>();       // subroutine -> clocks after returning
+  exitMax = new Map<number,number>();
+  work : number = 0;
+
   constructor(platform : Platform) {
     this.platform = platform;
+    this.reset();
   }
 
-  getClockCountsAtPC(pc) {
-    var opcode = this.platform.readAddress(pc);
-    var meta = this.platform.getOpcodeMetadata(opcode, pc);
-    return meta; // minCycles, maxCycles
-  }
-
-  traceInstructions(pc:number, minclocks:number, maxclocks:number, subaddr:number, constraints) {
-    if (this.WRAP_CLOCKS) {
-      if (this.pc2minclocks[pc] !== undefined)
-        minclocks = Math.min(minclocks, this.pc2minclocks[pc]);
-      if (this.pc2maxclocks[pc] !== undefined)
-        maxclocks = Math.max(maxclocks, this.pc2maxclocks[pc]);
-    }
-    //console.log("trace", hex(pc), minclocks, maxclocks);
-    if (!constraints) constraints = {};
-    var modified = true;
-    var abort = false;
-    for (var i=0; modified && !abort; i++) {
-      if (i >= this.MAX_CYCLES) {
-        console.log("too many cycles @", hex(pc), "routine", hex(subaddr));
-        break;
-      }
-      modified = false;
-      if (this.WRAP_CLOCKS && minclocks >= this.MAX_CLOCKS) {
-        // wrap clocks
-        minclocks = minclocks % this.MAX_CLOCKS;
-        maxclocks = maxclocks % this.MAX_CLOCKS;
-      } else {
-        // truncate clocks
-        minclocks = Math.min(this.MAX_CLOCKS, minclocks);
-        maxclocks = Math.min(this.MAX_CLOCKS, maxclocks);
+  addQuirks(quirks:TimingQuirk[]) {
+    for (var q of quirks) this.quirks.set(q.opcode | (q.operand << 8), q);
+  }
+  getQuirk(opcode:number, operand:number) : TimingQuirk {
+    return this.quirks.size ? this.quirks.get(opcode | (operand << 8)) : null;
+  }
+
+  reset() {
+    this.pc2minclocks.fill(-1);
+    this.pc2maxclocks.fill(-1);
+    this.states = new Map();
+    this.worklist = [];
+    this.head = 0;
+    this.returnSites = new Map();
+    this.exitMin = new Map();
+    this.exitMax = new Map();
+    this.work = 0;
+  }
+
+  getState(pc:number, owner:number) : TimingState {
+    return this.states.get((owner + 2) * 0x10000 + pc);
+  }
+
+  // widens the clock range at pc in subroutine owner, and queues it if anything changed
+  propagate(pc:number, minclocks:number, maxclocks:number, constraint:number, owner:number) {
+    pc &= 0xffff;
+    if (this.WRAP_CLOCKS && minclocks >= this.MAX_CLOCKS) {
+      minclocks %= this.MAX_CLOCKS;
+      maxclocks %= this.MAX_CLOCKS;
+      if (maxclocks < minclocks) maxclocks = this.MAX_CLOCKS; // could be anywhere
+    }
+    minclocks = Math.min(this.MAX_CLOCKS, minclocks);
+    maxclocks = Math.min(this.MAX_CLOCKS, maxclocks);
+    var state = this.getState(pc, owner);
+    var modified = false;
+    if (!state) {
+      state = {pc:pc, owner:owner, minclocks:minclocks, maxclocks:maxclocks, constraint:constraint, queued:false, widened:0};
+      this.states.set((owner + 2) * 0x10000 + pc, state);
+      modified = true;
+    } else {
+      if (minclocks < state.minclocks) {
+        state.minclocks = minclocks;
+        modified = true;
       }
-      var meta = this.getClockCountsAtPC(pc);
-      var lob = this.platform.readAddress(pc+1);
-      var hib = this.platform.readAddress(pc+2);
-      var addr = lob + (hib << 8);
-      var pc0 = pc;
-      if (!(minclocks >= this.pc2minclocks[pc0])) {
-        this.pc2minclocks[pc0] = minclocks;
+      if (maxclocks > state.maxclocks) {
+        // a loop without a sync point adds its clocks on every trip around it,
+        // so after a few trips assume it can go on until MAX_CLOCKS
+        state.maxclocks = ++state.widened >= this.WIDEN_AFTER ? this.MAX_CLOCKS : maxclocks;
         modified = true;
       }
-      if (!(maxclocks <= this.pc2maxclocks[pc0])) {
-        this.pc2maxclocks[pc0] = maxclocks;
+      if (constraint != state.constraint && state.constraint != NO_CONSTRAINT) {
+        state.constraint = NO_CONSTRAINT;
         modified = true;
       }
-      //console.log(hex(pc),minclocks,maxclocks,modified,meta,constraints);
-      if (!meta.insnlength) {
-        console.log("Illegal instruction!", hex(pc), hex(meta.opcode), meta);
-        break;
+    }
+    if (modified) {
+      var oldmin = this.pc2minclocks[pc];
+      if (oldmin < 0 || minclocks < oldmin) this.pc2minclocks[pc] = minclocks;
+      if (state.maxclocks > this.pc2maxclocks[pc]) this.pc2maxclocks[pc] = state.maxclocks;
+      if (!state.queued) {
+        state.queued = true;
+        this.worklist.push(state);
       }
-      pc += meta.insnlength;
-      var oldconstraints = constraints;
-      constraints = null;
-      // TODO: if jump to zero-page, maybe assume RTS?
-      switch (meta.opcode) {
-        case 0x19: case 0x1d:
-        case 0x39: case 0x3d:
-        case 0x59: case 0x5d:
-        case 0x79: case 0x7d:
-        case 0x99: case 0x9d:
-        case 0xa9: case 0xad:
-        case 0xb9: case 0xbd: case 0xbc: case 0xbe:
-        case 0xd9: case 0xdd:
-        case 0xf9: case 0xfd:
-          if (lob == 0)
-            meta.maxCycles -= 1; // no page boundary crossed
-          break;
-        // TODO: only VCS
-        case 0x85:
-          if (lob == 0x2) { // STA WSYNC
-            minclocks = maxclocks = 0;
-            meta.minCycles = meta.maxCycles = 0;
-          }
-          break;
-        // TODO: only NES (sprite 0 poll)
-        case 0x2c:
-          if (lob == 0x02 && hib == 0x20) { // BIT $2002
-            minclocks = 0;
-            maxclocks = 4; // uncertainty b/c of assumed branch poll
-            meta.minCycles = meta.maxCycles = 0;
-          }
-          break;
-        // TODO: only Apple2 (vapor lock)
-        case 0xad:
-          if (lob == 0x61 && hib == 0xc0) { // LDA $C061
-            minclocks = 0;
-            maxclocks = 4; // uncertainty?
-            meta.minCycles = meta.maxCycles = 0;
-          }
-          break;
-        case 0x20: // JSR
-          this.traceInstructions(addr, minclocks, maxclocks, addr, constraints);
-          var result = this.jsrresult[addr];
-          if (result) {
-            minclocks = result.minclocks;
-            maxclocks = result.maxclocks;
-          } else {
-            console.log("No JSR result!", hex(pc), hex(addr));
-            return;
-          }
-          break;
-        case 0x4c: // JMP
-          pc = addr; // TODO: make sure in ROM space
-          break;
-        case 0x40: // RTI
-          abort = true;
-          break;
-        case 0x60: // RTS
-          if (subaddr) { // TODO: 0 doesn't work
-            // TODO: combine with previous result
-            var result = this.jsrresult[subaddr];
-            if (!result) {
-              result = {minclocks:minclocks, maxclocks:maxclocks};
-            } else {
-              result = {
-                minclocks:Math.min(minclocks,result.minclocks),
-                maxclocks:Math.max(maxclocks,result.maxclocks)
-              }
-            }
-            this.jsrresult[subaddr] = result;
-            console.log("RTS", hex(pc), hex(subaddr), this.jsrresult[subaddr]);
-          }
-          return;
-        case 0x10: case 0x30: // branch
-        case 0x50: case 0x70:
-        case 0x90: case 0xB0:
-        case 0xD0: case 0xF0:
-          var newpc = pc + byte2signed(lob);
-          var crosspage = (pc>>8) != (newpc>>8);
-          if (!crosspage) meta.maxCycles--;
-          // TODO: other instructions might modify flags too
-          var cons = BRANCH_CONSTRAINTS[Math.floor((meta.opcode-0x10)/0x20)];
-          var cons0 = constraintEquals(oldconstraints, cons[0]);
-          var cons1 = constraintEquals(oldconstraints, cons[1]);
-          // recursively trace the taken branch
-          if (true || cons0 !== false) { // TODO?
-            this.traceInstructions(newpc, minclocks+meta.maxCycles, maxclocks+meta.maxCycles, subaddr, cons[0]);
-          }
-          // abort if we will always take the branch
-          if (cons1 === false) {
-            console.log("branch always taken", hex(pc), oldconstraints, cons[1]);
-            abort = true;
-          }
-          constraints = cons[1]; // not taken
-          meta.maxCycles = meta.minCycles; // branch not taken, no extra clock(s)
-          break;
-        case 0x6c:
-          console.log("Instruction not supported!", hex(pc), hex(meta.opcode), meta); // TODO
-          return;
+    }
+  }
+
+  // call to subroutine at addr from code owned by owner, returning to retaddr
+  call(addr:number, retaddr:number, minclocks:number, maxclocks:number, owner:number) {
+    addr &= 0xffff;
+    retaddr &= 0xffff;
+    var sites = this.returnSites.get(addr);
+    if (!sites) this.returnSites.set(addr, sites = []);
+    if (!sites.some((site) => site.addr == retaddr && site.owner == owner)) {
+      sites.push({addr:retaddr, owner:owner});
+      if (this.exitMin.has(addr)) {
+        this.propagate(retaddr, this.exitMin.get(addr), this.exitMax.get(addr), NO_CONSTRAINT, owner);
+      }
+    }
+    this.propagate(addr, minclocks, maxclocks, NO_CONSTRAINT, addr);
+  }
+
+  // return from subroutine owner, with these clocks after the return
+  ret(owner:number, minclocks:number, maxclocks:number) {
+    if (owner < 0) return;
+    var oldmin = this.exitMin.get(owner);
+    var oldmax = this.exitMax.get(owner);
+    if (oldmin != null) {
+      if (minclocks >= oldmin && maxclocks <= oldmax) return;
+      minclocks = Math.min(minclocks, oldmin);
+      maxclocks = Math.max(maxclocks, oldmax);
+    }
+    this.exitMin.set(owner, minclocks);
+    this.exitMax.set(owner, maxclocks);
+    for (var site of this.returnSites.get(owner) || []) {
+      this.propagate(site.addr, minclocks, maxclocks, NO_CONSTRAINT, site.owner);
+    }
+  }
+
+  // processes the instruction at pc, propagating to its successors
+  abstract step(pc:number, minclocks:number, maxclocks:number, constraint:number, owner:number) : void;
+
+  // entry points of the whole program
+  abstract getEntryPoints() : number[];
+
+  run() {
+    while (this.head < this.worklist.length) {
+      var state = this.worklist[this.head++];
+      state.queued = false;
+      if (++this.work > MAX_WORK) {
+        console.log("timing analysis gave up @", hex(state.pc));
+        break;
       }
-      // add min/max instruction time to min/max clocks bound
-      minclocks += meta.minCycles;
-      maxclocks += meta.maxCycles;
+      this.step(state.pc, state.minclocks, state.maxclocks, state.constraint, state.owner);
     }
+    this.worklist = [];
+    this.head = 0;
   }
 
   showLoopTimingForPC(pc:number) {
-    this.pc2minclocks = {};
-    this.pc2maxclocks = {};
-    this.jsrresult = {};
-    // recurse through all traces
-    this.traceInstructions(pc | this.platform.getOriginPC(), this.START_CLOCKS, this.MAX_CLOCKS, 0, {});
+    this.reset();
+    this.propagate(pc | this.platform.getOriginPC(), this.START_CLOCKS, this.MAX_CLOCKS, NO_CONSTRAINT, TOP_LEVEL);
+    this.run();
+  }
+
+  analyzeProgram() {
+    this.reset();
+    for (var pc of this.getEntryPoints()) {
+      this.propagate(pc, this.START_CLOCKS, this.MAX_CLOCKS, NO_CONSTRAINT, TOP_LEVEL);
+    }
+    this.run();
+  }
+}
+
+// 6502 branch opcodes are 0x10 + 0x20*n, and Z80 condition codes are
+// NZ,Z,NC,C,PO,PE,P,M; either way flag n>>1 is tested, and the branch is
+// taken if it equals n&1. A constraint is 1 + that flag*2 + its known value.
+function branchConstraint(n:number, taken:boolean) : number {
+  return 1 + (n & ~1) + ((n & 1) ^ (taken ? 0 : 1));
+}
+
+/// 6502 TIMING ANALYSIS
+
+// abs,X and abs,Y instructions, which take an extra clock if they cross a page
+const PAGE_CROSS_6502 = [
+  0x19, 0x1d, 0x39, 0x3d, 0x59, 0x5d, 0x79, 0x7d, 0x99, 0x9d,
+  0xb9, 0xbd, 0xbc, 0xbe, 0xd9, 0xdd, 0xf9, 0xfd
+];
+
+
+abstract class CodeAnalyzer6502 extends CodeAnalyzerBase {
+
+  readVector(a:number) : number {
+    return this.platform.readAddress(a) | (this.platform.readAddress(a+1) << 8);
+  }
+
+  getEntryPoints() : number[] {
+    // NMI, reset, IRQ
+    return [0xfffa, 0xfffc, 0xfffe].map((v) => this.readVector(v));
+  }
+
+  step(pc:number, minclocks:number, maxclocks:number, constraint:number, owner:number) {
+    var opcode = this.platform.readAddress(pc);
+    var meta = this.platform.getOpcodeMetadata(opcode, pc);
+    if (!meta.insnlength) {
+      console.log("Illegal instruction!", hex(pc), hex(opcode));
+      return;
+    }
+    var lob = this.platform.readAddress((pc+1) & 0xffff);
+    var hib = this.platform.readAddress((pc+2) & 0xffff);
+    var addr = lob + (hib << 8);
+    var next = pc + meta.insnlength;
+    var mincyc = meta.minCycles;
+    var maxcyc = meta.maxCycles;
+    var quirk = this.getQuirk(opcode, meta.insnlength == 2 ? lob : addr);
+    if (quirk) {
+      this.propagate(next, quirk.minClocks, quirk.maxClocks, NO_CONSTRAINT, owner);
+      return;
+    }
+    if (lob == 0 && maxcyc > mincyc && PAGE_CROSS_6502.indexOf(opcode) >= 0) {
+      maxcyc--; // no page boundary crossed
+    }
+    switch (opcode) {
+      case 0x20: // JSR
+        this.call(addr, next, minclocks+mincyc, maxclocks+maxcyc, owner);
+        return;
+      case 0x4c: // JMP
+        this.propagate(addr, minclocks+mincyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+        return;
+      case 0x60: // RTS
+        this.ret(owner, minclocks+mincyc, maxclocks+maxcyc);
+        return;
+      case 0x00: // BRK
+      case 0x40: // RTI
+      case 0x6c: // JMP (ind), target not known
+        return;
+      case 0x10: case 0x30: // branch
+      case 0x50: case 0x70:
+      case 0x90: case 0xB0:
+      case 0xD0: case 0xF0:
+        var n = opcode >> 5;
+        var newpc = (next + byte2signed(lob)) & 0xffff;
+        var taken = branchConstraint(n, true);
+        var nottaken = branchConstraint(n, false);
+        var takencyc = mincyc + ((next>>8) != (newpc>>8) ? 2 : 1);
+        // a previous branch on the same flag might decide this one
+        if (constraint != nottaken)
+          this.propagate(newpc, minclocks+takencyc, maxclocks+takencyc, taken, owner);
+        if (constraint != taken)
+          this.propagate(next, minclocks+mincyc, maxclocks+mincyc, nottaken, owner);
+        return;
+    }
+    this.propagate(next, minclocks+mincyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
   }
 }
 
@@ -222,6 +291,14 @@ export class CodeAnalyzer_vcs extends CodeAnalyzer6502 {
     super(platform);
     this.MAX_CLOCKS = this.START_CLOCKS = 76*2; // 2 scanlines
     this.WRAP_CLOCKS = false;
+    this.addQuirks([
+      {opcode:0x85, operand:0x02, minClocks:0, maxClocks:0}, // STA WSYNC
+      {opcode:0x86, operand:0x02, minClocks:0, maxClocks:0}, // STX WSYNC
+      {opcode:0x84, operand:0x02, minClocks:0, maxClocks:0}, // STY WSYNC
+    ]);
+  }
+  getEntryPoints() : number[] {
+    return [this.platform.getOriginPC()];
   }
 }
 
@@ -233,6 +310,18 @@ export class CodeAnalyzer_nes extends CodeAnalyzer6502 {
     this.MAX_CLOCKS = 114; // 341 clocks for 3 scanlines
     this.START_CLOCKS = 0;
     this.WRAP_CLOCKS = true;
+    this.addQuirks([
+      {opcode:0x2c, operand:0x2002, minClocks:0, maxClocks:4}, // BIT $2002 (sprite 0 poll, uncertainty b/c of assumed branch)
+    ]);
+  }
+  // Nothing is known about the scanline at reset or an IRQ, but the NMI comes
+  // at the start of vblank: up to 6 cycles to finish the current instruction,
+  // then 7 to take the interrupt. Code only reached from reset is left
+  // untimed rather than shown as anywhere on the scanline.
+  analyzeProgram() {
+    this.reset();
+    this.propagate(this.readVector(0xfffa), 7, 7+6, NO_CONSTRAINT, TOP_LEVEL);
+    this.run();
   }
 }
 
@@ -242,6 +331,178 @@ export class CodeAnalyzer_apple2 extends CodeAnalyzer6502 {
     this.MAX_CLOCKS = 65;
     this.START_CLOCKS = 0;
     this.WRAP_CLOCKS = true;
+    this.addQuirks([
+      {opcode:0xad, operand:0xc061, minClocks:0, maxClocks:4}, // LDA $C061 (vapor lock)
+    ]);
   }
 }
 
+/// Z80 TIMING ANALYSIS
+
+// T-states since reset, the last frame interrupt, or the HALT that waited
+// for it. HALT is treated as a call to the interrupt handler, which returns
+// to the next instruction. The handler is the NMI on some machines, or else
+// whatever the code selects with IM 0 or IM 1 (IM 2 vectors aren't followed).
+
+export interface InterruptEntry {
+  pc : number;
+  clocks : number; // T-states to accept the interrupt
+}
+
+const Z80_NMI : InterruptEntry = {pc:0x66, clocks:11};
+const Z80_IM1 : InterruptEntry = {pc:0x38, clocks:13}; // IM 0 with RST 38h on the bus takes the same
+
+export class CodeAnalyzer_z80 extends CodeAnalyzerBase {
+  nmi : boolean;               // frame interrupt is the NMI
+  interrupt : InterruptEntry;  // handler HALT waits for, if known
+  halts : {pc:number, owner:number}[]; // HALTs seen while the handler wasn't known
+
+  constructor(platform : Platform, frameClocks? : number, nmi? : boolean) {
+    super(platform);
+    this.MAX_CLOCKS = frameClocks || 0xffff;
+    this.START_CLOCKS = 0;
+    this.WRAP_CLOCKS = false;
+    this.WIDEN_AFTER = 8; // the frame is long, so loops would take thousands of trips to get there
+    this.nmi = !!nmi;
+  }
+
+  reset() {
+    super.reset();
+    this.interrupt = this.nmi ? Z80_NMI : null;
+    this.halts = [];
+  }
+
+  getEntryPoints() : number[] {
+    return [this.platform.getOriginPC ? this.platform.getOriginPC() : 0];
+  }
+
+  // unlike the 6502 analyzers, which start mid-scanline, clocks are known at reset
+  analyzeProgram() {
+    this.reset();
+    for (var pc of this.getEntryPoints()) {
+      this.propagate(pc, 0, 0, NO_CONSTRAINT, TOP_LEVEL);
+    }
+    this.run();
+  }
+
+  setInterrupt(entry:InterruptEntry) {
+    if (this.nmi || entry === this.interrupt) return;
+    this.interrupt = entry;
+    // go back to the HALTs that didn't know where they'd end up
+    if (entry) {
+      for (var halt of this.halts) {
+        var state = this.getState(halt.pc, halt.owner);
+        this.step(halt.pc, state.minclocks, state.maxclocks, NO_CONSTRAINT, halt.owner);
+      }
+    }
+  }
+
+  run() {
+    super.run();
+    // no handler found, so just start counting again after each HALT
+    if (!this.interrupt && this.halts.length) {
+      for (var halt of this.halts) {
+        this.propagate(halt.pc+1, 0, 0, NO_CONSTRAINT, halt.owner);
+      }
+      this.halts = [];
+      super.run();
+    }
+  }
+
+  step(pc:number, minclocks:number, maxclocks:number, constraint:number, owner:number) {
+    var opcode = this.platform.readAddress(pc);
+    var meta = this.platform.getOpcodeMetadata(opcode, pc);
+    if (!meta || !meta.insnlength) {
+      console.log("Illegal instruction!", hex(pc), hex(opcode));
+      return;
+    }
+    var b1 = this.platform.readAddress((pc+1) & 0xffff);
+    var b2 = this.platform.readAddress((pc+2) & 0xffff);
+    var addr = b1 + (b2 << 8);
+    var next = (pc + meta.insnlength) & 0xffff;
+    var mincyc = meta.minCycles;
+    var maxcyc = meta.maxCycles;
+    var quirk = meta.opcode < 0x100 && this.getQuirk(meta.opcode, meta.insnlength == 2 ? b1 : addr);
+    if (quirk) {
+      this.propagate(next, quirk.minClocks, quirk.maxClocks, NO_CONSTRAINT, owner);
+      return;
+    }
+    var cc = (opcode >> 3) & 7;
+    switch (meta.opcode) {
+      case 0x18: // JR
+        this.propagate(next + byte2signed(b1), minclocks+mincyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+        return;
+      case 0x20: case 0x28: case 0x30: case 0x38: // JR cc
+        cc &= 3;
+        if (constraint != branchConstraint(cc, false))
+          this.propagate(next + byte2signed(b1), minclocks+maxcyc, maxclocks+maxcyc, branchConstraint(cc, true), owner);
+        if (constraint != branchConstraint(cc, true))
+          this.propagate(next, minclocks+mincyc, maxclocks+mincyc, branchConstraint(cc, false), owner);
+        return;
+      case 0x10: // DJNZ
+        this.propagate(next + byte2signed(b1), minclocks+maxcyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+        this.propagate(next, minclocks+mincyc, maxclocks+mincyc, NO_CONSTRAINT, owner);
+        return;
+      case 0xc3: // JP
+        this.propagate(addr, minclocks+mincyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+        return;
+      case 0xc2: case 0xca: case 0xd2: case 0xda: // JP cc
+      case 0xe2: case 0xea: case 0xf2: case 0xfa:
+        if (constraint != branchConstraint(cc, false))
+          this.propagate(addr, minclocks+mincyc, maxclocks+maxcyc, branchConstraint(cc, true), owner);
+        if (constraint != branchConstraint(cc, true))
+          this.propagate(next, minclocks+mincyc, maxclocks+maxcyc, branchConstraint(cc, false), owner);
+        return;
+      case 0xcd: // CALL
+        this.call(addr, next, minclocks+mincyc, maxclocks+maxcyc, owner);
+        return;
+      case 0xc4: case 0xcc: case 0xd4: case 0xdc: // CALL cc
+      case 0xe4: case 0xec: case 0xf4: case 0xfc:
+        if (constraint != branchConstraint(cc, false))
+          this.call(addr, next, minclocks+maxcyc, maxclocks+maxcyc, owner);
+        if (constraint != branchConstraint(cc, true))
+          this.propagate(next, minclocks+mincyc, maxclocks+mincyc, branchConstraint(cc, false), owner);
+        return;
+      case 0xc9: // RET
+      case 0xed45: case 0xed55: case 0xed5d: case 0xed65: case 0xed6d: case 0xed75: case 0xed7d: // RETN
+      case 0xed4d: // RETI
+        this.ret(owner, minclocks+mincyc, maxclocks+maxcyc);
+        return;
+      case 0xc0: case 0xc8: case 0xd0: case 0xd8: // RET cc
+      case 0xe0: case 0xe8: case 0xf0: case 0xf8:
+        if (constraint != branchConstraint(cc, false))
+          this.ret(owner, minclocks+maxcyc, maxclocks+maxcyc);
+        if (constraint != branchConstraint(cc, true))
+          this.propagate(next, minclocks+mincyc, maxclocks+mincyc, branchConstraint(cc, false), owner);
+        return;
+      case 0xc7: case 0xcf: case 0xd7: case 0xdf: // RST
+      case 0xe7: case 0xef: case 0xf7: case 0xff:
+        this.call(opcode & 0x38, next, minclocks+mincyc, maxclocks+maxcyc, owner);
+        return;
+      case 0xe9: case 0xdde9: case 0xfde9: // JP (HL), (IX), (IY): target not known
+        return;
+      case 0x76: // HALT
+        if (this.interrupt) {
+          // the wait itself is unknown, so clocks start over at the interrupt
+          this.call(this.interrupt.pc, next, this.interrupt.clocks, this.interrupt.clocks, owner);
+        } else if (!this.halts.some((halt) => halt.pc == pc && halt.owner == owner)) {
+          this.halts.push({pc:pc, owner:owner}); // until IM 0/1 turns up, or run() gives up on it
+        }
+        return;
+      case 0xed46: case 0xed4e: case 0xed66: case 0xed6e: // IM 0
+      case 0xed56: case 0xed76: // IM 1
+        this.setInterrupt(Z80_IM1);
+        break;
+      case 0xed5e: case 0xed7e: // IM 2
+        this.setInterrupt(null);
+        break;
+      case 0xedb0: case 0xedb1: case 0xedb2: case 0xedb3: // LDIR, CPIR, INIR, OTIR
+      case 0xedb8: case 0xedb9: case 0xedba: case 0xedbb: // LDDR, CPDR, INDR, OTDR
+        // repeats until BC (or B) runs out, or a match, so the count isn't known
+        this.propagate(pc, minclocks+maxcyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+        this.propagate(next, minclocks+mincyc, maxclocks+mincyc, NO_CONSTRAINT, owner);
+        return;
+    }
+    this.propagate(next, minclocks+mincyc, maxclocks+maxcyc, NO_CONSTRAINT, owner);
+  }
+}
@@ -1,13 +1,14 @@
 
 import { RAM, RasterVideo, KeyFlags, dumpRAM, AnimationTimer, setKeyboardFromMap, padBytes, ControllerPoller } from "./emu";
 import { hex, printFlags, invertMap, getBasePlatform } from "./util";
-import { CodeAnalyzer } from "./analysis";
+import { CodeAnalyzer, CodeAnalyzer_z80 } from "./analysis";
 import { Segment, FileData } from "./workertypes";
 import { disassemble6502 } from "./cpu/disasm6502";
 import { disassembleZ80 } from "./cpu/disasmz80";
-import { Z80 } from "./cpu/ZilogZ80";
+import { Z80, cycle_counts, cycle_counts_ed, cycle_counts_cb, cycle_counts_dd } from "./cpu/ZilogZ80";
+import { MC6809, disassemble6809 } from "./cpu/MC6809";
 
-declare var jt, CPU6809;
+declare var jt;
 
 export interface OpcodeMetadata {
   minCycles: number;
@@ -102,6 +103,7 @@ export interface Platform {
   runToPC?(pc:number) : void;
   runUntilReturn?() : void;
   stepBack?() : void;
+  runBackToPC?(pc:number) : boolean;
   runEval?(evalfunc : DebugEvalCondition) : void;
   runToFrameClock?(clock : number) : void;
   stepOver?() : void;
@@ -124,6 +126,11 @@ export interface Platform {
 
   getRasterScanline?() : number;
   setBreakpoint?(id : string, cond : DebugCondition);
+  setPCBreakpoint?(id : string, pc : number);
+  setWatchpoint?(id : string, addr : number, flags : number); // WATCH_READ|WATCH_WRITE
+  canWatchMemory?() : boolean;
+  setExpressionBreakpoint?(id : string, source : string);
+  getTraceLog?() : string[];
   clearBreakpoint?(id : string);
   hasBreakpoint?(id : string) : boolean;
   getCPUState?() : CpuState;
@@ -133,6 +140,10 @@ export interface Platform {
   
   startProbing?() : ProbeRecorder;
   stopProbing?() : void;
+  startSampling?() : SamplingProbe;
+  stopSampling?() : void;
+  startCoverage?() : CoverageProbe;
+  stopCoverage?() : void;
 
   isBlocked?() : boolean; // is blocked, halted, or waiting for input?
 }
@@ -157,24 +168,59 @@ export type BreakpointCallback = (s:EmuState, msg?:string) => void;
 // for composite breakpoints w/ single debug function
 export class BreakpointList {
   id2bp : {[id:string] : Breakpoint} = {};
+  native : BreakpointSet = new BreakpointSet(); // the PC and watch breakpoints
+  atPC : {[pc:number] : Breakpoint[]} = {};    // what to do when native.hasPC()
+  everyInsn : Breakpoint[] = [];                // compiled conditions without a PC
+  traceLog : string[] = [];
+  set(id : string, bp : Breakpoint) {
+    this.id2bp[id] = bp;
+    this.update();
+  }
+  remove(id : string) {
+    delete this.id2bp[id];
+    this.update();
+  }
+  update() {
+    this.native.clear();
+    this.atPC = {};
+    this.everyInsn = [];
+    for (var id in this.id2bp) {
+      var bp = this.id2bp[id];
+      if (bp.pc != null) {
+        this.native.addPC(bp.pc);
+        (this.atPC[bp.pc & 0xffff] = this.atPC[bp.pc & 0xffff] || []).push(bp);
+      } else if (bp.expr || bp.trace) {
+        this.everyInsn.push(bp);
+      }
+      if (bp.watchAddr != null) this.native.addWatch(bp.watchAddr, bp.watchFlags);
+    }
+  }
+  addTrace(line : string) {
+    if (this.traceLog.length >= MAX_TRACE_LINES) this.traceLog.shift();
+    this.traceLog.push(line);
+  }
   getDebugCondition() : DebugCondition {
-    if (Object.keys(this.id2bp).length == 0) {
+    var conds = Object.keys(this.id2bp).filter((id) => this.id2bp[id].cond != null);
+    if (conds.length == 0) {
       return null; // no breakpoints
     } else {
       // evaluate all breakpoints
       return () => {
         var result = false;
-        for (var id in this.id2bp)
-          if (this.id2bp[id].cond())
+        for (var id of conds)
+          if (this.id2bp[id] && this.id2bp[id].cond())
             result = true;
         return result;
       };
     }
   }
 }
-export interface Breakpoint {
-  cond: DebugCondition;
+export interface Breakpoint extends ParsedBreakpoint {
+  cond?: DebugCondition;
+  pc?: number;          // stop before executing this address
+  hits?: number;        // times a compiled breakpoint was reached
 };
+const MAX_TRACE_LINES = 1000;
 
 export interface EmuRecorder {
   frameRequested() : boolean;
@@ -214,6 +260,8 @@ export abstract class BaseDebugPlatform extends BasePlatform {
   onBreakpointHit : BreakpointCallback;
   debugCallback : DebugCondition;
   debugSavedState : EmuState = null;
+  debugSavedBuffer : DataView = null; // debugSavedState as a binary snapshot, if supported
+  debugSavedBinary : boolean = false;
   debugBreakState : EmuState = null;
   debugTargetClock : number = 0;
   debugClock : number = 0;
@@ -224,26 +272,118 @@ export abstract class BaseDebugPlatform extends BasePlatform {
 
   setBreakpoint(id : string, cond : DebugCondition) {
     if (cond) {
-      this.breakpoints.id2bp[id] = {cond:cond};
-      this.restartDebugging();
+      this.addBreakpoint(id, {cond:cond});
     } else {
       this.clearBreakpoint(id);
     }
   }
+  setPCBreakpoint(id : string, pc : number) {
+    this.addBreakpoint(id, {pc:pc});
+  }
+  setWatchpoint(id : string, addr : number, flags : number) {
+    this.addBreakpoint(id, {watchAddr:addr, watchFlags:flags});
+  }
+  addBreakpoint(id : string, bp : Breakpoint) {
+    this.breakpoints.set(id, bp);
+    this.connectBreakpoints();
+    this.restartDebugging();
+  }
   clearBreakpoint(id : string) {
-    delete this.breakpoints.id2bp[id];
+    this.breakpoints.remove(id);
+    this.connectBreakpoints();
   }
   hasBreakpoint(id : string) {
     return this.breakpoints.id2bp[id] != null;
   }
+  // platforms that can watch memory hand the watchpoints to their bus here
+  connectBreakpoints() {
+  }
+  canWatchMemory() : boolean {
+    return false;
+  }
+  // counts debug clocks, and tests the PC and watch breakpoints before
+  // calling the others, so only those ever need the CPU state
   getDebugCallback() : DebugCondition {
-    return this.breakpoints.getDebugCondition();
+    var cond = this.breakpoints.getDebugCondition();
+    var bps = this.breakpoints.native;
+    var every = this.breakpoints.everyInsn;
+    if (!cond && bps.isEmpty() && !every.length) return null;
+    return () => {
+      ++this.debugClock;
+      var pc = (every.length || !bps.isEmpty()) ? this.getPC() : -1;
+      if (every.length || (pc >= 0 && bps.isHit(pc))) {
+        if (this.debugClock < this.debugTargetClock) {
+          bps.clearHit();
+        } else if (this.isStable() && !this.debugBreakState && this.checkBreakpoints(pc)) {
+          return true;
+        }
+      }
+      return cond != null && cond();
+    };
+  }
+  // stops if a watchpoint fired or a breakpoint at pc (or everywhere) says so
+  checkBreakpoints(pc : number) : boolean {
+    var bpl = this.breakpoints;
+    var bps = bpl.native;
+    var reason = bps.hitAddress >= 0 ? this.getWatchpointReason(bps) : null;
+    var stop = reason != null;
+    bps.clearHit();
+    this.registers = null;
+    var list = bps.hasPC(pc) && bpl.atPC[pc & 0xffff];
+    for (var i=0; i<2; i++) {
+      if (list) {
+        for (var bp of list) {
+          if (!bp.expr && !bp.trace) {
+            stop = true;
+          } else if (this.evalBreakpoint(bp, pc)) {
+            stop = true;
+          }
+        }
+      }
+      list = bpl.everyInsn;
+    }
+    if (stop) this.breakpointHit(this.debugClock, reason);
+    return stop;
+  }
+  // true if a compiled breakpoint should stop, tracepoints just log
+  evalBreakpoint(bp : Breakpoint, pc : number) : boolean {
+    var hits = bp.hits = (bp.hits|0) + 1;
+    var sp = this.getSP();
+    if (bp.expr && !bp.expr.fn(this.readRegs, this.readMem, hits, pc, sp)) return false;
+    if (!bp.trace) return true;
+    var line = formatTraceLine(pc, bp.traceLabels, bp.trace.fn(this.readRegs, this.readMem, hits, pc, sp));
+    this.breakpoints.addTrace(line);
+    return false;
+  }
+  readMem = (addr : number) => (<Platform><any>this).readAddress(addr & 0xffff);
+  // registers for compiled breakpoints, in getRegisterLayout()'s format,
+  // read at most once per instruction (checkBreakpoints() resets them)
+  registerBuf = new Int32Array(32);
+  registers : any = null;
+  readRegs = () => {
+    return this.registers || (this.registers = this.readRegisters());
+  }
+  getRegisterLayout() : RegisterLayout { return null; } // null means a CpuState
+  readRegisters() : any { return this.getCPUState(); }
+  // compiles a condition or tracepoint (see debugexpr.ts), throws if it's invalid
+  setExpressionBreakpoint(id : string, source : string) {
+    var symbols = this.debugSymbols && this.debugSymbols.symbolmap;
+    var bp = parseBreakpoint(source, this.getRegisterLayout(), symbols);
+    if (bp.watchAddr != null && !this.canWatchMemory()) throw new Error("This platform can't watch memory");
+    this.addBreakpoint(id, bp);
+  }
+  getTraceLog() : string[] {
+    return this.breakpoints.traceLog;
+  }
+  getWatchpointReason(bps : BreakpointSet) : string {
+    return (bps.hitFlags == WATCH_WRITE ? "Write" : "Read") + " $" + hex(bps.hitAddress, 4);
   }
   setupDebug(callback : BreakpointCallback) : void {
     this.onBreakpointHit = callback;
   }
   clearDebug() {
     this.debugSavedState = null;
+    this.debugSavedBinary = false;
     this.debugBreakState = null;
     this.debugTargetClock = -1;
     this.debugClock = 0;
@@ -254,11 +394,36 @@ export abstract class BaseDebugPlatform extends BasePlatform {
   setDebugCondition(debugCond : DebugCondition) {
     this.setBreakpoint('debug', debugCond);
   }
-  restartDebugging() {
-    if (this.debugSavedState) {
-      this.loadState(this.debugSavedState);
+  // binary snapshots (see SavesBinaryState) avoid building a state object every frame
+  getBinaryStateSize() : number { return 0; }
+  saveStateInto(buf:DataView, ofs:number) : number { return ofs; }
+  loadStateFrom(buf:DataView, ofs:number) : number { return ofs; }
+  saveDebugState() {
+    var size = this.getBinaryStateSize();
+    if (size > 0) {
+      if (!this.debugSavedBuffer || this.debugSavedBuffer.byteLength < size)
+        this.debugSavedBuffer = new DataView(new ArrayBuffer(size));
+      this.saveStateInto(this.debugSavedBuffer, 0);
+      this.debugSavedBinary = true;
+      this.debugSavedState = null;
     } else {
       this.debugSavedState = this.saveState();
+      this.debugSavedBinary = false;
+    }
+  }
+  loadDebugState() : boolean {
+    if (this.debugSavedBinary) {
+      this.loadStateFrom(this.debugSavedBuffer, 0);
+      return true;
+    } else if (this.debugSavedState) {
+      this.loadState(this.debugSavedState);
+      return true;
+    }
+    return false;
+  }
+  restartDebugging() {
+    if (!this.loadDebugState()) {
+      this.saveDebugState();
     }
     this.debugClock = 0;
     this.debugCallback = this.getDebugCallback();
@@ -269,7 +434,7 @@ export abstract class BaseDebugPlatform extends BasePlatform {
     // save state before frame, to record any inputs that happened pre-frame
     if (this.debugCallback && !this.debugBreakState) {
       // save state every frame and rewind debug clocks
-      this.debugSavedState = this.saveState();
+      this.saveDebugState();
       this.debugTargetClock -= this.debugClock;
       this.debugClock = 0;
     }
@@ -319,7 +484,7 @@ export abstract class BaseDebugPlatform extends BasePlatform {
   }
   runEval(evalfunc : DebugEvalCondition) {
     this.setDebugCondition( () => {
-      if (++this.debugClock >= this.debugTargetClock && this.isStable()) {
+      if (this.debugClock >= this.debugTargetClock && this.isStable()) {
         var cpuState = this.getCPUState();
         if (evalfunc(cpuState)) {
           this.breakpointHit(this.debugClock);
@@ -332,9 +497,7 @@ export abstract class BaseDebugPlatform extends BasePlatform {
   }
   runToPC(pc: number) {
     this.debugTargetClock++;
-    this.runEval((c) => {
-      return c.PC == pc;
-    });
+    this.setPCBreakpoint('debug', pc);
   }
   runUntilReturn() {
     var SP0 = this.getSP();
@@ -500,6 +663,75 @@ export function getOpcodeMetadata_6502(opcode, address) {
 
 ////// Z80
 
+// T-states from the emulator's tables; conditional jumps, calls and returns, DJNZ and
+// the repeating block instructions take the extra cycles below when taken
+var OPMETA_Z80 = {
+  cycletime: cycle_counts,
+  cycletime_ed: cycle_counts_ed,
+  cycletime_cb: cycle_counts_cb,
+  cycletime_dd: cycle_counts_dd, // for DD and FD (IX and IY), 0 if the prefix acts as a NOP
+  insnlengths: null as Uint8Array,    // filled in from the disassembler
+  insnlengths_ed: null as Uint8Array,
+  insnlengths_dd: null as Uint8Array,
+};
+
+function getExtraCycles_z80(opcode:number, op2:number) : number {
+  if (opcode == 0x10) return 5;                                   // DJNZ
+  if (opcode >= 0x20 && opcode <= 0x38 && (opcode & 7) == 0) return 5; // JR cc
+  if ((opcode & 0xc7) == 0xc0) return 6;                          // RET cc
+  if ((opcode & 0xc7) == 0xc4) return 7;                          // CALL cc
+  if (opcode == 0xed && (op2 & 0xf4) == 0xb0) return 5;           // LDIR etc. (repeating)
+  return 0;
+}
+
+function initInsnLengths_z80() {
+  var m = OPMETA_Z80;
+  m.insnlengths = new Uint8Array(256);
+  m.insnlengths_ed = new Uint8Array(256);
+  m.insnlengths_dd = new Uint8Array(256);
+  for (var op=0; op<256; op++) {
+    m.insnlengths[op] = disassembleZ80(0, op, 0, 0, 0).nbytes;
+    m.insnlengths_ed[op] = disassembleZ80(0, 0xed, op, 0, 0).nbytes;
+    m.insnlengths_dd[op] = disassembleZ80(0, 0xdd, op, 0, 0).nbytes;
+  }
+}
+
+// read() is needed for the bytes after a CB, DD, ED or FD prefix (returns null without it);
+// opcode is then the whole instruction (e.g. 0xedb0 for LDIR, 0xddcb06 for RLC (IX+d))
+export function getOpcodeMetadata_z80(opcode:number, address:number, read?:(addr:number) => number) : OpcodeMetadata {
+  var m = OPMETA_Z80;
+  if (!m.insnlengths) initInsnLengths_z80();
+  var cycles, len, op2 = 0;
+  switch (opcode) {
+    case 0xcb: case 0xdd: case 0xed: case 0xfd:
+      if (!read) return null;
+      op2 = read((address+1) & 0xffff);
+      if (opcode == 0xcb) {
+        cycles = m.cycletime_cb[op2];
+        len = 2;
+      } else if (opcode == 0xed) {
+        cycles = m.cycletime_ed[op2] || 8; // undefined ones act as 2-byte NOPs
+        len = m.insnlengths_ed[op2];
+      } else if (op2 == 0xcb) {
+        var op4 = read((address+3) & 0xffff);
+        cycles = m.cycletime_cb[op4] + 8;
+        len = 4;
+        op2 = (op2 << 8) | op4;
+      } else if (m.cycletime_dd[op2]) {
+        cycles = m.cycletime_dd[op2];
+        len = m.insnlengths_dd[op2];
+      } else {
+        return {opcode:opcode, minCycles:4, maxCycles:4, insnlength:1};
+      }
+      var extra = getExtraCycles_z80(opcode, op2);
+      opcode = (opcode << (op2 > 0xff ? 16 : 8)) | op2;
+      return {opcode:opcode, minCycles:cycles, maxCycles:cycles+extra, insnlength:len};
+    default:
+      cycles = m.cycletime[opcode];
+      return {opcode:opcode, minCycles:cycles, maxCycles:cycles+getExtraCycles_z80(opcode, 0), insnlength:m.insnlengths[opcode]};
+  }
+}
+
 export function cpuStateToLongString_Z80(c) {
   function decodeFlags(flags) {
     return printFlags(flags, ["S","Z",,"H",,"V","N","C"], true);
@@ -551,8 +783,6 @@ export abstract class BaseZ80Platform extends BaseDebugPlatform {
 
   getToolForFilename = getToolForFilename_z80;
   getDefaultExtension() { return ".c"; };
-  // TODO: Z80 opcode metadata
-  //this.getOpcodeMetadata = function() { }
 
   getDebugCategories() {
     return ['CPU','Stack'];
@@ -612,8 +842,9 @@ export function getToolForFilename_6809(fn:string) : string {
 export abstract class Base6809Platform extends BaseZ80Platform {
 
   newCPU(membus : MemoryBus) {
-    var cpu = new CPU6809();
-    cpu.init(membus.write, membus.read, 0);
+    var cpu = new MC6809();
+    cpu.connectMemoryBus(membus);
+    cpu.reset();
     return cpu;
   }
 
@@ -621,8 +852,7 @@ export abstract class Base6809Platform extends BaseZ80Platform {
     return cpuStateToLongString_6809(c);
   }
   disassemble(pc:number, read:(addr:number)=>number) : DisasmLine {
-    // TODO: don't create new CPU
-    return new CPU6809().disasm(read(pc), read(pc+1), read(pc+2), read(pc+3), read(pc+4), pc);
+    return disassemble6809(read(pc), read(pc+1), read(pc+2), read(pc+3), read(pc+4), pc);
   }
   getDefaultExtension() : string { return ".asm"; };
   //this.getOpcodeMetadata = function() { }
@@ -1022,9 +1252,11 @@ export function lookupSymbol(platform:Platform, addr:number, extra:boolean) {
 /// new Machine platform adapters
 
 import { Bus, Resettable, FrameBased, VideoSource, SampledAudioSource, AcceptsROM, AcceptsBIOS, AcceptsKeyInput, SavesState, SavesInputState, HasCPU, TrapCondition, CPU } from "./devices";
-import { Probeable, RasterFrameBased, AcceptsPaddleInput, SampledAudioSink, ProbeAll, NullProbe } from "./devices";
+import { Probeable, RasterFrameBased, AcceptsPaddleInput, SampledAudioSink, ProbeAll, NullProbe, UndoLog, BankSwitched, IdleLoopAware } from "./devices";
+import { BreakpointSet, WATCH_WRITE } from "./devices";
+import { RegisterLayout, ParsedBreakpoint, parseBreakpoint, formatTraceLine, REGS_6502, REGS_Z80 } from "./debugexpr";
 import { SampledAudio } from "./audio";
-import { ProbeRecorder } from "./recorder";
+import { ProbeRecorder, SamplingProbe, CoverageProbe } from "./recorder";
 
 export interface Machine extends Bus, Resettable, FrameBased, AcceptsROM, HasCPU, SavesState<EmuState>, SavesInputState<any> {
 }
@@ -1047,6 +1279,9 @@ function isRaster(arg:any): arg is RasterFrameBased {
 function hasProbe(arg:any): arg is Probeable {
     return typeof arg.connectProbe == 'function';
 }
+function hasBanks(arg:any): arg is BankSwitched {
+    return typeof arg.getBankAt == 'function';
+}
 function hasBIOS(arg:any): arg is AcceptsBIOS {
   return typeof arg.loadBIOS == 'function';
 }
@@ -1061,6 +1296,14 @@ export abstract class BaseMachinePlatform<T extends Machine> extends BaseDebugPl
   probeRecorder : ProbeRecorder;
   startProbing;
   stopProbing;
+  samplingProbe : SamplingProbe;
+  startSampling;
+  stopSampling;
+  coverageProbe : CoverageProbe;
+  startCoverage;
+  stopCoverage;
+  undoLog : UndoLog;
+  debugUndone : boolean = false; // CPU and memory were rewound, but not the other devices
   
   abstract newMachine() : T;
   abstract getToolForFilename(s:string) : string;
@@ -1082,6 +1325,60 @@ export abstract class BaseMachinePlatform<T extends Machine> extends BaseDebugPl
   getCPUState()  { return this.machine.cpu.saveState(); }
   loadControlsState(s)   { this.machine.loadControlsState(s); }
   saveControlsState()    { return this.machine.saveControlsState(); }
+  getBinaryStateSize()   { var m = this.machine as any; return m.getBinaryStateSize ? m.getBinaryStateSize() : 0; }
+  saveStateInto(buf:DataView, ofs:number) { return (this.machine as any).saveStateInto(buf, ofs); }
+  loadStateFrom(buf:DataView, ofs:number) { return (this.machine as any).loadStateFrom(buf, ofs); }
+
+  // journal instructions from the start of each debug frame, if the machine can undo them
+  saveDebugState() {
+    super.saveDebugState();
+    this.resetUndoLog();
+  }
+  loadDebugState() : boolean {
+    if (!super.loadDebugState()) return false;
+    this.resetUndoLog();
+    return true;
+  }
+  resetUndoLog() {
+    var m = this.machine as any;
+    this.debugUndone = false;
+    if (!m.canUndo || !m.canUndo()) return;
+    if (!this.undoLog) this.undoLog = new UndoLog(m.cpu);
+    this.undoLog.reset();
+    if (m.undoLog !== this.undoLog) m.connectUndoLog(this.undoLog);
+  }
+  clearDebug() {
+    var m = this.machine as any;
+    // only the CPU and memory were undone, so replay the frame up to here before running on
+    if (this.debugUndone && super.loadDebugState()) {
+      m.connectUndoLog(null);
+      this.advanceFrameClock(null, this.debugClock);
+    }
+    this.debugUndone = false;
+    if (m.undoLog) m.connectUndoLog(null);
+    super.clearDebug();
+  }
+  // undoes instructions until cond() is true or the log runs out; false if nothing was undone
+  undoUntil(cond:() => boolean) : boolean {
+    var log = this.undoLog;
+    // the log must hold every instruction since the debug state (one per debugClock tick)
+    if (!log || !this.debugBreakState || log.head != this.debugClock - 1 || !log.numUndoable())
+      return false;
+    do {
+      log.undo();
+      this.debugClock--;
+    } while (log.numUndoable() && !cond());
+    this.debugUndone = true;
+    this.breakpointHit(this.debugClock);
+    return true;
+  }
+  stepBack() {
+    if (!this.undoUntil(() => this.isStable()))
+      super.stepBack();
+  }
+  runBackToPC(pc:number) : boolean {
+    return this.undoUntil(() => this.isStable() && this.getPC() == pc);
+  }
   
   start() {
     const m = this.machine;
@@ -1117,6 +1414,24 @@ export abstract class BaseMachinePlatform<T extends Machine> extends BaseDebugPl
       this.stopProbing = () => {
         m.connectProbe(null);
       };
+      this.samplingProbe = new SamplingProbe(m);
+      if (hasBanks(m)) this.samplingProbe.getBank = (a) => m.getBankAt(a);
+      this.startSampling = () => {
+        m.connectProbe(this.samplingProbe);
+        return this.samplingProbe;
+      };
+      this.stopSampling = () => {
+        m.connectProbe(null);
+      };
+      this.coverageProbe = new CoverageProbe(m);
+      if (hasBanks(m)) this.coverageProbe.getBank = (a) => m.getBankAt(a);
+      this.startCoverage = () => {
+        m.connectProbe(this.coverageProbe);
+        return this.coverageProbe;
+      };
+      this.stopCoverage = () => {
+        m.connectProbe(null);
+      };
     }
     if (hasBIOS(m)) {
       this.loadBIOS = (title, data) => {
@@ -1161,6 +1476,22 @@ export abstract class BaseMachinePlatform<T extends Machine> extends BaseDebugPl
     }
   }
 
+  connectBreakpoints() {
+    var m = this.machine as any;
+    if (m.connectBreakpoints) m.connectBreakpoints(this.breakpoints.native);
+  }
+  canWatchMemory() : boolean {
+    return (this.machine as any).connectBreakpoints != null;
+  }
+  hasLiveRegisters() : boolean {
+    return (this.machine.cpu as any as IdleLoopAware).getRegisters != null;
+  }
+  readRegisters() : any {
+    if (!this.getRegisterLayout()) return this.getCPUState();
+    (this.machine.cpu as any as IdleLoopAware).getRegisters(this.registerBuf);
+    return this.registerBuf;
+  }
+
   isRunning() {
     return this.timer && this.timer.isRunning();
   }
@@ -1204,6 +1535,8 @@ export abstract class Base6502MachinePlatform<T extends Machine> extends BaseMac
   getOpcodeMetadata     = getOpcodeMetadata_6502;
   getToolForFilename    = getToolForFilename_6502;
 
+  getRegisterLayout() { return this.hasLiveRegisters() ? REGS_6502 : null; }
+
   disassemble(pc:number, read:(addr:number)=>number) : DisasmLine {
     return disassemble6502(pc, read(pc), read(pc+1), read(pc+2));
   }
@@ -1225,8 +1558,19 @@ export abstract class Base6502MachinePlatform<T extends Machine> extends BaseMac
 
 export abstract class BaseZ80MachinePlatform<T extends Machine> extends BaseMachinePlatform<T> {
 
-  //getOpcodeMetadata     = getOpcodeMetadata_z80;
   getToolForFilename    = getToolForFilename_z80;
+  nmiFrameInterrupt     = false; // the video interrupt is the NMI, not INT
+
+  getOpcodeMetadata(opcode:number, offset:number) : OpcodeMetadata {
+    return getOpcodeMetadata_z80(opcode, offset, (a) => this.readAddress(a));
+  }
+  newCodeAnalyzer() : CodeAnalyzer {
+    var m : any = this.machine;
+    var frameClocks = Math.round(m.cpuCyclesPerLine * m.numTotalScanlines) || 0;
+    return new CodeAnalyzer_z80(this, frameClocks, this.nmiFrameInterrupt);
+  }
+
+  getRegisterLayout() { return this.hasLiveRegisters() ? REGS_Z80 : null; }
 
   getDebugCategories() {
     if (isDebuggable(this.machine))
@@ -1433,7 +1777,7 @@ export abstract class BaseWASMMachine {
     if (this.probe && !(this.probe instanceof NullProbe)) {
       var datalen = this.exports.machine_get_probe_buffer_size();
       var dataaddr = this.exports.machine_get_probe_buffer_address();
-      // TODO: more efficient way to put into probe
+      // addLogBuffer() packs the events as it copies them
       var databuf = new Uint32Array(this.exports.memory.buffer, dataaddr, datalen);
       this.probe.logNewFrame(); // TODO: machine should do this
       this.probe.addLogBuffer(databuf);
@@ -0,0 +1,2573 @@
+import { CPU, Bus, InstructionBased, SavesState, SavesBinaryState, Interruptable, MemoryPageTable, MemoryPagesConnected, IdleLoopAware } from "../devices";
+/*
+The MIT License (MIT)
+Copyright (c) 2014 Martin Maly, http://retrocip.cz, http://www.uelectronics.info,
+twitter: @uelectronics
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+export function FastMC6809() {
+
+var ticks;
+var rA=0,rB=0,rX=0,rY=0,rU=0,rS=0,PC=0,CC=0,DP=0,
+F_CARRY     =1,
+F_OVERFLOW  =2,
+F_ZERO      =4,
+F_NEGATIVE  =8,
+F_IRQMASK   =16,
+F_HALFCARRY =32,
+F_FIRQMASK  =64,
+F_ENTIRE    =128,
+
+vecRESET = 0xFFFE,
+vecNMI = 0xFFFC,
+vecSWI = 0xFFFA,
+vecIRQ = 0xFFF8,
+vecFIRQ = 0xFFF6,
+vecSWI2 = 0xFFF4,
+vecSWI3 = 0xFFF2,
+
+T=0;
+
+var IRQs;
+
+// Memory goes through busWrite/busRead, except for pages mapped in
+//  readPages/writePages (see MemoryPageTable), which are plain arrays.
+var busWrite, busRead;
+var readPages : Uint8Array[] = new Array(256);
+var writePages : Uint8Array[] = new Array(256);
+
+var byteAt = function(addr:number) : number {
+    var page = readPages[addr >>> 8];
+    return page ? page[addr & 0xff] : busRead(addr);
+};
+var byteTo = function(addr:number, v:number) {
+    var page = writePages[addr >>> 8];
+    if (page) page[addr & 0xff] = v;
+    else busWrite(addr, v);
+};
+
+var cycles = [
+      6,0,0,6,6,0,6,6,6,6,6,0,6,6,3,6,          /* 00-0F */
+      0,0,2,4,0,0,5,9,0,2,3,0,3,2,8,6,          /* 10-1F */
+      3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,          /* 20-2F */
+      4,4,4,4,5,5,5,5,0,5,3,6,9,11,0,19,        /* 30-3F */
+      2,0,0,2,2,0,2,2,2,2,2,0,2,2,0,2,          /* 40-4F */
+      2,0,0,2,2,0,2,2,2,2,2,0,2,2,0,2,          /* 50-5F */
+      6,0,0,6,6,0,6,6,6,6,6,0,6,6,3,6,          /* 60-6F */
+      7,0,0,7,7,0,7,7,7,7,7,0,7,7,4,7,          /* 70-7F */
+      2,2,2,4,2,2,2,0,2,2,2,2,4,7,3,0,          /* 80-8F */
+      4,4,4,6,4,4,4,4,4,4,4,4,6,7,5,5,          /* 90-9F */
+      4,4,4,6,4,4,4,4,4,4,4,4,6,7,5,5,          /* A0-AF */
+      5,5,5,7,5,5,5,5,5,5,5,5,7,8,6,6,          /* B0-BF */
+      2,2,2,4,2,2,2,0,2,2,2,2,3,0,3,0,          /* C0-CF */
+      4,4,4,6,4,4,4,4,4,4,4,4,5,5,5,5,          /* D0-DF */
+      4,4,4,6,4,4,4,4,4,4,4,4,5,5,5,5,          /* E0-EF */
+      5,5,5,7,5,5,5,5,5,5,5,5,6,6,6,6];         /* F0-FF */
+
+/* Instruction timing for the two-byte opcodes */
+var cycles2 = [
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 00-0F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 10-1F */
+      0,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,          /* 20-2F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,20,         /* 30-3F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 40-4F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 50-5F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 60-6F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 70-7F */
+      0,0,0,5,0,0,0,0,0,0,0,0,5,0,4,0,          /* 80-8F */
+      0,0,0,7,0,0,0,0,0,0,0,0,7,0,6,6,          /* 90-9F */
+      0,0,0,7,0,0,0,0,0,0,0,0,7,0,6,6,          /* A0-AF */
+      0,0,0,8,0,0,0,0,0,0,0,0,8,0,7,7,          /* B0-BF */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,0,          /* C0-CF */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,6,6,          /* D0-DF */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,6,6,          /* E0-EF */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,7,7];         /* F0-FF */
+
+/* Negative and zero flags for quicker flag settings */
+var flagsNZ = [
+      4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 00-0F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 10-1F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 20-2F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 30-3F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 40-4F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 50-5F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 60-6F */
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,          /* 70-7F */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* 80-8F */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* 90-9F */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* A0-AF */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* B0-BF */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* C0-CF */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* D0-DF */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,          /* E0-EF */
+      8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8];         /* F0-FF */
+
+var setV8 = function(a,b,r) {CC |= (((a^b^r^(r>>1))&0x80)>>6);};
+var setV16 = function(a,b,r) {CC |= (((a^b^r^(r>>1))&0x8000)>>14);};
+var getD = function() {return (rA<<8)+rB;};
+var setD = function(v) {rA = (v>>8)& 0xff;rB=v&0xff;};
+var PUSHB = function(b) {
+    byteTo(--rS, b & 0xff);
+};
+var PUSHW = function(b) {
+    byteTo(--rS, b & 0xff);
+    byteTo(--rS, (b>>8) & 0xff);
+};
+
+var PUSHBU = function(b) {
+    byteTo(--rU, b & 0xff);
+};
+var PUSHWU = function(b) {
+    byteTo(--rU, b & 0xff);
+    byteTo(--rU, (b>>8) & 0xff);
+};
+var PULLB = function() {
+    return byteAt(rS++);
+};
+var PULLW = function() {
+    return byteAt(rS++) * 256 + byteAt(rS++);
+};
+
+var PULLBU = function() {
+    return byteAt(rU++);
+};
+var PULLWU = function() {
+    return byteAt(rU++) * 256 + byteAt(rU++);
+};
+
+var PSHS = function(ucTemp)  {
+      var i = 0;
+         if (ucTemp & 0x80) {PUSHW(PC);i += 2;}
+         if (ucTemp & 0x40) {PUSHW(rU);i += 2;}
+         if (ucTemp & 0x20){PUSHW(rY);i += 2;}
+         if (ucTemp & 0x10){PUSHW(rX);i += 2;}
+         if (ucTemp & 0x8){PUSHB(DP); i++;}
+         if (ucTemp & 0x4){PUSHB(rB); i++;}
+         if (ucTemp & 0x2){PUSHB(rA); i++;}
+         if (ucTemp & 0x1){PUSHB(CC); i++;}
+         T+=i; //timing
+};
+var PSHU = function(ucTemp)  {
+      var i = 0;
+         if (ucTemp & 0x80) {PUSHWU(PC);i += 2;}
+         if (ucTemp & 0x40) {PUSHWU(rS);i += 2;}
+         if (ucTemp & 0x20){PUSHWU(rY);i += 2;}
+         if (ucTemp & 0x10){PUSHWU(rX);i += 2;}
+         if (ucTemp & 0x8){PUSHBU(DP); i++;}
+         if (ucTemp & 0x4){PUSHBU(rB); i++;}
+         if (ucTemp & 0x2){PUSHBU(rA); i++;}
+         if (ucTemp & 0x1){PUSHBU(CC); i++;}
+         T+=i; //timing
+};
+var PULS = function(ucTemp)  {
+      var i = 0;
+      if (ucTemp & 0x1){CC = PULLB(); i++;}
+      if (ucTemp & 0x2){rA = PULLB(); i++;}
+      if (ucTemp & 0x4){rB = PULLB(); i++;}
+      if (ucTemp & 0x8){DP = PULLB(); i++;}
+      if (ucTemp & 0x10){rX = PULLW();i += 2;}
+      if (ucTemp & 0x20){rY = PULLW();i += 2;}
+      if (ucTemp & 0x40) {rU = PULLW();i += 2;}
+      if (ucTemp & 0x80) {PC = PULLW();i += 2;}
+      T+=i; //timing
+};
+var PULU = function(ucTemp)  {
+      var i = 0;
+      if (ucTemp & 0x1){CC = PULLBU(); i++;}
+      if (ucTemp & 0x2){rA = PULLBU(); i++;}
+      if (ucTemp & 0x4){rB = PULLBU(); i++;}
+      if (ucTemp & 0x8){DP = PULLBU(); i++;}
+      if (ucTemp & 0x10){rX = PULLWU();i += 2;}
+      if (ucTemp & 0x20){rY = PULLWU();i += 2;}
+      if (ucTemp & 0x40) {rS = PULLWU();i += 2;}
+      if (ucTemp & 0x80) {PC = PULLWU();i += 2;}
+      T+=i; //timing
+};
+
+
+var getPBR = function(ucPostByte) {
+    switch(ucPostByte & 0xf) {
+       case 0x00: /* D */
+            return getD();
+       case 0x1: /* X */
+          return rX;
+       case 0x2: /* Y */
+          return rY;
+       case 0x3: /* U */
+          return rU;
+       case 0x4: /* S */
+          return rS;
+       case 0x5: /* PC */
+          return PC;
+       case 0x8: /* A */
+          return rA;
+       case 0x9: /* B */
+          return rB;
+       case 0xA: /* CC */
+          return CC;
+       case 0xB: /* DP */
+          return DP;
+       default: /* illegal */
+          return null;
+       }
+};
+var setPBR = function(ucPostByte, v) {
+    switch(ucPostByte & 0xf) /* Get destination register */
+       {
+       case 0x00: /* D */
+            setD(v);return;
+       case 0x1: /* X */
+          rX = v; return;
+       case 0x2: /* Y */
+          rY = v; return;
+       case 0x3: /* U */
+          rU = v; return;
+       case 0x4: /* S */
+          rS = v; return;
+       case 0x5: /* PC */
+          PC = v; return;
+       case 0x8: /* A */
+          rA = v; return;
+       case 0x9: /* B */
+          rB = v; return;
+       case 0xA: /* CC */
+          CC = v; return;
+       case 0xB: /* DP */
+          DP = v; return;
+       default: /* illegal */
+          return;
+       }
+};
+
+var TFREXG = function(ucPostByte, bExchange)
+{
+
+   var ucTemp = ucPostByte & 0x88;
+   if (ucTemp == 0x80 || ucTemp == 0x08)
+      ucTemp = 0; /* PROBLEM! */
+
+    if (bExchange)
+          {
+          ucTemp = getPBR(ucPostByte>>4);
+          setPBR(ucPostByte>>4, getPBR(ucPostByte));
+          setPBR(ucPostByte, ucTemp);
+          }
+       else /* Transfer */ {
+          setPBR(ucPostByte, getPBR(ucPostByte>>4));
+        }
+} ;
+
+var signed = function(x) {
+    return (x>127)?(x-256):x;
+};
+var signed16 = function(x) {
+    return (x>32767)?(x-65536):x;
+};
+
+var fetch = function() {
+    var v = byteAt(PC++);
+    PC &= 0xffff;
+    return v;
+};
+var fetch16 = function() {
+    var v1 = byteAt(PC++);
+    PC &= 0xffff;
+    var v2 = byteAt(PC++);
+    PC &= 0xffff;
+    return v1*256+v2;
+};
+
+var ReadWord = function(addr) {
+    var v1 = byteAt(addr++);
+    addr &= 0xffff;
+    var v2 = byteAt(addr++);
+    addr &= 0xffff;
+    return v1*256+v2;
+};
+var WriteWord = function(addr,v) {
+    byteTo(addr++,(v>>8)&0xff);
+    addr &= 0xffff;
+    byteTo(addr,v&0xff);
+};
+
+var PostByte = function() {
+    var pb = fetch();
+    var preg;
+    switch (pb & 0x60) {
+        case 0:
+            preg = rX; break;
+        case 0x20:
+            preg = rY; break;
+        case 0x40:
+            preg = rU; break;
+        case 0x60:
+            preg = rS; break;
+    }
+
+    var xchg = null;
+    var addr = null;
+    var sTemp;
+
+    if (pb & 0x80) /* Complex stuff */
+       {
+       switch (pb & 0x0f)
+          {
+          case 0: /* EA = ,reg+ */
+             addr = preg;
+             xchg = preg + 1;
+             T += 2;
+             break;
+          case 1: /* EA = ,reg++ */
+             addr = preg;
+             xchg = preg + 2;
+             T += 3;
+             break;
+          case 2: /* EA = ,-reg */
+             xchg = preg - 1;
+             addr = xchg;
+             T += 2;
+             break;
+          case 3: /* EA = ,--reg */
+             xchg = preg - 2;
+             addr = xchg;
+             T += 3;
+             break;
+          case 4: /* EA = ,reg */
+             addr = preg;
+             break;
+          case 5: /* EA = ,reg + B */
+             //usAddr = *pReg + (signed short)(signed char)regs->ucRegB;
+             addr = preg + signed(rB);
+             T += 1;
+             break;
+          case 6: /* EA = ,reg + A */
+              addr = preg + signed(rA);
+              T += 1;
+             break;
+          case 7: /* illegal */
+             addr = 0;
+             break;
+          case 8: /* EA = ,reg + 8-bit offset */
+             addr = preg + signed(fetch());
+             T += 1;
+             break;
+          case 9: /* EA = ,reg + 16-bit offset */
+             addr = preg + signed16(fetch16());
+             T += 4;
+             break;
+          case 0xA: /* illegal */
+             addr = 0;
+             break;
+          case 0xB: /* EA = ,reg + D */
+             T += 4;
+             addr = preg + getD();
+             break;
+          case 0xC: /* EA = PC + 8-bit offset */
+             sTemp = signed(fetch());
+             addr = PC + sTemp;
+             T += 1;
+             break;
+          case 0xD: /* EA = PC + 16-bit offset */
+             sTemp =  signed16(fetch16());
+             addr = PC + sTemp;
+             T += 5;
+             break;
+          case 0xe: /* Illegal */
+             addr = 0;
+             break;
+          case 0xF: /* EA = [,address] */
+             T += 5;
+             addr = fetch16();
+             break;
+          } /* switch */
+
+       addr &= 0xffff;
+
+       if (pb & 0x10) /* Indirect addressing */
+          {
+          addr = byteAt(addr)*256+byteAt((addr+1) & 0xffff);
+          T += 3;
+          }
+       }
+    else /* Just a 5 bit signed offset + register */
+       {
+       var sByte = pb & 0x1f;
+       if (sByte > 15) /* Two's complement 5-bit value */
+          sByte -= 32;
+       addr = preg + sByte;
+       T += 1;
+       }
+
+    if (xchg!==null) {
+        switch (pb & 0x60) {
+            case 0:
+                rX = xchg; break;
+            case 0x20:
+                rY = xchg; break;
+            case 0x40:
+                rU = xchg; break;
+            case 0x60:
+                rS = xchg; break;
+        }
+
+    }
+
+    return addr & 0xffff; /* Return the effective address */
+};
+
+var flagsNZ16 = function(word) {
+    CC &= ~(F_ZERO | F_NEGATIVE);
+    if (word===0) CC |= F_ZERO;
+    if (word & 0x8000) CC |= F_NEGATIVE;
+};
+
+// ============= Operations
+
+var oINC = function(b) {
+   b++;
+   b &= 0xff;
+   CC &= ~(F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[b];
+   if (b === 0 || b == 0x80) CC |= F_OVERFLOW;
+   return b;
+};
+var oDEC = function(b) {
+   b--;
+   b &= 0xff;
+   CC &= ~(F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[b];
+   if (b === 0x7f || b == 0xff) CC |= F_OVERFLOW;
+   return b;
+};
+var oSUB = function(b,v) {
+   var temp = b-v;
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[temp & 0xff];
+   if (temp&0x100) CC|=F_CARRY;
+   setV8(b,v,temp);
+   return temp&0xff;
+};
+var oSUB16 = function(b,v) {
+   var temp = b-v;
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   if ((temp&0xffff)===0) CC|=F_ZERO;
+   if (temp&0x8000) CC|=F_NEGATIVE;
+   if (temp&0x10000) CC|=F_CARRY;
+   setV16(b,v,temp);
+   return temp&0xffff;
+};
+var oADD = function(b,v) {
+   var temp = b+v;
+   //temp &= 0xff;
+   CC &= ~(F_HALFCARRY | F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[temp & 0xff];
+   if (temp&0x100) CC|=F_CARRY;
+   setV8(b,v,temp);
+   if ((temp ^ b ^ v)&0x10) CC |= F_HALFCARRY;
+   return temp&0xff;
+};
+var oADD16 = function(b,v) {
+   var temp = b+v;
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   if ((temp&0xffff)===0) CC|=F_ZERO;
+   if (temp&0x8000) CC|=F_NEGATIVE;
+   if (temp&0x10000) CC|=F_CARRY;
+   setV16(b,v,temp);
+   return temp&0xffff;
+};
+var oADC = function(b,v) {
+   var temp = b+v+(CC & F_CARRY);
+   //temp &= 0xff;
+   CC &= ~(F_HALFCARRY | F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[temp & 0xff];
+   if (temp&0x100) CC|=F_CARRY;
+   setV8(b,v,temp);
+   if ((temp ^ b ^ v)&0x10) CC |= F_HALFCARRY;
+   return temp&0xff;
+};
+var oSBC = function(b,v) {
+   var temp = b-v-(CC & F_CARRY);
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[temp & 0xff];
+   if (temp&0x100) CC|=F_CARRY;
+   setV8(b,v,temp);
+   return temp&0xff;
+};
+var oCMP = function(b,v) {
+   var temp = b-v;
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   CC |= flagsNZ[temp & 0xff];
+   if (temp&0x100) CC|=F_CARRY;
+   setV8(b,v,temp);
+   return;
+};
+var oCMP16 = function(b,v) {
+   var temp = b-v;
+   //temp &= 0xff;
+   CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   if ((temp&0xffff)===0) CC|=F_ZERO;
+   if (temp&0x8000) CC|=F_NEGATIVE;
+   if (temp&0x10000) CC|=F_CARRY;
+   setV16(b,v,temp);
+   return;
+};
+
+var oNEG = function(b) {
+    CC &= ~(F_CARRY | F_ZERO | F_OVERFLOW | F_NEGATIVE);
+   if (b == 0x80)
+      CC |= F_OVERFLOW;
+   b = ((~b)&0xff) + 1;
+   if (b === 0) CC |= F_ZERO;
+   if (b & 0x80) CC |= F_NEGATIVE | F_CARRY;
+   return b;
+};
+
+var oLSR = function(b) {
+    CC &= ~(F_ZERO | F_CARRY | F_NEGATIVE);
+    if (b & 0x01) CC |= F_CARRY;
+    b >>= 1;
+    if (b === 0) CC |= F_ZERO;
+    return b & 0xff;
+};
+var oASR = function(b) {
+    CC &= ~(F_ZERO | F_CARRY | F_NEGATIVE);
+    if (b & 0x01) CC |= F_CARRY;
+    b = (b & 0x80) | (b>>1);
+    CC |= flagsNZ[b];
+    return b;
+};
+var oASL = function(b) {
+    var temp = b;
+    CC &= ~(F_ZERO | F_CARRY | F_NEGATIVE | F_OVERFLOW);
+    if (b & 0x80) CC |= F_CARRY;
+    b <<= 1;
+    CC |= flagsNZ[b];
+    if ((b ^ temp) & 0x80) CC|=F_OVERFLOW;
+    return b;
+};
+var oROL = function(b) {
+    var temp = b;
+    var oldc = CC&F_CARRY;
+    CC &= ~(F_ZERO | F_CARRY | F_NEGATIVE | F_OVERFLOW);
+    if (b & 0x80) CC |= F_CARRY;
+    b = b<<1 | oldc;
+    CC |= flagsNZ[b];
+    if ((b ^ temp) & 0x80) CC|=F_OVERFLOW;
+    return b;
+};
+var oROR = function(b) {
+    var oldc = CC&F_CARRY;
+    CC &= ~(F_ZERO | F_CARRY | F_NEGATIVE);
+    if (b & 0x01) CC |= F_CARRY;
+    b = b>>1 | oldc<<7;
+    CC |= flagsNZ[b];
+//    if ((b ^ temp) & 0x80) CC|=F_OVERFLOW;
+    return b;
+};
+
+var oEOR = function(b,v) {
+    CC &= ~(F_ZERO | F_NEGATIVE | F_OVERFLOW);
+    b ^= v;
+    CC |= flagsNZ[b];
+    return b;
+};
+var oOR = function(b,v) {
+    CC &= ~(F_ZERO | F_NEGATIVE | F_OVERFLOW);
+    b |= v;
+    CC |= flagsNZ[b];
+    return b;
+};
+var oAND = function(b,v) {
+    CC &= ~(F_ZERO | F_NEGATIVE | F_OVERFLOW);
+    b &= v;
+    CC |= flagsNZ[b];
+    return b;
+};
+var oCOM = function(b) {
+    CC &= ~(F_ZERO | F_NEGATIVE | F_OVERFLOW);
+    b ^= 0xff;
+    CC |= flagsNZ[b];
+    CC |= F_CARRY;
+    return b;
+};
+
+//----common
+var dpadd = function() {
+    //direct page + 8bit index
+    return DP*256 + fetch();
+};
+
+//---------- Instructions
+
+// One function per opcode, like the instruction tables of the Z80 core;
+//  the 0x10 and 0x11 prefixes dispatch again through ops10 and ops11.
+var ops = new Array(256);
+ops[0x00] = function() { //NEG DP
+    var addr = dpadd();
+    byteTo(addr, oNEG(byteAt(addr)));
+};
+ops[0x03] = function() { //COM DP
+    var addr = dpadd();
+    byteTo(addr, oCOM(byteAt(addr)));
+};
+ops[0x04] = function() { //LSR DP
+    var addr = dpadd();
+    byteTo(addr, oLSR(byteAt(addr)));
+};
+ops[0x06] = function() { //ROR DP
+    var addr = dpadd();
+    byteTo(addr, oROR(byteAt(addr)));
+};
+ops[0x07] = function() { //ASR DP
+    var addr = dpadd();
+    byteTo(addr, oASR(byteAt(addr)));
+};
+ops[0x08] = function() { //ASL DP
+    var addr = dpadd();
+    byteTo(addr, oASL(byteAt(addr)));
+};
+ops[0x09] = function() { //ROL DP
+    var addr = dpadd();
+    byteTo(addr, oROL(byteAt(addr)));
+};
+ops[0x0A] = function() { //DEC DP
+    var addr = dpadd();
+    byteTo(addr, oDEC(byteAt(addr)));
+};
+ops[0x0C] = function() { //INC DP
+    var addr = dpadd();
+    byteTo(addr, oINC(byteAt(addr)));
+};
+ops[0x0D] = function() { //TST DP
+    var addr = dpadd();
+    var pb = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[pb];
+};
+ops[0x0E] = function() { //JMP DP
+    var addr = dpadd();
+    PC = addr;
+};
+ops[0x0F] = function() { //CLR DP
+    var addr = dpadd();
+    byteTo(addr,0);
+    CC&=~(F_CARRY|F_NEGATIVE|F_OVERFLOW);
+    CC |= F_ZERO;
+};
+ops[0x12] = function() { //NOP
+};
+ops[0x13] = function() { //SYNC
+};
+ops[0x16] = function() { //LBRA relative
+    var addr = signed16(fetch16());
+    PC += addr;
+};
+ops[0x17] = function() { //LBSR relative
+    var addr = signed16(fetch16());
+    PUSHW(PC);
+    PC += addr;
+};
+ops[0x19] = function() { //DAA
+    var cf = 0;
+    var nhi = rA & 0xf0, nlo = rA & 0x0f;
+    if( nlo>0x09 || CC & 0x20 ) cf |= 0x06;
+    if( nhi>0x80 && nlo>0x09 ) cf |= 0x60;
+    if( nhi>0x90 || CC & 0x01 ) cf |= 0x60;
+    var addr = cf + rA;
+    CC  &= ~(F_CARRY | F_NEGATIVE | F_ZERO | F_OVERFLOW);
+    if (addr & 0x100)
+       CC  |= F_CARRY;
+    rA = addr & 0xff;
+    CC  |= flagsNZ[rA];
+};
+ops[0x1A] = function() { //ORCC
+    CC |= fetch();
+};
+ops[0x1C] = function() { //ANDCC
+    CC &= fetch();
+};
+ops[0x1D] = function() { //SEX
+    rA = (rB & 0x80)?0xff:0;
+    flagsNZ16(getD());
+    CC &= ~F_OVERFLOW;
+};
+ops[0x1E] = function() { //EXG
+    var pb = fetch();
+    TFREXG(pb,true);
+};
+ops[0x1F] = function() { //EXG
+    var pb = fetch();
+    TFREXG(pb,false);
+};
+ops[0x20] = function() { //BRA
+    var addr = signed(fetch());
+    PC += addr;
+};
+ops[0x21] = function() { //BRN
+    var addr = signed(fetch());
+};
+ops[0x22] = function() { //BHI
+    var addr = signed(fetch());
+    if (!(CC&(F_CARRY | F_ZERO))) PC += addr;
+};
+ops[0x23] = function() { //BLS
+    var addr = signed(fetch());
+    if (CC&(F_CARRY | F_ZERO)) PC += addr;
+};
+ops[0x24] = function() { //BCC
+    var addr = signed(fetch());
+    if (!(CC&F_CARRY)) PC += addr;
+};
+ops[0x25] = function() { //BCS
+    var addr = signed(fetch());
+    if (CC&F_CARRY) PC += addr;
+};
+ops[0x26] = function() { //BNE
+    var addr = signed(fetch());
+    if (!(CC&F_ZERO)) PC += addr;
+};
+ops[0x27] = function() { //BEQ
+    var addr = signed(fetch());
+    if (CC&F_ZERO) PC += addr;
+};
+ops[0x28] = function() { //BVC
+    var addr = signed(fetch());
+    if (!(CC&F_OVERFLOW)) PC += addr;
+};
+ops[0x29] = function() { //BVS
+    var addr = signed(fetch());
+    if (CC&F_OVERFLOW) PC += addr;
+};
+ops[0x2A] = function() { //BPL
+    var addr = signed(fetch());
+    if (!(CC&F_NEGATIVE)) PC += addr;
+};
+ops[0x2B] = function() { //BMI
+    var addr = signed(fetch());
+    if (CC&F_NEGATIVE) PC += addr;
+};
+ops[0x2C] = function() { //BGE
+    var addr = signed(fetch());
+    if (!((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2))) PC += addr;
+};
+ops[0x2D] = function() { //BLT
+    var addr = signed(fetch());
+    if ((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2)) PC += addr;
+};
+ops[0x2E] = function() { //BGT
+    var addr = signed(fetch());
+    if (!((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2) || (CC&F_ZERO))) PC += addr;
+};
+ops[0x2F] = function() { //BLE
+    var addr = signed(fetch());
+    if ((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2) || (CC&F_ZERO)) PC += addr;
+};
+ops[0x30] = function() { //LEAX
+    rX = PostByte();
+    if (rX===0) CC|=F_ZERO; else CC&=~F_ZERO;
+};
+ops[0x31] = function() { //LEAY
+    rY = PostByte();
+    if (rY===0) CC|=F_ZERO; else CC&=~F_ZERO;
+};
+ops[0x32] = function() { //LEAS
+    rS = PostByte();
+};
+ops[0x33] = function() { //LEAU
+    rU = PostByte();
+};
+ops[0x34] = function() { //PSHS
+    PSHS(fetch());
+};
+ops[0x35] = function() { //PULS
+    PULS(fetch());
+};
+ops[0x36] = function() { //PSHU
+    PSHU(fetch());
+};
+ops[0x37] = function() { //PULU
+    PULU(fetch());
+};
+ops[0x39] = function() { //RTS
+    PC = PULLW();
+};
+ops[0x3A] = function() { //ABX
+    rX += rB;
+};
+ops[0x3B] = function() { //RTI
+    CC = PULLB();
+    if (CC & F_ENTIRE) {
+        T+=9;
+        rA = PULLB();
+        rB = PULLB();
+        DP = PULLB();
+        rX = PULLW();
+        rY = PULLW();
+        rU = PULLW();
+    }
+    PC = PULLW();
+};
+ops[0x3C] = function() { //CWAI **todo
+    CC &= fetch();
+};
+ops[0x3D] = function() { //MUL
+    var addr = rA * rB;
+    if (addr===0) CC|=F_ZERO; else CC&=~F_ZERO;
+    if (addr&0x80) CC|=F_CARRY; else CC&=~F_CARRY;
+    setD(addr);
+};
+ops[0x3F] = function() { //SWI
+    CC |= F_ENTIRE;
+    PUSHW(PC);
+    PUSHW(rU);
+    PUSHW(rY);
+    PUSHW(rX);
+    PUSHB(DP);
+    PUSHB(rB);
+    PUSHB(rA);
+    PUSHB(CC);
+    CC |= F_IRQMASK | F_FIRQMASK;
+    PC = ReadWord(vecSWI);
+};
+ops[0x40] = function() {
+    rA = oNEG(rA);
+};
+ops[0x43] = function() {
+    rA = oCOM(rA);
+};
+ops[0x44] = function() {
+    rA = oLSR(rA);
+};
+ops[0x46] = function() {
+    rA = oROR(rA);
+};
+ops[0x47] = function() {
+    rA = oASR(rA);
+};
+ops[0x48] = function() {
+    rA = oASL(rA);
+};
+ops[0x49] = function() {
+    rA = oROL(rA);
+};
+ops[0x4A] = function() {
+    rA = oDEC(rA);
+};
+ops[0x4C] = function() {
+    rA = oINC(rA);
+};
+ops[0x4D] = function() {
+    CC &= ~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0x4F] = function() {
+    rA = 0;
+    CC &= ~(F_NEGATIVE|F_OVERFLOW|F_CARRY);
+    CC |= F_ZERO;
+};
+ops[0x50] = function() {
+    rB = oNEG(rB);
+};
+ops[0x53] = function() {
+    rB = oCOM(rB);
+};
+ops[0x54] = function() {
+    rB = oLSR(rB);
+};
+ops[0x56] = function() {
+    rB = oROR(rB);
+};
+ops[0x57] = function() {
+    rB = oASR(rB);
+};
+ops[0x58] = function() {
+    rB = oASL(rB);
+};
+ops[0x59] = function() {
+    rB = oROL(rB);
+};
+ops[0x5A] = function() {
+    rB = oDEC(rB);
+};
+ops[0x5C] = function() {
+    rB = oINC(rB);
+};
+ops[0x5D] = function() {
+    CC &= ~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0x5F] = function() {
+    rB = 0;
+    CC &= ~(F_NEGATIVE|F_OVERFLOW|F_CARRY);
+    CC |= F_ZERO;
+};
+ops[0x60] = function() { //NEG indexed
+    var addr = PostByte();
+    byteTo(addr, oNEG(byteAt(addr)));
+};
+ops[0x63] = function() { //COM indexed
+    var addr = PostByte();
+    byteTo(addr, oCOM(byteAt(addr)));
+};
+ops[0x64] = function() { //LSR indexed
+    var addr = PostByte();
+    byteTo(addr, oLSR(byteAt(addr)));
+};
+ops[0x66] = function() { //ROR indexed
+    var addr = PostByte();
+    byteTo(addr, oROR(byteAt(addr)));
+};
+ops[0x67] = function() { //ASR indexed
+    var addr = PostByte();
+    byteTo(addr, oASR(byteAt(addr)));
+};
+ops[0x68] = function() { //ASL indexed
+    var addr = PostByte();
+    byteTo(addr, oASL(byteAt(addr)));
+};
+ops[0x69] = function() { //ROL indexed
+    var addr = PostByte();
+    byteTo(addr, oROL(byteAt(addr)));
+};
+ops[0x6A] = function() { //DEC indexed
+    var addr = PostByte();
+    byteTo(addr, oDEC(byteAt(addr)));
+};
+ops[0x6C] = function() { //INC indexed
+    var addr = PostByte();
+    byteTo(addr, oINC(byteAt(addr)));
+};
+ops[0x6D] = function() { //TST indexed
+    var addr = PostByte();
+    var pb = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[pb];
+};
+ops[0x6E] = function() { //JMP indexed
+    var addr = PostByte();
+    PC = addr;
+};
+ops[0x6F] = function() { //CLR indexed
+    var addr = PostByte();
+    byteTo(addr,0);
+    CC&=~(F_CARRY|F_NEGATIVE|F_OVERFLOW);
+    CC |= F_ZERO;
+};
+ops[0x70] = function() { //NEG extended
+    var addr = fetch16();
+    byteTo(addr, oNEG(byteAt(addr)));
+};
+ops[0x73] = function() { //COM extended
+    var addr = fetch16();
+    byteTo(addr, oCOM(byteAt(addr)));
+};
+ops[0x74] = function() { //LSR extended
+    var addr = fetch16();
+    byteTo(addr, oLSR(byteAt(addr)));
+};
+ops[0x76] = function() { //ROR extended
+    var addr = fetch16();
+    byteTo(addr, oROR(byteAt(addr)));
+};
+ops[0x77] = function() { //ASR extended
+    var addr = fetch16();
+    byteTo(addr, oASR(byteAt(addr)));
+};
+ops[0x78] = function() { //ASL extended
+    var addr = fetch16();
+    byteTo(addr, oASL(byteAt(addr)));
+};
+ops[0x79] = function() { //ROL extended
+    var addr = fetch16();
+    byteTo(addr, oROL(byteAt(addr)));
+};
+ops[0x7A] = function() { //DEC extended
+    var addr = fetch16();
+    byteTo(addr, oDEC(byteAt(addr)));
+};
+ops[0x7C] = function() { //INC extended
+    var addr = fetch16();
+    byteTo(addr, oINC(byteAt(addr)));
+};
+ops[0x7D] = function() { //TST extended
+    var addr = fetch16();
+    var pb = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[pb];
+};
+ops[0x7E] = function() { //JMP extended
+    var addr = fetch16();
+    PC = addr;
+};
+ops[0x7F] = function() { //CLR extended
+    var addr = fetch16();
+    byteTo(addr,0);
+    CC&=~(F_CARRY|F_NEGATIVE|F_OVERFLOW);
+    CC |= F_ZERO;
+};
+ops[0x80] = function() { //SUBA imm
+    rA = oSUB(rA, fetch());
+};
+ops[0x81] = function() { //CMPA imm
+    oCMP(rA, fetch());
+};
+ops[0x82] = function() { //SBCA imm
+    rA = oSBC(rA, fetch());
+};
+ops[0x83] = function() { //SUBD imm
+    setD(oSUB16(getD(),fetch16()));
+};
+ops[0x84] = function() { //ANDA imm
+    rA = oAND(rA, fetch());
+};
+ops[0x85] = function() { //BITA imm
+    oAND(rA, fetch());
+};
+ops[0x86] = function() { //LDA imm
+    rA = fetch();
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0x88] = function() { //EORA imm
+    rA = oEOR(rA, fetch());
+};
+ops[0x89] = function() { //ADCA imm
+    rA = oADC(rA, fetch());
+};
+ops[0x8A] = function() { //ORA imm
+    rA = oOR(rA, fetch());
+};
+ops[0x8B] = function() { //ADDA imm
+    rA = oADD(rA, fetch());
+};
+ops[0x8C] = function() { //CMPX imm
+    oCMP16(rX, fetch16());
+};
+ops[0x8D] = function() { //JSR imm
+    var addr = signed(fetch());
+    PUSHW(PC);
+    PC+=addr;
+};
+ops[0x8E] = function() { //LDX imm
+    rX = fetch16();
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0x90] = function() { //SUBA direct
+    var addr = dpadd();
+    rA = oSUB(rA, byteAt(addr));
+};
+ops[0x91] = function() { //CMPA direct
+    var addr = dpadd();
+    oCMP(rA, byteAt(addr));
+};
+ops[0x92] = function() { //SBCA direct
+    var addr = dpadd();
+    rA = oSBC(rA, byteAt(addr));
+};
+ops[0x93] = function() { //SUBD direct
+    var addr = dpadd();
+    setD(oSUB16(getD(),ReadWord(addr)));
+};
+ops[0x94] = function() { //ANDA direct
+    var addr = dpadd();
+    rA = oAND(rA, byteAt(addr));
+};
+ops[0x95] = function() { //BITA direct
+    var addr = dpadd();
+    oAND(rA, byteAt(addr));
+};
+ops[0x96] = function() { //LDA direct
+    var addr = dpadd();
+    rA = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0x97] = function() { //STA direct
+    var addr = dpadd();
+    byteTo(addr,rA);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0x98] = function() { //EORA direct
+    var addr = dpadd();
+    rA = oEOR(rA, byteAt(addr));
+};
+ops[0x99] = function() { //ADCA direct
+    var addr = dpadd();
+    rA = oADC(rA, byteAt(addr));
+};
+ops[0x9A] = function() { //ORA direct
+    var addr = dpadd();
+    rA = oOR(rA, byteAt(addr));
+};
+ops[0x9B] = function() { //ADDA direct
+    var addr = dpadd();
+    rA = oADD(rA, byteAt(addr));
+};
+ops[0x9C] = function() { //CMPX direct
+    var addr = dpadd();
+    oCMP16(rX, ReadWord(addr));
+};
+ops[0x9D] = function() { //JSR direct
+    var addr = dpadd();
+    PUSHW(PC);
+    PC=addr;
+};
+ops[0x9E] = function() { //LDX direct
+    var addr = dpadd();
+    rX = ReadWord(addr);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0x9F] = function() { //STX direct
+    var addr = dpadd();
+    WriteWord(addr,rX);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0xA0] = function() { //SUBA indexed
+    var addr = PostByte();
+    rA = oSUB(rA, byteAt(addr));
+};
+ops[0xA1] = function() { //CMPA indexed
+    var addr = PostByte();
+    oCMP(rA, byteAt(addr));
+};
+ops[0xA2] = function() { //SBCA indexed
+    var addr = PostByte();
+    rA = oSBC(rA, byteAt(addr));
+};
+ops[0xA3] = function() { //SUBD indexed
+    var addr = PostByte();
+    setD(oSUB16(getD(),ReadWord(addr)));
+};
+ops[0xA4] = function() { //ANDA indexed
+    var addr = PostByte();
+    rA = oAND(rA, byteAt(addr));
+};
+ops[0xA5] = function() { //BITA indexed
+    var addr = PostByte();
+    oAND(rA, byteAt(addr));
+};
+ops[0xA6] = function() { //LDA indexed
+    var addr = PostByte();
+    rA = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0xA7] = function() { //STA indexed
+    var addr = PostByte();
+    byteTo(addr,rA);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0xA8] = function() { //EORA indexed
+    var addr = PostByte();
+    rA = oEOR(rA, byteAt(addr));
+};
+ops[0xA9] = function() { //ADCA indexed
+    var addr = PostByte();
+    rA = oADC(rA, byteAt(addr));
+};
+ops[0xAA] = function() { //ORA indexed
+    var addr = PostByte();
+    rA = oOR(rA, byteAt(addr));
+};
+ops[0xAB] = function() { //ADDA indexed
+    var addr = PostByte();
+    rA = oADD(rA, byteAt(addr));
+};
+ops[0xAC] = function() { //CMPX indexed
+    var addr = PostByte();
+    oCMP16(rX, ReadWord(addr));
+};
+ops[0xAD] = function() { //JSR indexed
+    var addr = PostByte();
+    PUSHW(PC);
+    PC=addr;
+};
+ops[0xAE] = function() { //LDX indexed
+    var addr = PostByte();
+    rX = ReadWord(addr);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0xAF] = function() { //STX indexed
+    var addr = PostByte();
+    WriteWord(addr,rX);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0xB0] = function() { //SUBA extended
+    var addr = fetch16();
+    rA = oSUB(rA, byteAt(addr));
+};
+ops[0xB1] = function() { //CMPA extended
+    var addr = fetch16();
+    oCMP(rA, byteAt(addr));
+};
+ops[0xB2] = function() { //SBCA extended
+    var addr = fetch16();
+    rA = oSBC(rA, byteAt(addr));
+};
+ops[0xB3] = function() { //SUBD extended
+    var addr = fetch16();
+    setD(oSUB16(getD(),ReadWord(addr)));
+};
+ops[0xB4] = function() { //ANDA extended
+    var addr = fetch16();
+    rA = oAND(rA, byteAt(addr));
+};
+ops[0xB5] = function() { //BITA extended
+    var addr = fetch16();
+    oAND(rA, byteAt(addr));
+};
+ops[0xB6] = function() { //LDA extended
+    var addr = fetch16();
+    rA = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0xB7] = function() { //STA extended
+    var addr = fetch16();
+    byteTo(addr,rA);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rA];
+};
+ops[0xB8] = function() { //EORA extended
+    var addr = fetch16();
+    rA = oEOR(rA, byteAt(addr));
+};
+ops[0xB9] = function() { //ADCA extended
+    var addr = fetch16();
+    rA = oADC(rA, byteAt(addr));
+};
+ops[0xBA] = function() { //ORA extended
+    var addr = fetch16();
+    rA = oOR(rA, byteAt(addr));
+};
+ops[0xBB] = function() { //ADDA extended
+    var addr = fetch16();
+    rA = oADD(rA, byteAt(addr));
+};
+ops[0xBC] = function() { //CMPX extended
+    var addr = fetch16();
+    oCMP16(rX, ReadWord(addr));
+};
+ops[0xBD] = function() { //JSR extended
+    var addr = fetch16();
+    PUSHW(PC);
+    PC=addr;
+};
+ops[0xBE] = function() { //LDX extended
+    var addr = fetch16();
+    rX = ReadWord(addr);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0xBF] = function() { //STX extended
+    var addr = fetch16();
+    WriteWord(addr,rX);
+    flagsNZ16(rX);
+    CC&=~F_OVERFLOW;
+};
+ops[0xC0] = function() { //SUBB imm
+    rB = oSUB(rB, fetch());
+};
+ops[0xC1] = function() { //CMPB imm
+    oCMP(rB, fetch());
+};
+ops[0xC2] = function() { //SBCB imm
+    rB = oSBC(rB, fetch());
+};
+ops[0xC3] = function() { //ADDD imm
+    setD(oADD16(getD(),fetch16()));
+};
+ops[0xC4] = function() { //ANDB imm
+    rB = oAND(rB, fetch());
+};
+ops[0xC5] = function() { //BITB imm
+    oAND(rB, fetch());
+};
+ops[0xC6] = function() { //LDB imm
+    rB = fetch();
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xC8] = function() { //EORB imm
+    rB = oEOR(rB, fetch());
+};
+ops[0xC9] = function() { //ADCB imm
+    rB = oADC(rB, fetch());
+};
+ops[0xCA] = function() { //ORB imm
+    rB = oOR(rB, fetch());
+};
+ops[0xCB] = function() { //ADDB imm
+    rB = oADD(rB, fetch());
+};
+ops[0xCC] = function() { //LDD imm
+    var addr = fetch16();
+    setD(addr);
+    flagsNZ16(addr);
+    CC&=~F_OVERFLOW;
+};
+ops[0xCE] = function() { //LDU imm
+    rU = fetch16();
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xD0] = function() { //SUBB direct
+    var addr = dpadd();
+    rB = oSUB(rB, byteAt(addr));
+};
+ops[0xD1] = function() { //CMPB direct
+    var addr = dpadd();
+    oCMP(rB, byteAt(addr));
+};
+ops[0xD2] = function() { //SBCB direct
+    var addr = dpadd();
+    rB = oSBC(rB, byteAt(addr));
+};
+ops[0xD3] = function() { //ADDD direct
+    var addr = dpadd();
+    setD(oADD16(getD(),ReadWord(addr)));
+};
+ops[0xD4] = function() { //ANDB direct
+    var addr = dpadd();
+    rB = oAND(rB, byteAt(addr));
+};
+ops[0xD5] = function() { //BITB direct
+    var addr = dpadd();
+    oAND(rB, byteAt(addr));
+};
+ops[0xD6] = function() { //LDB direct
+    var addr = dpadd();
+    rB = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xD7] = function() { //STB direct
+    var addr = dpadd();
+    byteTo(addr,rB);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xD8] = function() { //EORB direct
+    var addr = dpadd();
+    rB = oEOR(rB, byteAt(addr));
+};
+ops[0xD9] = function() { //ADCB direct
+    var addr = dpadd();
+    rB = oADC(rB, byteAt(addr));
+};
+ops[0xDA] = function() { //ORB direct
+    var addr = dpadd();
+    rB = oOR(rB, byteAt(addr));
+};
+ops[0xDB] = function() { //ADDB direct
+    var addr = dpadd();
+    rB = oADD(rB, byteAt(addr));
+};
+ops[0xDC] = function() { //LDD direct
+    var addr = dpadd();
+    var pb = ReadWord(addr);
+    setD(pb);
+    flagsNZ16(pb);
+    CC&=~F_OVERFLOW;
+};
+ops[0xDD] = function() { //STD direct
+    var addr = dpadd();
+    WriteWord(addr, getD());
+    CC&=~F_OVERFLOW;
+};
+ops[0xDE] = function() { //LDU direct
+    var addr = dpadd();
+    rU = ReadWord(addr);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xDF] = function() { //STU direct
+    var addr = dpadd();
+    WriteWord(addr,rU);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xE0] = function() { //SUBB indexed
+    var addr = PostByte();
+    rB = oSUB(rB, byteAt(addr));
+};
+ops[0xE1] = function() { //CMPB indexed
+    var addr = PostByte();
+    oCMP(rB, byteAt(addr));
+};
+ops[0xE2] = function() { //SBCB indexed
+    var addr = PostByte();
+    rB = oSBC(rB, byteAt(addr));
+};
+ops[0xE3] = function() { //ADDD indexed
+    var addr = PostByte();
+    setD(oADD16(getD(),ReadWord(addr)));
+};
+ops[0xE4] = function() { //ANDB indexed
+    var addr = PostByte();
+    rB = oAND(rB, byteAt(addr));
+};
+ops[0xE5] = function() { //BITB indexed
+    var addr = PostByte();
+    oAND(rB, byteAt(addr));
+};
+ops[0xE6] = function() { //LDB indexed
+    var addr = PostByte();
+    rB = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xE7] = function() { //STB indexed
+    var addr = PostByte();
+    byteTo(addr,rB);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xE8] = function() { //EORB indexed
+    var addr = PostByte();
+    rB = oEOR(rB, byteAt(addr));
+};
+ops[0xE9] = function() { //ADCB indexed
+    var addr = PostByte();
+    rB = oADC(rB, byteAt(addr));
+};
+ops[0xEA] = function() { //ORB indexed
+    var addr = PostByte();
+    rB = oOR(rB, byteAt(addr));
+};
+ops[0xEB] = function() { //ADDB indexed
+    var addr = PostByte();
+    rB = oADD(rB, byteAt(addr));
+};
+ops[0xEC] = function() { //LDD indexed
+    var addr = PostByte();
+    var pb = ReadWord(addr);
+    setD(pb);
+    flagsNZ16(pb);
+    CC&=~F_OVERFLOW;
+};
+ops[0xED] = function() { //STD indexed
+    var addr = PostByte();
+    WriteWord(addr, getD());
+    CC&=~F_OVERFLOW;
+};
+ops[0xEE] = function() { //LDU indexed
+    var addr = PostByte();
+    rU = ReadWord(addr);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xEF] = function() { //STU indexed
+    var addr = PostByte();
+    WriteWord(addr,rU);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xF0] = function() { //SUBB extended
+    var addr = fetch16();
+    rB = oSUB(rB, byteAt(addr));
+};
+ops[0xF1] = function() { //CMPB extended
+    var addr = fetch16();
+    oCMP(rB, byteAt(addr));
+};
+ops[0xF2] = function() { //SBCB extended
+    var addr = fetch16();
+    rB = oSBC(rB, byteAt(addr));
+};
+ops[0xF3] = function() { //ADDD extended
+    var addr = fetch16();
+    setD(oADD16(getD(),ReadWord(addr)));
+};
+ops[0xF4] = function() { //ANDB extended
+    var addr = fetch16();
+    rB = oAND(rB, byteAt(addr));
+};
+ops[0xF5] = function() { //BITB extended
+    var addr = fetch16();
+    oAND(rB, byteAt(addr));
+};
+ops[0xF6] = function() { //LDB extended
+    var addr = fetch16();
+    rB = byteAt(addr);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xF7] = function() { //STB extended
+    var addr = fetch16();
+    byteTo(addr,rB);
+    CC&=~(F_ZERO|F_NEGATIVE|F_OVERFLOW);
+    CC |= flagsNZ[rB];
+};
+ops[0xF8] = function() { //EORB extended
+    var addr = fetch16();
+    rB = oEOR(rB, byteAt(addr));
+};
+ops[0xF9] = function() { //ADCB extended
+    var addr = fetch16();
+    rB = oADC(rB, byteAt(addr));
+};
+ops[0xFA] = function() { //ORB extended
+    var addr = fetch16();
+    rB = oOR(rB, byteAt(addr));
+};
+ops[0xFB] = function() { //ADDB extended
+    var addr = fetch16();
+    rB = oADD(rB, byteAt(addr));
+};
+ops[0xFC] = function() { //LDD extended
+    var addr = fetch16();
+    var pb = ReadWord(addr);
+    setD(pb);
+    flagsNZ16(pb);
+    CC&=~F_OVERFLOW;
+};
+ops[0xFD] = function() { //STD extended
+    var addr = fetch16();
+    WriteWord(addr, getD());
+    CC&=~F_OVERFLOW;
+};
+ops[0xFE] = function() { //LDU extended
+    var addr = fetch16();
+    rU = ReadWord(addr);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+ops[0xFF] = function() { //STU extended
+    var addr = fetch16();
+    WriteWord(addr,rU);
+    flagsNZ16(rU);
+    CC&=~F_OVERFLOW;
+};
+
+// page 1 (prefix 0x10)
+var ops10 = new Array(256);
+ops10[0x21] = function() { //BRN
+    var addr = signed16(fetch16());
+};
+ops10[0x22] = function() { //BHI
+    var addr = signed16(fetch16());
+    if (!(CC&(F_CARRY | F_ZERO))) PC += addr;
+};
+ops10[0x23] = function() { //BLS
+    var addr = signed16(fetch16());
+    if (CC&(F_CARRY | F_ZERO)) PC += addr;
+};
+ops10[0x24] = function() { //BCC
+    var addr = signed16(fetch16());
+    if (!(CC&F_CARRY)) PC += addr;
+};
+ops10[0x25] = function() { //BCS
+    var addr = signed16(fetch16());
+    if (CC&F_CARRY) PC += addr;
+};
+ops10[0x26] = function() { //BNE
+    var addr = signed16(fetch16());
+    if (!(CC&F_ZERO)) PC += addr;
+};
+ops10[0x27] = function() { //BEQ
+    var addr = signed16(fetch16());
+    if (CC&F_ZERO) PC += addr;
+};
+ops10[0x28] = function() { //BVC
+    var addr = signed16(fetch16());
+    if (!(CC&F_OVERFLOW)) PC += addr;
+};
+ops10[0x29] = function() { //BVS
+    var addr = signed16(fetch16());
+    if (CC&F_OVERFLOW) PC += addr;
+};
+ops10[0x2A] = function() { //BPL
+    var addr = signed16(fetch16());
+    if (!(CC&F_NEGATIVE)) PC += addr;
+};
+ops10[0x2B] = function() { //BMI
+    var addr = signed16(fetch16());
+    if (CC&F_NEGATIVE) PC += addr;
+};
+ops10[0x2C] = function() { //BGE
+    var addr = signed16(fetch16());
+    if (!((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2))) PC += addr;
+};
+ops10[0x2D] = function() { //BLT
+    var addr = signed16(fetch16());
+    if ((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2)) PC += addr;
+};
+ops10[0x2E] = function() { //BGT
+    var addr = signed16(fetch16());
+    if (!((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2) || (CC&F_ZERO))) PC += addr;
+};
+ops10[0x2F] = function() { //BLE
+    var addr = signed16(fetch16());
+    if ((CC&F_NEGATIVE) ^ ((CC&F_OVERFLOW)<<2) || (CC&F_ZERO)) PC += addr;
+};
+ops10[0x3F] = function() { //SWI2
+    CC |= F_ENTIRE;
+    PUSHW(PC);
+    PUSHW(rU);
+    PUSHW(rY);
+    PUSHW(rX);
+    PUSHB(DP);
+    PUSHB(rB);
+    PUSHB(rA);
+    PUSHB(CC);
+    CC |= F_IRQMASK | F_FIRQMASK;
+    PC = ReadWord(vecSWI2);
+};
+ops10[0x83] = function() { //CMPD imm
+    oCMP16(getD(),fetch16());
+};
+ops10[0x8C] = function() { //CMPY imm
+    oCMP16(rY,fetch16());
+};
+ops10[0x8E] = function() { //LDY imm
+    rY = fetch16();
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0x93] = function() { //CMPD direct
+    var addr = dpadd();
+    oCMP16(getD(),ReadWord(addr));
+};
+ops10[0x9C] = function() { //CMPY direct
+    var addr = dpadd();
+    oCMP16(rY,ReadWord(addr));
+};
+ops10[0x9E] = function() { //LDY direct
+    var addr = dpadd();
+    rY = ReadWord(addr);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0x9F] = function() { //STY direct
+    var addr = dpadd();
+    WriteWord(addr,rY);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xA3] = function() { //CMPD indexed
+    var addr = PostByte();
+    oCMP16(getD(),ReadWord(addr));
+};
+ops10[0xAC] = function() { //CMPY indexed
+    var addr = PostByte();
+    oCMP16(rY,ReadWord(addr));
+};
+ops10[0xAE] = function() { //LDY indexed
+    var addr = PostByte();
+    rY = ReadWord(addr);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xAF] = function() { //STY indexed
+    var addr = PostByte();
+    WriteWord(addr,rY);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xB3] = function() { //CMPD extended
+    var addr = fetch16();
+    oCMP16(getD(),ReadWord(addr));
+};
+ops10[0xBC] = function() { //CMPY extended
+    var addr = fetch16();
+    oCMP16(rY,ReadWord(addr));
+};
+ops10[0xBE] = function() { //LDY extended
+    var addr = fetch16();
+    rY = ReadWord(addr);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xBF] = function() { //STY extended
+    var addr = fetch16();
+    WriteWord(addr,rY);
+    flagsNZ16(rY);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xCE] = function() { //LDS imm
+    rS = fetch16();
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xDE] = function() { //LDS direct
+    var addr = dpadd();
+    rS = ReadWord(addr);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xDF] = function() { //STS direct
+    var addr = dpadd();
+    WriteWord(addr,rS);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xEE] = function() { //LDS indexed
+    var addr = PostByte();
+    rS = ReadWord(addr);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xEF] = function() { //STS indexed
+    var addr = PostByte();
+    WriteWord(addr,rS);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xFE] = function() { //LDS extended
+    var addr = fetch16();
+    rS = ReadWord(addr);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+ops10[0xFF] = function() { //STS extended
+    var addr = fetch16();
+    WriteWord(addr,rS);
+    flagsNZ16(rS);
+    CC&=~F_OVERFLOW;
+};
+
+// page 2 (prefix 0x11)
+var ops11 = new Array(256);
+ops11[0x3F] = function() { //SWI3
+    CC |= F_ENTIRE;
+    PUSHW(PC);
+    PUSHW(rU);
+    PUSHW(rY);
+    PUSHW(rX);
+    PUSHB(DP);
+    PUSHB(rB);
+    PUSHB(rA);
+    PUSHB(CC);
+    CC |= F_IRQMASK | F_FIRQMASK;
+    PC = ReadWord(vecSWI3);
+};
+ops11[0x83] = function() { //CMPU imm
+    oCMP16(rU, fetch16());
+};
+ops11[0x8C] = function() { //CMPS imm
+    oCMP16(rS, fetch16());
+};
+ops11[0x93] = function() { //CMPU imm
+    var addr = dpadd();
+    oCMP16(rU, ReadWord(addr));
+};
+ops11[0x9C] = function() { //CMPS imm
+    var addr = dpadd();
+    oCMP16(rS, ReadWord(addr));
+};
+ops11[0xA3] = function() { //CMPU imm
+    var addr = PostByte();
+    oCMP16(rU, ReadWord(addr));
+};
+ops11[0xAC] = function() { //CMPS imm
+    var addr = PostByte();
+    oCMP16(rS, ReadWord(addr));
+};
+ops11[0xB3] = function() { //CMPU imm
+    var addr = fetch16();
+    oCMP16(rU, ReadWord(addr));
+};
+ops11[0xBC] = function() { //CMPS imm
+    var addr = fetch16();
+    oCMP16(rS, ReadWord(addr));
+};
+
+ops[0x10] = function() { //page 1
+    var opcode = fetch();
+    T+=cycles2[opcode];
+    ops10[opcode]();
+};
+ops[0x11] = function() { //page 2
+    var opcode = fetch();
+    T+=cycles2[opcode];
+    ops11[opcode]();
+};
+
+// undefined opcodes just take their cycles
+var illegal = function() { };
+for (var i=0; i<256; i++) {
+    if (!ops[i]) ops[i] = illegal;
+    if (!ops10[i]) ops10[i] = illegal;
+    if (!ops11[i]) ops11[i] = illegal;
+}
+
+var step = function() : number {
+    var oldT = T;
+
+    var opcode = fetch();
+    T+=cycles[opcode];
+    ops[opcode]();
+
+    rA &= 0xff;
+    rB &= 0xff;
+    CC &= 0xff;
+    DP &= 0xff;
+    rX &= 0xffff;
+    rY &= 0xffff;
+    rU &= 0xffff;
+    rS &= 0xffff;
+    PC &= 0xffff;
+    return T-oldT;
+
+};
+
+var reset = function(){
+    PC = ReadWord(vecRESET);
+    DP = 0;
+    CC |= F_FIRQMASK | F_IRQMASK;
+    T=0;
+    rA=rB=DP=rX=rY=rU=rS=0;
+};
+
+//---------- Exports
+
+return {
+    steps: function(Ts){
+        //T=0;
+        while (Ts>0){
+            Ts-=step();
+        }
+    },
+    runFrame: function(Tt){
+        while (T<Tt){
+          step();
+        }
+    },
+    advanceInsn: function() {
+        return step();
+    },
+    T:function(){return T;},
+    getTstates:function(){return T;},
+    setTstates:function(t){T=t;},
+    reset: reset,
+    init: function(bt,ba,tck){
+        busWrite=bt;
+        busRead=ba;
+        ticks=tck;
+        reset();
+    },
+    // like init(), but keeps the CPU state
+    connectBus: function(bt,ba) {
+        busWrite=bt;
+        busRead=ba;
+    },
+    connectPages: function(rp:Uint8Array[], wp:Uint8Array[]) {
+        readPages=rp;
+        writePages=wp;
+    },
+    // everything that has to match for a loop iteration to repeat exactly
+    getRegisters: function(r:Int32Array) {
+        r[0]=PC; r[1]=rS; r[2]=rU; r[3]=rA; r[4]=rB;
+        r[5]=rX; r[6]=rY; r[7]=DP; r[8]=CC;
+    },
+    getPC: function() { return PC; },
+    getSP: function() { return rS; },
+    saveState: function() {
+        return {
+            PC:PC,
+            SP:rS,
+            U:rU,
+            A:rA,
+            B:rB,
+            X:rX,
+            Y:rY,
+            DP:DP,
+            CC:CC,
+            T:T
+        };
+    },
+    loadState: function(s) {
+      PC=s.PC;
+      rS=s.SP;
+      rU=s.U;
+      rA=s.A;
+      rB=s.B;
+      rX=s.X;
+      rY=s.Y;
+      DP=s.DP;
+      CC=s.CC;
+      T=s.T;
+    },
+    // same fields as saveState(), in a fixed 22-byte layout
+    saveStateInto: function(buf:DataView, ofs:number) : number {
+      buf.setUint16(ofs, PC);
+      buf.setUint16(ofs+2, rS);
+      buf.setUint16(ofs+4, rU);
+      buf.setUint16(ofs+6, rX);
+      buf.setUint16(ofs+8, rY);
+      buf.setUint8(ofs+10, rA);
+      buf.setUint8(ofs+11, rB);
+      buf.setUint8(ofs+12, DP);
+      buf.setUint8(ofs+13, CC);
+      buf.setFloat64(ofs+14, T);
+      return ofs+22;
+    },
+    loadStateFrom: function(buf:DataView, ofs:number) : number {
+      PC=buf.getUint16(ofs);
+      rS=buf.getUint16(ofs+2);
+      rU=buf.getUint16(ofs+4);
+      rX=buf.getUint16(ofs+6);
+      rY=buf.getUint16(ofs+8);
+      rA=buf.getUint8(ofs+10);
+      rB=buf.getUint8(ofs+11);
+      DP=buf.getUint8(ofs+12);
+      CC=buf.getUint8(ofs+13);
+      T=buf.getFloat64(ofs+14);
+      return ofs+22;
+    },
+    firq: function() {
+      if (CC & F_FIRQMASK) return;
+      PUSHW(PC);
+      CC &= ~F_ENTIRE;
+      PUSHB(CC);
+      CC |= F_IRQMASK | F_FIRQMASK;
+      PC = ReadWord(vecFIRQ);
+      T += 9;
+    },
+    interrupt: function() {
+      if (CC & F_IRQMASK) return;
+      PUSHW(PC);
+      PUSHW(rU);
+      PUSHW(rY);
+      PUSHW(rX);
+      PUSHB(DP);
+      PUSHB(rB);
+      PUSHB(rA);
+      CC |= F_ENTIRE;
+      PUSHB(CC);
+      CC |= F_IRQMASK;
+      PC = ReadWord(vecIRQ);
+      T += 18;
+    },
+    nmi: function() {
+      PUSHW(PC);
+      PUSHW(rU);
+      PUSHW(rY);
+      PUSHW(rX);
+      PUSHB(DP);
+      PUSHB(rB);
+      PUSHB(rA);
+      CC |= F_ENTIRE;
+      PUSHB(CC);
+      CC |= F_IRQMASK | F_FIRQMASK;
+      PC = ReadWord(vecNMI);
+      T += 18;
+    },
+    set:function(reg,value) {
+        switch (reg.toUpperCase()) {
+            case "PC": PC=value;return;
+            case "A": rA=value;return;
+            case "B": rB=value;return;
+            case "X": rX=value;return;
+            case "Y": rY=value;return;
+            case "SP": rS=value;return;
+            case "U": rU=value;return;
+            case "FLAGS": CC=value;return;
+        }
+    },
+    flagsToString: function() {
+        var f='',fx = "EFHINZVC";
+        for (var i=0;i<8;i++) {
+            var n = CC&(0x80>>i);
+            if (n===0) {f+=fx[i].toLowerCase();} else {f+=fx[i];}
+        }
+        return f;
+    }
+};
+
+}
+
+//---------- Disassembler
+
+/*
+ILLEGAL 0
+DIRECT 1
+INHERENT 2
+BRANCH_REL_16 3
+IMMEDIAT_8 4
+BRANCH_REL_8 5
+INDEXED 6
+EXTENDED 7
+IMMEDIAT_16 8
+
+PSHS 10
+PSHU 11
+
+EXG, TFR 20
+*/
+var ds = [
+[2,  1,"NEG"],
+[1,  0,"???"],
+[1,  0,"???"],
+[2,  1,"COM"],
+[2,  1,"LSR"],
+[1,  0,"???"],
+[2,  1,"ROR"],
+[2,  1,"ASR"],
+[2,  1,"LSL"],
+[2,  1,"ROL"],
+[2,  1,"DEC"],
+[1,  0,"???"],
+[2,  1,"INC"],
+[2,  1,"TST"],
+[2,  1,"JMP"],
+[2,  1,"CLR"],
+[1,  0,"Prefix"],
+[1,  0,"Prefix"],
+[1,  2,"NOP"],
+[1,  2,"SYNC"],
+[1,  0,"???"],
+[1,  0,"???"],
+[3,  3,"LBRA"],
+[3,  3,"LBSR"],
+[1,  0,"???"],
+[1,  2,"DAA"],
+[2,  4,"ORCC"],
+[1,  0,"???"],
+[2,  4,"ANDCC"],
+[1,  2,"SEX"],
+[2,  20,"EXG"],
+[2,  20,"TFR"],
+[2,  5,"BRA"],
+[2,  5,"BRN"],
+[2,  5,"BHI"],
+[2,  5,"BLS"],
+[2,  5,"BCC"],
+[2,  5,"BCS"],
+[2,  5,"BNE"],
+[2,  5,"BEQ"],
+[2,  5,"BVC"],
+[2,  5,"BVS"],
+[2,  5,"BPL"],
+[2,  5,"BMI"],
+[2,  5,"BGE"],
+[2,  5,"BLT"],
+[2,  5,"BGT"],
+[2,  5,"BLE"],
+[2,  6,"LEAX"],
+[2,  6,"LEAY"],
+[2,  6,"LEAS"],
+[2,  6,"LEAU"],
+[2,  10,"PSHS"],
+[2,  10,"PULS"],
+[2,  11,"PSHU"],
+[2,  11,"PULU"],
+[1,  0,"???"],
+[1,  2,"RTS"],
+[1,  2,"ABX"],
+[1,  2,"RTI"],
+[2,  2,"CWAI"],
+[1,  2,"MUL"],
+[1,  2,"RESET"],
+[1,  2,"SWI1"],
+[1,  2,"NEGA"],
+[1,  0,"???"],
+[1,  0,"???"],
+[1,  2,"COMA"],
+[1,  2,"LSRA"],
+[1,  0,"???"],
+[1,  2,"RORA"],
+[1,  2,"ASRA"],
+[1,  2,"ASLA"],
+[1,  2,"ROLA"],
+[1,  2,"DECA"],
+[1,  0,"???"],
+[1,  2,"INCA"],
+[1,  2,"TSTA"],
+[1,  0,"???"],
+[1,  2,"CLRA"],
+[1,  2,"NEGB"],
+[1,  0,"???"],
+[1,  0,"???"],
+[1,  2,"COMB"],
+[1,  2,"LSRB"],
+[1,  0,"???"],
+[1,  2,"RORB"],
+[1,  2,"ASRB"],
+[1,  2,"ASLB"],
+[1,  2,"ROLB"],
+[1,  2,"DECB"],
+[1,  0,"???"],
+[1,  2,"INCB"],
+[1,  2,"TSTB"],
+[1,  0,"???"],
+[1,  2,"CLRB"],
+[2,  6,"NEG"],
+[1,  0,"???"],
+[1,  0,"???"],
+[2,  6,"COM"],
+[2,  6,"LSR"],
+[1,  0,"???"],
+[2,  6,"ROR"],
+[2,  6,"ASR"],
+[2,  6,"LSL"],
+[2,  6,"ROL"],
+[2,  6,"DEC"],
+[1,  0,"???"],
+[2,  6,"INC"],
+[2,  6,"TST"],
+[2,  6,"JMP"],
+[2,  6,"CLR"],
+[3,  7,"NEG"],
+[1,  0,"???"],
+[1,  0,"???"],
+[3,  7,"COM"],
+[3,  7,"LSR"],
+[1,  0,"???"],
+[3,  7,"ROR"],
+[3,  7,"ASR"],
+[3,  7,"LSL"],
+[3,  7,"ROL"],
+[3,  7,"DEC"],
+[1,  0,"???"],
+[3,  7,"INC"],
+[3,  7,"TST"],
+[3,  7,"JMP"],
+[3,  7,"CLR"],
+[2,  4,"SUBA"],
+[2,  4,"CMPA"],
+[2,  4,"SBCA"],
+[3,  8,"SUBD"],
+[2,  4,"ANDA"],
+[2,  4,"BITA"],
+[2,  4,"LDA"],
+[1,  0,"???"],
+[2,  4,"EORA"],
+[2,  4,"ADCA"],
+[2,  4,"ORA"],
+[2,  4,"ADDA"],
+[3,  8,"CMPX"],
+[2,  5,"BSR"],
+[3,  8,"LDX"],
+[1,  0,"???"],
+[2,  1,"SUBA"],
+[2,  1,"CMPA"],
+[2,  1,"SBCA"],
+[2,  1,"SUBd"],
+[2,  1,"ANDA"],
+[2,  1,"BITA"],
+[2,  1,"LDA"],
+[2,  1,"STA"],
+[2,  1,"EORA"],
+[2,  1,"ADCA"],
+[2,  1,"ORA"],
+[2,  1,"ADDA"],
+[2,  1,"CMPX"],
+[2,  1,"JSR"],
+[2,  1,"LDX"],
+[2,  1,"STX"],
+[2,  6,"SUBA"],
+[2,  6,"CMPA"],
+[2,  6,"SBCA"],
+[2,  6,"SUBD"],
+[2,  6,"ANDA"],
+[2,  6,"BITA"],
+[2,  6,"LDA"],
+[2,  6,"STA"],
+[2,  6,"EORA"],
+[2,  6,"ADCA"],
+[2,  6,"ORA"],
+[2,  6,"ADDA"],
+[2,  6,"CMPX"],
+[2,  6,"JSR"],
+[2,  6,"LDX"],
+[2,  6,"STX"],
+[3,  7,"SUBA"],
+[3,  7,"CMPA"],
+[3,  7,"SBCA"],
+[3,  7,"SUBD"],
+[3,  7,"ANDA"],
+[3,  7,"BITA"],
+[3,  7,"LDA"],
+[3,  7,"STA"],
+[3,  7,"EORA"],
+[3,  7,"ADCA"],
+[3,  7,"ORA"],
+[3,  7,"ADDA"],
+[3,  7,"CMPX"],
+[3,  7,"JSR"],
+[3,  7,"LDX"],
+[3,  7,"STX"],
+[2,  4,"SUBB"],
+[2,  4,"CMPB"],
+[2,  4,"SBCB"],
+[3,  8,"ADDD"],
+[2,  4,"ANDB"],
+[2,  4,"BITB"],
+[2,  4,"LDB"],
+[1,  0,"???"],
+[2,  4,"EORB"],
+[2,  4,"ADCB"],
+[2,  4,"ORB"],
+[2,  4,"ADDB"],
+[3,  8,"LDD"],
+[1,  0,"???"],
+[3,  8,"LDU"],
+[1,  0,"???"],
+[2,  1,"SUBB"],
+[2,  1,"CMPB"],
+[2,  1,"SBCB"],
+[2,  1,"ADDD"],
+[2,  1,"ANDB"],
+[2,  1,"BITB"],
+[2,  1,"LDB"],
+[2,  1,"STB"],
+[2,  1,"EORB"],
+[2,  1,"ADCB"],
+[2,  1,"ORB "],
+[2,  1,"ADDB"],
+[2,  1,"LDD "],
+[2,  1,"STD "],
+[2,  1,"LDU "],
+[2,  1,"STU "],
+[2,  6,"SUBB"],
+[2,  6,"CMPB"],
+[2,  6,"SBCB"],
+[2,  6,"ADDD"],
+[2,  6,"ANDB"],
+[2,  6,"BITB"],
+[2,  6,"LDB"],
+[2,  6,"STB"],
+[2,  6,"EORB"],
+[2,  6,"ADCB"],
+[2,  6,"ORB"],
+[2,  6,"ADDB"],
+[2,  6,"LDD"],
+[2,  6,"STD"],
+[2,  6,"LDU"],
+[2,  6,"STU"],
+[3,  7,"SUBB"],
+[3,  7,"CMPB"],
+[3,  7,"SBCB"],
+[3,  7,"ADDD"],
+[3,  7,"ANDB"],
+[3,  7,"BITB"],
+[3,  7,"LDB"],
+[3,  7,"STB"],
+[3,  7,"EORB"],
+[3,  7,"ADCB"],
+[3,  7,"ORB"],
+[3,  7,"ADDB"],
+[3,  7,"LDD"],
+[3,  7,"STD"],
+[3,  7,"LDU"],
+[3,  7,"STU"]
+];
+
+var ds11 = {
+0x3F: [2,2,"SWI3"],
+0x83: [4,8,"CMPU"],
+0x8C: [4,8,"CMPS"],
+0x93: [3,1,"CMPU"],
+0x9C: [3,1,"CMPS"],
+0xA3: [3,6,"CMPU"],
+0xAC: [3,6,"CMPS"],
+0xB3: [4,7,"CMPU"],
+0xBC: [4,7,"CMPS"]
+};
+
+var ds10 = {
+0x21:[5,3,"LBRN"],
+0x22:[5,3,"LBHI"],
+0x23:[5,3,"LBLS"],
+0x24:[5,3,"LBCC"],
+0x25:[5,3,"LBCS"],
+0x26:[5,3,"LBNE"],
+0x27:[5,3,"LBEQ"],
+0x28:[5,3,"LBVC"],
+0x29:[5,3,"LBVS"],
+0x2a:[5,3,"LBPL"],
+0x2b:[5,3,"LBMI"],
+0x2c:[5,3,"LBGE"],
+0x2d:[5,3,"LBLT"],
+0x2e:[5,3,"LBGT"],
+0x2f:[5,3,"LBLE"],
+0x3F:[2,2,"SWI2"],
+0x83:[4,8,"CMPD"],
+0x8C:[4,8,"CMPY"],
+0x8E:[4,8,"LDY"],
+0x93:[3,1,"CMPD"],
+0x9C:[3,1,"CMPY"],
+0x9E:[3,1,"LDY"],
+0x9F:[3,1,"STY"],
+0xA3:[3,6,"CMPD"],
+0xAC:[3,6,"CMPY"],
+0xAE:[3,6,"LDY"],
+0xAF:[3,6,"STY"],
+0xB3:[4,7,"CMPD"],
+0xBC:[4,7,"CMPY"],
+0xBE:[4,7,"LDY"],
+0xBF:[4,7,"STY"],
+0xCE:[4,8,"LDS"],
+0xDE:[3,1,"LDS"],
+0xDF:[3,1,"STS"],
+0xEE:[3,6,"LDS"],
+0xEF:[3,6,"STS"],
+0xFE:[4,7,"LDS"],
+0xFF:[4,7,"STS"]
+};
+/*
+ILLEGAL 0
+DIRECT 1
+INHERENT 2
+BRANCH_REL_16 3
+IMMEDIAT_8 4
+BRANCH_REL_8 5
+INDEXED 6
+EXTENDED 7
+IMMEDIAT_16 8
+*/
+
+var disasm = function(i,a,b,c,d,pc) {
+    var toHexN = function(n,d) {
+      var s = n.toString(16);
+      while (s.length <d) {s = '0'+s;}
+      return s.toUpperCase();
+    };
+
+    var toHex2 = function(n) {return toHexN(n & 0xff,2);};
+    var toHex4 = function(n) {return toHexN(n,4);};
+    var rx,ro,j;
+      var sx : any = ds[i];
+      if (i===0x10) {
+        sx = ds10[a];
+        if (sx===undefined) {
+            return {line:"???",nbytes:2};
+        }
+        i=a;a=b;b=c;c=d;
+      }
+      if (i===0x11) {
+        sx = ds11[a];
+        if (sx===undefined) {
+            return {line:"???",nbytes:2};
+        }
+        i=a;a=b;b=c;c=d;
+      }
+      var bytes = sx[0];
+      var mode = sx[1];
+      var mnemo = sx[2];
+
+      switch (mode) {
+        case 0: //invalid
+            break;
+        case 1: //direct page
+            mnemo+="\t$"+toHex2(a); break;
+        case 2: // inherent
+            break;
+        case 3: //brel16
+            mnemo+="\t#$"+toHex4((a*256+b)<32768 ? (a*256+b+pc):(a*256+b+pc-65536)); break;
+        case 4: //imm8
+            mnemo+="\t#$"+toHex2(a); break;
+        case 5: //brel8
+            mnemo+="\t#$"+toHex4((a)<128 ? (a+pc+2):(a+pc-254)); break;
+        case 6: //indexed, postbyte etc.
+            mnemo+='\t';
+            var pb = a;
+            var ixr = ["X","Y","U","S"][(pb & 0x60)>>5];
+            if (!(pb & 0x80)) {
+                //direct5
+                var disp = pb & 0x1f;
+                if (disp>15) disp = disp-32;
+                mnemo+=disp+','+ixr;
+                break;
+            }
+            var ind = pb & 0x10;
+            var mod = pb & 0x0f;
+            var ofs8 = (b>127)?(b-256):b;
+            var ofs16 = ((b*256+c)>32767)?((b*256+c)-65536):(b*256+c);
+            if (!ind) {
+                switch (mod) {
+                    case 0: mnemo += ","+ixr+'+'; break;
+                    case 1: mnemo += ","+ixr+'++'; break;
+                    case 2: mnemo += ",-"+ixr; break;
+                    case 3: mnemo += ",--"+ixr; break;
+                    case 4: mnemo += ","+ixr; break;
+                    case 5: mnemo += "B,"+ixr; break;
+                    case 6: mnemo += "A,"+ixr; break;
+                    case 7: mnemo += "???"; break;
+                    case 8: mnemo += ofs8+","+ixr; bytes++; break;
+                    case 9: mnemo += ofs16+","+ixr; bytes+=2; break;
+                    case 10: mnemo += "???"; break;
+                    case 11: mnemo += "D,"+ixr; break;
+                    case 12: mnemo += ofs8+",PC"; bytes++; break;
+                    case 13: mnemo += ofs16+",PC"; bytes+=2; break;
+                    case 14: mnemo += "???"; break;
+                    case 15: mnemo += "$"+toHex4((b*256+c)); bytes+=2; break;
+                }
+            }  else {
+                switch (mod) {
+                    case 0: mnemo += "???"; break;
+                    case 1: mnemo += "[,"+ixr+'++]'; break;
+                    case 2: mnemo += "???"; break;
+                    case 3: mnemo += "[,--"+ixr+']'; break;
+                    case 4: mnemo += "[,"+ixr+']'; break;
+                    case 5: mnemo += "[B,"+ixr+']'; break;
+                    case 6: mnemo += "[A,"+ixr+']'; break;
+                    case 7: mnemo += "???"; break;
+                    case 8: mnemo += "["+ofs8+","+ixr+']'; bytes++; break;
+                    case 9: mnemo += "["+ofs16+","+ixr+']'; bytes+=2; break;
+                    case 10: mnemo += "???"; break;
+                    case 11: mnemo += "[D,"+ixr+']'; break;
+                    case 12: mnemo += "["+ofs8+",PC]"; bytes++; break;
+                    case 13: mnemo += "["+ofs16+",PC]"; bytes+=2; break;
+                    case 14: mnemo += "???"; break;
+                    case 15: mnemo += "[$"+toHex4((b*256+c))+']'; bytes+=2; break;
+                }
+            }
+
+            break;
+        case 7: //extended
+            mnemo+="\t$"+toHex4(a*256+b); break;
+        case 8: //imm16
+            mnemo+="\t#$"+toHex4(a*256+b); break;
+
+        case 10: //pshs, puls
+            rx = ['PC','U','Y','X','DP','B','A','CC'];
+            ro = [];
+            for (j=0;j<8;j++) {
+                if ((a & 1)!==0) {ro.push(rx[7-j]);}
+                a>>=1;
+            }
+            mnemo += '\t'+ro.join(',');
+            break;
+        case 11: //pshs, puls
+            rx = ['PC','S','Y','X','DP','B','A','CC'];
+            ro = [];
+            for (j=0;j<8;j++) {
+                if ((a & 1)!==0) {ro.push(rx[7-j]);}
+                a>>=1;
+            }
+            mnemo += '\t'+ro.join(',');
+            break;
+        case 20: //TFR etc
+            rx = ['D','X','Y','U','S','PC','?','?','A','B','CC','DP','?','?','?','?'];
+            mnemo += '\t'+rx[a>>4]+','+rx[a&0x0f];
+            break;
+      }
+
+      return {line:mnemo,nbytes:bytes};
+    };
+
+
+
+export function disassemble6809(i:number, a:number, b:number, c:number, d:number, pc:number) : {line:string, nbytes:number} {
+  return disasm(i, a, b, c, d, pc);
+}
+
+export interface MC6809State {
+  PC : number;
+  SP : number;
+  U : number;
+  A : number;
+  B : number;
+  X : number;
+  Y : number;
+  DP : number;
+  CC : number;
+  T : number;
+}
+
+export enum MC6809Interrupts { IRQ=0, FIRQ=1, NMI=2 };
+
+export class MC6809 implements CPU, InstructionBased, MemoryPagesConnected, IdleLoopAware, SavesState<MC6809State>, SavesBinaryState, Interruptable<MC6809Interrupts> {
+
+  cpu = FastMC6809();
+  // shared with FastMC6809, so pages can be (un)mapped at any time
+  readPages : Uint8Array[] = new Array(256);
+  writePages : Uint8Array[] = new Array(256);
+
+  constructor() {
+    this.cpu.connectPages(this.readPages, this.writePages);
+  }
+  connectMemoryBus(bus:Bus) {
+    this.cpu.connectBus(bus.write.bind(bus), bus.read.bind(bus));
+  }
+  // null goes back to using the memory bus for everything
+  connectMemoryPages(pages:MemoryPageTable) {
+    for (var i=0; i<256; i++) {
+      this.readPages[i] = pages ? pages.read[i] : null;
+      this.writePages[i] = pages ? pages.write[i] : null;
+    }
+  }
+  advanceInsn() : number {
+    return this.cpu.advanceInsn();
+  }
+  reset() {
+    this.cpu.reset();
+  }
+  interrupt(itype:MC6809Interrupts = MC6809Interrupts.IRQ) {
+    switch (itype) {
+      case MC6809Interrupts.IRQ: this.cpu.interrupt(); break;
+      case MC6809Interrupts.FIRQ: this.cpu.firq(); break;
+      case MC6809Interrupts.NMI: this.cpu.nmi(); break;
+    }
+  }
+  IRQ() {
+    this.cpu.interrupt();
+  }
+  FIRQ() {
+    this.cpu.firq();
+  }
+  NMI() {
+    this.cpu.nmi();
+  }
+  getSP() {
+    return this.cpu.getSP();
+  }
+  getPC() {
+    return this.cpu.getPC();
+  }
+  saveState() : MC6809State {
+    return this.cpu.saveState();
+  }
+  loadState(s:MC6809State) {
+    this.cpu.loadState(s);
+  }
+  getRegisters(r:Int32Array) {
+    this.cpu.getRegisters(r);
+  }
+  // nothing free-running to catch up, so an idle loop repeats on the registers alone
+  getIdleRegisters(r:Int32Array) {
+    this.cpu.getRegisters(r);
+  }
+  getBinaryStateSize() {
+    return 22;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    return this.cpu.saveStateInto(buf, ofs);
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    return this.cpu.loadStateFrom(buf, ofs);
+  }
+  isStable() { return true; }
+}
@@ -1,5 +1,5 @@
 
-import { CPU, Bus, ClockBased, SavesState, Interruptable } from "../devices";
+import { CPU, Bus, ClockBased, InstructionBased, SavesState, Interruptable, IdleLoopAware, SavesBinaryState } from "../devices";
 
 // Copyright 2015 by Paulo Augusto Peccin. See license.txt distributed with this file.
 
@@ -917,167 +917,211 @@ var _MOS6502 = function() {
     // Single Byte instructions
 
     function ASL_ACC() {
-        return implied(function() {
-            setC(A > 127);
-            A = (A << 1) & 255;
-            setZ(A);
-            setN(A);
-        });
+        return implied(opASL_ACC);
+    }
+
+    function opASL_ACC() {
+        setC(A > 127);
+        A = (A << 1) & 255;
+        setZ(A);
+        setN(A);
     }
 
     function CLC() {
-        return implied(function() {
-            C = 0;
-        });
+        return implied(opCLC);
+    }
+
+    function opCLC() {
+        C = 0;
     }
 
     function CLD() {
-        return implied(function() {
-            D = 0;
-        });
+        return implied(opCLD);
+    }
+
+    function opCLD() {
+        D = 0;
     }
 
     function CLI() {
-        return implied(function() {
-            I = 0;
-        });
+        return implied(opCLI);
+    }
+
+    function opCLI() {
+        I = 0;
     }
 
     function CLV() {
-        return implied(function() {
-            V = 0;
-        });
+        return implied(opCLV);
+    }
+
+    function opCLV() {
+        V = 0;
     }
 
     function DEX() {
-        return implied(function() {
-            X = (X - 1) & 255;
-            setZ(X);
-            setN(X);
-        });
+        return implied(opDEX);
+    }
+
+    function opDEX() {
+        X = (X - 1) & 255;
+        setZ(X);
+        setN(X);
     }
 
     function DEY() {
-        return implied(function() {
-            Y = (Y - 1) & 255;
-            setZ(Y);
-            setN(Y);
-        });
+        return implied(opDEY);
+    }
+
+    function opDEY() {
+        Y = (Y - 1) & 255;
+        setZ(Y);
+        setN(Y);
     }
 
     function INX() {
-        return implied(function() {
-            X = (X + 1) & 255;
-            setZ(X);
-            setN(X);
-        });
+        return implied(opINX);
+    }
+
+    function opINX() {
+        X = (X + 1) & 255;
+        setZ(X);
+        setN(X);
     }
 
     function INY() {
-        return implied(function() {
-            Y = (Y + 1) & 255;
-            setZ(Y);
-            setN(Y);
-        });
+        return implied(opINY);
+    }
+
+    function opINY() {
+        Y = (Y + 1) & 255;
+        setZ(Y);
+        setN(Y);
     }
 
     function LSR_ACC() {
-        return implied(function() {
-            C = A & 0x01;
-            A >>>= 1;
-            setZ(A);
-            N = 0;
-        });
+        return implied(opLSR_ACC);
+    }
+
+    function opLSR_ACC() {
+        C = A & 0x01;
+        A >>>= 1;
+        setZ(A);
+        N = 0;
     }
 
     function NOP() {
-        return implied(function() {
-            // nothing
-        });
+        return implied(opNOP);
+    }
+
+    function opNOP() {
+        // nothing
     }
 
     function ROL_ACC() {
-        return implied(function() {
-            var newC = A > 127;
-            A = ((A << 1) | C) & 255;
-            setC(newC);
-            setZ(A);
-            setN(A);
-        });
+        return implied(opROL_ACC);
+    }
+
+    function opROL_ACC() {
+        var newC = A > 127;
+        A = ((A << 1) | C) & 255;
+        setC(newC);
+        setZ(A);
+        setN(A);
     }
 
     function ROR_ACC() {
-        return implied(function() {
-            var newC = A & 0x01;
-            A = (A >>> 1) | (C << 7);
-            setC(newC);
-            setZ(A);
-            setN(A);
-        });
+        return implied(opROR_ACC);
+    }
+
+    function opROR_ACC() {
+        var newC = A & 0x01;
+        A = (A >>> 1) | (C << 7);
+        setC(newC);
+        setZ(A);
+        setN(A);
     }
 
     function SEC() {
-        return implied(function() {
-            C = 1;
-        });
+        return implied(opSEC);
+    }
+
+    function opSEC() {
+        C = 1;
     }
 
     function SED() {
-        return implied(function() {
-            D = 1;
-        });
+        return implied(opSED);
+    }
+
+    function opSED() {
+        D = 1;
     }
 
     function SEI() {
-        return implied(function() {
-            I = 1;
-        });
+        return implied(opSEI);
+    }
+
+    function opSEI() {
+        I = 1;
     }
 
     function TAX() {
-        return implied(function() {
-            X = A;
-            setZ(X);
-            setN(X);
-        });
+        return implied(opTAX);
+    }
+
+    function opTAX() {
+        X = A;
+        setZ(X);
+        setN(X);
     }
 
     function TAY() {
-        return implied(function() {
-            Y = A;
-            setZ(Y);
-            setN(Y);
-        });
+        return implied(opTAY);
+    }
+
+    function opTAY() {
+        Y = A;
+        setZ(Y);
+        setN(Y);
     }
 
     function TSX() {
-        return implied(function() {
-            X = SP;
-            setZ(X);
-            setN(X);
-        });
+        return implied(opTSX);
+    }
+
+    function opTSX() {
+        X = SP;
+        setZ(X);
+        setN(X);
     }
 
     function TXA() {
-        return implied(function() {
-            A = X;
-            setZ(A);
-            setN(A);
-        });
+        return implied(opTXA);
+    }
+
+    function opTXA() {
+        A = X;
+        setZ(A);
+        setN(A);
     }
 
     function TXS() {
-        return implied(function() {
-            SP = X;
-        });
+        return implied(opTXS);
+    }
+
+    function opTXS() {
+        SP = X;
     }
 
     function TYA() {
-        return implied(function() {
-            A = Y;
-            setZ(A);
-            setN(A);
-        });
+        return implied(opTYA);
+    }
+
+    function opTYA() {
+        A = Y;
+        setZ(A);
+        setN(A);
     }
 
     function uKIL() {
@@ -1093,480 +1137,562 @@ var _MOS6502 = function() {
     }
 
     function uNOP(addressing) {
-        return addressing(function() {
-            illegalOpcode("NOP/DOP");
-            // nothing
-        });
+        return addressing(opuNOP);
+    }
+
+    function opuNOP() {
+        illegalOpcode("NOP/DOP");
+        // nothing
     }
 
 
     // Internal Execution on Memory Data
 
     function ADC(addressing) {
-        return addressing(function() {
-            if (D) {
-                var operand = data;
-                var AL = (A & 15) + (operand & 15) + C;
-                if (AL > 9) { AL += 6; }
-                var AH = ((A >> 4) + (operand >> 4) + ((AL > 15)?1:0)) << 4;
-                setZ((A + operand + C) & 255);
-                setN(AH);
-                setV(((A ^AH) & ~(A ^ operand)) & 128);
-                if (AH > 0x9f) { AH += 0x60; }
-                setC(AH > 255);
-                A = (AH | (AL & 15)) & 255;
-            } else {
-                var add = A + data + C;
-                setC(add > 255);
-                setV(((A ^ add) & (data ^ add)) & 0x80);
-                A = add & 255;
-                setZ(A);
-                setN(A);
-            }
-        });
+        return addressing(opADC);
+    }
+
+    function opADC() {
+        if (D) {
+            var operand = data;
+            var AL = (A & 15) + (operand & 15) + C;
+            if (AL > 9) { AL += 6; }
+            var AH = ((A >> 4) + (operand >> 4) + ((AL > 15)?1:0)) << 4;
+            setZ((A + operand + C) & 255);
+            setN(AH);
+            setV(((A ^AH) & ~(A ^ operand)) & 128);
+            if (AH > 0x9f) { AH += 0x60; }
+            setC(AH > 255);
+            A = (AH | (AL & 15)) & 255;
+        } else {
+            var add = A + data + C;
+            setC(add > 255);
+            setV(((A ^ add) & (data ^ add)) & 0x80);
+            A = add & 255;
+            setZ(A);
+            setN(A);
+        }
     }
 
     function AND(addressing) {
-        return addressing(function() {
-            A &= data;
-            setZ(A);
-            setN(A);
-        });
+        return addressing(opAND);
+    }
+
+    function opAND() {
+        A &= data;
+        setZ(A);
+        setN(A);
     }
 
     function BIT(addressing) {
-        return addressing(function() {
-            var par = data;
-            setZ(A & par);
-            setV(par & 0x40);
-            setN(par);
-        });
+        return addressing(opBIT);
+    }
+
+    function opBIT() {
+        var par = data;
+        setZ(A & par);
+        setV(par & 0x40);
+        setN(par);
     }
 
     function CMP(addressing) {
-        return addressing(function() {
-            var val = (A - data) & 255;
-            setC(A >= data);
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opCMP);
+    }
+
+    function opCMP() {
+        var val = (A - data) & 255;
+        setC(A >= data);
+        setZ(val);
+        setN(val);
     }
 
     function CPX(addressing) {
-        return addressing(function() {
-            var val = (X - data) & 255;
-            setC(X >= data);
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opCPX);
+    }
+
+    function opCPX() {
+        var val = (X - data) & 255;
+        setC(X >= data);
+        setZ(val);
+        setN(val);
     }
 
     function CPY(addressing) {
-        return addressing(function() {
-            var val = (Y - data) & 255;
-            setC(Y >= data);
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opCPY);
+    }
+
+    function opCPY() {
+        var val = (Y - data) & 255;
+        setC(Y >= data);
+        setZ(val);
+        setN(val);
     }
 
     function EOR(addressing) {
-        return addressing(function() {
-            A ^= data;
-            setZ(A);
-            setN(A);
-        });
+        return addressing(opEOR);
+    }
+
+    function opEOR() {
+        A ^= data;
+        setZ(A);
+        setN(A);
     }
 
     function LDA(addressing) {
-        return addressing(function() {
-            A = data;
-            setZ(A);
-            setN(A);
-        });
+        return addressing(opLDA);
+    }
+
+    function opLDA() {
+        A = data;
+        setZ(A);
+        setN(A);
     }
 
     function LDX(addressing) {
-        return addressing(function() {
-            X = data;
-            setZ(X);
-            setN(X);
-        });
+        return addressing(opLDX);
+    }
+
+    function opLDX() {
+        X = data;
+        setZ(X);
+        setN(X);
     }
 
     function LDY(addressing) {
-        return addressing(function() {
-            Y = data;
-            setZ(Y);
-            setN(Y);
-        });
+        return addressing(opLDY);
+    }
+
+    function opLDY() {
+        Y = data;
+        setZ(Y);
+        setN(Y);
     }
 
     function ORA(addressing) {
-        return addressing(function() {
-            A |= data;
-            setZ(A);
-            setN(A);
-        });
+        return addressing(opORA);
+    }
+
+    function opORA() {
+        A |= data;
+        setZ(A);
+        setN(A);
     }
 
     function SBC(addressing) {
-        return addressing(function() {
-            if (D) {
-                var operand = data;
-                var AL = (A & 15) - (operand & 15) - (1-C);
-                var AH = (A >> 4) - (operand >> 4) - ((AL < 0)?1:0);
-                if (AL < 0) { AL -= 6; }
-                if (AH < 0) { AH -= 6; }
-                var sub = A - operand - (1-C);
-                setC(~sub & 256);
-                setV(((A ^ operand) & (A ^ sub)) & 128);
-                setZ(sub & 255);
-                setN(sub);
-                A = ((AH << 4) | (AL & 15)) & 255;
-            } else {
-                operand = (~data) & 255;
-                sub = A + operand + C;
-                setC(sub > 255);
-                setV(((A ^ sub) & (operand ^ sub) & 0x80));
-                A = sub & 255;
-                setZ(A);
-                setN(A);
-            }
-        });
+        return addressing(opSBC);
+    }
+
+    function opSBC() {
+        if (D) {
+            var operand = data;
+            var AL = (A & 15) - (operand & 15) - (1-C);
+            var AH = (A >> 4) - (operand >> 4) - ((AL < 0)?1:0);
+            if (AL < 0) { AL -= 6; }
+            if (AH < 0) { AH -= 6; }
+            var sub = A - operand - (1-C);
+            setC(~sub & 256);
+            setV(((A ^ operand) & (A ^ sub)) & 128);
+            setZ(sub & 255);
+            setN(sub);
+            A = ((AH << 4) | (AL & 15)) & 255;
+        } else {
+            operand = (~data) & 255;
+            sub = A + operand + C;
+            setC(sub > 255);
+            setV(((A ^ sub) & (operand ^ sub) & 0x80));
+            A = sub & 255;
+            setZ(A);
+            setN(A);
+        }
     }
 
     function uANC(addressing) {
-        return addressing(function() {
-            illegalOpcode("ANC");
-            A &= data;
-            setZ(A);
-            N = C = (A & 0x080) ? 1 : 0;
-        });
+        return addressing(opuANC);
+    }
+
+    function opuANC() {
+        illegalOpcode("ANC");
+        A &= data;
+        setZ(A);
+        N = C = (A & 0x080) ? 1 : 0;
     }
 
     function uANE(addressing) {
-        return addressing(function() {
-            illegalOpcode("ANE");
-            // Exact operation unknown. Do nothing
-        });
+        return addressing(opuANE);
+    }
+
+    function opuANE() {
+        illegalOpcode("ANE");
+        // Exact operation unknown. Do nothing
     }
 
     function uARR(addressing) {
         // Some sources say flags are affected per ROR, others say its more complex. The complex one is chosen
-        return addressing(function() {
-            illegalOpcode("ARR");
-            var val = A & data;
-            var oldC = C ? 0x80 : 0;
-            val = (val >>> 1) | oldC;
-            A = val;
-            setZ(val);
-            setN(val);
-            var comp = A & 0x60;
-            if (comp == 0x60) 		{ C = 1; V = 0; }
-            else if (comp == 0x00) 	{ C = 0; V = 0; }
-            else if (comp == 0x20) 	{ C = 0; V = 1; }
-            else if (comp == 0x40) 	{ C = 1; V = 1; }
-        });
+        return addressing(opuARR);
+    }
+
+    function opuARR() {
+        illegalOpcode("ARR");
+        var val = A & data;
+        var oldC = C ? 0x80 : 0;
+        val = (val >>> 1) | oldC;
+        A = val;
+        setZ(val);
+        setN(val);
+        var comp = A & 0x60;
+        if (comp == 0x60) 		{ C = 1; V = 0; }
+        else if (comp == 0x00) 	{ C = 0; V = 0; }
+        else if (comp == 0x20) 	{ C = 0; V = 1; }
+        else if (comp == 0x40) 	{ C = 1; V = 1; }
     }
 
     function uASR(addressing) {
-        return addressing(function() {
-            illegalOpcode("ASR");
-            var val = A & data;
-            C = (val & 0x01);		// bit 0
-            val = val >>> 1;
-            A = val;
-            setZ(val);
-            N = 0;
-        });
+        return addressing(opuASR);
+    }
+
+    function opuASR() {
+        illegalOpcode("ASR");
+        var val = A & data;
+        C = (val & 0x01);		// bit 0
+        val = val >>> 1;
+        A = val;
+        setZ(val);
+        N = 0;
     }
 
     function uLAS(addressing) {
-        return addressing(function() {
-            illegalOpcode("LAS");
-            var val = SP & data;
-            A = val;
-            X = val;
-            SP = val;
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opuLAS);
+    }
+
+    function opuLAS() {
+        illegalOpcode("LAS");
+        var val = SP & data;
+        A = val;
+        X = val;
+        SP = val;
+        setZ(val);
+        setN(val);
     }
 
     function uLAX(addressing) {
-        return addressing(function() {
-            illegalOpcode("LAX");
-            var val = data;
-            A = val;
-            X = val;
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opuLAX);
+    }
+
+    function opuLAX() {
+        illegalOpcode("LAX");
+        var val = data;
+        A = val;
+        X = val;
+        setZ(val);
+        setN(val);
     }
 
     function uLXA(addressing) {
-        return addressing(function() {
-            // Some sources say its an OR with $EE then AND with IMM, others exclude the OR,
-            // others exclude both the OR and the AND. Excluding just the OR...
-            illegalOpcode("LXA");
-            var val = A /* | 0xEE) */ & data;
-            A = val;
-            X = val;
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opuLXA);
+    }
+
+    function opuLXA() {
+        // Some sources say its an OR with $EE then AND with IMM, others exclude the OR,
+        // others exclude both the OR and the AND. Excluding just the OR...
+        illegalOpcode("LXA");
+        var val = A /* | 0xEE) */ & data;
+        A = val;
+        X = val;
+        setZ(val);
+        setN(val);
     }
 
     function uSBX(addressing) {
-        return addressing(function() {
-            illegalOpcode("SBX");
-            var par = A & X;
-            var val = data;
-            var newX = (par - val) & 255;
-            X = newX;
-            setC(par >= val);
-            setZ(newX);
-            setN(newX);
-        });
+        return addressing(opuSBX);
+    }
+
+    function opuSBX() {
+        illegalOpcode("SBX");
+        var par = A & X;
+        var val = data;
+        var newX = (par - val) & 255;
+        X = newX;
+        setC(par >= val);
+        setZ(newX);
+        setN(newX);
     }
 
 
     // Store operations
 
     function STA(addressing) {
-        return addressing(function() {
-            data = A;
-        });
+        return addressing(opSTA);
+    }
+
+    function opSTA() {
+        data = A;
     }
 
     function STX(addressing) {
-        return addressing(function() {
-            data = X;
-        });
+        return addressing(opSTX);
+    }
+
+    function opSTX() {
+        data = X;
     }
 
     function STY(addressing) {
-        return addressing(function() {
-            data = Y;
-        });
+        return addressing(opSTY);
+    }
+
+    function opSTY() {
+        data = Y;
     }
 
     function uSAX(addressing) {
-        return addressing(function() {
-            // Some sources say it would affect N and Z flags, some say it wouldn't. Chose not to affect
-            illegalOpcode("SAX");
-            data = A & X;
-        });
+        return addressing(opuSAX);
+    }
+
+    function opuSAX() {
+        // Some sources say it would affect N and Z flags, some say it wouldn't. Chose not to affect
+        illegalOpcode("SAX");
+        data = A & X;
     }
 
     function uSHA(addressing) {
-        return addressing(function() {
-            illegalOpcode("SHA");
-            data = A & X & ((BA >>> 8) + 1) & 255; // A & X & (High byte of effective address + 1) !!!
-            // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
-        });
+        return addressing(opuSHA);
+    }
+
+    function opuSHA() {
+        illegalOpcode("SHA");
+        data = A & X & ((BA >>> 8) + 1) & 255; // A & X & (High byte of effective address + 1) !!!
+        // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
     }
 
     function uSHS(addressing) {
-        return addressing(function() {
-            illegalOpcode("SHS");
-            var val = A & X;
-            SP = val;
-            data = val & ((BA >>> 8) + 1) & 255; // A & X & (High byte of effective address + 1) !!!
-            // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
-        });
+        return addressing(opuSHS);
+    }
+
+    function opuSHS() {
+        illegalOpcode("SHS");
+        var val = A & X;
+        SP = val;
+        data = val & ((BA >>> 8) + 1) & 255; // A & X & (High byte of effective address + 1) !!!
+        // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
     }
 
     function uSHX(addressing) {
-        return addressing(function() {
-            illegalOpcode("SHX");
-            data = X & ((BA >>> 8) + 1) & 255; // X & (High byte of effective address + 1) !!!
-            // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
-        });
+        return addressing(opuSHX);
+    }
+
+    function opuSHX() {
+        illegalOpcode("SHX");
+        data = X & ((BA >>> 8) + 1) & 255; // X & (High byte of effective address + 1) !!!
+        // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
     }
 
     function uSHY(addressing) {
-        return addressing(function() {
-            illegalOpcode("SHY");
-            data = Y & ((BA >>> 8) + 1) & 255; // Y & (High byte of effective address + 1) !!!
-            // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
-        });
+        return addressing(opuSHY);
+    }
+
+    function opuSHY() {
+        illegalOpcode("SHY");
+        data = Y & ((BA >>> 8) + 1) & 255; // Y & (High byte of effective address + 1) !!!
+        // data would also be stored BAH if page boundary is crossed. Unobservable, not needed here
     }
 
 
     // Read-Modify-Write operations
 
     function ASL(addressing) {
-        return addressing(function() {
-            setC(data > 127);
-            var par = (data << 1) & 255;
-            data = par;
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opASL);
+    }
+
+    function opASL() {
+        setC(data > 127);
+        var par = (data << 1) & 255;
+        data = par;
+        setZ(par);
+        setN(par);
     }
 
     function DEC(addressing) {
-        return addressing(function() {
-            var par = (data - 1) & 255;
-            data = par;
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opDEC);
+    }
+
+    function opDEC() {
+        var par = (data - 1) & 255;
+        data = par;
+        setZ(par);
+        setN(par);
     }
 
     function INC(addressing) {
-        return addressing(function() {
-            var par = (data + 1) & 255;
-            data = par;
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opINC);
+    }
+
+    function opINC() {
+        var par = (data + 1) & 255;
+        data = par;
+        setZ(par);
+        setN(par);
     }
 
     function LSR(addressing) {
-        return addressing(function() {
-            C = data & 0x01;
-            data >>>= 1;
-            setZ(data);
-            N = 0;
-        });
+        return addressing(opLSR);
+    }
+
+    function opLSR() {
+        C = data & 0x01;
+        data >>>= 1;
+        setZ(data);
+        N = 0;
     }
 
     function ROL(addressing) {
-        return addressing(function() {
-            var newC = data > 127;
-            var par = ((data << 1) | C) & 255;
-            data = par;
-            setC(newC);
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opROL);
+    }
+
+    function opROL() {
+        var newC = data > 127;
+        var par = ((data << 1) | C) & 255;
+        data = par;
+        setC(newC);
+        setZ(par);
+        setN(par);
     }
 
     function ROR(addressing) {
-        return addressing(function() {
-            var newC = data & 0x01;
-            var par = (data >>> 1) | (C << 7);
-            data = par;
-            setC(newC);
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opROR);
+    }
+
+    function opROR() {
+        var newC = data & 0x01;
+        var par = (data >>> 1) | (C << 7);
+        data = par;
+        setC(newC);
+        setZ(par);
+        setN(par);
     }
 
     function uDCP(addressing) {
-        return addressing(function() {
-            illegalOpcode("DCP");
-            var par = (data - 1) & 255;
-            data = par;
-            par = A - par;
-            setC(par >= 0);
-            setZ(par);
-            setN(par);
-        });
+        return addressing(opuDCP);
+    }
+
+    function opuDCP() {
+        illegalOpcode("DCP");
+        var par = (data - 1) & 255;
+        data = par;
+        par = A - par;
+        setC(par >= 0);
+        setZ(par);
+        setN(par);
     }
 
     function uISB(addressing) {
-        return addressing(function() {
-            illegalOpcode("ISB");
-            data = (data + 1) & 255;    // ISB is the same as SBC but incs the operand first
-            if (D) {
-                var operand = data;
-                var AL = (A & 15) - (operand & 15) - (1-C);
-                var AH = (A >> 4) - (operand >> 4) - ((AL < 0)?1:0);
-                if (AL < 0) { AL -= 6; }
-                if (AH < 0) { AH -= 6; }
-                var sub = A - operand - (1-C);
-                setC(~sub & 256);
-                setV(((A ^ operand) & (A ^ sub)) & 128);
-                setZ(sub & 255);
-                setN(sub);
-                A = ((AH << 4) | (AL & 15)) & 255;
-            } else {
-                operand = (~data) & 255;
-                sub = A + operand + C;
-                setC(sub > 255);
-                setV(((A ^ sub) & (operand ^ sub) & 0x80));
-                A = sub & 255;
-                setZ(A);
-                setN(A);
-            }
-        });
+        return addressing(opuISB);
+    }
+
+    function opuISB() {
+        illegalOpcode("ISB");
+        data = (data + 1) & 255;    // ISB is the same as SBC but incs the operand first
+        if (D) {
+            var operand = data;
+            var AL = (A & 15) - (operand & 15) - (1-C);
+            var AH = (A >> 4) - (operand >> 4) - ((AL < 0)?1:0);
+            if (AL < 0) { AL -= 6; }
+            if (AH < 0) { AH -= 6; }
+            var sub = A - operand - (1-C);
+            setC(~sub & 256);
+            setV(((A ^ operand) & (A ^ sub)) & 128);
+            setZ(sub & 255);
+            setN(sub);
+            A = ((AH << 4) | (AL & 15)) & 255;
+        } else {
+            operand = (~data) & 255;
+            sub = A + operand + C;
+            setC(sub > 255);
+            setV(((A ^ sub) & (operand ^ sub) & 0x80));
+            A = sub & 255;
+            setZ(A);
+            setN(A);
+        }
     }
 
     function uRLA(addressing) {
-        return addressing(function() {
-            illegalOpcode("RLA");
-            var val = data;
-            var oldC = C;
-            setC(val & 0x80);		// bit 7 was set
-            val = ((val << 1) | oldC) & 255;
-            data = val;
-            A &= val;
-            setZ(val);              // TODO Verify. May be A instead of val in the flags setting
-            setN(val);
-        });
+        return addressing(opuRLA);
+    }
+
+    function opuRLA() {
+        illegalOpcode("RLA");
+        var val = data;
+        var oldC = C;
+        setC(val & 0x80);		// bit 7 was set
+        val = ((val << 1) | oldC) & 255;
+        data = val;
+        A &= val;
+        setZ(val);              // TODO Verify. May be A instead of val in the flags setting
+        setN(val);
     }
 
     function uRRA(addressing) {
-        return addressing(function() {
-            illegalOpcode("RRA");
-            var val = data;
-            var oldC = C ? 0x80 : 0;
-            setC(val & 0x01);		// bit 0 was set
-            val = (val >>> 1) | oldC;
-            data = val;
-            // RRA is the same as ADC from here
-            if (D) {
-                var operand = data;
-                var AL = (A & 15) + (operand & 15) + C;
-                if (AL > 9) { AL += 6; }
-                var AH = ((A >> 4) + (operand >> 4) + ((AL > 15)?1:0)) << 4;
-                setZ((A + operand + C) & 255);
-                setN(AH);
-                setV(((A ^AH) & ~(A ^ operand)) & 128);
-                if (AH > 0x9f) { AH += 0x60; }
-                setC(AH > 255);
-                A = (AH | (AL & 15)) & 255;
-            } else {
-                var add = A + data + C;
-                setC(add > 255);
-                setV(((A ^ add) & (data ^ add)) & 0x80);
-                A = add & 255;
-                setZ(A);
-                setN(A);
-            }
-        });
+        return addressing(opuRRA);
+    }
+
+    function opuRRA() {
+        illegalOpcode("RRA");
+        var val = data;
+        var oldC = C ? 0x80 : 0;
+        setC(val & 0x01);		// bit 0 was set
+        val = (val >>> 1) | oldC;
+        data = val;
+        // RRA is the same as ADC from here
+        if (D) {
+            var operand = data;
+            var AL = (A & 15) + (operand & 15) + C;
+            if (AL > 9) { AL += 6; }
+            var AH = ((A >> 4) + (operand >> 4) + ((AL > 15)?1:0)) << 4;
+            setZ((A + operand + C) & 255);
+            setN(AH);
+            setV(((A ^AH) & ~(A ^ operand)) & 128);
+            if (AH > 0x9f) { AH += 0x60; }
+            setC(AH > 255);
+            A = (AH | (AL & 15)) & 255;
+        } else {
+            var add = A + data + C;
+            setC(add > 255);
+            setV(((A ^ add) & (data ^ add)) & 0x80);
+            A = add & 255;
+            setZ(A);
+            setN(A);
+        }
     }
 
     function uSLO(addressing) {
-        return addressing(function() {
-            illegalOpcode("SLO");
-            var val = data;
-            setC(val & 0x80);		// bit 7 was set
-            val = (val << 1) & 255;
-            data = val;
-            val = A | val;
-            A = val;
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opuSLO);
+    }
+
+    function opuSLO() {
+        illegalOpcode("SLO");
+        var val = data;
+        setC(val & 0x80);		// bit 7 was set
+        val = (val << 1) & 255;
+        data = val;
+        val = A | val;
+        A = val;
+        setZ(val);
+        setN(val);
     }
 
     function uSRE(addressing) {
-        return addressing(function() {
-            illegalOpcode("SRE");
-            var val = data;
-            setC(val & 0x01);		// bit 0 was set
-            val = val >>> 1;
-            data = val;
-            val = (A ^ val) & 255;
-            A = val;
-            setZ(val);
-            setN(val);
-        });
+        return addressing(opuSRE);
+    }
+
+    function opuSRE() {
+        illegalOpcode("SRE");
+        var val = data;
+        setC(val & 0x01);		// bit 0 was set
+        val = val >>> 1;
+        data = val;
+        val = (A ^ val) & 255;
+        A = val;
+        setZ(val);
+        setN(val);
     }
 
 
@@ -1751,6 +1877,539 @@ var _MOS6502 = function() {
     }
 
 
+    // Instruction-granular execution  -------------------------------------------
+
+    // Runs the already-fetched opcode in one dispatch instead of one closure per cycle.
+    // Every bus access (including dummy reads and writes) happens in the same order as
+    // the per-cycle tables above, and the internal registers end up with the same values,
+    // so the two engines share MOS6502State and can be switched at any stable point.
+
+    var readImplied = function() {
+        fetchOpcodeAndDiscard();
+        return 2;
+    };
+
+    var readImmediate = function() {
+        fetchDataFromImmediate();
+        return 2;
+    };
+
+    var readZeroPage = function() {
+        fetchADL(); fetchDataFromAD();
+        return 3;
+    };
+
+    var readAbsolute = function() {
+        fetchADL(); fetchADH(); fetchDataFromAD();
+        return 4;
+    };
+
+    var readIndirectX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL(); fetchADLFromBA();
+        add1toBAL(); fetchADHFromBA();
+        fetchDataFromAD();
+        return 6;
+    };
+
+    var readAbsoluteX = function() {
+        fetchBAL(); fetchBAH();
+        addXtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        if (!BALCrossed) return 4;
+        fetchDataFromBA();
+        return 5;
+    };
+
+    var readAbsoluteY = function() {
+        fetchBAL(); fetchBAH();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        if (!BALCrossed) return 4;
+        fetchDataFromBA();
+        return 5;
+    };
+
+    var readZeroPageX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL(); fetchDataFromBA();
+        return 4;
+    };
+
+    var readZeroPageY = function() {
+        fetchBAL(); fetchDataFromBA();
+        addYtoBAL(); fetchDataFromBA();
+        return 4;
+    };
+
+    var readIndirectY = function() {
+        fetchIAL(); fetchBALFromIA();
+        add1toIAL(); fetchBAHFromIA();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        if (!BALCrossed) return 5;
+        fetchDataFromBA();
+        return 6;
+    };
+
+    // write addressing leaves the target in AD (zp, abs, (zp,X)) or BA (indexed)
+
+    var addrZeroPage = function() {
+        fetchADL();
+        return 3;
+    };
+
+    var addrAbsolute = function() {
+        fetchADL(); fetchADH();
+        return 4;
+    };
+
+    var addrIndirectX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL(); fetchADLFromBA();
+        add1toBAL(); fetchADHFromBA();
+        return 6;
+    };
+
+    var addrAbsoluteX = function() {
+        fetchBAL(); fetchBAH();
+        addXtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        return 5;
+    };
+
+    var addrAbsoluteY = function() {
+        fetchBAL(); fetchBAH();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        return 5;
+    };
+
+    var addrZeroPageX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL();
+        return 4;
+    };
+
+    var addrZeroPageY = function() {
+        fetchBAL(); fetchDataFromBA();
+        addYtoBAL();
+        return 4;
+    };
+
+    var addrIndirectY = function() {
+        fetchIAL(); fetchBALFromIA();
+        add1toIAL(); fetchBAHFromIA();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        return 6;
+    };
+
+    // read-modify-write addressing does the read and the dummy write-back
+
+    var rmwZeroPage = function() {
+        fetchADL(); fetchDataFromAD(); writeDataToAD();
+        return 5;
+    };
+
+    var rmwAbsolute = function() {
+        fetchADL(); fetchADH(); fetchDataFromAD(); writeDataToAD();
+        return 6;
+    };
+
+    var rmwIndirectX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL(); fetchADLFromBA();
+        add1toBAL(); fetchADHFromBA();
+        fetchDataFromAD(); writeDataToAD();
+        return 8;
+    };
+
+    var rmwAbsoluteX = function() {
+        fetchBAL(); fetchBAH();
+        addXtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        fetchDataFromBA(); writeDataToBA();
+        return 7;
+    };
+
+    var rmwAbsoluteY = function() {
+        fetchBAL(); fetchBAH();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        fetchDataFromBA(); writeDataToBA();
+        return 7;
+    };
+
+    var rmwZeroPageX = function() {
+        fetchBAL(); fetchDataFromBA();
+        addXtoBAL(); fetchDataFromBA(); writeDataToBA();
+        return 6;
+    };
+
+    var rmwIndirectY = function() {
+        fetchIAL(); fetchBALFromIA();
+        add1toIAL(); fetchBAHFromIA();
+        addYtoBAL(); fetchDataFromBA(); add1toBAHifBALCrossed();
+        fetchDataFromBA(); writeDataToBA();
+        return 8;
+    };
+
+    var branch = function(taken) {
+        fetchBranchOffset();
+        if (!taken) return 2;
+        fetchOpcodeAndDiscard();
+        addBranchOffsetToPCL();
+        if (!branchOffsetCrossAdjust) return 3;
+        fetchOpcodeAndDiscard();
+        adjustPCHForBranchOffsetCross();
+        return 4;
+    };
+
+    var executeBRK = function() {
+        fetchDataFromImmediate();
+        if (self.debug) self.breakpoint("BRK " + data);
+        pushToStack((PC >>> 8) & 0xff);
+        pushToStack(PC & 0xff);
+        pushToStack(getStatusBits());
+        AD = bus.read(IRQ_VECTOR);
+        AD |= bus.read(IRQ_VECTOR + 1) << 8;
+        PC = AD; I = 1;
+        return 7;
+    };
+
+    var executeJSR = function() {
+        fetchADL();
+        peekFromStack();
+        pushToStack((PC >>> 8) & 0xff);
+        pushToStack(PC & 0xff);
+        fetchADH();
+        PC = AD;
+        return 6;
+    };
+
+    var executeRTI = function() {
+        fetchOpcodeAndDiscard();
+        peekFromStack();
+        setStatusBits(popFromStack());
+        AD = popFromStack();
+        AD |= popFromStack() << 8;
+        PC = AD;
+        return 6;
+    };
+
+    var executeRTS = function() {
+        fetchOpcodeAndDiscard();
+        peekFromStack();
+        AD = popFromStack();
+        AD |= popFromStack() << 8;
+        PC = AD;
+        fetchDataFromImmediate();
+        return 6;
+    };
+
+    var executeKIL = function() {
+        illegalOpcode("KIL/HLT/JAM");
+        T = 1;      // same jammed state the per-cycle table ends up in
+        return 2;
+    };
+
+    // only call when isPCStable() is true; returns the number of cycles taken
+    this.executeInstruction = function() : number {
+        if (!RDY) return 1;
+        var c : number;
+        switch (opcode) {
+            case 0x00: c = executeBRK(); break; // BRK
+            case 0x01: c = readIndirectX(); opORA(); break; // ORA
+            case 0x02: return executeKIL(); // uKIL
+            case 0x03: c = rmwIndirectX(); opuSLO(); writeDataToAD(); break; // uSLO
+            case 0x04: c = readZeroPage(); opuNOP(); break; // uNOP
+            case 0x05: c = readZeroPage(); opORA(); break; // ORA
+            case 0x06: c = rmwZeroPage(); opASL(); writeDataToAD(); break; // ASL
+            case 0x07: c = rmwZeroPage(); opuSLO(); writeDataToAD(); break; // uSLO
+            case 0x08: fetchOpcodeAndDiscard(); pushToStack(getStatusBits()); c = 3; break; // PHP
+            case 0x09: c = readImmediate(); opORA(); break; // ORA
+            case 0x0a: c = readImplied(); opASL_ACC(); break; // ASL
+            case 0x0b: c = readImmediate(); opuANC(); break; // uANC
+            case 0x0c: c = readAbsolute(); opuNOP(); break; // uNOP
+            case 0x0d: c = readAbsolute(); opORA(); break; // ORA
+            case 0x0e: c = rmwAbsolute(); opASL(); writeDataToAD(); break; // ASL
+            case 0x0f: c = rmwAbsolute(); opuSLO(); writeDataToAD(); break; // uSLO
+            case 0x10: c = branch(N === 0); break; // BPL
+            case 0x11: c = readIndirectY(); opORA(); break; // ORA
+            case 0x12: return executeKIL(); // uKIL
+            case 0x13: c = rmwIndirectY(); opuSLO(); writeDataToBA(); break; // uSLO
+            case 0x14: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0x15: c = readZeroPageX(); opORA(); break; // ORA
+            case 0x16: c = rmwZeroPageX(); opASL(); writeDataToBA(); break; // ASL
+            case 0x17: c = rmwZeroPageX(); opuSLO(); writeDataToBA(); break; // uSLO
+            case 0x18: c = readImplied(); opCLC(); break; // CLC
+            case 0x19: c = readAbsoluteY(); opORA(); break; // ORA
+            case 0x1a: c = readImplied(); opuNOP(); break; // uNOP
+            case 0x1b: c = rmwAbsoluteY(); opuSLO(); writeDataToBA(); break; // uSLO
+            case 0x1c: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0x1d: c = readAbsoluteX(); opORA(); break; // ORA
+            case 0x1e: c = rmwAbsoluteX(); opASL(); writeDataToBA(); break; // ASL
+            case 0x1f: c = rmwAbsoluteX(); opuSLO(); writeDataToBA(); break; // uSLO
+            case 0x20: c = executeJSR(); break; // JSR
+            case 0x21: c = readIndirectX(); opAND(); break; // AND
+            case 0x22: return executeKIL(); // uKIL
+            case 0x23: c = rmwIndirectX(); opuRLA(); writeDataToAD(); break; // uRLA
+            case 0x24: c = readZeroPage(); opBIT(); break; // BIT
+            case 0x25: c = readZeroPage(); opAND(); break; // AND
+            case 0x26: c = rmwZeroPage(); opROL(); writeDataToAD(); break; // ROL
+            case 0x27: c = rmwZeroPage(); opuRLA(); writeDataToAD(); break; // uRLA
+            case 0x28: fetchOpcodeAndDiscard(); peekFromStack(); setStatusBits(popFromStack()); c = 4; break; // PLP
+            case 0x29: c = readImmediate(); opAND(); break; // AND
+            case 0x2a: c = readImplied(); opROL_ACC(); break; // ROL
+            case 0x2b: c = readImmediate(); opuANC(); break; // uANC
+            case 0x2c: c = readAbsolute(); opBIT(); break; // BIT
+            case 0x2d: c = readAbsolute(); opAND(); break; // AND
+            case 0x2e: c = rmwAbsolute(); opROL(); writeDataToAD(); break; // ROL
+            case 0x2f: c = rmwAbsolute(); opuRLA(); writeDataToAD(); break; // uRLA
+            case 0x30: c = branch(N === 1); break; // BMI
+            case 0x31: c = readIndirectY(); opAND(); break; // AND
+            case 0x32: return executeKIL(); // uKIL
+            case 0x33: c = rmwIndirectY(); opuRLA(); writeDataToBA(); break; // uRLA
+            case 0x34: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0x35: c = readZeroPageX(); opAND(); break; // AND
+            case 0x36: c = rmwZeroPageX(); opROL(); writeDataToBA(); break; // ROL
+            case 0x37: c = rmwZeroPageX(); opuRLA(); writeDataToBA(); break; // uRLA
+            case 0x38: c = readImplied(); opSEC(); break; // SEC
+            case 0x39: c = readAbsoluteY(); opAND(); break; // AND
+            case 0x3a: c = readImplied(); opuNOP(); break; // uNOP
+            case 0x3b: c = rmwAbsoluteY(); opuRLA(); writeDataToBA(); break; // uRLA
+            case 0x3c: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0x3d: c = readAbsoluteX(); opAND(); break; // AND
+            case 0x3e: c = rmwAbsoluteX(); opROL(); writeDataToBA(); break; // ROL
+            case 0x3f: c = rmwAbsoluteX(); opuRLA(); writeDataToBA(); break; // uRLA
+            case 0x40: c = executeRTI(); break; // RTI
+            case 0x41: c = readIndirectX(); opEOR(); break; // EOR
+            case 0x42: return executeKIL(); // uKIL
+            case 0x43: c = rmwIndirectX(); opuSRE(); writeDataToAD(); break; // uSRE
+            case 0x44: c = readZeroPage(); opuNOP(); break; // uNOP
+            case 0x45: c = readZeroPage(); opEOR(); break; // EOR
+            case 0x46: c = rmwZeroPage(); opLSR(); writeDataToAD(); break; // LSR
+            case 0x47: c = rmwZeroPage(); opuSRE(); writeDataToAD(); break; // uSRE
+            case 0x48: fetchOpcodeAndDiscard(); pushToStack(A); c = 3; break; // PHA
+            case 0x49: c = readImmediate(); opEOR(); break; // EOR
+            case 0x4a: c = readImplied(); opLSR_ACC(); break; // LSR
+            case 0x4b: c = readImmediate(); opuASR(); break; // uASR
+            case 0x4c: fetchADL(); fetchADH(); PC = AD; c = 3; break; // JMP
+            case 0x4d: c = readAbsolute(); opEOR(); break; // EOR
+            case 0x4e: c = rmwAbsolute(); opLSR(); writeDataToAD(); break; // LSR
+            case 0x4f: c = rmwAbsolute(); opuSRE(); writeDataToAD(); break; // uSRE
+            case 0x50: c = branch(V === 0); break; // BVC
+            case 0x51: c = readIndirectY(); opEOR(); break; // EOR
+            case 0x52: return executeKIL(); // uKIL
+            case 0x53: c = rmwIndirectY(); opuSRE(); writeDataToBA(); break; // uSRE
+            case 0x54: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0x55: c = readZeroPageX(); opEOR(); break; // EOR
+            case 0x56: c = rmwZeroPageX(); opLSR(); writeDataToBA(); break; // LSR
+            case 0x57: c = rmwZeroPageX(); opuSRE(); writeDataToBA(); break; // uSRE
+            case 0x58: c = readImplied(); opCLI(); break; // CLI
+            case 0x59: c = readAbsoluteY(); opEOR(); break; // EOR
+            case 0x5a: c = readImplied(); opuNOP(); break; // uNOP
+            case 0x5b: c = rmwAbsoluteY(); opuSRE(); writeDataToBA(); break; // uSRE
+            case 0x5c: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0x5d: c = readAbsoluteX(); opEOR(); break; // EOR
+            case 0x5e: c = rmwAbsoluteX(); opLSR(); writeDataToBA(); break; // LSR
+            case 0x5f: c = rmwAbsoluteX(); opuSRE(); writeDataToBA(); break; // uSRE
+            case 0x60: c = executeRTS(); break; // RTS
+            case 0x61: c = readIndirectX(); opADC(); break; // ADC
+            case 0x62: return executeKIL(); // uKIL
+            case 0x63: c = rmwIndirectX(); opuRRA(); writeDataToAD(); break; // uRRA
+            case 0x64: c = readZeroPage(); opuNOP(); break; // uNOP
+            case 0x65: c = readZeroPage(); opADC(); break; // ADC
+            case 0x66: c = rmwZeroPage(); opROR(); writeDataToAD(); break; // ROR
+            case 0x67: c = rmwZeroPage(); opuRRA(); writeDataToAD(); break; // uRRA
+            case 0x68: fetchOpcodeAndDiscard(); peekFromStack(); A = popFromStack(); setZ(A); setN(A); c = 4; break; // PLA
+            case 0x69: c = readImmediate(); opADC(); break; // ADC
+            case 0x6a: c = readImplied(); opROR_ACC(); break; // ROR
+            case 0x6b: c = readImmediate(); opuARR(); break; // uARR
+            case 0x6c: fetchIAL(); fetchIAH(); fetchBALFromIA(); add1toIAL(); fetchBAHFromIA(); PC = BA; c = 5; break; // JMP
+            case 0x6d: c = readAbsolute(); opADC(); break; // ADC
+            case 0x6e: c = rmwAbsolute(); opROR(); writeDataToAD(); break; // ROR
+            case 0x6f: c = rmwAbsolute(); opuRRA(); writeDataToAD(); break; // uRRA
+            case 0x70: c = branch(V === 1); break; // BVS
+            case 0x71: c = readIndirectY(); opADC(); break; // ADC
+            case 0x72: return executeKIL(); // uKIL
+            case 0x73: c = rmwIndirectY(); opuRRA(); writeDataToBA(); break; // uRRA
+            case 0x74: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0x75: c = readZeroPageX(); opADC(); break; // ADC
+            case 0x76: c = rmwZeroPageX(); opROR(); writeDataToBA(); break; // ROR
+            case 0x77: c = rmwZeroPageX(); opuRRA(); writeDataToBA(); break; // uRRA
+            case 0x78: c = readImplied(); opSEI(); break; // SEI
+            case 0x79: c = readAbsoluteY(); opADC(); break; // ADC
+            case 0x7a: c = readImplied(); opuNOP(); break; // uNOP
+            case 0x7b: c = rmwAbsoluteY(); opuRRA(); writeDataToBA(); break; // uRRA
+            case 0x7c: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0x7d: c = readAbsoluteX(); opADC(); break; // ADC
+            case 0x7e: c = rmwAbsoluteX(); opROR(); writeDataToBA(); break; // ROR
+            case 0x7f: c = rmwAbsoluteX(); opuRRA(); writeDataToBA(); break; // uRRA
+            case 0x80: c = readImmediate(); opuNOP(); break; // uNOP
+            case 0x81: c = addrIndirectX(); opSTA(); writeDataToAD(); break; // STA
+            case 0x82: c = readImmediate(); opuNOP(); break; // uNOP
+            case 0x83: c = addrIndirectX(); opuSAX(); writeDataToAD(); break; // uSAX
+            case 0x84: c = addrZeroPage(); opSTY(); writeDataToAD(); break; // STY
+            case 0x85: c = addrZeroPage(); opSTA(); writeDataToAD(); break; // STA
+            case 0x86: c = addrZeroPage(); opSTX(); writeDataToAD(); break; // STX
+            case 0x87: c = addrZeroPage(); opuSAX(); writeDataToAD(); break; // uSAX
+            case 0x88: c = readImplied(); opDEY(); break; // DEY
+            case 0x89: c = readImmediate(); opuNOP(); break; // uNOP
+            case 0x8a: c = readImplied(); opTXA(); break; // TXA
+            case 0x8b: c = readImmediate(); opuANE(); break; // uANE
+            case 0x8c: c = addrAbsolute(); opSTY(); writeDataToAD(); break; // STY
+            case 0x8d: c = addrAbsolute(); opSTA(); writeDataToAD(); break; // STA
+            case 0x8e: c = addrAbsolute(); opSTX(); writeDataToAD(); break; // STX
+            case 0x8f: c = addrAbsolute(); opuSAX(); writeDataToAD(); break; // uSAX
+            case 0x90: c = branch(C === 0); break; // BCC
+            case 0x91: c = addrIndirectY(); opSTA(); writeDataToBA(); break; // STA
+            case 0x92: return executeKIL(); // uKIL
+            case 0x93: c = addrIndirectY(); opuSHA(); writeDataToBA(); break; // uSHA
+            case 0x94: c = addrZeroPageX(); opSTY(); writeDataToBA(); break; // STY
+            case 0x95: c = addrZeroPageX(); opSTA(); writeDataToBA(); break; // STA
+            case 0x96: c = addrZeroPageY(); opSTX(); writeDataToBA(); break; // STX
+            case 0x97: c = addrZeroPageY(); opuSAX(); writeDataToBA(); break; // uSAX
+            case 0x98: c = readImplied(); opTYA(); break; // TYA
+            case 0x99: c = addrAbsoluteY(); opSTA(); writeDataToBA(); break; // STA
+            case 0x9a: c = readImplied(); opTXS(); break; // TXS
+            case 0x9b: c = addrAbsoluteY(); opuSHS(); writeDataToBA(); break; // uSHS
+            case 0x9c: c = addrAbsoluteX(); opuSHY(); writeDataToBA(); break; // uSHY
+            case 0x9d: c = addrAbsoluteX(); opSTA(); writeDataToBA(); break; // STA
+            case 0x9e: c = addrAbsoluteY(); opuSHX(); writeDataToBA(); break; // uSHX
+            case 0x9f: c = addrAbsoluteY(); opuSHA(); writeDataToBA(); break; // uSHA
+            case 0xa0: c = readImmediate(); opLDY(); break; // LDY
+            case 0xa1: c = readIndirectX(); opLDA(); break; // LDA
+            case 0xa2: c = readImmediate(); opLDX(); break; // LDX
+            case 0xa3: c = readIndirectX(); opuLAX(); break; // uLAX
+            case 0xa4: c = readZeroPage(); opLDY(); break; // LDY
+            case 0xa5: c = readZeroPage(); opLDA(); break; // LDA
+            case 0xa6: c = readZeroPage(); opLDX(); break; // LDX
+            case 0xa7: c = readZeroPage(); opuLAX(); break; // uLAX
+            case 0xa8: c = readImplied(); opTAY(); break; // TAY
+            case 0xa9: c = readImmediate(); opLDA(); break; // LDA
+            case 0xaa: c = readImplied(); opTAX(); break; // TAX
+            case 0xab: c = readImmediate(); opuLXA(); break; // uLXA
+            case 0xac: c = readAbsolute(); opLDY(); break; // LDY
+            case 0xad: c = readAbsolute(); opLDA(); break; // LDA
+            case 0xae: c = readAbsolute(); opLDX(); break; // LDX
+            case 0xaf: c = readAbsolute(); opuLAX(); break; // uLAX
+            case 0xb0: c = branch(C === 1); break; // BCS
+            case 0xb1: c = readIndirectY(); opLDA(); break; // LDA
+            case 0xb2: return executeKIL(); // uKIL
+            case 0xb3: c = readIndirectY(); opuLAX(); break; // uLAX
+            case 0xb4: c = readZeroPageX(); opLDY(); break; // LDY
+            case 0xb5: c = readZeroPageX(); opLDA(); break; // LDA
+            case 0xb6: c = readZeroPageY(); opLDX(); break; // LDX
+            case 0xb7: c = readZeroPageY(); opuLAX(); break; // uLAX
+            case 0xb8: c = readImplied(); opCLV(); break; // CLV
+            case 0xb9: c = readAbsoluteY(); opLDA(); break; // LDA
+            case 0xba: c = readImplied(); opTSX(); break; // TSX
+            case 0xbb: c = readAbsoluteY(); opuLAS(); break; // uLAS
+            case 0xbc: c = readAbsoluteX(); opLDY(); break; // LDY
+            case 0xbd: c = readAbsoluteX(); opLDA(); break; // LDA
+            case 0xbe: c = readAbsoluteY(); opLDX(); break; // LDX
+            case 0xbf: c = readAbsoluteY(); opuLAX(); break; // uLAX
+            case 0xc0: c = readImmediate(); opCPY(); break; // CPY
+            case 0xc1: c = readIndirectX(); opCMP(); break; // CMP
+            case 0xc2: c = readImmediate(); opuNOP(); break; // uNOP
+            case 0xc3: c = rmwIndirectX(); opuDCP(); writeDataToAD(); break; // uDCP
+            case 0xc4: c = readZeroPage(); opCPY(); break; // CPY
+            case 0xc5: c = readZeroPage(); opCMP(); break; // CMP
+            case 0xc6: c = rmwZeroPage(); opDEC(); writeDataToAD(); break; // DEC
+            case 0xc7: c = rmwZeroPage(); opuDCP(); writeDataToAD(); break; // uDCP
+            case 0xc8: c = readImplied(); opINY(); break; // INY
+            case 0xc9: c = readImmediate(); opCMP(); break; // CMP
+            case 0xca: c = readImplied(); opDEX(); break; // DEX
+            case 0xcb: c = readImmediate(); opuSBX(); break; // uSBX
+            case 0xcc: c = readAbsolute(); opCPY(); break; // CPY
+            case 0xcd: c = readAbsolute(); opCMP(); break; // CMP
+            case 0xce: c = rmwAbsolute(); opDEC(); writeDataToAD(); break; // DEC
+            case 0xcf: c = rmwAbsolute(); opuDCP(); writeDataToAD(); break; // uDCP
+            case 0xd0: c = branch(Z === 0); break; // BNE
+            case 0xd1: c = readIndirectY(); opCMP(); break; // CMP
+            case 0xd2: return executeKIL(); // uKIL
+            case 0xd3: c = rmwIndirectY(); opuDCP(); writeDataToBA(); break; // uDCP
+            case 0xd4: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0xd5: c = readZeroPageX(); opCMP(); break; // CMP
+            case 0xd6: c = rmwZeroPageX(); opDEC(); writeDataToBA(); break; // DEC
+            case 0xd7: c = rmwZeroPageX(); opuDCP(); writeDataToBA(); break; // uDCP
+            case 0xd8: c = readImplied(); opCLD(); break; // CLD
+            case 0xd9: c = readAbsoluteY(); opCMP(); break; // CMP
+            case 0xda: c = readImplied(); opuNOP(); break; // uNOP
+            case 0xdb: c = rmwAbsoluteY(); opuDCP(); writeDataToBA(); break; // uDCP
+            case 0xdc: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0xdd: c = readAbsoluteX(); opCMP(); break; // CMP
+            case 0xde: c = rmwAbsoluteX(); opDEC(); writeDataToBA(); break; // DEC
+            case 0xdf: c = rmwAbsoluteX(); opuDCP(); writeDataToBA(); break; // uDCP
+            case 0xe0: c = readImmediate(); opCPX(); break; // CPX
+            case 0xe1: c = readIndirectX(); opSBC(); break; // SBC
+            case 0xe2: c = readImmediate(); opuNOP(); break; // uNOP
+            case 0xe3: c = rmwIndirectX(); opuISB(); writeDataToAD(); break; // uISB
+            case 0xe4: c = readZeroPage(); opCPX(); break; // CPX
+            case 0xe5: c = readZeroPage(); opSBC(); break; // SBC
+            case 0xe6: c = rmwZeroPage(); opINC(); writeDataToAD(); break; // INC
+            case 0xe7: c = rmwZeroPage(); opuISB(); writeDataToAD(); break; // uISB
+            case 0xe8: c = readImplied(); opINX(); break; // INX
+            case 0xe9: c = readImmediate(); opSBC(); break; // SBC
+            case 0xea: c = readImplied(); opNOP(); break; // NOP
+            case 0xeb: c = readImmediate(); opSBC(); break; // SBC
+            case 0xec: c = readAbsolute(); opCPX(); break; // CPX
+            case 0xed: c = readAbsolute(); opSBC(); break; // SBC
+            case 0xee: c = rmwAbsolute(); opINC(); writeDataToAD(); break; // INC
+            case 0xef: c = rmwAbsolute(); opuISB(); writeDataToAD(); break; // uISB
+            case 0xf0: c = branch(Z === 1); break; // BEQ
+            case 0xf1: c = readIndirectY(); opSBC(); break; // SBC
+            case 0xf2: return executeKIL(); // uKIL
+            case 0xf3: c = rmwIndirectY(); opuISB(); writeDataToBA(); break; // uISB
+            case 0xf4: c = readZeroPageX(); opuNOP(); break; // uNOP
+            case 0xf5: c = readZeroPageX(); opSBC(); break; // SBC
+            case 0xf6: c = rmwZeroPageX(); opINC(); writeDataToBA(); break; // INC
+            case 0xf7: c = rmwZeroPageX(); opuISB(); writeDataToBA(); break; // uISB
+            case 0xf8: c = readImplied(); opSED(); break; // SED
+            case 0xf9: c = readAbsoluteY(); opSBC(); break; // SBC
+            case 0xfa: c = readImplied(); opuNOP(); break; // uNOP
+            case 0xfb: c = rmwAbsoluteY(); opuISB(); writeDataToBA(); break; // uISB
+            case 0xfc: c = readAbsoluteX(); opuNOP(); break; // uNOP
+            case 0xfd: c = readAbsoluteX(); opSBC(); break; // SBC
+            case 0xfe: c = rmwAbsoluteX(); opINC(); writeDataToBA(); break; // INC
+            case 0xff: c = rmwAbsoluteX(); opuISB(); writeDataToBA(); break; // uISB
+        }
+        fetchNextOpcode();
+        return c;
+    };
+
+    // only call when isPCStable() is true; same bus cycles as setNMI()/setIRQ() + clockPulse()
+    this.executeInterrupt = function(vector:number) : number {
+        PC = (PC-1) & 0xffff;
+        pushToStack((PC >>> 8) & 0xff);
+        pushToStack(PC & 0xff);
+        pushToStack(getStatusBits());
+        AD = bus.read(vector);
+        AD |= bus.read(vector + 1) << 8;
+        PC = AD;
+        fetchNextOpcode();
+        return 6;
+    };
+
+    this.executeNMI = function() : number {
+        return this.executeInterrupt(NMI_VECTOR);
+    };
+
+    this.executeIRQ = function() : number {
+        return this.executeInterrupt(IRQ_VECTOR);
+    };
+
+    // register file for translated code: [PC, A, X, Y, SP, N, V, D, I, Z, C]
+    // only call when isPCStable() is true
+    this.getRegisters = function(r:Int32Array) {
+        r[0] = (PC-1) & 0xffff;
+        r[1] = A; r[2] = X; r[3] = Y; r[4] = SP;
+        r[5] = N; r[6] = V; r[7] = D; r[8] = I; r[9] = Z; r[10] = C;
+    };
+
+    // resumes at r[0], fetching its opcode like the end of any instruction
+    this.setRegisters = function(r:Int32Array) {
+        PC = r[0];
+        A = r[1]; X = r[2]; Y = r[3]; SP = r[4];
+        N = r[5]; V = r[6]; D = r[7]; I = r[8]; Z = r[9]; C = r[10];
+        fetchNextOpcode();
+    };
+
+
     // Savestate  -------------------------------------------
 
     this.saveState = function():MOS6502State {
@@ -1775,6 +2434,32 @@ var _MOS6502 = function() {
     };
 
 
+    // same fields as saveState(), in a fixed 48-byte layout
+    this.saveStateInto = function(buf:DataView, ofs:number):number {
+        buf.setUint16(ofs, (PC-1) & 0xffff);
+        buf.setUint8(ofs+2, A); buf.setUint8(ofs+3, X); buf.setUint8(ofs+4, Y); buf.setUint8(ofs+5, SP);
+        buf.setUint8(ofs+6, N); buf.setUint8(ofs+7, V); buf.setUint8(ofs+8, D);
+        buf.setUint8(ofs+9, I); buf.setUint8(ofs+10, Z); buf.setUint8(ofs+11, C);
+        buf.setInt32(ofs+12, T); buf.setInt32(ofs+16, opcode);
+        buf.setUint8(ofs+20, RDY?1:0); buf.setUint8(ofs+21, BALCrossed?1:0);
+        buf.setInt32(ofs+24, data); buf.setInt32(ofs+28, AD); buf.setInt32(ofs+32, BA); buf.setInt32(ofs+36, IA);
+        buf.setInt32(ofs+40, branchOffset); buf.setInt32(ofs+44, branchOffsetCrossAdjust);
+        return ofs+48;
+    };
+
+    this.loadStateFrom = function(buf:DataView, ofs:number):number {
+        PC = (buf.getUint16(ofs)+1) & 0xffff;
+        A = buf.getUint8(ofs+2); X = buf.getUint8(ofs+3); Y = buf.getUint8(ofs+4); SP = buf.getUint8(ofs+5);
+        N = buf.getUint8(ofs+6); V = buf.getUint8(ofs+7); D = buf.getUint8(ofs+8);
+        I = buf.getUint8(ofs+9); Z = buf.getUint8(ofs+10); C = buf.getUint8(ofs+11);
+        T = buf.getInt32(ofs+12); opcode = buf.getInt32(ofs+16);
+        RDY = buf.getUint8(ofs+20) != 0; BALCrossed = buf.getUint8(ofs+21) != 0;
+        data = buf.getInt32(ofs+24); AD = buf.getInt32(ofs+28); BA = buf.getInt32(ofs+32); IA = buf.getInt32(ofs+36);
+        branchOffset = buf.getInt32(ofs+40); branchOffsetCrossAdjust = buf.getInt32(ofs+44);
+        instruction = opcode < 0 ? [ fetchOpcodeAndDecodeInstruction ] : instructions[opcode];
+        return ofs+48;
+    };
+
     // Accessory methods
 
     this.toString = function() {
@@ -1895,6 +2580,7 @@ var _MOS6502 = function() {
     this.getSP = function() { return SP; }
     this.getPC = function() { return (PC-1) & 0xffff; }
     this.getT = function() { return T; }
+    this.getI = function() { return I; }
     
     this.isPCStable = function() {
       return T == 0;
@@ -1927,7 +2613,7 @@ boa : number;
 
 export enum MOS6502Interrupts { None=0, NMI=1, IRQ=2 };
 
-export class MOS6502 implements CPU, ClockBased, SavesState<MOS6502State>, Interruptable<MOS6502Interrupts> {
+abstract class BaseMOS6502 implements CPU, IdleLoopAware, SavesState<MOS6502State>, SavesBinaryState, Interruptable<MOS6502Interrupts> {
 
   cpu = new _MOS6502();
   interruptType : MOS6502Interrupts = MOS6502Interrupts.None;
@@ -1935,21 +2621,6 @@ export class MOS6502 implements CPU, ClockBased, SavesState<MOS6502State>, Inter
   connectMemoryBus(bus:Bus) {
     this.cpu.connectBus(bus);
   }
-  advanceClock() {
-    if (this.interruptType && this.isStable()) {
-      switch (this.interruptType) {
-        case MOS6502Interrupts.NMI: this.cpu.setNMI(); break;
-        case MOS6502Interrupts.IRQ: this.cpu.setIRQ(); break;
-      }
-      this.interruptType = 0;
-    }
-    this.cpu.clockPulse();
-  }
-  advanceInsn() {
-    do {
-      this.advanceClock();
-    } while (!this.isStable());
-  }
   reset() {
     this.cpu.reset();
     this.interruptType = 0;
@@ -1978,9 +2649,77 @@ export class MOS6502 implements CPU, ClockBased, SavesState<MOS6502State>, Inter
     this.cpu.loadState(s);
     this.interruptType = s.it;
   }
+  getBinaryStateSize() {
+    return 48 + 1;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    ofs = this.cpu.saveStateInto(buf, ofs);
+    buf.setUint8(ofs, this.interruptType);
+    return ofs + 1;
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = this.cpu.loadStateFrom(buf, ofs);
+    this.interruptType = buf.getUint8(ofs);
+    return ofs + 1;
+  }
   isStable() : boolean {
     return this.cpu.isPCStable();
   }
+  getRegisters(r:Int32Array) {
+    this.cpu.getRegisters(r);
+    r[11] = this.interruptType;
+  }
+  getIdleRegisters(r:Int32Array) {
+    this.getRegisters(r);
+  }
+  // IRQ() doesn't check the I flag, so devices with an IRQ line can ask first
+  isIRQMasked() : boolean {
+    return this.cpu.getI() != 0;
+  }
   // TODO: metadata
   // TODO: disassembler
 }
+
+export class MOS6502 extends BaseMOS6502 implements ClockBased, InstructionBased {
+
+  advanceClock() {
+    if (this.interruptType && this.isStable()) {
+      switch (this.interruptType) {
+        case MOS6502Interrupts.NMI: this.cpu.setNMI(); break;
+        case MOS6502Interrupts.IRQ: this.cpu.setIRQ(); break;
+      }
+      this.interruptType = 0;
+    }
+    this.cpu.clockPulse();
+  }
+  advanceInsn() {
+    var n = 0;
+    do {
+      this.advanceClock();
+      n++;
+    } while (!this.isStable());
+    return n;
+  }
+}
+
+// Same CPU and MOS6502State, but executes a whole opcode per step (no sub-instruction timing).
+// Machines that only look at the bus between instructions can use this instead of MOS6502.
+export class MOS6502Fast extends BaseMOS6502 implements InstructionBased {
+
+  advanceInsn() : number {
+    // finish an instruction that was left mid-way by the per-cycle engine
+    if (!this.isStable()) {
+      this.cpu.clockPulse();
+      return 1;
+    }
+    if (this.interruptType) {
+      var itype = this.interruptType;
+      this.interruptType = 0;
+      switch (itype) {
+        case MOS6502Interrupts.NMI: return this.cpu.executeNMI();
+        case MOS6502Interrupts.IRQ: return this.cpu.executeIRQ();
+      }
+    }
+    return this.cpu.executeInstruction();
+  }
+}
@@ -0,0 +1,448 @@
+import { Bus } from "../devices";
+import { MOS6502Fast, MOS6502State } from "./MOS6502";
+
+// Block-translating MOS6502: straight-line runs of hot code are turned into
+// JavaScript functions (like AddressDecoder does for memory maps) and cached by
+// start address. Everything else, including interrupts, illegal opcodes and BRK,
+// goes through the MOS6502Fast interpreter. Opcode and operand fetches are
+// compiled in as constants, so only data accesses reach the bus.
+//
+// Writes through the CPU into a page with translated code discard its blocks.
+// Machines that change memory behind the CPU's back (bank switching, DMA) must
+// call invalidate(), and pages with side-effecting reads must be marked with
+// setIORange() -- code there is never translated, a constant access to them
+// gets a block of its own, and an indexed access to them ends the block.
+//
+// Translated blocks do not report single instructions, so turn off jitEnabled
+// while a probe or breakpoint is attached.
+
+type JITBlock = (r:Int32Array, m:Bus, j:MOS6502JIT, pf:Uint8Array, ram:Uint8Array) => number;
+
+const PAGE_IO    = 1; // reads have side effects
+const PAGE_CODE  = 2; // has translated blocks
+const PAGE_NOJIT = 4; // rewritten too often to bother
+const PAGE_RAM   = 8; // reads come straight from the memory array
+
+const JIT_THRESHOLD = 8;        // visits before a start address is translated
+const JIT_MAX_INSNS = 32;       // instructions per block
+const JIT_MAX_REWRITES = 32;    // invalidations before a page is left to the interpreter
+const JIT_LOOP_CYCLES = 128;    // a block that branches back to its start may loop this long
+
+// documented opcodes only
+const OPTABLE : {[opcode:number] : [string,string]} = {
+  0x69:['ADC','imm'], 0x65:['ADC','zp'], 0x75:['ADC','zpx'], 0x6d:['ADC','abs'], 0x7d:['ADC','absx'], 0x79:['ADC','absy'], 0x61:['ADC','indx'], 0x71:['ADC','indy'],
+  0x29:['AND','imm'], 0x25:['AND','zp'], 0x35:['AND','zpx'], 0x2d:['AND','abs'], 0x3d:['AND','absx'], 0x39:['AND','absy'], 0x21:['AND','indx'], 0x31:['AND','indy'],
+  0x49:['EOR','imm'], 0x45:['EOR','zp'], 0x55:['EOR','zpx'], 0x4d:['EOR','abs'], 0x5d:['EOR','absx'], 0x59:['EOR','absy'], 0x41:['EOR','indx'], 0x51:['EOR','indy'],
+  0x09:['ORA','imm'], 0x05:['ORA','zp'], 0x15:['ORA','zpx'], 0x0d:['ORA','abs'], 0x1d:['ORA','absx'], 0x19:['ORA','absy'], 0x01:['ORA','indx'], 0x11:['ORA','indy'],
+  0xc9:['CMP','imm'], 0xc5:['CMP','zp'], 0xd5:['CMP','zpx'], 0xcd:['CMP','abs'], 0xdd:['CMP','absx'], 0xd9:['CMP','absy'], 0xc1:['CMP','indx'], 0xd1:['CMP','indy'],
+  0xe9:['SBC','imm'], 0xe5:['SBC','zp'], 0xf5:['SBC','zpx'], 0xed:['SBC','abs'], 0xfd:['SBC','absx'], 0xf9:['SBC','absy'], 0xe1:['SBC','indx'], 0xf1:['SBC','indy'],
+  0xa9:['LDA','imm'], 0xa5:['LDA','zp'], 0xb5:['LDA','zpx'], 0xad:['LDA','abs'], 0xbd:['LDA','absx'], 0xb9:['LDA','absy'], 0xa1:['LDA','indx'], 0xb1:['LDA','indy'],
+  0xa2:['LDX','imm'], 0xa6:['LDX','zp'], 0xb6:['LDX','zpy'], 0xae:['LDX','abs'], 0xbe:['LDX','absy'],
+  0xa0:['LDY','imm'], 0xa4:['LDY','zp'], 0xb4:['LDY','zpx'], 0xac:['LDY','abs'], 0xbc:['LDY','absx'],
+  0xe0:['CPX','imm'], 0xe4:['CPX','zp'], 0xec:['CPX','abs'],
+  0xc0:['CPY','imm'], 0xc4:['CPY','zp'], 0xcc:['CPY','abs'],
+  0x24:['BIT','zp'], 0x2c:['BIT','abs'],
+  0x85:['STA','zp'], 0x95:['STA','zpx'], 0x8d:['STA','abs'], 0x9d:['STA','absx'], 0x99:['STA','absy'], 0x81:['STA','indx'], 0x91:['STA','indy'],
+  0x86:['STX','zp'], 0x96:['STX','zpy'], 0x8e:['STX','abs'],
+  0x84:['STY','zp'], 0x94:['STY','zpx'], 0x8c:['STY','abs'],
+  0x0a:['ASL','acc'], 0x06:['ASL','zp'], 0x16:['ASL','zpx'], 0x0e:['ASL','abs'], 0x1e:['ASL','absx'],
+  0x4a:['LSR','acc'], 0x46:['LSR','zp'], 0x56:['LSR','zpx'], 0x4e:['LSR','abs'], 0x5e:['LSR','absx'],
+  0x2a:['ROL','acc'], 0x26:['ROL','zp'], 0x36:['ROL','zpx'], 0x2e:['ROL','abs'], 0x3e:['ROL','absx'],
+  0x6a:['ROR','acc'], 0x66:['ROR','zp'], 0x76:['ROR','zpx'], 0x6e:['ROR','abs'], 0x7e:['ROR','absx'],
+  0xe6:['INC','zp'], 0xf6:['INC','zpx'], 0xee:['INC','abs'], 0xfe:['INC','absx'],
+  0xc6:['DEC','zp'], 0xd6:['DEC','zpx'], 0xce:['DEC','abs'], 0xde:['DEC','absx'],
+  0x18:['CLC','imp'], 0xd8:['CLD','imp'], 0x58:['CLI','imp'], 0xb8:['CLV','imp'],
+  0x38:['SEC','imp'], 0xf8:['SED','imp'], 0x78:['SEI','imp'], 0xea:['NOP','imp'],
+  0xca:['DEX','imp'], 0x88:['DEY','imp'], 0xe8:['INX','imp'], 0xc8:['INY','imp'],
+  0xaa:['TAX','imp'], 0xa8:['TAY','imp'], 0xba:['TSX','imp'], 0x8a:['TXA','imp'], 0x9a:['TXS','imp'], 0x98:['TYA','imp'],
+  0x48:['PHA','imp'], 0x08:['PHP','imp'], 0x68:['PLA','imp'], 0x28:['PLP','imp'],
+  0x10:['BPL','rel'], 0x30:['BMI','rel'], 0x50:['BVC','rel'], 0x70:['BVS','rel'],
+  0x90:['BCC','rel'], 0xb0:['BCS','rel'], 0xd0:['BNE','rel'], 0xf0:['BEQ','rel'],
+  0x4c:['JMP','abs'], 0x6c:['JMP','ind'], 0x20:['JSR','abs'], 0x60:['RTS','imp'], 0x40:['RTI','imp'],
+};
+
+const INSN_LENGTH = {
+  imp:1, acc:1, imm:2, zp:2, zpx:2, zpy:2, rel:2, indx:2, indy:2, abs:3, absx:3, absy:3, ind:3
+};
+
+function zn(v:string) : string {
+  return "Z=" + v + "===0?1:0;N=" + v + ">>7;";
+}
+
+// operations on the fetched operand d
+const READ_OPS = {
+  ADC: "if(D){al=(A&15)+(d&15)+C;if(al>9)al+=6;ah=((A>>4)+(d>>4)+(al>15?1:0))<<4;"
+      +"Z=((A+d+C)&255)===0?1:0;N=(ah>>7)&1;V=((A^ah)&~(A^d)&128)?1:0;if(ah>0x9f)ah+=0x60;C=ah>255?1:0;A=(ah|(al&15))&255;}"
+      +"else{t=A+d+C;C=t>255?1:0;V=((A^t)&(d^t)&128)?1:0;A=t&255;" + zn("A") + "}",
+  SBC: "if(D){al=(A&15)-(d&15)-(1-C);ah=(A>>4)-(d>>4)-(al<0?1:0);if(al<0)al-=6;if(ah<0)ah-=6;"
+      +"t=A-d-(1-C);C=(~t&256)?1:0;V=((A^d)&(A^t)&128)?1:0;Z=(t&255)===0?1:0;N=(t>>7)&1;A=((ah<<4)|(al&15))&255;}"
+      +"else{u=(~d)&255;t=A+u+C;C=t>255?1:0;V=((A^t)&(u^t)&128)?1:0;A=t&255;" + zn("A") + "}",
+  AND: "A&=d;" + zn("A"),
+  EOR: "A^=d;" + zn("A"),
+  ORA: "A|=d;" + zn("A"),
+  LDA: "A=d;" + zn("A"),
+  LDX: "X=d;" + zn("X"),
+  LDY: "Y=d;" + zn("Y"),
+  CMP: "C=A>=d?1:0;t=(A-d)&255;" + zn("t"),
+  CPX: "C=X>=d?1:0;t=(X-d)&255;" + zn("t"),
+  CPY: "C=Y>=d?1:0;t=(Y-d)&255;" + zn("t"),
+  BIT: "Z=(A&d)===0?1:0;V=(d>>6)&1;N=d>>7;",
+};
+
+const STORE_OPS = { STA:"A", STX:"X", STY:"Y" };
+
+const RMW_OPS = {
+  ASL: "C=d>>7;d=(d<<1)&255;" + zn("d"),
+  LSR: "C=d&1;d>>>=1;Z=d===0?1:0;N=0;",
+  ROL: "t=d>>7;d=((d<<1)|C)&255;C=t;" + zn("d"),
+  ROR: "t=d&1;d=(d>>>1)|(C<<7);C=t;" + zn("d"),
+  INC: "d=(d+1)&255;" + zn("d"),
+  DEC: "d=(d-1)&255;" + zn("d"),
+};
+
+const IMPLIED_OPS = {
+  CLC: "C=0;", CLD: "D=0;", CLI: "I=0;", CLV: "V=0;",
+  SEC: "C=1;", SED: "D=1;", SEI: "I=1;", NOP: "",
+  DEX: "X=(X-1)&255;" + zn("X"), DEY: "Y=(Y-1)&255;" + zn("Y"),
+  INX: "X=(X+1)&255;" + zn("X"), INY: "Y=(Y+1)&255;" + zn("Y"),
+  TAX: "X=A;" + zn("X"), TAY: "Y=A;" + zn("Y"), TSX: "X=SP;" + zn("X"),
+  TXA: "A=X;" + zn("A"), TYA: "A=Y;" + zn("A"), TXS: "SP=X;",
+};
+
+const BRANCH_CONDITIONS = {
+  BPL: "!N", BMI: "N", BVC: "!V", BVS: "V", BCC: "!C", BCS: "C", BNE: "!Z", BEQ: "Z"
+};
+
+const PUSH = (v:string) => "j.write(256+SP," + v + ");SP=(SP-1)&255;";
+
+export class MOS6502JIT extends MOS6502Fast {
+
+  jitEnabled = true;
+
+  bus : Bus;
+  regs = new Int32Array(11);
+  live = false;     // true when regs, not the interpreter, hold the CPU state
+  stop = false;     // set when a write lands in an I/O or translated page
+  blocks : JITBlock[] = new Array(0x10000);
+  pageBlocks : number[][] = new Array(256);
+  pageFlags = new Uint8Array(256);
+  pageRewrites = new Uint8Array(256);
+  hits = new Uint8Array(0x10000);
+  hasIO = false;
+  ram : Uint8Array;
+
+  connectMemoryBus(bus:Bus) {
+    this.bus = bus;
+    // interpreter writes go through write() too, so they invalidate translated code
+    super.connectMemoryBus(this);
+    this.flush();
+  }
+  read(a:number) : number {
+    return this.bus.read(a);
+  }
+  write(a:number, v:number) {
+    this.bus.write(a, v);
+    var f = this.pageFlags[a >> 8] & (PAGE_IO | PAGE_CODE);
+    if (f) {
+      if (f & PAGE_CODE) this.invalidatePage(a >> 8);
+      this.stop = true;
+    }
+  }
+  setIORange(start:number, end:number) {
+    for (var p = start >> 8; p <= (end >> 8); p++)
+      this.pageFlags[p] |= PAGE_IO;
+    this.hasIO = true;
+    this.flush();
+  }
+  // reads in this range have no side effects and can index mem directly (writes still use the bus)
+  setRAMRange(start:number, end:number, mem:Uint8Array) {
+    for (var p = start >> 8; p <= (end >> 8); p++)
+      this.pageFlags[p] |= PAGE_RAM;
+    this.ram = mem;
+    this.flush();
+  }
+  // discard translated code in a range of addresses
+  invalidate(start:number, end:number) {
+    for (var p = start >> 8; p <= (end >> 8); p++)
+      this.invalidatePage(p);
+  }
+  invalidatePage(p:number) {
+    var list = this.pageBlocks[p];
+    if (list) {
+      for (var a of list) this.blocks[a] = undefined;
+      this.pageBlocks[p] = null;
+    }
+    for (var a = p << 8; a < (p << 8) + 256; a++)
+      this.blocks[a] = undefined;
+    if (this.pageFlags[p] & PAGE_CODE) {
+      this.pageFlags[p] &= ~PAGE_CODE;
+      if (++this.pageRewrites[p] >= JIT_MAX_REWRITES) this.pageFlags[p] |= PAGE_NOJIT;
+    }
+    this.stop = true;
+  }
+  flush() {
+    this.blocks = new Array(0x10000);
+    this.pageBlocks = new Array(256);
+    this.pageRewrites.fill(0);
+    this.hits.fill(0);
+    for (var p = 0; p < 256; p++)
+      this.pageFlags[p] &= PAGE_IO | PAGE_RAM;
+  }
+
+  advanceInsn() : number {
+    if (this.jitEnabled && !this.interruptType && (this.live || this.cpu.isPCStable())) {
+      var pc = this.live ? this.regs[0] : this.cpu.getPC();
+      var block = this.blocks[pc];
+      if (block === undefined && ++this.hits[pc] >= JIT_THRESHOLD) {
+        block = this.blocks[pc] = this.translate(pc);
+      }
+      if (block) {
+        if (!this.live) {
+          this.cpu.getRegisters(this.regs);
+          this.live = true;
+        }
+        this.stop = false;
+        return block(this.regs, this.bus, this, this.pageFlags, this.ram);
+      }
+    }
+    this.sync();
+    return super.advanceInsn();
+  }
+  // hand the registers back to the interpreter
+  sync() {
+    if (this.live) {
+      this.live = false;
+      this.cpu.setRegisters(this.regs);
+    }
+  }
+
+  reset() {
+    this.live = false;
+    super.reset();
+    this.flush();
+  }
+  getPC() {
+    return this.live ? this.regs[0] : super.getPC();
+  }
+  getSP() {
+    return this.live ? this.regs[4] : super.getSP();
+  }
+  isIRQMasked() : boolean {
+    return this.live ? this.regs[8] != 0 : super.isIRQMasked();
+  }
+  isStable() : boolean {
+    return this.live || super.isStable();
+  }
+  getRegisters(r:Int32Array) {
+    if (this.live) {
+      r.set(this.regs);
+      r[11] = this.interruptType;
+    } else {
+      super.getRegisters(r);
+    }
+  }
+  saveState() {
+    this.sync();
+    return super.saveState();
+  }
+  loadState(s:MOS6502State) {
+    this.live = false;
+    super.loadState(s);
+    // memory is usually restored along with the CPU
+    this.flush();
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    this.sync();
+    return super.saveStateInto(buf, ofs);
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    this.live = false;
+    ofs = super.loadStateFrom(buf, ofs);
+    this.flush();
+    return ofs;
+  }
+
+  translate(start:number) : JITBlock {
+    var pf = this.pageFlags;
+    // zero page and stack are accessed without I/O checks
+    if ((pf[0] | pf[1]) & PAGE_IO) return null;
+    var src = "";
+    var pages = [];
+    var pc = start;
+    var cycles = 0;
+    var ninsns = 0;
+    var ended = false;
+    var alone = false;
+    var loops = false;
+    while (ninsns < JIT_MAX_INSNS && !ended && !alone) {
+      var entry = OPTABLE[this.bus.read(pc)];
+      if (!entry) break;
+      var len = INSN_LENGTH[entry[1]];
+      var last = pc + len - 1;
+      if (last > 0xffff || ((pf[pc >> 8] | pf[last >> 8]) & (PAGE_IO | PAGE_NOJIT))) break;
+      var b1 = this.bus.read(pc + 1);
+      var b2 = this.bus.read(pc + 2);
+      var insn = this.translateInsn(entry[0], entry[1], pc, b1, b2, cycles, start);
+      if (insn.alone && ninsns > 0) break; // give it its own block so its clock is exact
+      src += "// " + pc.toString(16) + " " + entry[0] + "\n" + insn.code + "\n";
+      pages.push(pc >> 8, last >> 8);
+      cycles += insn.cycles;
+      ended = insn.ended;
+      alone = insn.alone;
+      loops = loops || insn.loops;
+      pc = (last + 1) & 0xffff;
+      ninsns++;
+    }
+    if (ninsns == 0) return null;
+    if (!ended) src += exitCode(pc.toString(), cycles) + "\n";
+    if (loops) src = "for(;;){\n" + src + "}";
+    src = "var A=r[1],X=r[2],Y=r[3],SP=r[4],N=r[5],V=r[6],D=r[7],I=r[8],Z=r[9],C=r[10];\n"
+        + "var x=0,d,ea,p,t,u,al,ah;\n" + src;
+    var block = new Function('r', 'm', 'j', 'pf', 'ram', src) as JITBlock;
+    for (var p of pages) {
+      if (!(pf[p] & PAGE_CODE)) {
+        pf[p] |= PAGE_CODE;
+        this.pageBlocks[p] = [];
+      }
+      if (this.pageBlocks[p].indexOf(start) < 0) this.pageBlocks[p].push(start);
+    }
+    return block;
+  }
+
+  translateInsn(op:string, mode:string, pc:number, b1:number, b2:number, cycles:number, start:number) {
+    var pf = this.pageFlags;
+    var w = b1 | (b2 << 8);
+    var next = (pc + INSN_LENGTH[mode]) & 0xffff;
+    var code = "";
+    var n = 0;
+    var ended = false;
+    var alone = false;
+    var loops = false;
+    var ioCheck = false;    // effective address in ea might be I/O
+    var writeCheck = false; // a write may have invalidated this block
+    var isIO = (a:number) => (pf[a >> 8] & PAGE_IO) != 0;
+    // read expression; known is any address in the same page, if that is known now
+    var rd = (a:string, known?:number) => {
+      if (known != null) return (pf[known >> 8] & PAGE_RAM) ? "ram[" + a + "]" : "m.read(" + a + ")";
+      if (!this.ram) return "m.read(" + a + ")";
+      return "((pf[" + a + ">>8]&" + PAGE_RAM + ")?ram[" + a + "]:m.read(" + a + "))";
+    };
+    var pop = (v:string) => "SP=(SP+1)&255;" + v + "=" + rd("256+SP", 256) + ";";
+    var known : number = null; // page of ea, if constant
+    // effective address, with the same dummy reads as the interpreter where they could matter
+    var address = (store:boolean) => {
+      switch (mode) {
+        case 'zp':
+          known = 0;
+          return "ea=" + b1 + ";";
+        case 'zpx':
+          known = 0;
+          return "ea=(" + b1 + "+X)&255;";
+        case 'zpy':
+          known = 0;
+          return "ea=(" + b1 + "+Y)&255;";
+        case 'abs':
+          if (isIO(w)) alone = true;
+          known = w;
+          return "ea=" + w + ";";
+        case 'absx':
+        case 'absy':
+          var reg = mode == 'absx' ? 'X' : 'Y';
+          var s = "t=" + b1 + "+" + reg + ";ea=(" + w + "+" + reg + ")&65535;";
+          if (!store) s += "if(t>255){x++;";
+          if (isIO(w)) s += "m.read(" + (w & 0xff00) + "|(t&255));";
+          if (!store) s += "}";
+          ioCheck = true;
+          return s;
+        case 'indx':
+          ioCheck = true;
+          return "t=(" + b1 + "+X)&255;ea=" + rd("t", 0) + "|(" + rd("(t+1)&255", 0) + "<<8);";
+        case 'indy':
+          var s = "p=" + rd(String(b1), 0) + "|(" + rd(String((b1 + 1) & 255), 0) + "<<8);t=(p&255)+Y;ea=(p+Y)&65535;";
+          var dummy = this.hasIO ? "if(pf[p>>8]&1)m.read((p&65280)|(t&255));" : "";
+          s += store ? dummy : "if(t>255){x++;" + dummy + "}";
+          ioCheck = true;
+          return s;
+      }
+    };
+    if (READ_OPS[op]) {
+      n = { imm:2, zp:3, zpx:4, zpy:4, abs:4, absx:4, absy:4, indx:6, indy:5 }[mode];
+      code = (mode == 'imm' ? "d=" + b1 + ";" : address(false) + "d=" + rd("ea", known) + ";") + READ_OPS[op];
+    } else if (STORE_OPS[op]) {
+      n = { zp:3, zpx:4, zpy:4, abs:4, absx:5, absy:5, indx:6, indy:6 }[mode];
+      code = address(true) + "j.write(ea," + STORE_OPS[op] + ");";
+      writeCheck = true;
+    } else if (RMW_OPS[op] && mode == 'acc') {
+      n = 2;
+      code = RMW_OPS[op].replace(/d/g, 'A');
+    } else if (RMW_OPS[op]) {
+      n = { zp:5, zpx:6, abs:6, absx:7 }[mode];
+      code = address(true) + "d=" + rd("ea", known) + ";";
+      // the 6502 writes the unmodified value back first
+      if (mode == 'abs') code += isIO(w) ? "j.write(ea,d);" : "";
+      else if (ioCheck && this.hasIO) code += "if(pf[ea>>8]&1)j.write(ea,d);";
+      code += RMW_OPS[op] + "j.write(ea,d);";
+      writeCheck = true;
+    } else if (IMPLIED_OPS[op] != null) {
+      n = 2;
+      code = IMPLIED_OPS[op];
+    } else if (BRANCH_CONDITIONS[op]) {
+      var target = (next + (b1 < 128 ? b1 : b1 - 256)) & 0xffff;
+      var taken = ((target ^ next) & 0xff00) ? 4 : 3;
+      n = 2;
+      code = "if(" + BRANCH_CONDITIONS[op] + ")";
+      if (target == start) {
+        // count the iteration and go around again without leaving the block
+        code += "{x+=" + (cycles + taken) + ";if(x<" + JIT_LOOP_CYCLES + ")continue;" + exitCode(target.toString(), 0) + "}";
+        loops = true;
+      } else {
+        code += exitCode(target.toString(), cycles + taken);
+      }
+    } else {
+      switch (op) {
+        case 'PHA':
+          n = 3; code = PUSH("A"); writeCheck = true; break;
+        case 'PHP':
+          n = 3; code = PUSH("N<<7|V<<6|48|D<<3|I<<2|Z<<1|C"); writeCheck = true; break;
+        case 'PLA':
+          n = 4; code = pop("A") + zn("A"); break;
+        case 'PLP':
+          n = 4; code = pop("t") + "N=t>>>7;V=t>>>6&1;D=t>>>3&1;I=t>>>2&1;Z=t>>>1&1;C=t&1;"; break;
+        case 'JMP':
+          if (mode == 'abs') {
+            n = 3; code = exitCode(w.toString(), cycles + n);
+          } else {
+            // no carry into the high byte of the pointer
+            if (isIO(w)) alone = true;
+            n = 5; code = "t=" + rd(String(w), w) + "|(" + rd(String((w & 0xff00) | ((w + 1) & 0xff)), w) + "<<8);" + exitCode("t", cycles + n);
+          }
+          ended = true;
+          break;
+        case 'JSR':
+          var ret = (pc + 2) & 0xffff;
+          n = 6; code = PUSH(String(ret >> 8)) + PUSH(String(ret & 0xff)) + exitCode(w.toString(), cycles + n);
+          ended = true;
+          break;
+        case 'RTS':
+          n = 6; code = pop("t") + pop("u") + exitCode("(t|(u<<8))+1&65535", cycles + n);
+          ended = true;
+          break;
+        case 'RTI':
+          n = 6; code = pop("t") + "N=t>>>7;V=t>>>6&1;D=t>>>3&1;I=t>>>2&1;Z=t>>>1&1;C=t&1;"
+                      + pop("t") + pop("u") + exitCode("t|(u<<8)", cycles + n);
+          ended = true;
+          break;
+      }
+    }
+    // leave the block right after an indexed I/O access or a write that needs attention
+    var exits = [];
+    if (ioCheck && this.hasIO) exits.push("(pf[ea>>8]&1)");
+    if (writeCheck) exits.push("j.stop");
+    if (exits.length && !ended) code += "if(" + exits.join("||") + ")" + exitCode(next.toString(), cycles + n);
+    return { code:code, cycles:n, ended:ended, alone:alone, loops:loops };
+  }
+}
+
+function exitCode(pc:string, cycles:number) : string {
+  return "{r[0]=" + pc + ";r[1]=A;r[2]=X;r[3]=Y;r[4]=SP;r[5]=N;r[6]=V;r[7]=D;r[8]=I;r[9]=Z;r[10]=C;return " + cycles + "+x;}";
+}
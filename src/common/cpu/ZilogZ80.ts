@@ -1,6 +1,6 @@
 // Generated by CoffeeScript 1.9.3
 
-import { CPU, Bus, InstructionBased, IOBusConnected, SavesState, Interruptable } from "../devices";
+import { CPU, Bus, InstructionBased, IOBusConnected, SavesState, Interruptable, MemoryPageTable, MemoryPagesConnected, IdleLoopAware, SavesBinaryState } from "../devices";
 
 ///////////////////////////////////////////////////////////////////////////////
 /// @file Z80.js
@@ -44,6 +44,28 @@ function FastZ80(coreParameter)
    if (!core || (typeof core.mem_read !== "function") || (typeof core.mem_write !== "function") ||
                 (typeof core.io_read !== "function")  || (typeof core.io_write !== "function"))
       throw("Z80: Core object is missing required functions.");
+
+   // Optionally, the core can also provide read_pages and write_pages:
+   //  256 entries each, one per 256-byte page of the address space.
+   // An entry that is a Uint8Array is plain memory and is accessed directly,
+   //  a null entry sends the access to mem_read/mem_write as usual.
+   const read_pages = core.read_pages || new Array(256);
+   const write_pages = core.write_pages || new Array(256);
+
+   function mem_read(address)
+   {
+      var page = read_pages[address >>> 8];
+      return page ? page[address & 0xff] : core.mem_read(address);
+   }
+
+   function mem_write(address, value)
+   {
+      var page = write_pages[address >>> 8];
+      if (page) { page[address & 0xff] = value; page_writes++; }
+      else core.mem_write(address, value);
+   }
+   // counts writes that didn't go through core.mem_write
+   let page_writes = 0;
    
    // All right, let's initialize the registers.
    // First, the standard 8080 registers.
@@ -119,6 +141,110 @@ function FastZ80(coreParameter)
       };   
    }
 
+   // same fields as getState(), in a fixed 38-byte layout
+   function saveStateInto(buf:DataView, ofs:number):number {
+      buf.setUint16(ofs, pc);
+      buf.setUint16(ofs+2, sp);
+      buf.setUint16(ofs+4, ix);
+      buf.setUint16(ofs+6, iy);
+      buf.setUint16(ofs+8, (a<<8)+get_flags_register());
+      buf.setUint16(ofs+10, (b<<8)+c);
+      buf.setUint16(ofs+12, (d<<8)+e);
+      buf.setUint16(ofs+14, (h<<8)+l);
+      buf.setUint16(ofs+16, (a_prime<<8)+get_flags_prime());
+      buf.setUint16(ofs+18, (b_prime<<8)+c_prime);
+      buf.setUint16(ofs+20, (d_prime<<8)+e_prime);
+      buf.setUint16(ofs+22, (h_prime<<8)+l_prime);
+      buf.setUint16(ofs+24, (i<<8)+r);
+      buf.setUint8(ofs+26, imode);
+      buf.setUint8(ofs+27, iff1);
+      buf.setUint8(ofs+28, iff2);
+      buf.setUint8(ofs+29, (halted?1:0) + (do_delayed_di?2:0) + (do_delayed_ei?4:0));
+      buf.setFloat64(ofs+30, cycle_counter);
+      return ofs+38;
+   }
+
+   function loadStateFrom(buf:DataView, ofs:number):number {
+      pc = buf.getUint16(ofs);
+      sp = buf.getUint16(ofs+2);
+      ix = buf.getUint16(ofs+4);
+      iy = buf.getUint16(ofs+6);
+      var af = buf.getUint16(ofs+8);
+      a = af >> 8;
+      set_flags_register(af);
+      var bc = buf.getUint16(ofs+10);
+      b = bc >> 8;
+      c = bc & 0xff;
+      var de = buf.getUint16(ofs+12);
+      d = de >> 8;
+      e = de & 0xff;
+      var hl = buf.getUint16(ofs+14);
+      h = hl >> 8;
+      l = hl & 0xff;
+      var af_ = buf.getUint16(ofs+16);
+      a_prime = af_ >> 8;
+      set_flags_prime(af_);
+      var bc_ = buf.getUint16(ofs+18);
+      b_prime = bc_ >> 8;
+      c_prime = bc_ & 0xff;
+      var de_ = buf.getUint16(ofs+20);
+      d_prime = de_ >> 8;
+      e_prime = de_ & 0xff;
+      var hl_ = buf.getUint16(ofs+22);
+      h_prime = hl_ >> 8;
+      l_prime = hl_ & 0xff;
+      var ir = buf.getUint16(ofs+24);
+      i = ir >> 8;
+      r = ir & 0xff;
+      imode = buf.getUint8(ofs+26);
+      iff1 = buf.getUint8(ofs+27);
+      iff2 = buf.getUint8(ofs+28);
+      var bits = buf.getUint8(ofs+29);
+      halted = (bits & 1) != 0;
+      do_delayed_di = (bits & 2) != 0;
+      do_delayed_ei = (bits & 4) != 0;
+      cycle_counter = buf.getFloat64(ofs+30);
+      return ofs+38;
+   }
+
+   // Everything that has to match for a loop iteration to repeat exactly.
+   // R is left out, since it counts instructions; skip_idle_iterations()
+   //  steps it forward by however much the last iteration moved it.
+   let idle_r = 0;
+   let idle_r_step = 0;
+   function get_registers(regs:Int32Array)
+   {
+      regs[0] = pc;
+      regs[1] = sp;
+      regs[2] = (a << 8) + get_flags_register();
+      regs[3] = (b << 8) + c;
+      regs[4] = (d << 8) + e;
+      regs[5] = (h << 8) + l;
+      regs[6] = (a_prime << 8) + get_flags_prime();
+      regs[7] = (b_prime << 8) + c_prime;
+      regs[8] = (d_prime << 8) + e_prime;
+      regs[9] = (h_prime << 8) + l_prime;
+      regs[10] = ix;
+      regs[11] = iy;
+      regs[12] = i;
+      regs[13] = (imode << 2) + (iff1 << 1) + iff2;
+      regs[14] = (halted ? 1 : 0) + (do_delayed_di ? 2 : 0) + (do_delayed_ei ? 4 : 0);
+      regs[15] = page_writes;
+   }
+
+   function get_idle_registers(regs:Int32Array)
+   {
+      get_registers(regs);
+      idle_r_step = (r - idle_r) & 0x7f;
+      idle_r = r;
+   }
+
+   function skip_idle_iterations(n:number)
+   {
+      r = (r & 0x80) | ((r + n * idle_r_step) & 0x7f);
+      idle_r = r;
+   }
+
    function setState(state:Z80State) {
     pc = state.PC;
     sp = state.SP;
@@ -213,7 +339,7 @@ let run_instruction = function()
       r = (r & 0x80) | (((r & 0x7f) + 1) & 0x7f);
       
       // Read the byte at the PC and run the instruction it encodes.
-      var opcode = core.mem_read(pc);
+      var opcode = mem_read(pc);
       decode_instruction(opcode);
       pc = (pc + 1) & 0xffff;
       
@@ -307,8 +433,8 @@ let interrupt = function(non_maskable:boolean, data:number) : boolean
          //  but it doesn't appear that this is actually the case on the hardware,
          //  so we don't attempt to enforce that here.
          var vector_address = ((i << 8) | data);
-         pc = core.mem_read(vector_address) | 
-                   (core.mem_read((vector_address + 1) & 0xffff) << 8);
+         pc = mem_read(vector_address) | 
+                   (mem_read((vector_address + 1) & 0xffff) << 8);
          
          cycle_counter += 19;
       }
@@ -336,7 +462,7 @@ let decode_instruction = function(opcode)
              ((opcode & 0x07) === 3) ? e :
              ((opcode & 0x07) === 4) ? h :
              ((opcode & 0x07) === 5) ? l :
-             ((opcode & 0x07) === 6) ? core.mem_read(l | (h << 8)) : a;
+             ((opcode & 0x07) === 6) ? mem_read(l | (h << 8)) : a;
    };
 
    // Handle HALT right up front, because it fouls up our LD decoding
@@ -364,7 +490,7 @@ let decode_instruction = function(opcode)
       else if (((opcode & 0x38) >>> 3) === 5)
          l = operand;
       else if (((opcode & 0x38) >>> 3) === 6)
-         core.mem_write(l | (h << 8), operand);
+         mem_write(l | (h << 8), operand);
       else if (((opcode & 0x38) >>> 3) === 7)
          a = operand;
    }
@@ -518,18 +644,18 @@ let push_word = function(operand)
    //  decrement the stack pointer, write the high byte to the new
    //  stack pointer location, then repeat for the low byte.
    sp = (sp - 1) & 0xffff;
-   core.mem_write(sp, (operand & 0xff00) >>> 8);
+   mem_write(sp, (operand & 0xff00) >>> 8);
    sp = (sp - 1) & 0xffff;
-   core.mem_write(sp, operand & 0x00ff);
+   mem_write(sp, operand & 0x00ff);
 };
 
 let pop_word = function()
 {
    // Again, not complicated; read a byte off the top of the stack,
    //  increment the stack pointer, rinse and repeat.
-   var retval = core.mem_read(sp) & 0xff;
+   var retval = mem_read(sp) & 0xff;
    sp = (sp + 1) & 0xffff;
-   retval |= core.mem_read(sp) << 8;
+   retval |= mem_read(sp) << 8;
    sp = (sp + 1) & 0xffff;
    return retval;
 };
@@ -550,8 +676,8 @@ let do_conditional_absolute_jump = function(condition)
       //  because the instruction decoder increments the PC
       //  unconditionally at the end of every instruction
       //  and we need to counteract that so we end up at the jump target.
-      pc =  core.mem_read((pc + 1) & 0xffff) |
-                (core.mem_read((pc + 2) & 0xffff) << 8);
+      pc =  mem_read((pc + 1) & 0xffff) |
+                (mem_read((pc + 2) & 0xffff) << 8);
       pc = (pc - 1) & 0xffff;
    }
    else
@@ -569,7 +695,7 @@ let do_conditional_relative_jump = function(condition)
       // We need a few more cycles to actually take the jump.
       cycle_counter += 5;
       // Calculate the offset specified by our operand.
-      var offset = get_signed_offset_byte(core.mem_read((pc + 1) & 0xffff));
+      var offset = get_signed_offset_byte(mem_read((pc + 1) & 0xffff));
       // Add the offset to the PC, also skipping past this instruction.
       pc = (pc + offset + 1) & 0xffff;
    }
@@ -588,8 +714,8 @@ let do_conditional_call = function(condition)
    {
       cycle_counter += 7;
       push_word((pc + 3) & 0xffff);
-      pc =  core.mem_read((pc + 1) & 0xffff) |
-                (core.mem_read((pc + 2) & 0xffff) << 8);
+      pc =  mem_read((pc + 1) & 0xffff) |
+                (mem_read((pc + 2) & 0xffff) << 8);
       pc = (pc - 1) & 0xffff;
    }
    else
@@ -853,8 +979,8 @@ let do_neg = function()
 let do_ldi = function()
 {
    // Copy the value that we're supposed to copy.
-   var read_value = core.mem_read(l | (h << 8));
-   core.mem_write(e | (d << 8), read_value);
+   var read_value = mem_read(l | (h << 8));
+   mem_write(e | (d << 8), read_value);
    
    // Increment DE and HL, and decrement BC.
    var result = (e | (d << 8)) + 1;
@@ -877,7 +1003,7 @@ let do_ldi = function()
 let do_cpi = function()
 {
    var temp_carry = flags.C;
-   var read_value = core.mem_read(l | (h << 8))
+   var read_value = mem_read(l | (h << 8))
    do_cp(read_value);
    flags.C = temp_carry;
    flags.Y = ((a - read_value - flags.H) & 0x02) >>> 1;
@@ -897,7 +1023,7 @@ let do_ini = function()
 {
    b = do_dec(b);
    
-   core.mem_write(l | (h << 8), core.io_read((b << 8) | c));
+   mem_write(l | (h << 8), core.io_read((b << 8) | c));
    
    var result = (l | (h << 8)) + 1;
    l = result & 0xff;
@@ -908,7 +1034,7 @@ let do_ini = function()
 
 let do_outi = function()
 {
-   core.io_write((b << 8) | c, core.mem_read(l | (h << 8)));
+   core.io_write((b << 8) | c, mem_read(l | (h << 8)));
    
    var result = (l | (h << 8)) + 1;
    l = result & 0xff;
@@ -923,8 +1049,8 @@ let do_ldd = function()
    flags.N = 0;
    flags.H = 0;
    
-   var read_value = core.mem_read(l | (h << 8));
-   core.mem_write(e | (d << 8), read_value);
+   var read_value = mem_read(l | (h << 8));
+   mem_write(e | (d << 8), read_value);
    
    var result = (e | (d << 8)) - 1;
    e = result & 0xff;
@@ -944,7 +1070,7 @@ let do_ldd = function()
 let do_cpd = function()
 {
    var temp_carry = flags.C
-   var read_value = core.mem_read(l | (h << 8))
+   var read_value = mem_read(l | (h << 8))
    do_cp(read_value);
    flags.C = temp_carry;
    flags.Y = ((a - read_value - flags.H) & 0x02) >>> 1;
@@ -964,7 +1090,7 @@ let do_ind = function()
 {
    b = do_dec(b);
    
-   core.mem_write(l | (h << 8), core.io_read((b << 8) | c));
+   mem_write(l | (h << 8), core.io_read((b << 8) | c));
    
    var result = (l | (h << 8)) - 1;
    l = result & 0xff;
@@ -975,7 +1101,7 @@ let do_ind = function()
 
 let do_outd = function()
 {
-   core.io_write((b << 8) | c, core.mem_read(l | (h << 8)));
+   core.io_write((b << 8) | c, mem_read(l | (h << 8)));
    
    var result = (l | (h << 8)) - 1;
    l = result & 0xff;
@@ -1143,14 +1269,14 @@ instructions[0x00] = function() { };
 instructions[0x01] = function()
 {
    pc = (pc + 1) & 0xffff;
-   c = core.mem_read(pc);
+   c = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   b = core.mem_read(pc);
+   b = mem_read(pc);
 };
 // 0x02 : LD (BC), A
 instructions[0x02] = function()
 {
-   core.mem_write(c | (b << 8), a);
+   mem_write(c | (b << 8), a);
 };
 // 0x03 : INC BC
 instructions[0x03] = function()
@@ -1174,7 +1300,7 @@ instructions[0x05] = function()
 instructions[0x06] = function()
 {
    pc = (pc + 1) & 0xffff;
-   b = core.mem_read(pc);
+   b = mem_read(pc);
 };
 // 0x07 : RLCA
 instructions[0x07] = function()
@@ -1208,7 +1334,7 @@ instructions[0x09] = function()
 // 0x0a : LD A, (BC)
 instructions[0x0a] = function()
 {
-   a = core.mem_read(c | (b << 8));
+   a = mem_read(c | (b << 8));
 };
 // 0x0b : DEC BC
 instructions[0x0b] = function()
@@ -1232,7 +1358,7 @@ instructions[0x0d] = function()
 instructions[0x0e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   c = core.mem_read(pc);
+   c = mem_read(pc);
 };
 // 0x0f : RRCA
 instructions[0x0f] = function()
@@ -1253,14 +1379,14 @@ instructions[0x10] = function()
 instructions[0x11] = function()
 {
    pc = (pc + 1) & 0xffff;
-   e = core.mem_read(pc);
+   e = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   d = core.mem_read(pc);
+   d = mem_read(pc);
 };
 // 0x12 : LD (DE), A
 instructions[0x12] = function()
 {
-   core.mem_write(e | (d << 8), a);
+   mem_write(e | (d << 8), a);
 };
 // 0x13 : INC DE
 instructions[0x13] = function()
@@ -1284,7 +1410,7 @@ instructions[0x15] = function()
 instructions[0x16] = function()
 {
    pc = (pc + 1) & 0xffff;
-   d = core.mem_read(pc);
+   d = mem_read(pc);
 };
 // 0x17 : RLA
 instructions[0x17] = function()
@@ -1298,7 +1424,7 @@ instructions[0x17] = function()
 // 0x18 : JR n
 instructions[0x18] = function()
 {
-   var offset = get_signed_offset_byte(core.mem_read((pc + 1) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read((pc + 1) & 0xffff));
    pc = (pc + offset + 1) & 0xffff;
 };
 // 0x19 : ADD HL, DE
@@ -1309,7 +1435,7 @@ instructions[0x19] = function()
 // 0x1a : LD A, (DE)
 instructions[0x1a] = function()
 {
-   a = core.mem_read(e | (d << 8));
+   a = mem_read(e | (d << 8));
 };
 // 0x1b : DEC DE
 instructions[0x1b] = function()
@@ -1333,7 +1459,7 @@ instructions[0x1d] = function()
 instructions[0x1e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   e = core.mem_read(pc);
+   e = mem_read(pc);
 };
 // 0x1f : RRA
 instructions[0x1f] = function()
@@ -1353,20 +1479,20 @@ instructions[0x20] = function()
 instructions[0x21] = function()
 {
    pc = (pc + 1) & 0xffff;
-   l = core.mem_read(pc);
+   l = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   h = core.mem_read(pc);
+   h = mem_read(pc);
 };
 // 0x22 : LD (nn), HL
 instructions[0x22] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, l);
-   core.mem_write((address + 1) & 0xffff, h);
+   mem_write(address, l);
+   mem_write((address + 1) & 0xffff, h);
 };
 // 0x23 : INC HL
 instructions[0x23] = function()
@@ -1390,7 +1516,7 @@ instructions[0x25] = function()
 instructions[0x26] = function()
 {
    pc = (pc + 1) & 0xffff;
-   h = core.mem_read(pc);
+   h = mem_read(pc);
 };
 // 0x27 : DAA
 instructions[0x27] = function()
@@ -1439,12 +1565,12 @@ instructions[0x29] = function()
 instructions[0x2a] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   l = core.mem_read(address);
-   h = core.mem_read((address + 1) & 0xffff);
+   l = mem_read(address);
+   h = mem_read((address + 1) & 0xffff);
 };
 // 0x2b : DEC HL
 instructions[0x2b] = function()
@@ -1468,7 +1594,7 @@ instructions[0x2d] = function()
 instructions[0x2e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   l = core.mem_read(pc);
+   l = mem_read(pc);
 };
 // 0x2f : CPL
 instructions[0x2f] = function()
@@ -1486,19 +1612,19 @@ instructions[0x30] = function()
 // 0x31 : LD SP, nn
 instructions[0x31] = function()
 {
-   sp =  core.mem_read((pc + 1) & 0xffff) | 
-            (core.mem_read((pc + 2) & 0xffff) << 8);
+   sp =  mem_read((pc + 1) & 0xffff) | 
+            (mem_read((pc + 2) & 0xffff) << 8);
    pc = (pc + 2) & 0xffff;
 };
 // 0x32 : LD (nn), A
 instructions[0x32] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, a);
+   mem_write(address, a);
 };
 // 0x33 : INC SP
 instructions[0x33] = function()
@@ -1509,19 +1635,19 @@ instructions[0x33] = function()
 instructions[0x34] = function()
 {
    var address = l | (h << 8);
-   core.mem_write(address, do_inc(core.mem_read(address)));
+   mem_write(address, do_inc(mem_read(address)));
 };
 // 0x35 : DEC (HL)
 instructions[0x35] = function()
 {
    var address = l | (h << 8);
-   core.mem_write(address, do_dec(core.mem_read(address)));
+   mem_write(address, do_dec(mem_read(address)));
 };
 // 0x36 : LD (HL), n
 instructions[0x36] = function()
 {
    pc = (pc + 1) & 0xffff;
-   core.mem_write(l | (h << 8), core.mem_read(pc));
+   mem_write(l | (h << 8), mem_read(pc));
 };
 // 0x37 : SCF
 instructions[0x37] = function()
@@ -1545,11 +1671,11 @@ instructions[0x39] = function()
 instructions[0x3a] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   a = core.mem_read(address);
+   a = mem_read(address);
 };
 // 0x3b : DEC SP
 instructions[0x3b] = function()
@@ -1569,7 +1695,7 @@ instructions[0x3d] = function()
 // 0x3e : LD A, n
 instructions[0x3e] = function()
 {
-   a = core.mem_read((pc + 1) & 0xffff);
+   a = mem_read((pc + 1) & 0xffff);
    pc = (pc + 1) & 0xffff;
 };
 // 0x3f : CCF
@@ -1600,8 +1726,8 @@ instructions[0xc2] = function()
 // 0xc3 : JP nn
 instructions[0xc3] = function()
 {
-   pc =  core.mem_read((pc + 1) & 0xffff) |
-            (core.mem_read((pc + 2) & 0xffff) << 8);
+   pc =  mem_read((pc + 1) & 0xffff) |
+            (mem_read((pc + 2) & 0xffff) << 8);
    pc = (pc - 1) & 0xffff;
 };
 // 0xc4 : CALL NZ, nn
@@ -1618,7 +1744,7 @@ instructions[0xc5] = function()
 instructions[0xc6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_add(core.mem_read(pc));
+   do_add(mem_read(pc));
 };
 // 0xc7 : RST 00h
 instructions[0xc7] = function()
@@ -1652,7 +1778,7 @@ instructions[0xcb] = function()
    // We don't have a table for this prefix,
    //  the instructions are all so uniform that we can directly decode them.
    pc = (pc + 1) & 0xffff;
-   var opcode = core.mem_read(pc),
+   var opcode = mem_read(pc),
        bit_number = (opcode & 0x38) >>> 3,
        reg_code = opcode & 0x07;
    
@@ -1675,8 +1801,8 @@ instructions[0xcb] = function()
       else if (reg_code === 5)
          l = op_array[bit_number]( l);
       else if (reg_code === 6)
-         core.mem_write(l | (h << 8),
-                            op_array[bit_number]( core.mem_read(l | (h << 8))));
+         mem_write(l | (h << 8),
+                            op_array[bit_number]( mem_read(l | (h << 8))));
       else if (reg_code === 7)
          a = op_array[bit_number]( a);
    }
@@ -1696,7 +1822,7 @@ instructions[0xcb] = function()
       else if (reg_code === 5)
          flags.Z = !(l & (1 << bit_number)) ? 1 : 0;
       else if (reg_code === 6)
-         flags.Z = !((core.mem_read(l | (h << 8))) & (1 << bit_number)) ? 1 : 0;
+         flags.Z = !((mem_read(l | (h << 8))) & (1 << bit_number)) ? 1 : 0;
       else if (reg_code === 7)
          flags.Z = !(a & (1 << bit_number)) ? 1 : 0;
          
@@ -1729,8 +1855,8 @@ instructions[0xcb] = function()
       else if (reg_code === 5)
          l &= (0xff & ~(1 << bit_number));
       else if (reg_code === 6)
-         core.mem_write(l | (h << 8),
-                            core.mem_read(l | (h << 8)) & ~(1 << bit_number));
+         mem_write(l | (h << 8),
+                            mem_read(l | (h << 8)) & ~(1 << bit_number));
       else if (reg_code === 7)
          a &= (0xff & ~(1 << bit_number));
    }
@@ -1750,8 +1876,8 @@ instructions[0xcb] = function()
       else if (reg_code === 5)
          l |= (1 << bit_number);
       else if (reg_code === 6)
-         core.mem_write(l | (h << 8),
-                            core.mem_read(l | (h << 8)) | (1 << bit_number));
+         mem_write(l | (h << 8),
+                            mem_read(l | (h << 8)) | (1 << bit_number));
       else if (reg_code === 7)
          a |= (1 << bit_number);
    }
@@ -1767,15 +1893,15 @@ instructions[0xcc] = function()
 instructions[0xcd] = function()
 {
    push_word((pc + 3) & 0xffff);
-   pc =  core.mem_read((pc + 1) & 0xffff) |
-            (core.mem_read((pc + 2) & 0xffff) << 8);
+   pc =  mem_read((pc + 1) & 0xffff) |
+            (mem_read((pc + 2) & 0xffff) << 8);
    pc = (pc - 1) & 0xffff;
 };
 // 0xce : ADC A, n
 instructions[0xce] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_adc(core.mem_read(pc));
+   do_adc(mem_read(pc));
 };
 // 0xcf : RST 08h
 instructions[0xcf] = function()
@@ -1803,7 +1929,7 @@ instructions[0xd2] = function()
 instructions[0xd3] = function()
 {
    pc = (pc + 1) & 0xffff;
-   core.io_write((a << 8) | core.mem_read(pc), a);
+   core.io_write((a << 8) | mem_read(pc), a);
 };
 // 0xd4 : CALL NC, nn
 instructions[0xd4] = function()
@@ -1819,7 +1945,7 @@ instructions[0xd5] = function()
 instructions[0xd6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_sub(core.mem_read(pc));
+   do_sub(mem_read(pc));
 };
 // 0xd7 : RST 10h
 instructions[0xd7] = function()
@@ -1862,7 +1988,7 @@ instructions[0xda] = function()
 instructions[0xdb] = function()
 {
    pc = (pc + 1) & 0xffff;
-   a = core.io_read((a << 8) | core.mem_read(pc));
+   a = core.io_read((a << 8) | mem_read(pc));
 };
 // 0xdc : CALL C, nn
 instructions[0xdc] = function()
@@ -1879,7 +2005,7 @@ instructions[0xdd] = function()
    r = (r & 0x80) | (((r & 0x7f) + 1) & 0x7f);
 
    pc = (pc + 1) & 0xffff;
-   var opcode = core.mem_read(pc),
+   var opcode = mem_read(pc),
        func = dd_instructions[opcode];
        
    if (func)
@@ -1904,7 +2030,7 @@ instructions[0xdd] = function()
 instructions[0xde] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_sbc(core.mem_read(pc));
+   do_sbc(mem_read(pc));
 };
 // 0xdf : RST 18h
 instructions[0xdf] = function()
@@ -1931,11 +2057,11 @@ instructions[0xe2] = function()
 // 0xe3 : EX (SP), HL
 instructions[0xe3] = function()
 {
-   var temp = core.mem_read(sp);
-   core.mem_write(sp, l);
+   var temp = mem_read(sp);
+   mem_write(sp, l);
    l = temp;
-   temp = core.mem_read((sp + 1) & 0xffff);
-   core.mem_write((sp + 1) & 0xffff, h);
+   temp = mem_read((sp + 1) & 0xffff);
+   mem_write((sp + 1) & 0xffff, h);
    h = temp;
 };
 // 0xe4 : CALL PO, nn
@@ -1952,7 +2078,7 @@ instructions[0xe5] = function()
 instructions[0xe6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_and(core.mem_read(pc));
+   do_and(mem_read(pc));
 };
 // 0xe7 : RST 20h
 instructions[0xe7] = function()
@@ -2000,7 +2126,7 @@ instructions[0xed] = function()
    r = (r & 0x80) | (((r & 0x7f) + 1) & 0x7f);
 
    pc = (pc + 1) & 0xffff;
-   var opcode = core.mem_read(pc),
+   var opcode = mem_read(pc),
        func = ed_instructions[opcode];
        
    if (func)
@@ -2019,7 +2145,7 @@ instructions[0xed] = function()
 instructions[0xee] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_xor(core.mem_read(pc));
+   do_xor(mem_read(pc));
 };
 // 0xef : RST 28h
 instructions[0xef] = function()
@@ -2063,7 +2189,7 @@ instructions[0xf5] = function()
 instructions[0xf6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_or(core.mem_read(pc));
+   do_or(mem_read(pc));
 };
 // 0xf7 : RST 30h
 instructions[0xf7] = function()
@@ -2106,7 +2232,7 @@ instructions[0xfd] = function()
    r = (r & 0x80) | (((r & 0x7f) + 1) & 0x7f);
    
    pc = (pc + 1) & 0xffff;
-   var opcode = core.mem_read(pc),
+   var opcode = mem_read(pc),
        func = dd_instructions[opcode];
        
    if (func)
@@ -2139,7 +2265,7 @@ instructions[0xfd] = function()
 instructions[0xfe] = function()
 {
    pc = (pc + 1) & 0xffff;
-   do_cp(core.mem_read(pc));
+   do_cp(mem_read(pc));
 };
 // 0xff : RST 38h
 instructions[0xff] = function()
@@ -2173,12 +2299,12 @@ ed_instructions[0x42] = function()
 ed_instructions[0x43] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, c);
-   core.mem_write((address + 1) & 0xffff, b);
+   mem_write(address, c);
+   mem_write((address + 1) & 0xffff, b);
 };
 // 0x44 : NEG
 ed_instructions[0x44] = function()
@@ -2220,12 +2346,12 @@ ed_instructions[0x4a] = function()
 ed_instructions[0x4b] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   c = core.mem_read(address);
-   b = core.mem_read((address + 1) & 0xffff);
+   c = mem_read(address);
+   b = mem_read((address + 1) & 0xffff);
 };
 // 0x4c : NEG (Undocumented)
 ed_instructions[0x4c] = function()
@@ -2266,12 +2392,12 @@ ed_instructions[0x52] = function()
 ed_instructions[0x53] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, e);
-   core.mem_write((address + 1) & 0xffff, d);
+   mem_write(address, e);
+   mem_write((address + 1) & 0xffff, d);
 };
 // 0x54 : NEG (Undocumented)
 ed_instructions[0x54] = function()
@@ -2319,12 +2445,12 @@ ed_instructions[0x5a] = function()
 ed_instructions[0x5b] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   e = core.mem_read(address);
-   d = core.mem_read((address + 1) & 0xffff);
+   e = mem_read(address);
+   d = mem_read((address + 1) & 0xffff);
 };
 // 0x5c : NEG (Undocumented)
 ed_instructions[0x5c] = function()
@@ -2372,12 +2498,12 @@ ed_instructions[0x62] = function()
 ed_instructions[0x63] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, l);
-   core.mem_write((address + 1) & 0xffff, h);
+   mem_write(address, l);
+   mem_write((address + 1) & 0xffff, h);
 };
 // 0x64 : NEG (Undocumented)
 ed_instructions[0x64] = function()
@@ -2398,11 +2524,11 @@ ed_instructions[0x66] = function()
 // 0x67 : RRD
 ed_instructions[0x67] = function()
 {
-   var hl_value = core.mem_read(l | (h << 8));
+   var hl_value = mem_read(l | (h << 8));
    var temp1 = hl_value & 0x0f, temp2 = a & 0x0f;
    hl_value = ((hl_value & 0xf0) >>> 4) | (temp2 << 4);
    a = (a & 0xf0) | temp1;
-   core.mem_write(l | (h << 8), hl_value);
+   mem_write(l | (h << 8), hl_value);
    
    flags.S = (a & 0x80) ? 1 : 0;
    flags.Z = a ? 0 : 1;
@@ -2430,12 +2556,12 @@ ed_instructions[0x6a] = function()
 ed_instructions[0x6b] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   l = core.mem_read(address);
-   h = core.mem_read((address + 1) & 0xffff);
+   l = mem_read(address);
+   h = mem_read((address + 1) & 0xffff);
 };
 // 0x6c : NEG (Undocumented)
 ed_instructions[0x6c] = function()
@@ -2456,11 +2582,11 @@ ed_instructions[0x6e] = function()
 // 0x6f : RLD
 ed_instructions[0x6f] = function()
 {
-   var hl_value = core.mem_read(l | (h << 8));
+   var hl_value = mem_read(l | (h << 8));
    var temp1 = hl_value & 0xf0, temp2 = a & 0x0f;
    hl_value = ((hl_value & 0x0f) << 4) | temp2;
    a = (a & 0xf0) | (temp1 >>> 4);
-   core.mem_write(l | (h << 8), hl_value);
+   mem_write(l | (h << 8), hl_value);
    
    flags.S = (a & 0x80) ? 1 : 0;
    flags.Z = a ? 0 : 1;
@@ -2488,12 +2614,12 @@ ed_instructions[0x72] = function()
 ed_instructions[0x73] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   core.mem_write(address, sp & 0xff);
-   core.mem_write((address + 1) & 0xffff, (sp >>> 8) & 0xff);
+   mem_write(address, sp & 0xff);
+   mem_write((address + 1) & 0xffff, (sp >>> 8) & 0xff);
 };
 // 0x74 : NEG (Undocumented)
 ed_instructions[0x74] = function()
@@ -2530,12 +2656,12 @@ ed_instructions[0x7a] = function()
 ed_instructions[0x7b] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= core.mem_read(pc) << 8;
+   address |= mem_read(pc) << 8;
    
-   sp = core.mem_read(address);
-   sp |= core.mem_read((address + 1) & 0xffff) << 8;
+   sp = mem_read(address);
+   sp |= mem_read((address + 1) & 0xffff) << 8;
 };
 // 0x7c : NEG (Undocumented)
 ed_instructions[0x7c] = function()
@@ -2696,20 +2822,20 @@ dd_instructions[0x19] = function()
 dd_instructions[0x21] = function()
 {
    pc = (pc + 1) & 0xffff;
-   ix = core.mem_read(pc);
+   ix = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   ix |= (core.mem_read(pc) << 8);
+   ix |= (mem_read(pc) << 8);
 };
 // 0x22 : LD (nn), IX
 dd_instructions[0x22] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= (core.mem_read(pc) << 8);
+   address |= (mem_read(pc) << 8);
    
-   core.mem_write(address, ix & 0xff);
-   core.mem_write((address + 1) & 0xffff, (ix >>> 8) & 0xff);
+   mem_write(address, ix & 0xff);
+   mem_write((address + 1) & 0xffff, (ix >>> 8) & 0xff);
 };
 // 0x23 : INC IX
 dd_instructions[0x23] = function()
@@ -2730,7 +2856,7 @@ dd_instructions[0x25] = function()
 dd_instructions[0x26] = function()
 {
    pc = (pc + 1) & 0xffff;
-   ix = (core.mem_read(pc) << 8) | (ix & 0xff);
+   ix = (mem_read(pc) << 8) | (ix & 0xff);
 };
 // 0x29 : ADD IX, IX
 dd_instructions[0x29] = function()
@@ -2741,12 +2867,12 @@ dd_instructions[0x29] = function()
 dd_instructions[0x2a] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var address = core.mem_read(pc);
+   var address = mem_read(pc);
    pc = (pc + 1) & 0xffff;
-   address |= (core.mem_read(pc) << 8);
+   address |= (mem_read(pc) << 8);
    
-   ix = core.mem_read(address);
-   ix |= (core.mem_read((address + 1) & 0xffff) << 8);
+   ix = mem_read(address);
+   ix |= (mem_read((address + 1) & 0xffff) << 8);
 };
 // 0x2b : DEC IX
 dd_instructions[0x2b] = function()
@@ -2767,31 +2893,31 @@ dd_instructions[0x2d] = function()
 dd_instructions[0x2e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   ix = (core.mem_read(pc) & 0xff) | (ix & 0xff00);
+   ix = (mem_read(pc) & 0xff) | (ix & 0xff00);
 };
 // 0x34 : INC (IX+n)
 dd_instructions[0x34] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc)),
-       value = core.mem_read((offset + ix) & 0xffff);
-   core.mem_write((offset + ix) & 0xffff, do_inc(value));
+   var offset = get_signed_offset_byte(mem_read(pc)),
+       value = mem_read((offset + ix) & 0xffff);
+   mem_write((offset + ix) & 0xffff, do_inc(value));
 };
 // 0x35 : DEC (IX+n)
 dd_instructions[0x35] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc)),
-       value = core.mem_read((offset + ix) & 0xffff);
-   core.mem_write((offset + ix) & 0xffff, do_dec(value));
+   var offset = get_signed_offset_byte(mem_read(pc)),
+       value = mem_read((offset + ix) & 0xffff);
+   mem_write((offset + ix) & 0xffff, do_dec(value));
 };
 // 0x36 : LD (IX+n), n
 dd_instructions[0x36] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
+   var offset = get_signed_offset_byte(mem_read(pc));
    pc = (pc + 1) & 0xffff;
-   core.mem_write((ix + offset) & 0xffff, core.mem_read(pc));   
+   mem_write((ix + offset) & 0xffff, mem_read(pc));   
 };
 // 0x39 : ADD IX, SP
 dd_instructions[0x39] = function()
@@ -2812,8 +2938,8 @@ dd_instructions[0x45] = function()
 dd_instructions[0x46] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   b = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   b = mem_read((ix + offset) & 0xffff);
 };
 // 0x4c : LD C, IXH (Undocumented)
 dd_instructions[0x4c] = function()
@@ -2829,8 +2955,8 @@ dd_instructions[0x4d] = function()
 dd_instructions[0x4e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   c = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   c = mem_read((ix + offset) & 0xffff);
 };
 // 0x54 : LD D, IXH (Undocumented)
 dd_instructions[0x54] = function()
@@ -2846,8 +2972,8 @@ dd_instructions[0x55] = function()
 dd_instructions[0x56] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   d = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   d = mem_read((ix + offset) & 0xffff);
 };
 // 0x5c : LD E, IXH (Undocumented)
 dd_instructions[0x5c] = function()
@@ -2863,8 +2989,8 @@ dd_instructions[0x5d] = function()
 dd_instructions[0x5e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   e = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   e = mem_read((ix + offset) & 0xffff);
 };
 // 0x60 : LD IXH, B (Undocumented)
 dd_instructions[0x60] = function()
@@ -2900,8 +3026,8 @@ dd_instructions[0x65] = function()
 dd_instructions[0x66] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   h = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   h = mem_read((ix + offset) & 0xffff);
 };
 // 0x67 : LD IXH, A (Undocumented)
 dd_instructions[0x67] = function()
@@ -2942,8 +3068,8 @@ dd_instructions[0x6d] = function()
 dd_instructions[0x6e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   l = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   l = mem_read((ix + offset) & 0xffff);
 };
 // 0x6f : LD IXL, A (Undocumented)
 dd_instructions[0x6f] = function()
@@ -2954,50 +3080,50 @@ dd_instructions[0x6f] = function()
 dd_instructions[0x70] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, b);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, b);
 };
 // 0x71 : LD (IX+n), C
 dd_instructions[0x71] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, c);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, c);
 };
 // 0x72 : LD (IX+n), D
 dd_instructions[0x72] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, d);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, d);
 };
 // 0x73 : LD (IX+n), E
 dd_instructions[0x73] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, e);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, e);
 };
 // 0x74 : LD (IX+n), H
 dd_instructions[0x74] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, h);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, h);
 };
 // 0x75 : LD (IX+n), L
 dd_instructions[0x75] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, l);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, l);
 };
 // 0x77 : LD (IX+n), A
 dd_instructions[0x77] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   core.mem_write((ix + offset) & 0xffff, a);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   mem_write((ix + offset) & 0xffff, a);
 };
 // 0x7c : LD A, IXH (Undocumented)
 dd_instructions[0x7c] = function()
@@ -3013,8 +3139,8 @@ dd_instructions[0x7d] = function()
 dd_instructions[0x7e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   a = core.mem_read((ix + offset) & 0xffff);
+   var offset = get_signed_offset_byte(mem_read(pc));
+   a = mem_read((ix + offset) & 0xffff);
 };
 // 0x84 : ADD A, IXH (Undocumented)
 dd_instructions[0x84] = function()
@@ -3030,8 +3156,8 @@ dd_instructions[0x85] = function()
 dd_instructions[0x86] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_add(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_add(mem_read((ix + offset) & 0xffff));
 };
 // 0x8c : ADC A, IXH (Undocumented)
 dd_instructions[0x8c] = function()
@@ -3047,8 +3173,8 @@ dd_instructions[0x8d] = function()
 dd_instructions[0x8e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_adc(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_adc(mem_read((ix + offset) & 0xffff));
 };
 // 0x94 : SUB IXH (Undocumented)
 dd_instructions[0x94] = function()
@@ -3064,8 +3190,8 @@ dd_instructions[0x95] = function()
 dd_instructions[0x96] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_sub(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_sub(mem_read((ix + offset) & 0xffff));
 };
 // 0x9c : SBC IXH (Undocumented)
 dd_instructions[0x9c] = function()
@@ -3081,8 +3207,8 @@ dd_instructions[0x9d] = function()
 dd_instructions[0x9e] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_sbc(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_sbc(mem_read((ix + offset) & 0xffff));
 };
 // 0xa4 : AND IXH (Undocumented)
 dd_instructions[0xa4] = function()
@@ -3098,8 +3224,8 @@ dd_instructions[0xa5] = function()
 dd_instructions[0xa6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_and(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_and(mem_read((ix + offset) & 0xffff));
 };
 // 0xac : XOR IXH (Undocumented)
 dd_instructions[0xac] = function()
@@ -3115,8 +3241,8 @@ dd_instructions[0xad] = function()
 dd_instructions[0xae] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_xor(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_xor(mem_read((ix + offset) & 0xffff));
 };
 // 0xb4 : OR IXH (Undocumented)
 dd_instructions[0xb4] = function()
@@ -3132,8 +3258,8 @@ dd_instructions[0xb5] = function()
 dd_instructions[0xb6] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_or(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_or(mem_read((ix + offset) & 0xffff));
 };
 // 0xbc : CP IXH (Undocumented)
 dd_instructions[0xbc] = function()
@@ -3149,16 +3275,16 @@ dd_instructions[0xbd] = function()
 dd_instructions[0xbe] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
-   do_cp(core.mem_read((ix + offset) & 0xffff));
+   var offset = get_signed_offset_byte(mem_read(pc));
+   do_cp(mem_read((ix + offset) & 0xffff));
 };
 // 0xcb : CB Prefix (IX bit instructions)
 dd_instructions[0xcb] = function()
 {
    pc = (pc + 1) & 0xffff;
-   var offset = get_signed_offset_byte(core.mem_read(pc));
+   var offset = get_signed_offset_byte(mem_read(pc));
    pc = (pc + 1) & 0xffff;
-   var opcode = core.mem_read(pc), value;
+   var opcode = mem_read(pc), value;
    
    // As with the "normal" CB prefix, we implement the DDCB prefix
    //  by decoding the opcode directly, rather than using a table.
@@ -3171,9 +3297,9 @@ dd_instructions[0xcb] = function()
       // Most of the opcodes in this range are not valid,
       //  so we map this opcode onto one of the ones that is.
       var func = ddcb_functions[(opcode & 0x38) >>> 3],
-      value = func( core.mem_read((ix + offset) & 0xffff));
+      value = func( mem_read((ix + offset) & 0xffff));
       
-      core.mem_write((ix + offset) & 0xffff, value);
+      mem_write((ix + offset) & 0xffff, value);
    }
    else
    {
@@ -3184,21 +3310,21 @@ dd_instructions[0xcb] = function()
          // BIT
          flags.N = 0;
          flags.H = 1;
-         flags.Z = !(core.mem_read((ix + offset) & 0xffff) & (1 << bit_number)) ? 1 : 0;
+         flags.Z = !(mem_read((ix + offset) & 0xffff) & (1 << bit_number)) ? 1 : 0;
          flags.P = flags.Z;
          flags.S = ((bit_number === 7) && !flags.Z) ? 1 : 0;
       }
       else if (opcode < 0xc0)
       {
          // RES
-         value = core.mem_read((ix + offset) & 0xffff) & ~(1 << bit_number) & 0xff;
-         core.mem_write((ix + offset) & 0xffff, value);
+         value = mem_read((ix + offset) & 0xffff) & ~(1 << bit_number) & 0xff;
+         mem_write((ix + offset) & 0xffff, value);
       }
       else
       {
          // SET
-         value = core.mem_read((ix + offset) & 0xffff) | (1 << bit_number);
-         core.mem_write((ix + offset) & 0xffff, value);
+         value = mem_read((ix + offset) & 0xffff) | (1 << bit_number);
+         mem_write((ix + offset) & 0xffff, value);
       }
    }
    
@@ -3234,10 +3360,10 @@ dd_instructions[0xe1] = function()
 dd_instructions[0xe3] = function()
 {
    var temp = ix;
-   ix = core.mem_read(sp);
-   ix |= core.mem_read((sp + 1) & 0xffff) << 8;
-   core.mem_write(sp, temp & 0xff);
-   core.mem_write((sp + 1) & 0xffff, (temp >>> 8) & 0xff);
+   ix = mem_read(sp);
+   ix |= mem_read((sp + 1) & 0xffff) << 8;
+   mem_write(sp, temp & 0xff);
+   mem_write((sp + 1) & 0xffff, (temp >>> 8) & 0xff);
 };
 // 0xe5 : PUSH IX
 dd_instructions[0xe5] = function()
@@ -3256,13 +3382,31 @@ dd_instructions[0xf9] = function()
 };
 
 
+   // There's tons of stuff in this object,
+   //  but only these three functions are the public API.
+   this.saveState = getState;
+   this.loadState = setState;
+   this.saveStateInto = saveStateInto;
+   this.loadStateFrom = loadStateFrom;
+   this.reset = reset;
+   this.advanceInsn = run_instruction;
+   this.interrupt = interrupt;
+   this.getPC = ():number => { return pc; }
+   this.getSP = ():number => { return sp; }
+   this.getHalted = ():boolean => { return halted; }
+   this.getRegisters = get_registers;
+   this.getIdleRegisters = get_idle_registers;
+   this.skipIdleIterations = skip_idle_iterations;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// These tables contain the number of T cycles used for each instruction.
 /// In a few special cases, such as conditional control flow instructions,
 ///  additional cycles might be added to these values.
 /// The total number of cycles is the return value of run_instruction().
+/// The debugger's timing analysis reads them too (see getOpcodeMetadata_z80).
 ///////////////////////////////////////////////////////////////////////////////
-let cycle_counts = [
+export const cycle_counts = [
     4, 10,  7,  6,  4,  4,  7,  4,  4, 11,  7,  6,  4,  4,  7,  4,
     8, 10,  7,  6,  4,  4,  7,  4, 12, 11,  7,  6,  4,  4,  7,  4,
     7, 10, 16,  6,  4,  4,  7,  4,  7, 11, 16,  6,  4,  4,  7,  4,
@@ -3281,7 +3425,7 @@ let cycle_counts = [
     5, 10, 10,  4, 10, 11,  7, 11,  5,  6, 10,  4, 10,  0,  7, 11
 ];
 
-let cycle_counts_ed = [
+export const cycle_counts_ed = [
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
@@ -3300,7 +3444,7 @@ let cycle_counts_ed = [
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
 ];
 
-let cycle_counts_cb = [
+export const cycle_counts_cb = [
     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8,
@@ -3319,7 +3463,7 @@ let cycle_counts_cb = [
     8,  8,  8,  8,  8,  8, 15,  8,  8,  8,  8,  8,  8,  8, 15,  8
 ];
 
-let cycle_counts_dd = [
+export const cycle_counts_dd = [
     0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0,  0,  0,  0,  0,
     0, 14, 20, 10,  8,  8, 11,  0,  0, 15, 20, 10,  8,  8, 11,  0,
@@ -3338,18 +3482,6 @@ let cycle_counts_dd = [
     0,  0,  0,  0,  0,  0,  0,  0,  0, 10,  0,  0,  0,  0,  0,  0
 ];
 
-   // There's tons of stuff in this object,
-   //  but only these three functions are the public API.
-   this.saveState = getState;
-   this.loadState = setState;
-   this.reset = reset;
-   this.advanceInsn = run_instruction;
-   this.interrupt = interrupt;
-   this.getPC = ():number => { return pc; }
-   this.getSP = ():number => { return sp; }
-   this.getHalted = ():boolean => { return halted; }
-}
-
 export interface Z80State {
 AF : number;
 BC : number;
@@ -3373,7 +3505,7 @@ do_delayed_ei : boolean;
 cycle_counter : number;
 }
 
-export class Z80 implements CPU, InstructionBased, IOBusConnected, SavesState<Z80State>, Interruptable<number> {
+export class Z80 implements CPU, InstructionBased, IOBusConnected, MemoryPagesConnected, IdleLoopAware, SavesState<Z80State>, SavesBinaryState, Interruptable<number> {
 
   cpu;
   interruptType;
@@ -3381,15 +3513,30 @@ export class Z80 implements CPU, InstructionBased, IOBusConnected, SavesState<Z8
   ioBus : Bus;
   retryInterrupts : boolean = false;
   retryData : number = -1;
+  // shared with FastZ80, so pages can be (un)mapped without rebuilding it
+  readPages : Uint8Array[] = new Array(256);
+  writePages : Uint8Array[] = new Array(256);
   
   private buildCPU() {
     if (this.memBus && this.ioBus) {
+      // buses can be swapped at any time (e.g. when a probe is connected)
+      var state = this.cpu && this.cpu.saveState();
       this.cpu = new FastZ80({
         mem_read: this.memBus.read.bind(this.memBus),
         mem_write: this.memBus.write.bind(this.memBus),
         io_read: this.ioBus.read.bind(this.ioBus),
         io_write: this.ioBus.write.bind(this.ioBus),
+        read_pages: this.readPages,
+        write_pages: this.writePages,
       });
+      if (state) this.cpu.loadState(state);
+    }
+  }
+  // null goes back to using the memory bus for everything
+  connectMemoryPages(pages:MemoryPageTable) {
+    for (var i=0; i<256; i++) {
+      this.readPages[i] = pages ? pages.read[i] : null;
+      this.writePages[i] = pages ? pages.write[i] : null;
     }
   }
   connectMemoryBus(bus:Bus) {
@@ -3426,12 +3573,36 @@ export class Z80 implements CPU, InstructionBased, IOBusConnected, SavesState<Z8
   isHalted() {
    return this.cpu.getHalted();
   }
+  getRegisters(r:Int32Array) {
+    this.cpu.getRegisters(r);
+    r[16] = this.retryData;
+  }
+  getIdleRegisters(r:Int32Array) {
+    this.cpu.getIdleRegisters(r);
+    r[16] = this.retryData;
+  }
+  skipIdleIterations(n:number) {
+    this.cpu.skipIdleIterations(n);
+  }
   saveState() {
     return this.cpu.saveState();
   }
   loadState(s) {
     this.cpu.loadState(s);
   }
+  getBinaryStateSize() {
+    return 38 + 4;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    ofs = this.cpu.saveStateInto(buf, ofs);
+    buf.setInt32(ofs, this.retryData);
+    return ofs + 4;
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = this.cpu.loadStateFrom(buf, ofs);
+    this.retryData = buf.getInt32(ofs);
+    return ofs + 4;
+  }
   isStable() { return true; }
   // TODO: metadata
   // TODO: disassembler
@@ -0,0 +1,184 @@
+
+import { hex } from "./util";
+import { WATCH_READ, WATCH_WRITE } from "./devices";
+
+// Breakpoint conditions and tracepoints, compiled once into JS functions:
+//
+//   A==0 && mem[$80]>10          break when true (tested every instruction)
+//   at $1234 if X>=8             break at an address (or symbol) when true
+//   at _main if hits>100         hits counts the times the breakpoint was reached
+//   trace A, mem[$80] at $1234   log values without stopping (also takes "if")
+//   watch $80 w                  break after a write to an address (r, w or rw)
+//
+// PC and SP come from the CPU's getPC() and getSP(). The other registers are
+// only read if the condition gets to them, from the array filled by the CPU's
+// getRegisters(), so nothing is allocated per instruction. Platforms that
+// can't do that pass a null layout, and they come from getCPUState() instead.
+
+// register name -> JS expression on the array r
+export type RegisterLayout = {[name:string] : string};
+
+export const REGS_6502 : RegisterLayout = {
+  A:'r[1]', X:'r[2]', Y:'r[3]',
+  N:'r[5]', V:'r[6]', D:'r[7]', I:'r[8]', Z:'r[9]', C:'r[10]',
+};
+
+export const REGS_Z80 : RegisterLayout = {
+  AF:'r[2]', A:'(r[2]>>8)', F:'(r[2]&255)',
+  BC:'r[3]', B:'(r[3]>>8)', C:'(r[3]&255)',
+  DE:'r[4]', D:'(r[4]>>8)', E:'(r[4]&255)',
+  HL:'r[5]', H:'(r[5]>>8)', L:'(r[5]&255)',
+  IX:'r[10]', IY:'r[11]', I:'r[12]',
+};
+
+// regs() returns the register array (or CpuState), mem() reads memory
+export type DebugExprFunction = (regs:() => any, mem:(addr:number) => number, hits:number, pc:number, sp:number) => any;
+
+export interface DebugExpression {
+  source : string;
+  fn : DebugExprFunction;
+}
+
+export interface ParsedBreakpoint {
+  pc? : number;             // only tested when the CPU gets to this address
+  expr? : DebugExpression;  // condition
+  trace? : DebugExpression; // values to log, returned as an array
+  traceLabels? : string[];
+  watchAddr? : number;      // stop after an access to this address
+  watchFlags? : number;     // WATCH_READ|WATCH_WRITE
+}
+
+const TOKEN_RE = /\s*(?:(\$[0-9a-f]+|0x[0-9a-f]+|[0-9]+)|([a-z_][a-z0-9_]*)|(===?|!==?|<=|>=|&&|\|\||<<|>>>?|[-+*\/%&|^!~<>()\[\],?:]))/ig;
+
+// translates an expression to JS, allowing only numbers, registers, mem[] and hits
+function translate(source:string, layout:RegisterLayout) : string {
+  var js = "";
+  var pos = 0;
+  var m;
+  var afterName = false;
+  while (/\S/.test(source.substring(pos))) {
+    TOKEN_RE.lastIndex = pos;
+    m = TOKEN_RE.exec(source);
+    if (!m || m.index != pos) throw new Error("Unexpected '" + source.substring(pos).trim().charAt(0) + "' in expression");
+    pos = TOKEN_RE.lastIndex;
+    if (afterName && m[3] == '(') throw new Error("Unexpected '(' in expression"); // no calls
+    afterName = m[2] != null;
+    if (m[1] != null) {
+      js += m[1].charAt(0) == '$' ? parseInt(m[1].substring(1), 16) : parseInt(m[1]);
+    } else if (m[2] != null) {
+      var name = m[2];
+      var uname = name.toUpperCase();
+      if (name == 'mem' || name == 'hits') {
+        js += name;
+      } else if (uname == 'PC' || uname == 'SP') {
+        js += uname.toLowerCase();
+      } else if (layout) {
+        var reg = layout[uname];
+        if (reg == null) throw new Error("Unknown register '" + name + "'");
+        js += reg.replace(/\br\[/g, 'regs()[');
+      } else {
+        js += 'regs().' + uname;
+      }
+    } else {
+      var op = m[3];
+      if (op == '[') op = '(';        // mem[x] -> mem(x)
+      else if (op == ']') op = ')';
+      js += op;
+    }
+    js += ' ';
+  }
+  if (!js) throw new Error("Empty expression");
+  return js;
+}
+
+function compile(source:string, js:string) : DebugExpression {
+  try {
+    var fn = new Function('regs', 'mem', 'hits', 'pc', 'sp', 'return (' + js + ');') as DebugExprFunction;
+  } catch (e) {
+    throw new Error("Bad expression '" + source + "': " + e.message);
+  }
+  return {source:source, fn:fn};
+}
+
+export function compileDebugExpression(source:string, layout:RegisterLayout) : DebugExpression {
+  return compile(source, translate(source, layout));
+}
+
+// splits on the commas that aren't inside brackets or parentheses
+function splitList(source:string) : string[] {
+  var parts = [];
+  var depth = 0;
+  var start = 0;
+  for (var i=0; i<source.length; i++) {
+    var ch = source.charAt(i);
+    if (ch == '(' || ch == '[') depth++;
+    else if (ch == ')' || ch == ']') depth--;
+    else if (ch == ',' && depth == 0) {
+      parts.push(source.substring(start, i).trim());
+      start = i+1;
+    }
+  }
+  parts.push(source.substring(start).trim());
+  return parts;
+}
+
+function parseAddress(s:string, symbols:{[sym:string]:number}) : number {
+  if (/^(\$[0-9a-f]+|0x[0-9a-f]+|[0-9]+)$/i.test(s)) {
+    return s.charAt(0) == '$' ? parseInt(s.substring(1), 16) : parseInt(s);
+  }
+  var addr = symbols && (symbols[s] != null ? symbols[s] : symbols['_'+s]);
+  if (typeof addr !== 'number') throw new Error("Unknown address '" + s + "'");
+  return addr;
+}
+
+export function parseBreakpoint(source:string, layout:RegisterLayout, symbols?:{[sym:string]:number}) : ParsedBreakpoint {
+  var bp : ParsedBreakpoint = {};
+  var s = source.trim();
+  // "watch <addr> [r|w|rw]", both if not given
+  var m = /^watch\s+(\S+)(?:\s+(\S+))?$/i.exec(s);
+  if (m) {
+    var mode = (m[2] || 'rw').toLowerCase();
+    if (!/^(r|w|rw)$/.test(mode)) throw new Error("Watch mode must be r, w or rw");
+    bp.watchAddr = parseAddress(m[1], symbols) & 0xffff;
+    bp.watchFlags = (mode.indexOf('r') >= 0 ? WATCH_READ : 0) | (mode.indexOf('w') >= 0 ? WATCH_WRITE : 0);
+    return bp;
+  }
+  m = /^trace\s+([\s\S]*)$/i.exec(s);
+  var traceSource : string = null;
+  if (m) {
+    traceSource = m[1];
+    s = "";
+    // "trace <values> [at <addr>] [if <cond>]"
+    var mat = /^([\s\S]*?)(?:\s+at\s+(\S+))?(?:\s+if\s+([\s\S]*))?$/i.exec(traceSource);
+    traceSource = mat[1];
+    if (mat[2] != null) bp.pc = parseAddress(mat[2], symbols);
+    if (mat[3] != null) s = mat[3];
+  } else {
+    // "at <addr> [if <cond>]", or just "<cond>"
+    m = /^at\s+(\S+)(?:\s+if\s+([\s\S]*))?$/i.exec(s);
+    if (m) {
+      bp.pc = parseAddress(m[1], symbols);
+      s = m[2] || "";
+    }
+  }
+  if (s.trim()) {
+    bp.expr = compileDebugExpression(s.trim(), layout);
+  }
+  if (traceSource != null) {
+    var items = splitList(traceSource);
+    bp.traceLabels = items;
+    bp.trace = compile(traceSource, '[' + items.map((item) => translate(item, layout)).join(',') + ']');
+  }
+  if (bp.pc == null && !bp.expr && !bp.trace) throw new Error("Empty expression");
+  return bp;
+}
+
+export function formatTraceLine(pc:number, labels:string[], values:any[]) : string {
+  var s = "$" + hex(pc, 4);
+  for (var i=0; i<labels.length; i++) {
+    var v = values[i];
+    var vs = typeof v === 'number' ? (v >= 0 && v < 0x100 ? "$" + hex(v, 2) : v >= 0 && v < 0x10000 ? "$" + hex(v, 4) : v+"") : v+"";
+    s += " " + labels[i] + "=" + vs;
+  }
+  return s;
+}
@@ -79,6 +79,221 @@ export interface IOBusConnected {
     connectIOBus(bus:Bus) : void;
 }
 
+export interface MemoryPagesConnected {
+    connectMemoryPages(pages:MemoryPageTable) : void;
+}
+
+// 256 pages of 256 bytes each. A Uint8Array entry is plain memory the CPU can
+// access directly, a null entry means the access has to go through the Bus.
+export class MemoryPageTable {
+    read : Uint8Array[] = new Array(256);
+    write : Uint8Array[] = new Array(256);
+
+    // maps start..end (page-aligned) to mem[a & mask], like an AddressDecoder entry
+    // (mask 0 means no mask); pages that don't fit inside mem stay on the bus
+    mapRead(start:number, end:number, mem:Uint8Array, mask?:number) {
+        this.map(this.read, start, end, mem, mask);
+    }
+    mapWrite(start:number, end:number, mem:Uint8Array, mask?:number) {
+        this.map(this.write, start, end, mem, mask);
+    }
+    mapRAM(start:number, end:number, mem:Uint8Array, mask?:number) {
+        this.map(this.read, start, end, mem, mask);
+        this.map(this.write, start, end, mem, mask);
+    }
+    private map(pages:Uint8Array[], start:number, end:number, mem:Uint8Array, mask:number) {
+        if (!mem) return;
+        for (var p = start >> 8; p <= (end >> 8); p++) {
+            var ofs = mask ? (p << 8) & mask : (p << 8);
+            pages[p] = (ofs + 256 <= mem.length) ? mem.subarray(ofs, ofs + 256) : null;
+        }
+    }
+}
+
+// CPUs that let a machine fast-forward through loops that can't make progress
+export interface IdleLoopAware {
+    // fills r with the state that has to repeat for a loop iteration to repeat exactly
+    getIdleRegisters(r:Int32Array) : void;
+    // same layout as getIdleRegisters(), but doesn't touch the idle detector
+    getRegisters?(r:Int32Array) : void;
+    // catches up free-running counters after n more iterations were skipped
+    skipIdleIterations?(n:number) : void;
+}
+
+// Fixed-layout binary snapshots, written into a preallocated buffer instead of
+// building a new state object. Each class writes its fields after its parent's,
+// starting with a tag that identifies the layout (and its version).
+export interface SavesBinaryState {
+    getBinaryStateSize() : number; // 0 if not supported
+    saveStateInto(buf:DataView, ofs:number) : number; // returns the offset after the state
+    loadStateFrom(buf:DataView, ofs:number) : number;
+}
+
+var stateView : DataView;
+var stateBytes : Uint8Array;
+
+function bytesOf(buf:DataView) : Uint8Array {
+    if (buf !== stateView) {
+        stateView = buf;
+        stateBytes = new Uint8Array(buf.buffer, buf.byteOffset, buf.byteLength);
+    }
+    return stateBytes;
+}
+export function saveBytesInto(buf:DataView, ofs:number, arr:Uint8Array) : number {
+    bytesOf(buf).set(arr, ofs);
+    return ofs + arr.length;
+}
+export function loadBytesFrom(buf:DataView, ofs:number, arr:Uint8Array) : number {
+    arr.set(bytesOf(buf).subarray(ofs, ofs + arr.length));
+    return ofs + arr.length;
+}
+export function checkStateTag(buf:DataView, ofs:number, tag:number) : number {
+    var found = buf.getUint32(ofs);
+    if (found != tag) throw new Error("Binary state has layout " + found.toString(16) + ", expected " + tag.toString(16));
+    return ofs + 4;
+}
+
+export const UNDO_MAX_INSNS = 1<<15;   // must be powers of 2
+export const UNDO_MAX_WRITES = 1<<16;
+
+// Journal of the instructions executed since reset(), so the debugger can step
+// backwards in O(instructions undone) instead of replaying the frame.
+// Each entry is the CPU's binary state before the instruction, plus the old value
+// of every byte it wrote to plain memory. A write that can't be undone (I/O,
+// banked memory) cuts the journal off, as does running out of room.
+export class UndoLog {
+    cpu : SavesBinaryState;
+    stride : number;
+    cpuStates : DataView;
+    writeStart : Int32Array = new Int32Array(UNDO_MAX_INSNS);
+    writePages : Uint8Array[] = new Array(UNDO_MAX_WRITES);
+    writeOld : Int32Array = new Int32Array(UNDO_MAX_WRITES); // offset<<8 | old value
+    head : number = 0;  // instructions logged since reset()
+    tail : number = 0;  // oldest instruction that can still be undone
+    writeHead : number = 0;
+
+    constructor(cpu:SavesBinaryState) {
+        this.cpu = cpu;
+        this.stride = cpu.getBinaryStateSize();
+        this.cpuStates = new DataView(new ArrayBuffer(this.stride * UNDO_MAX_INSNS));
+    }
+    reset() {
+        this.head = this.tail = this.writeHead = 0;
+    }
+    numUndoable() : number {
+        return this.head - this.tail;
+    }
+    logInstruction() {
+        if (this.head - this.tail >= UNDO_MAX_INSNS) this.tail++;
+        var slot = this.head & (UNDO_MAX_INSNS-1);
+        this.cpu.saveStateInto(this.cpuStates, slot * this.stride);
+        this.writeStart[slot] = this.writeHead;
+        this.head++;
+    }
+    logWrite(page:Uint8Array, ofs:number) {
+        // make room by forgetting the oldest instructions
+        while (this.tail < this.head && this.writeHead - this.writeStart[this.tail & (UNDO_MAX_INSNS-1)] >= UNDO_MAX_WRITES)
+            this.tail++;
+        if (this.tail == this.head) return;
+        var w = this.writeHead++ & (UNDO_MAX_WRITES-1);
+        this.writePages[w] = page;
+        this.writeOld[w] = (ofs << 8) | page[ofs];
+    }
+    logBarrier() {
+        this.tail = this.head;
+    }
+    undo() : boolean {
+        if (this.head == this.tail) return false;
+        var slot = --this.head & (UNDO_MAX_INSNS-1);
+        var start = this.writeStart[slot];
+        for (var w = this.writeHead-1; w >= start; w--) {
+            var i = w & (UNDO_MAX_WRITES-1);
+            this.writePages[i][this.writeOld[i] >> 8] = this.writeOld[i] & 0xff;
+            this.writePages[i] = null;
+        }
+        this.writeHead = start;
+        this.cpu.loadStateFrom(this.cpuStates, slot * this.stride);
+        return true;
+    }
+}
+
+export const WATCH_READ = 1;
+export const WATCH_WRITE = 2;
+
+// PC breakpoints and memory watchpoints, cheap enough to test every instruction
+// without building the CPU state. PCs are a 64K bitmap. Watchpoints are checked
+// by the machine's bus wrapper, and only pages with a watched address are taken
+// out of the page table (see BasicHeadlessMachine.connectBreakpoints).
+export class BreakpointSet {
+    pcs : Uint32Array = new Uint32Array(0x10000 >> 5);
+    watches : Uint8Array = new Uint8Array(0x10000); // WATCH_READ|WATCH_WRITE by address
+    watchPages : Uint8Array = new Uint8Array(0x100); // the same, or'ed together by page
+    numPCs : number = 0;
+    numWatches : number = 0;
+    hitAddress : number = -1; // last watched access, until clearHit()
+    hitFlags : number = 0;
+
+    clear() {
+        if (this.numPCs) this.pcs.fill(0);
+        if (this.numWatches) {
+            this.watches.fill(0);
+            this.watchPages.fill(0);
+        }
+        this.numPCs = this.numWatches = 0;
+        this.clearHit();
+    }
+    isEmpty() : boolean {
+        return this.numPCs == 0 && this.numWatches == 0;
+    }
+    addPC(pc:number) {
+        if (!this.hasPC(pc)) {
+            this.pcs[(pc >> 5) & 0x7ff] |= 1 << (pc & 31);
+            this.numPCs++;
+        }
+    }
+    hasPC(pc:number) : boolean {
+        return (this.pcs[(pc >> 5) & 0x7ff] & (1 << (pc & 31))) != 0;
+    }
+    addWatch(addr:number, flags:number) {
+        addr &= 0xffff;
+        if (!this.watches[addr]) this.numWatches++;
+        this.watches[addr] |= flags;
+        this.watchPages[addr >> 8] |= flags;
+    }
+    hasWatches() : boolean {
+        return this.numWatches > 0;
+    }
+    checkRead(addr:number) {
+        if (this.watches[addr & 0xffff] & WATCH_READ) {
+            this.hitAddress = addr & 0xffff;
+            this.hitFlags = WATCH_READ;
+        }
+    }
+    checkWrite(addr:number) {
+        if (this.watches[addr & 0xffff] & WATCH_WRITE) {
+            this.hitAddress = addr & 0xffff;
+            this.hitFlags = WATCH_WRITE;
+        }
+    }
+    // should the CPU stop before executing the instruction at pc?
+    isHit(pc:number) : boolean {
+        return this.hitAddress >= 0 || this.hasPC(pc);
+    }
+    clearHit() {
+        this.hitAddress = -1;
+        this.hitFlags = 0;
+    }
+    // a copy of the page table that sends the watched pages through the bus
+    filterPages(pages:MemoryPageTable) : MemoryPageTable {
+        var t = new MemoryPageTable();
+        for (var p=0; p<256; p++) {
+            t.read[p] = (this.watchPages[p] & WATCH_READ) ? null : pages.read[p];
+            t.write[p] = (this.watchPages[p] & WATCH_WRITE) ? null : pages.write[p];
+        }
+        return t;
+    }
+}
+
 export interface CPU extends MemoryBusConnected, Resettable, SavesState<any> {
     getPC() : number;
     getSP() : number;
@@ -111,6 +326,11 @@ export interface Probeable {
     connectProbe(probe: ProbeAll) : void;
 }
 
+// tells profilers which ROM bank is mapped at an address
+export interface BankSwitched {
+    getBankAt(address:number) : number;
+}
+
 export function xorshift32(x : number) : number {
   x ^= x << 13;
   x ^= x >> 17;
@@ -150,6 +370,7 @@ export interface ProbeVRAM {
 export interface ProbeAll extends ProbeTime, ProbeCPU, ProbeBus, ProbeIO, ProbeVRAM {
   logData(data:number); // entire 32 bits
   addLogBuffer(src: Uint32Array);
+  cpuOnly? : boolean; // only wants logExecute() and logClocks(), so skip the bus wrappers
 }
 
 export class NullProbe implements ProbeAll {
@@ -169,6 +390,59 @@ export class NullProbe implements ProbeAll {
   addLogBuffer(src: Uint32Array) {}
 }
 
+/// SCHEDULER
+
+export type ScheduledCallback = (time:number) => void;
+
+export class ScheduledEvent {
+  time : number = -1; // -1 when not scheduled
+  constructor(public callback : ScheduledCallback) { }
+}
+
+// Cycle-timestamped events. Devices post the clock of their next event and the
+// machine runs the CPU uninterrupted up to the earliest one, instead of polling
+// each device every cycle. Events fire at the end of the instruction that
+// reaches them; the callback gets the time it was scheduled for, so periodic
+// events can reschedule without drifting.
+export class EventScheduler {
+  clock : number = 0;
+  queue : ScheduledEvent[] = [];
+  nextTime : number = Infinity; // time of queue[0], kept up to date for advanceScheduled()
+
+  // (re)schedules an event at an absolute clock
+  schedule(event:ScheduledEvent, time:number) {
+    this.cancel(event);
+    event.time = time;
+    var i = this.queue.length;
+    while (i > 0 && this.queue[i-1].time > time) i--;
+    this.queue.splice(i, 0, event);
+    this.nextTime = this.nextEventTime();
+  }
+  scheduleIn(event:ScheduledEvent, delay:number) {
+    this.schedule(event, this.clock + delay);
+  }
+  cancel(event:ScheduledEvent) {
+    if (event.time >= 0) {
+      this.queue.splice(this.queue.indexOf(event), 1);
+      event.time = -1;
+      this.nextTime = this.nextEventTime();
+    }
+  }
+  nextEventTime() : number {
+    return this.queue.length ? this.queue[0].time : Infinity;
+  }
+  // fires everything due at or before the current clock, in time order
+  runDueEvents() {
+    while (this.queue.length && this.queue[0].time <= this.clock) {
+      var event = this.queue.shift();
+      var time = event.time;
+      event.time = -1;
+      this.nextTime = this.nextEventTime();
+      event.callback(time);
+    }
+  }
+}
+
 /// CONVENIENCE
 
 export interface BasicMachineControlsState {
@@ -181,7 +455,7 @@ export interface BasicMachineState extends BasicMachineControlsState {
 }
 
 export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, Probeable,
-  SavesState<BasicMachineState>, SavesInputState<BasicMachineControlsState> {
+  SavesState<BasicMachineState>, SavesInputState<BasicMachineControlsState>, SavesBinaryState {
 
   abstract cpuFrequency : number;
   abstract defaultROMSize : number;
@@ -195,6 +469,13 @@ export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, P
 
   nullProbe = new NullProbe();
   probe : ProbeAll = this.nullProbe;
+  scheduler : EventScheduler = new EventScheduler();
+  pageTable : MemoryPageTable;
+  busActivity : number = 0; // memory writes and I/O accesses, for idle detection
+  cpuMemoryBus : Bus; // as given to connectCPUMemoryBus(), before any probe wrapper
+  cpuIOBus : Bus;
+  undoLog : UndoLog = null;
+  breakpoints : BreakpointSet = null; // only while something is being watched
   
   abstract read(a:number) : number;
   abstract write(a:number, v:number) : void;
@@ -203,7 +484,40 @@ export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, P
     this.handler && this.handler(key,code,flags);
   }
   connectProbe(probe: ProbeAll) : void {
+    var wasProbing = this.isProbing();
     this.probe = probe || this.nullProbe;
+    this.reconnectCPUBuses(wasProbing);
+  }
+  // the undo log sees writes through the probe wrappers, and writes back into the page table
+  canUndo() : boolean {
+    var c = this.cpu as any as SavesBinaryState;
+    return this.pageTable != null && c.getBinaryStateSize != null && c.getBinaryStateSize() > 0;
+  }
+  connectUndoLog(log: UndoLog) : void {
+    var wasProbing = this.isProbing();
+    this.undoLog = log;
+    this.reconnectCPUBuses(wasProbing);
+  }
+  // watchpoints get their own bus wrapper, the PCs are tested by the debugger's trap
+  connectBreakpoints(bps: BreakpointSet) : void {
+    this.breakpoints = bps && bps.hasWatches() ? bps : null;
+    if (this.cpuMemoryBus) this.connectCPUMemoryBus(this.cpuMemoryBus);
+    this.connectCPUMemoryPages(this.pageTable);
+  }
+  // swap between the probe wrappers and the bare buses
+  reconnectCPUBuses(wasProbing:boolean) : void {
+    if (wasProbing != this.isProbing()) {
+      if (this.cpuMemoryBus) this.connectCPUMemoryBus(this.cpuMemoryBus);
+      if (this.cpuIOBus) this.connectCPUIOBus(this.cpuIOBus);
+    }
+    this.connectCPUMemoryPages(this.pageTable);
+  }
+  isProbing() : boolean {
+    return (this.probe !== this.nullProbe && !this.probe.cpuOnly) || this.undoLog != null;
+  }
+  // true if busActivity has to be counted even without a probe
+  needsBusActivity() : boolean {
+    return false;
   }
   reset() {
     this.cpu.reset();
@@ -224,6 +538,28 @@ export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, P
       inputs:this.inputs.slice(0),
     };
   }
+  // Binary snapshots are opt-in, since subclasses usually have state of their own.
+  // A machine supports them by overriding getBinaryStateSize() and extending
+  // saveStateInto()/loadStateFrom(), after setting binaryStateTag.
+  binaryStateTag : number = 0;
+  getBinaryStateSize() : number {
+    return 0;
+  }
+  getHeadlessStateSize() : number {
+    return 4 + (this.cpu as any as SavesBinaryState).getBinaryStateSize() + this.ram.length + this.inputs.length;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    buf.setUint32(ofs, this.binaryStateTag);
+    ofs = (this.cpu as any as SavesBinaryState).saveStateInto(buf, ofs + 4);
+    ofs = saveBytesInto(buf, ofs, this.ram);
+    return saveBytesInto(buf, ofs, this.inputs);
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = checkStateTag(buf, ofs, this.binaryStateTag);
+    ofs = (this.cpu as any as SavesBinaryState).loadStateFrom(buf, ofs);
+    ofs = loadBytesFrom(buf, ofs, this.ram);
+    return loadBytesFrom(buf, ofs, this.inputs);
+  }
   loadControlsState(state) {
     this.inputs.set(state.inputs);
   }
@@ -235,12 +571,34 @@ export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, P
   advanceCPU() {
     var c = this.cpu as any;
     var n = 1;
+    if (this.probe === this.nullProbe && !this.undoLog) {
+      // nothing to log, so skip isStable() and the probe calls
+      if (c.advanceClock) { c.advanceClock(); return 1; }
+      return c.advanceInsn(1);
+    }
+    if (this.undoLog) { this.undoLog.logInstruction(); }
     if (this.cpu.isStable()) { this.probe.logExecute(this.cpu.getPC(), this.cpu.getSP()); }
     if (c.advanceClock) { c.advanceClock(); }
     else if (c.advanceInsn) { n = c.advanceInsn(1); }
     this.probe.logClocks(n);
     return n;
   }
+  // runs the CPU until the scheduler clock reaches endClock, only stopping to
+  // fire device events on the way; stops early if trap() returns true
+  advanceScheduled(endClock:number, trap:TrapCondition) : number {
+    var sched = this.scheduler;
+    var steps = 0;
+    while (sched.clock < endClock) {
+      // the CPU can schedule events too, so check nextTime after every step
+      while (sched.clock < endClock && sched.clock < sched.nextTime) {
+        if (trap && trap()) return steps;
+        sched.clock += this.advanceCPU();
+        steps++;
+      }
+      sched.runDueEvents();
+    }
+    return steps;
+  }
   probeMemoryBus(membus:Bus) : Bus {
     return {
       read: (a) => {
@@ -249,29 +607,89 @@ export abstract class BasicHeadlessMachine implements HasCPU, Bus, AcceptsROM, P
         return val;
       },
       write: (a,v) => {
+        this.busActivity++;
         this.probe.logWrite(a,v);
+        if (this.undoLog) this.logUndoWrite(a);
         membus.write(a,v);
       }
     };
   }
+  logUndoWrite(a:number) {
+    var page = this.pageTable && this.pageTable.write[(a >> 8) & 0xff];
+    if (page) this.undoLog.logWrite(page, a & 0xff);
+    else this.undoLog.logBarrier();
+  }
+  // the CPU only gets the probe wrapper while a probe is connected (see connectProbe)
   connectCPUMemoryBus(membus:Bus) : void {
-    this.cpu.connectMemoryBus(this.probeMemoryBus(membus));
+    this.cpuMemoryBus = membus;
+    var bus = this.isProbing() ? this.probeMemoryBus(membus) : this.countMemoryBus(membus);
+    this.cpu.connectMemoryBus(this.breakpoints ? this.watchMemoryBus(bus) : bus);
+  }
+  watchMemoryBus(membus:Bus) : Bus {
+    var bps = this.breakpoints;
+    return {
+      read: (a) => {
+        if (bps.watchPages[(a >> 8) & 0xff] & WATCH_READ) bps.checkRead(a);
+        return membus.read(a);
+      },
+      write: (a,v) => {
+        if (bps.watchPages[(a >> 8) & 0xff] & WATCH_WRITE) bps.checkWrite(a);
+        membus.write(a,v);
+      }
+    };
+  }
+  countMemoryBus(membus:Bus) : Bus {
+    if (!this.needsBusActivity()) return membus;
+    return {
+      read: membus.read.bind(membus),
+      write: (a,v) => {
+        this.busActivity++;
+        membus.write(a,v);
+      }
+    };
+  }
+  // the page table bypasses probeMemoryBus(), so the CPU only gets it while nothing is probing
+  // (and without the watched pages, which have to go through watchMemoryBus())
+  connectCPUMemoryPages(pages:MemoryPageTable) : void {
+    this.pageTable = pages;
+    var c = this.cpu as any;
+    if (!c.connectMemoryPages) return;
+    if (this.isProbing() || !pages)
+      c.connectMemoryPages(null);
+    else
+      c.connectMemoryPages(this.breakpoints ? this.breakpoints.filterPages(pages) : pages);
   }
   probeIOBus(iobus:Bus) : Bus {
     return {
       read: (a) => {
         let val = iobus.read(a);
+        this.busActivity++;
         this.probe.logIORead(a,val);
         return val;
       },
       write: (a,v) => {
+        this.busActivity++;
         this.probe.logIOWrite(a,v);
         iobus.write(a,v);
       }
     };
   }
   connectCPUIOBus(iobus:Bus) : void {
-    this.cpu['connectIOBus'](this.probeIOBus(iobus));
+    this.cpuIOBus = iobus;
+    this.cpu['connectIOBus'](this.isProbing() ? this.probeIOBus(iobus) : this.countIOBus(iobus));
+  }
+  countIOBus(iobus:Bus) : Bus {
+    if (!this.needsBusActivity()) return iobus;
+    return {
+      read: (a) => {
+        this.busActivity++;
+        return iobus.read(a);
+      },
+      write: (a,v) => {
+        this.busActivity++;
+        iobus.write(a,v);
+      }
+    };
   }
 }
 
@@ -302,6 +720,15 @@ export abstract class BasicMachine extends BasicHeadlessMachine implements Sampl
   }
 }
 
+const MAX_IDLE_LOOP_CYCLES = 256;
+const MAX_IDLE_BACKOFF = 63;
+
+function sameInt32Array(a:Int32Array, b:Int32Array) : boolean {
+  for (var i=0; i<a.length; i++)
+    if (a[i] !== b[i]) return false;
+  return true;
+}
+
 export abstract class BasicScanlineMachine extends BasicMachine implements RasterFrameBased {
 
   abstract numTotalScanlines : number;
@@ -311,13 +738,34 @@ export abstract class BasicScanlineMachine extends BasicMachine implements Raste
   abstract drawScanline() : void;
 
   frameCycles : number;
+
+  // Set by machines whose memory reads have no side effects (or only idempotent
+  // ones) and only change at scanline boundaries. When the CPU comes back to the
+  // same PC with the same registers and no writes or I/O in between, it can't
+  // leave the loop before the next scanline, so we skip whole iterations.
+  skipIdleLoops : boolean = false;
+  idlePC : number = -1;
+  idleClock : number = 0;
+  idleSteps : number = 0;
+  idleActivity : number = 0;
+  idleHold : number = 0;
+  idleBackoff : number = 0;
+  idleRegs = new Int32Array(32);
+  idleRegs2 = new Int32Array(32);
   
+  needsBusActivity() : boolean {
+    return this.skipIdleLoops;
+  }
+
   advanceFrame(trap: TrapCondition) : number {
     this.preFrame();
     var endLineClock = 0;
     var steps = 0;
+    // skipped iterations would only show up as clocks in the probe's views, so run them all while probing
+    var idle = this.skipIdleLoops && !trap && this.probe === this.nullProbe && (this.cpu as any).getIdleRegisters != null;
     this.probe.logNewFrame();
     this.frameCycles = 0;
+    this.idlePC = -1;
     for (var sl=0; sl<this.numTotalScanlines; sl++) {
       endLineClock += this.cpuCyclesPerLine; // could be fractional
       this.scanline = sl;
@@ -327,6 +775,11 @@ export abstract class BasicScanlineMachine extends BasicMachine implements Raste
           sl = 999;
           break;
         }
+        var skipped = idle ? this.skipIdleLoop(endLineClock, steps) : 0;
+        if (skipped) {
+          steps += skipped;
+          continue;
+        }
         this.frameCycles += this.advanceCPU();
         steps++;
       }
@@ -337,6 +790,58 @@ export abstract class BasicScanlineMachine extends BasicMachine implements Raste
     this.postFrame();
     return steps; // TODO: return steps, not clock? for recorder
   }
+  // returns the number of steps skipped, or 0 if the CPU isn't idling
+  skipIdleLoop(endLineClock:number, steps:number) : number {
+    var cpu = this.cpu as any as IdleLoopAware;
+    if (!this.cpu.isStable()) return 0;
+    var pc = this.cpu.getPC();
+    var period = this.frameCycles - this.idleClock;
+    if (pc !== this.idlePC) {
+      // pick a new loop candidate if we've been away from the old one too long
+      if (this.idlePC < 0 || period > MAX_IDLE_LOOP_CYCLES) {
+        this.idlePC = pc;
+        this.idleHold = this.idleBackoff = 0;
+        this.armIdleLoop(steps);
+      }
+      return 0;
+    }
+    if (period <= 0) return 0;
+    // loops that keep failing the check below only get looked at now and then
+    if (this.idleHold > 0) {
+      this.idleHold--;
+      this.idleClock = this.frameCycles;
+      if (this.idleHold == 0) this.armIdleLoop(steps);
+      return 0;
+    }
+    if (this.busActivity === this.idleActivity) {
+      cpu.getIdleRegisters(this.idleRegs2);
+      if (sameInt32Array(this.idleRegs, this.idleRegs2)) {
+        var n = Math.floor((endLineClock - this.frameCycles) / period);
+        if (n > 0) {
+          var skipped = n * (steps - this.idleSteps);
+          cpu.skipIdleIterations && cpu.skipIdleIterations(n);
+          this.frameCycles += n * period;
+          this.idleBackoff = 0;
+          // registers already match idleRegs, so just move the loop's starting point
+          this.idleClock = this.frameCycles;
+          this.idleSteps = steps + skipped;
+          return skipped;
+        }
+        this.armIdleLoop(steps);
+        return 0;
+      }
+    }
+    this.idleBackoff = Math.min(this.idleBackoff * 2 + 1, MAX_IDLE_BACKOFF);
+    this.idleHold = this.idleBackoff;
+    this.idleClock = this.frameCycles;
+    return 0;
+  }
+  armIdleLoop(steps:number) {
+    this.idleClock = this.frameCycles;
+    this.idleSteps = steps;
+    this.idleActivity = this.busActivity;
+    (this.cpu as any as IdleLoopAware).getIdleRegisters(this.idleRegs);
+  }
   preFrame() { }
   postFrame() { }
   getRasterY() { return this.scanline; }
@@ -0,0 +1,422 @@
+
+import { Platform, EmuState, EmuControlsState } from "./baseplatform";
+import { getNoiseSeed, setNoiseSeed } from "./emu";
+import { encodeXORDelta, decodeXORDelta } from "./recorder";
+
+// INPUT MOVIES
+//
+// A movie holds everything needed to replay a recording deterministically: the
+// ROM, a starting state, and the controls and noise seed of every frame after it.
+// It's written as a stream of chunks, so an hour-long recording never has to
+// sit in memory.
+//
+//   header:   "8BWM" version:u8 meta:bytes rom:bytes
+//   records:  type:u8 ...
+//     CONTROLS  seed:varint controls:bytes   (one frame, controls stored in full)
+//     FRAME     seed:varint delta:bytes      (one frame, controls XORed with the previous)
+//     REPEAT    count:varint                 (frames with the same controls and seed)
+//     KEYFRAME  frame:varint state:bytes     (state at the start of that frame)
+//
+// bytes = varint length + data. Seeds are XORed with the previous frame's seed.
+// Controls and states are JSON with typed arrays moved into a binary section,
+// so a frame whose controls didn't change costs a byte or two.
+
+const MOVIE_MAGIC = [0x38, 0x42, 0x57, 0x4d]; // "8BWM"
+const MOVIE_VERSION = 1;
+
+enum MovieRecord {
+  CONTROLS = 1,
+  FRAME = 2,
+  REPEAT = 3,
+  KEYFRAME = 4,
+}
+
+export interface MovieMetadata {
+  platform : string;
+  title? : string;
+}
+
+// where the chunks of a movie go
+export interface MovieSink {
+  write(chunk:Uint8Array) : void;
+  close() : void;
+}
+
+/// ENCODING
+
+const TYPED_ARRAYS = {
+  Uint8Array:Uint8Array, Int8Array:Int8Array, Uint8ClampedArray:Uint8ClampedArray,
+  Uint16Array:Uint16Array, Int16Array:Int16Array, Uint32Array:Uint32Array,
+  Int32Array:Int32Array, Float32Array:Float32Array, Float64Array:Float64Array,
+  DataView:DataView,
+};
+
+var textEncoder = new TextEncoder();
+var textDecoder = new TextDecoder();
+
+// JSON, followed by the contents of every typed array in it
+export function encodeObject(obj:any) : Uint8Array {
+  var arrays : Uint8Array[] = [];
+  var binlen = 0;
+  var json = JSON.stringify(obj, function(key, value) {
+    if (ArrayBuffer.isView(value)) {
+      var bytes = new Uint8Array(value.buffer, value.byteOffset, value.byteLength);
+      arrays.push(bytes);
+      binlen += bytes.length;
+      return {$t:value.constructor.name, $n:bytes.length};
+    }
+    return value;
+  });
+  var text = textEncoder.encode(json);
+  var out = new ByteWriter(text.length + binlen + 5);
+  out.writeBytes(text);
+  for (var a of arrays) out.writeRaw(a);
+  return out.finish();
+}
+
+export function decodeObject(data:Uint8Array) : any {
+  var inp = new ByteReader(data);
+  var text = textDecoder.decode(inp.readBytes());
+  var ofs = inp.pos;
+  return JSON.parse(text, function(key, value) {
+    if (value && value.$t && TYPED_ARRAYS[value.$t]) {
+      var bytes = data.slice(ofs, ofs + value.$n);
+      ofs += value.$n;
+      return new TYPED_ARRAYS[value.$t](bytes.buffer);
+    }
+    return value;
+  });
+}
+
+function sameBytes(a:Uint8Array, b:Uint8Array) : boolean {
+  if (a.length != b.length) return false;
+  for (var i=0; i<a.length; i++)
+    if (a[i] !== b[i]) return false;
+  return true;
+}
+
+class ByteWriter {
+  buf : Uint8Array;
+  pos : number = 0;
+
+  constructor(size:number) {
+    this.buf = new Uint8Array(size);
+  }
+  ensure(n:number) {
+    if (this.pos + n > this.buf.length) {
+      var nb = new Uint8Array(Math.max(this.buf.length * 2, this.pos + n));
+      nb.set(this.buf.subarray(0, this.pos));
+      this.buf = nb;
+    }
+  }
+  writeByte(b:number) {
+    this.ensure(1);
+    this.buf[this.pos++] = b;
+  }
+  writeVarint(n:number) {
+    this.ensure(5);
+    n >>>= 0;
+    while (n >= 0x80) {
+      this.buf[this.pos++] = (n & 0x7f) | 0x80;
+      n >>>= 7;
+    }
+    this.buf[this.pos++] = n;
+  }
+  writeRaw(data:Uint8Array) {
+    this.ensure(data.length);
+    this.buf.set(data, this.pos);
+    this.pos += data.length;
+  }
+  writeBytes(data:Uint8Array) {
+    this.writeVarint(data.length);
+    this.writeRaw(data);
+  }
+  // returns what was written, and starts over
+  finish() : Uint8Array {
+    var result = this.buf.slice(0, this.pos);
+    this.pos = 0;
+    return result;
+  }
+}
+
+class ByteReader {
+  pos : number = 0;
+
+  constructor(public data:Uint8Array) { }
+
+  eof() : boolean {
+    return this.pos >= this.data.length;
+  }
+  readByte() : number {
+    if (this.pos >= this.data.length) throw new Error("Movie is truncated");
+    return this.data[this.pos++];
+  }
+  readVarint() : number {
+    var n = 0;
+    var shift = 0;
+    var b;
+    do {
+      b = this.readByte();
+      n += (b & 0x7f) * Math.pow(2, shift);
+      shift += 7;
+    } while (b & 0x80);
+    return n;
+  }
+  readBytes() : Uint8Array {
+    var len = this.readVarint();
+    if (this.pos + len > this.data.length) throw new Error("Movie is truncated");
+    var result = this.data.subarray(this.pos, this.pos + len);
+    this.pos += len;
+    return result;
+  }
+}
+
+/// WRITING
+
+export class MovieWriter {
+
+  keyframeInterval : number = 60*60; // frames
+  flushInterval : number = 60;       // frames
+
+  sink : MovieSink;
+  out : ByteWriter = new ByteWriter(0x1000);
+  lastControls : Uint8Array = null;
+  lastSeed : number = 0;
+  repeat : number = 0;
+  frameCount : number = 0;
+  lastKeyframe : number = -1;
+  sinceFlush : number = 0;
+
+  constructor(sink:MovieSink, meta:MovieMetadata, rom:Uint8Array) {
+    this.sink = sink;
+    for (var b of MOVIE_MAGIC) this.out.writeByte(b);
+    this.out.writeByte(MOVIE_VERSION);
+    this.out.writeBytes(textEncoder.encode(JSON.stringify(meta)));
+    this.out.writeBytes(rom || new Uint8Array(0));
+  }
+  // the first keyframe has to come before the first frame
+  wantsKeyframe() : boolean {
+    return this.lastKeyframe < 0 || this.frameCount - this.lastKeyframe >= this.keyframeInterval;
+  }
+  addKeyframe(state:EmuState) {
+    this.flushRepeat();
+    this.out.writeByte(MovieRecord.KEYFRAME);
+    this.out.writeVarint(this.frameCount);
+    this.out.writeBytes(encodeObject(state));
+    this.lastKeyframe = this.frameCount;
+  }
+  addFrame(controls:EmuControlsState, seed:number) {
+    if (this.lastKeyframe < 0) throw new Error("Movie needs a keyframe before the first frame");
+    var bytes = encodeObject(controls || null);
+    var seedxor = (seed ^ this.lastSeed) >>> 0;
+    if (seedxor == 0 && this.lastControls && sameBytes(bytes, this.lastControls)) {
+      this.repeat++;
+    } else {
+      this.flushRepeat();
+      if (this.lastControls && bytes.length == this.lastControls.length) {
+        this.out.writeByte(MovieRecord.FRAME);
+        this.out.writeVarint(seedxor);
+        this.out.writeBytes(encodeXORDelta(bytes, this.lastControls));
+      } else {
+        this.out.writeByte(MovieRecord.CONTROLS);
+        this.out.writeVarint(seedxor);
+        this.out.writeBytes(bytes);
+      }
+      this.lastControls = bytes;
+      this.lastSeed = seed;
+    }
+    this.frameCount++;
+    if (++this.sinceFlush >= this.flushInterval) this.flush();
+  }
+  flushRepeat() {
+    if (this.repeat > 0) {
+      this.out.writeByte(MovieRecord.REPEAT);
+      this.out.writeVarint(this.repeat);
+      this.repeat = 0;
+    }
+  }
+  flush() {
+    this.flushRepeat();
+    this.sinceFlush = 0;
+    if (this.out.pos > 0) this.sink.write(this.out.finish());
+  }
+  close() {
+    this.flush();
+    this.sink.close();
+  }
+}
+
+/// READING
+
+export type MovieFrame = {controls:EmuControlsState, seed:number};
+
+export class MovieReader {
+
+  meta : MovieMetadata;
+  rom : Uint8Array;
+  inp : ByteReader;
+  frame : number = 0;    // frames returned so far
+  controls : Uint8Array = null;
+  seed : number = 0;
+  repeat : number = 0;
+  keyframe : {frame:number, state:Uint8Array} = null; // most recent one read
+
+  constructor(data:Uint8Array) {
+    this.inp = new ByteReader(data);
+    for (var b of MOVIE_MAGIC)
+      if (this.inp.readByte() != b) throw new Error("Not a movie file");
+    var version = this.inp.readByte();
+    if (version != MOVIE_VERSION) throw new Error("Unsupported movie version " + version);
+    this.meta = JSON.parse(textDecoder.decode(this.inp.readBytes()));
+    this.rom = this.inp.readBytes();
+  }
+  // returns the next frame, or null at the end; keyframes along the way end up in this.keyframe
+  nextFrame() : MovieFrame {
+    while (this.repeat == 0) {
+      if (this.inp.eof()) return null;
+      var type = this.inp.readByte();
+      switch (type) {
+        case MovieRecord.CONTROLS:
+          this.seed = (this.seed ^ this.inp.readVarint()) | 0;
+          this.controls = this.inp.readBytes().slice(0);
+          this.repeat = 1;
+          break;
+        case MovieRecord.FRAME:
+          this.seed = (this.seed ^ this.inp.readVarint()) | 0;
+          var next = new Uint8Array(this.controls.length);
+          decodeXORDelta(this.inp.readBytes(), this.controls, next);
+          this.controls = next;
+          this.repeat = 1;
+          break;
+        case MovieRecord.REPEAT:
+          this.repeat = this.inp.readVarint();
+          break;
+        case MovieRecord.KEYFRAME:
+          var frame = this.inp.readVarint();
+          this.keyframe = {frame:frame, state:this.inp.readBytes()};
+          break;
+        default:
+          throw new Error("Bad movie record type " + type + " at offset " + (this.inp.pos-1));
+      }
+    }
+    this.repeat--;
+    this.frame++;
+    return {controls:decodeObject(this.controls), seed:this.seed};
+  }
+}
+
+// Replays a whole movie as fast as possible, without drawing.
+// Keyframes after the first are checked against the replayed state, and the
+// result says which frame diverged first (-1 if none did).
+export function playMovie(platform:Platform, data:Uint8Array) : {frames:number, diverged:number} {
+  var reader = new MovieReader(data);
+  var lastKeyframe = null;
+  var diverged = -1;
+  var frame : MovieFrame;
+  do {
+    frame = reader.nextFrame();
+    var key = reader.keyframe;
+    if (key && key !== lastKeyframe && lastKeyframe == null) {
+      platform.loadState(decodeObject(key.state));
+    }
+    // keyframes are saved after the frame's controls are set
+    if (frame) {
+      if (platform.loadControlsState) platform.loadControlsState(frame.controls);
+      setNoiseSeed(frame.seed);
+    }
+    if (key && key !== lastKeyframe) {
+      if (lastKeyframe != null && diverged < 0 && !sameBytes(encodeObject(platform.saveState()), key.state))
+        diverged = key.frame;
+      lastKeyframe = key;
+    }
+    if (frame) {
+      platform.advance(true);
+    }
+  } while (frame);
+  return {frames:reader.frame, diverged:diverged};
+}
+
+/// SINKS
+
+export class MemoryMovieSink implements MovieSink {
+  chunks : Uint8Array[] = [];
+
+  write(chunk:Uint8Array) {
+    this.chunks.push(chunk);
+  }
+  close() {
+  }
+  getData() : Uint8Array {
+    return concatChunks(this.chunks);
+  }
+}
+
+// appends to a file, in Node
+export class FileMovieSink implements MovieSink {
+  fs;
+  fd : number;
+
+  constructor(path:string) {
+    this.fs = require('fs');
+    this.fd = this.fs.openSync(path, 'w');
+  }
+  write(chunk:Uint8Array) {
+    this.fs.writeSync(this.fd, chunk);
+  }
+  close() {
+    this.fs.closeSync(this.fd);
+  }
+}
+
+// Stores each chunk as its own item in a localforage store (IndexedDB in the
+// browser), plus an item under the movie's name that counts them, so a movie
+// is readable up to the last chunk written even if the page goes away.
+// Writes happen one after another, and stop at the first one that fails.
+export class StoreMovieSink implements MovieSink {
+  store;
+  name : string;
+  numChunks : number = 0;
+  pending : Promise<void> = Promise.resolve();
+  error = null;
+  onerror : (e) => void;
+
+  constructor(store, name:string) {
+    this.store = store;
+    this.name = name;
+  }
+  write(chunk:Uint8Array) {
+    var key = this.name + '/' + this.numChunks++;
+    var index = {chunks:this.numChunks};
+    this.pending = this.pending.then(() => {
+      if (this.error) return;
+      // the index only counts chunks that were written
+      return this.store.setItem(key, chunk).then(() => this.store.setItem(this.name, index));
+    }).catch((e) => {
+      this.error = e;
+      if (this.onerror) this.onerror(e);
+    });
+  }
+  close() {
+  }
+}
+
+export async function loadMovieFromStore(store, name:string) : Promise<Uint8Array> {
+  var index = await store.getItem(name);
+  if (!index) return null;
+  var chunks = [];
+  for (var i=0; i<index.chunks; i++)
+    chunks.push(await store.getItem(name + '/' + i));
+  return concatChunks(chunks);
+}
+
+function concatChunks(chunks:Uint8Array[]) : Uint8Array {
+  var len = 0;
+  for (var c of chunks) len += c.length;
+  var data = new Uint8Array(len);
+  var ofs = 0;
+  for (var c of chunks) {
+    data.set(c, ofs);
+    ofs += c.length;
+  }
+  return data;
+}
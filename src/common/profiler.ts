@@ -0,0 +1,307 @@
+
+import { ProbeRecorder, ProbeFlags } from "./recorder";
+import { lpad } from "./util";
+import { CodeListingMap, SourceLine } from "./workertypes";
+
+// Routine entries and exits, timed in CPU clocks, which can be saved in the
+// formats read by Chrome's trace viewer (chrome://tracing, Perfetto) and speedscope.
+
+const MAX_TRACE_EVENTS = 1000000;
+
+export interface CallTraceEvent {
+  open : boolean;   // entering (true) or leaving (false)
+  name : string;
+  clock : number;
+}
+
+export class CallTraceLog {
+
+  events : CallTraceEvent[] = [];
+  maxEvents : number;
+
+  constructor(maxEvents?:number) {
+    this.maxEvents = maxEvents || MAX_TRACE_EVENTS;
+  }
+  reset() {
+    this.events = [];
+  }
+  isFull() : boolean {
+    return this.events.length >= this.maxEvents;
+  }
+  enter(name:string, clock:number) {
+    if (!this.isFull()) this.events.push({open:true, name:name, clock:clock});
+  }
+  exit(name:string, clock:number) {
+    if (!this.isFull()) this.events.push({open:false, name:name, clock:clock});
+  }
+  lastClock() : number {
+    return this.events.length ? this.events[this.events.length-1].clock : 0;
+  }
+  // calls fn with properly nested events: exits without an entry are dropped,
+  // and routines still running at the end are closed at the last clock
+  forEachNested(fn:(open:boolean, name:string, clock:number) => void) {
+    var stack : string[] = [];
+    for (var ev of this.events) {
+      if (ev.open) {
+        stack.push(ev.name);
+        fn(true, ev.name, ev.clock);
+      } else if (stack.length) {
+        fn(false, stack.pop(), ev.clock);
+      }
+    }
+    var end = this.lastClock();
+    while (stack.length) {
+      fn(false, stack.pop(), end);
+    }
+  }
+  // Chrome trace event format, timestamps in microseconds
+  toChromeTrace(clocksPerSecond:number) : {} {
+    var usecs = 1000000 / clocksPerSecond;
+    var traceEvents = [];
+    this.forEachNested((open, name, clock) => {
+      traceEvents.push({name:name, ph:open?'B':'E', ts:clock*usecs, pid:1, tid:1});
+    });
+    return {traceEvents:traceEvents, displayTimeUnit:'ns'};
+  }
+  // speedscope's evented profile, in CPU clocks
+  toSpeedscope(title:string) : {} {
+    var frames = [];
+    var frameIndex = {};
+    var events = [];
+    this.forEachNested((open, name, clock) => {
+      var i = frameIndex[name];
+      if (i == null) {
+        i = frameIndex[name] = frames.length;
+        frames.push({name:name});
+      }
+      events.push({type:open?'O':'C', frame:i, at:clock});
+    });
+    return {
+      $schema: 'https://www.speedscope.app/file-format-schema.json',
+      shared: {frames:frames},
+      profiles: [{
+        type: 'evented',
+        name: title,
+        unit: 'none',
+        startValue: events.length ? events[0].at : 0,
+        endValue: this.lastClock(),
+        events: events
+      }],
+      name: title,
+      exporter: '8bitworkshop'
+    };
+  }
+}
+
+/// INTERRUPT BUDGET
+
+export const MAX_INTERRUPT_RUNS = 10000;
+export const INTERRUPT_REPORT_HEADER = "Frame  Type   Row  Col  End row   Cycles  Spill";
+
+export interface InterruptRun {
+  frame : number;       // probe frame it started in
+  type : number;        // as passed to logInterrupt()
+  startRow : number;
+  startCol : number;
+  endFrame : number;    // -1 if it hasn't returned yet
+  endRow : number;
+  cycles : number;
+  inVblank : boolean;   // started outside the visible scanlines
+  spillCycles : number; // cycles it kept running after the visible scanlines began
+}
+
+// Times each interrupt handler, from the INTERRUPT event until the stack pointer
+// rises above where it was when the interrupt happened (RTI/RETI), and notes the
+// ones that start in vblank but are still running once the visible area begins.
+export class InterruptBudgetAnalyzer {
+
+  firstVisible : number;
+  numVisible : number;
+  runs : InterruptRun[] = [];
+  open : {run:InterruptRun, sp:number, start:number, spillStart:number}[] = [];
+  frame : number = 0;
+  clock : number = 0;   // clocks before the current frame
+  nextFrame : number = 0; // next probe frame for addFrames()
+
+  constructor(firstVisible:number, numVisible:number) {
+    this.firstVisible = firstVisible;
+    this.numVisible = numVisible;
+  }
+  isVisible(row:number) : boolean {
+    return row >= this.firstVisible && row < this.firstVisible + this.numVisible;
+  }
+  startFrame(frame:number) {
+    this.frame = frame;
+  }
+  endFrame(clocks:number) {
+    this.clock += clocks;
+  }
+  event(op:number, addr:number, col:number, row:number, clk:number, sp:number) {
+    var clock = this.clock + clk;
+    // spilling into the visible area?
+    if (this.open.length && this.isVisible(row)) {
+      for (var o of this.open) {
+        if (o.run.inVblank && o.spillStart < 0) o.spillStart = clock;
+      }
+    }
+    switch (op) {
+      case ProbeFlags.INTERRUPT:
+        var run = {frame:this.frame, type:addr, startRow:row, startCol:col, endFrame:-1, endRow:-1,
+          cycles:0, inVblank:!this.isVisible(row), spillCycles:0};
+        this.runs.push(run);
+        if (this.runs.length > MAX_INTERRUPT_RUNS) this.runs.shift();
+        this.open.push({run:run, sp:sp, start:clock, spillStart:-1});
+        break;
+      case ProbeFlags.SP_PUSH:
+        // SP wasn't known at the interrupt, so use the interrupt's own push
+        var top = this.open[this.open.length-1];
+        if (top && top.sp < 0) top.sp = addr + 1;
+        break;
+      case ProbeFlags.SP_POP:
+        while (this.open.length && this.open[this.open.length-1].sp >= 0 && addr >= this.open[this.open.length-1].sp) {
+          var done = this.open.pop();
+          done.run.endFrame = this.frame;
+          done.run.endRow = row;
+          done.run.cycles = clock - done.start;
+          if (done.spillStart >= 0) done.run.spillCycles = clock - done.spillStart;
+        }
+        break;
+    }
+  }
+  // analyzes the probe's frames since the last call, except for the last one
+  // (which might still be running) unless includeLast is set
+  addFrames(probe:ProbeRecorder, includeLast?:boolean) {
+    var last = includeLast ? probe.numFrames : probe.numFrames - 1;
+    for (var n = Math.max(this.nextFrame, probe.firstFrame()); n < last; n++) {
+      var start = probe.getFrameStart(n);
+      if (start < 0) continue;
+      this.startFrame(n);
+      var clocks = probe.forEachEvent(start, probe.getFrameEnd(n), (op,addr,col,row,clk,value,sp) => {
+        this.event(op, addr, col, row, clk, sp);
+      });
+      this.endFrame(clocks);
+    }
+    this.nextFrame = Math.max(this.nextFrame, last);
+  }
+  // frames with a handler that spilled into the visible area
+  getSpilledFrames() : number[] {
+    var frames = [];
+    for (var run of this.runs) {
+      if (run.spillCycles > 0 && frames.indexOf(run.frame) < 0) frames.push(run.frame);
+    }
+    return frames;
+  }
+  getMaxCycles() : number {
+    var maxCycles = 0;
+    for (var run of this.runs) maxCycles = Math.max(maxCycles, run.cycles);
+    return maxCycles;
+  }
+  getSummary() : string {
+    var spilled = this.getSpilledFrames();
+    return this.runs.length + " interrupts, longest " + this.getMaxCycles() + " cycles, "
+      + spilled.length + " frame(s) spilled into the visible area" + (spilled.length ? ": " + spilled.join(", ") : "");
+  }
+  formatRun(run:InterruptRun) : string {
+    var end = run.endFrame < 0 ? "running" : (run.endRow + (run.endFrame > run.frame ? "+" + (run.endFrame - run.frame) + "f" : ""));
+    return lpad(run.frame+"", 5) + lpad(run.type+"", 6) + lpad(run.startRow+"", 6) + lpad(run.startCol+"", 5)
+      + lpad(end, 9) + lpad(run.cycles+"", 9) + (run.spillCycles ? lpad(run.spillCycles+"", 7) + " SPILL" : "");
+  }
+  getReport() : string {
+    var s = INTERRUPT_REPORT_HEADER + "\n";
+    for (var run of this.runs) s += this.formatRun(run) + "\n";
+    return s + this.getSummary() + "\n";
+  }
+}
+
+// analyzes every frame still in the probe's buffer, e.g. after running headless
+export function analyzeInterrupts(probe:ProbeRecorder, firstVisible:number, numVisible:number) : InterruptBudgetAnalyzer {
+  var analyzer = new InterruptBudgetAnalyzer(firstVisible, numVisible);
+  analyzer.addFrames(probe, true);
+  return analyzer;
+}
+
+/// CODE COVERAGE
+
+const MAX_LINE_BYTES = 64; // a line's code ends at the next line's offset, or after this many bytes
+
+export interface LineCoverage {
+  line : number;
+  offset : number;
+  hit : boolean;
+}
+
+export interface FileCoverage {
+  path : string;
+  lines : LineCoverage[]; // by line number
+  numHit : number;
+}
+
+// Resolves executed addresses to listing lines. A line counts as hit if any
+// address from its offset up to the next line's offset was executed, since
+// a branch can land after a line's first instruction.
+export function getLineCoverage(lines:SourceLine[], isHit:(addr:number) => boolean) : LineCoverage[] {
+  var code = lines.filter((info) => info.offset >= 0 && info.iscode !== false);
+  var offsets = code.map((info) => info.offset).sort((a,b) => a-b);
+  var result : LineCoverage[] = [];
+  var byLine = {};
+  for (var info of code) {
+    // binary search for the next higher offset
+    var lo = 0, hi = offsets.length;
+    while (lo < hi) {
+      var mid = (lo + hi) >> 1;
+      if (offsets[mid] <= info.offset) lo = mid+1; else hi = mid;
+    }
+    var end = Math.min(lo < offsets.length ? offsets[lo] : info.offset+1, info.offset + MAX_LINE_BYTES);
+    var hit = false;
+    for (var a = info.offset; a < end && !hit; a++) hit = isHit(a);
+    // several snippets can share a line
+    var lc : LineCoverage = byLine[info.line];
+    if (lc) {
+      lc.hit = lc.hit || hit;
+    } else {
+      lc = byLine[info.line] = {line:info.line, offset:info.offset, hit:hit};
+      result.push(lc);
+    }
+  }
+  result.sort((a,b) => a.line-b.line);
+  return result;
+}
+
+// Coverage of each source and assembly file in the listings. Source lines
+// are attributed to their own path if they have one, otherwise to
+// getSourcePath(listing name), which defaults to the listing name.
+export function getListingCoverage(listings:CodeListingMap, isHit:(addr:number) => boolean,
+                                   getSourcePath?:(lstfn:string) => string) : FileCoverage[] {
+  var files : {[path:string]:SourceLine[]} = {};
+  function add(path:string, info:SourceLine) {
+    (files[path] = files[path] || []).push(info);
+  }
+  for (var lstfn in listings) {
+    var lst = listings[lstfn];
+    var srcpath = (getSourcePath && getSourcePath(lstfn)) || lstfn;
+    for (var info of lst.lines || []) add(info.path || srcpath, info);
+    for (var info of lst.asmlines || []) add(lstfn, info);
+  }
+  var result : FileCoverage[] = [];
+  for (var path in files) {
+    var lines = getLineCoverage(files[path], isHit);
+    if (lines.length) {
+      result.push({path:path, lines:lines, numHit:lines.filter((lc) => lc.hit).length});
+    }
+  }
+  return result;
+}
+
+// LCOV tracefile, as read by genhtml and most coverage tools (hit lines count as 1)
+export function toLcov(files:FileCoverage[], testName?:string) : string {
+  var s = "";
+  for (var file of files) {
+    s += "TN:" + (testName || "") + "\n";
+    s += "SF:" + file.path + "\n";
+    for (var lc of file.lines) s += "DA:" + lc.line + "," + (lc.hit ? 1 : 0) + "\n";
+    s += "LF:" + file.lines.length + "\n";
+    s += "LH:" + file.numHit + "\n";
+    s += "end_of_record\n";
+  }
+  return s;
+}
@@ -1,26 +1,234 @@
 
 import { Platform, EmuState, EmuControlsState, EmuRecorder } from "./baseplatform";
 import { getNoiseSeed, setNoiseSeed } from "./emu";
+import { MovieWriter } from "./movie";
 
 // RECORDER
 
 type FrameRec = {controls:EmuControlsState, seed:number};
 
+// Checkpoints are stored as deltas against the most recent keyframe (a full state).
+// Every typed array in the state is XORed with the keyframe's array at the same
+// path, then run-length encoded, so RAM that hasn't changed costs a few bytes.
+// Large plain arrays of numbers (jsnes and Javatari keep memory in them) are
+// packed into Float64Arrays first and treated the same way.
+// Decoding any checkpoint takes a single pass over its own delta.
+
+const KEYFRAME_INTERVAL = 30;   // checkpoints per keyframe
+const MIN_ZERO_RUN = 4;         // shorter runs of unchanged bytes stay in the literal
+const MIN_PACKED_LENGTH = 64;   // smaller plain arrays are kept as they are
+
+type TypedArrayType = { new(len:number) : ArrayBufferView & {length:number} };
+
+class DeltaArray {
+  constructor(
+    public type : TypedArrayType,
+    public length : number,
+    public data : Uint8Array,   // RLE of the XOR with the keyframe, or raw bytes if rle is false
+    public rle : boolean,
+    public plain? : boolean) { } // decodes to a plain Array (packed as a Float64Array)
+}
+
+type Checkpoint = {frame : number, key : EmuState, delta : any}; // key == null means delta is the keyframe itself
+
+var rleScratch = new Uint8Array(0);
+
+function byteView(a:ArrayBufferView) : Uint8Array {
+  return new Uint8Array(a.buffer, a.byteOffset, a.byteLength);
+}
+
+function writeVarint(out:Uint8Array, i:number, n:number) : number {
+  while (n >= 0x80) {
+    out[i++] = (n & 0x7f) | 0x80;
+    n >>>= 7;
+  }
+  out[i++] = n;
+  return i;
+}
+
+// [zero run length][literal length][literal bytes] ...
+export function encodeXORDelta(cur:Uint8Array, key:Uint8Array) : Uint8Array {
+  var n = cur.length;
+  if (rleScratch.length < n*2 + 16) rleScratch = new Uint8Array(n*2 + 16);
+  var out = rleScratch;
+  var o = 0;
+  var i = 0;
+  while (i < n) {
+    var zstart = i;
+    while (i < n && cur[i] == key[i]) i++;
+    var lstart = i;
+    // extend the literal until we see enough unchanged bytes in a row
+    var zeros = 0;
+    while (i < n && zeros < MIN_ZERO_RUN) {
+      zeros = (cur[i] == key[i]) ? zeros+1 : 0;
+      i++;
+    }
+    if (zeros == MIN_ZERO_RUN || (i == n && zeros > 0)) i -= zeros;
+    o = writeVarint(out, o, lstart - zstart);
+    o = writeVarint(out, o, i - lstart);
+    for (var j=lstart; j<i; j++)
+      out[o++] = cur[j] ^ key[j];
+  }
+  return out.slice(0, o);
+}
+
+export function decodeXORDelta(data:Uint8Array, key:Uint8Array, dest:Uint8Array) {
+  dest.set(key);
+  var o = 0;
+  var i = 0;
+  var shift, n;
+  while (i < data.length) {
+    for (n=0, shift=0; data[i] & 0x80; shift += 7) n |= (data[i++] & 0x7f) << shift;
+    o += n | (data[i++] << shift);
+    for (n=0, shift=0; data[i] & 0x80; shift += 7) n |= (data[i++] & 0x7f) << shift;
+    n |= data[i++] << shift;
+    while (n-- > 0)
+      dest[o++] ^= data[i++];
+  }
+}
+
+// null if the array has anything but numbers in it
+function packNumbers(a:any[]) : Float64Array {
+  var packed = new Float64Array(a.length);
+  for (var i=0; i<a.length; i++) {
+    var v = a[i];
+    if (typeof v !== 'number') return null;
+    packed[i] = v;
+  }
+  return packed;
+}
+
+// the keyframe is encoded against many times, so keep its packed arrays around
+// (until the next keyframe, see recordFrame)
+var packedKeys = new WeakMap<any[],Float64Array>();
+
+function packKey(key:any[]) : Float64Array {
+  var packed = packedKeys.get(key);
+  if (packed === undefined) {
+    packed = packNumbers(key);
+    packedKeys.set(key, packed);
+  }
+  return packed;
+}
+
+// returns a copy of the state tree where each typed array (or large number array)
+// is a DeltaArray, sharing everything else (states from saveState() are not modified afterwards)
+function encodeState(cur, key) {
+  if (Array.isArray(cur) && cur.length >= MIN_PACKED_LENGTH) {
+    if (cur === key) return cur;
+    var packed = packNumbers(cur);
+    if (packed) {
+      var packedKey = Array.isArray(key) && key.length === cur.length ? packKey(key) : null;
+      if (packedKey)
+        return new DeltaArray(Float64Array, cur.length, encodeXORDelta(byteView(packed), byteView(packedKey)), true, true);
+      else
+        return new DeltaArray(Float64Array, cur.length, byteView(packed), false, true);
+    }
+  }
+  if (ArrayBuffer.isView(cur)) {
+    // unchanged buffers shared with the keyframe (e.g. copy-on-write disk tracks)
+    if (cur === key) return cur;
+    var type = cur.constructor as any;
+    var bytes = byteView(cur);
+    if (key && key.constructor === type && key.length === (cur as any).length)
+      return new DeltaArray(type, (cur as any).length, encodeXORDelta(bytes, byteView(key)), true);
+    else
+      return new DeltaArray(type, (cur as any).length, bytes.slice(0), false);
+  }
+  if (cur == null || typeof cur !== 'object')
+    return cur;
+  var result = null;
+  for (var k in cur) {
+    var v = cur[k];
+    if (v != null && typeof v === 'object') {
+      var enc = encodeState(v, key && key[k]);
+      if (enc !== v) {
+        if (!result) result = Array.isArray(cur) ? cur.slice(0) : Object.assign({}, cur);
+        result[k] = enc;
+      }
+    }
+  }
+  return result || cur;
+}
+
+function decodeState(delta, key) {
+  if (delta instanceof DeltaArray) {
+    var arr = new delta.type(delta.length);
+    if (delta.rle)
+      decodeXORDelta(delta.data, byteView(delta.plain ? packKey(key) : key), byteView(arr));
+    else
+      byteView(arr).set(delta.data);
+    if (delta.plain) {
+      var plain = new Array(delta.length);
+      for (var i=0; i<plain.length; i++) plain[i] = arr[i];
+      return plain;
+    }
+    return arr;
+  }
+  if (ArrayBuffer.isView(delta))
+    return delta;
+  if (delta == null || typeof delta !== 'object')
+    return delta;
+  var result = null;
+  for (var k in delta) {
+    var v = delta[k];
+    if (v != null && typeof v === 'object') {
+      var dec = decodeState(v, key && key[k]);
+      if (dec !== v) {
+        if (!result) result = Array.isArray(delta) ? delta.slice(0) : Object.assign({}, delta);
+        result[k] = dec;
+      }
+    }
+  }
+  return result || delta;
+}
+
+// Checkpoints get sparser with age: the newest checkpointsPerTier are checkpointInterval
+// frames apart, the next checkpointsPerTier twice that, and so on, so a long session
+// stays seekable without keeping a checkpoint every few frames.
+
+const PREFETCH_FRAMES = 30;     // frames replayed per idle slice
+const MAX_PREFETCH_STATES = 32;
+
+function runWhenIdle(fn : () => void) {
+    var ric = typeof window !== 'undefined' && window['requestIdleCallback'];
+    if (ric)
+        ric(fn);
+    else
+        setTimeout(fn, 0);
+}
+
 export class StateRecorderImpl implements EmuRecorder {
-  
+
     checkpointInterval : number = 10;
+    checkpointsPerTier : number = 60;
     callbackStateChanged : () => void;
     callbackNewCheckpoint : (state:EmuState) => void;
-    maxCheckpoints : number = 300;
-    
+    maxCheckpoints : number = 420;
+
     platform : Platform;
-    checkpoints : EmuState[];
-    framerecs : FrameRec[];
+    checkpoints : Checkpoint[];  // oldest first, the first one is always at frame 0
+    numCheckpoints : number;
+    baseFrame : number;          // frames dropped from the start of the history
+    lastKeyframe : EmuState;
+    lastCheckpoint : EmuState;
+    sinceKeyframe : number;
+    framerecs : FrameRec[];      // controls for each frame, from framerecsStart on
+    framerecsStart : number;     // dropped frames still at the start of framerecs
     frameCount : number;
+    thinnedFrameCount : number;  // frameCount at the last thinCheckpoints()
     lastSeekFrame : number;
     lastSeekStep : number;
     lastStepCount : number;
-    
+    // states replayed in idle time, near where the user is likely to seek
+    prefetched : {frame : number, state : EmuState}[];
+    prefetchTarget : number;
+    prefetchPending : boolean = false;
+    // keyframes that were thinned out, whose dependents still need a new keyframe
+    removedKeys : EmuState[];
+    rekeyPending : boolean = false;
+    movie : MovieWriter = null; // also streams every recorded frame here, if set
+
     constructor(platform : Platform) {
         this.reset();
         this.platform = platform;
@@ -28,11 +236,21 @@ export class StateRecorderImpl implements EmuRecorder {
 
     reset() {
         this.checkpoints = [];
+        this.numCheckpoints = 0;
+        this.baseFrame = 0;
+        this.lastKeyframe = null;
+        this.lastCheckpoint = null;
+        this.sinceKeyframe = 0;
         this.framerecs = [];
+        this.framerecsStart = 0;
         this.frameCount = 0;
+        this.thinnedFrameCount = 0;
         this.lastSeekFrame = 0;
         this.lastSeekStep = 0;
         this.lastStepCount = 0;
+        this.prefetched = [];
+        this.prefetchTarget = -1;
+        this.removedKeys = [];
         if (this.callbackStateChanged) this.callbackStateChanged();
     }
 
@@ -50,6 +268,10 @@ export class StateRecorderImpl implements EmuRecorder {
             if (this.platform.saveControlsState) {
                 this.framerecs.push(controls);
             }
+            if (this.movie) {
+                if (this.movie.wantsKeyframe()) this.movie.addKeyframe(this.platform.saveState());
+                this.movie.addFrame(controls.controls, controls.seed);
+            }
             // time to save next frame?
             requested = (this.frameCount++ % this.checkpointInterval) == 0;
         }
@@ -58,11 +280,11 @@ export class StateRecorderImpl implements EmuRecorder {
         if (this.callbackStateChanged) this.callbackStateChanged();
         return requested;
     }
-    
+
     numFrames() : number {
         return this.frameCount;
     }
-    
+
     currentFrame() : number {
         return this.lastSeekFrame;
     }
@@ -72,27 +294,161 @@ export class StateRecorderImpl implements EmuRecorder {
   }
 
     recordFrame(state : EmuState) {
-        this.checkpoints.push(state);
-        if (this.callbackNewCheckpoint) this.callbackNewCheckpoint(state);
-        // checkpoints full?
+        var cp : Checkpoint;
+        var frame = this.frameCount - 1;
+        if (this.lastKeyframe == null || ++this.sinceKeyframe >= KEYFRAME_INTERVAL) {
+            cp = {frame:frame, key:null, delta:state};
+            this.lastKeyframe = state;
+            packedKeys = new WeakMap();
+            this.sinceKeyframe = 0;
+        } else {
+            cp = {frame:frame, key:this.lastKeyframe, delta:encodeState(state, this.lastKeyframe)};
+        }
+        this.lastCheckpoint = state;
+        this.checkpoints.push(cp);
+        this.thinCheckpoints();
+        // too many? drop the oldest, and the frames before the new oldest
         if (this.checkpoints.length > this.maxCheckpoints) {
-            this.checkpoints.shift(); // remove 1st checkpoint
-            this.framerecs = this.framerecs.slice(this.checkpointInterval);
-            this.lastSeekFrame -= this.checkpointInterval;
-            this.frameCount -= this.checkpointInterval;
-            if (this.callbackStateChanged) this.callbackStateChanged();
+            this.removeCheckpoint(0);
+            this.dropFrames(this.checkpoints[0].frame);
+        }
+        this.numCheckpoints = this.checkpoints.length;
+        if (this.callbackNewCheckpoint) this.callbackNewCheckpoint(state);
+    }
+
+    // Keeps a checkpoint only if it falls on the spacing for its age. A checkpoint is
+    // in tier t once its age reaches span * (2^t - 1), and only changes tier when it
+    // crosses one of those ages, so only the checkpoints that just did are looked at.
+    thinCheckpoints() {
+        var span = this.checkpointInterval * this.checkpointsPerTier;
+        var prevCount = this.thinnedFrameCount;
+        this.thinnedFrameCount = this.frameCount;
+        for (var tier=1; ; tier++) {
+            var age = span * ((1 << tier) - 1);
+            if (age >= this.frameCount) break;
+            // frames in (prevCount - age, frameCount - age]
+            var i = this.findCheckpointAtOrBefore(this.frameCount - age);
+            for (; i>0 && this.checkpoints[i].frame > prevCount - age; i--) {
+                var frame = this.checkpoints[i].frame;
+                if ((frame + this.baseFrame) % (this.checkpointInterval << tier) != 0)
+                    this.removeCheckpoint(i);
+            }
+        }
+    }
+
+    // index of the last checkpoint at or before frame (0 if there are none)
+    findCheckpointAtOrBefore(frame : number) : number {
+        var lo = 0;
+        var hi = this.checkpoints.length-1;
+        while (lo < hi) {
+            var mid = (lo + hi + 1) >> 1;
+            if (this.checkpoints[mid].frame <= frame) lo = mid; else hi = mid-1;
+        }
+        return lo;
+    }
+
+    removeCheckpoint(i : number) {
+        var cp = this.checkpoints[i];
+        this.checkpoints.splice(i, 1);
+        if (cp.key != null) return;
+        // a keyframe: the checkpoints that used it still point to it, so they can
+        // get a new keyframe later, when it won't hold up the emulator
+        var key = cp.delta;
+        if (this.lastKeyframe === key) this.lastKeyframe = null;
+        this.removedKeys.push(key);
+        if (!this.rekeyPending) {
+            this.rekeyPending = true;
+            runWhenIdle(() => this.rekeyStep());
         }
     }
 
+    // the first checkpoint that still uses a removed keyframe becomes the new keyframe
+    // (one keyframe per idle slice, not counting those that nothing uses anymore)
+    rekeyStep() {
+        this.rekeyPending = false;
+        var j = this.checkpoints.length;
+        while (j == this.checkpoints.length && this.removedKeys.length) {
+            var key = this.removedKeys.shift();
+            j = 0;
+            while (j < this.checkpoints.length && this.checkpoints[j].key !== key) j++;
+        }
+        var newKey = null;
+        for (; j<this.checkpoints.length && this.checkpoints[j].key === key; j++) {
+            var next = this.checkpoints[j];
+            var state = decodeState(next.delta, key);
+            if (newKey == null) {
+                newKey = state;
+                next.key = null;
+                next.delta = state;
+            } else {
+                next.key = newKey;
+                next.delta = encodeState(state, newKey);
+            }
+        }
+        if (this.removedKeys.length) {
+            this.rekeyPending = true;
+            runWhenIdle(() => this.rekeyStep());
+        }
+    }
+
+    dropFrames(n : number) {
+        // slicing on every checkpoint would copy all the frames each time
+        this.framerecsStart += n;
+        if (this.framerecsStart * 2 >= this.framerecs.length) {
+            this.framerecs = this.framerecs.slice(this.framerecsStart);
+            this.framerecsStart = 0;
+        }
+        for (var cp of this.checkpoints)
+            cp.frame -= n;
+        this.baseFrame += n;
+        this.lastSeekFrame -= n;
+        this.frameCount -= n;
+        this.thinnedFrameCount -= n;
+        this.prefetched = [];
+        if (this.callbackStateChanged) this.callbackStateChanged();
+    }
+
+    getCheckpoint(i : number) : EmuState {
+        var cp = this.checkpoints[i];
+        return cp.key ? decodeState(cp.delta, cp.key) : cp.delta;
+    }
+
+    // all checkpoints, oldest first (decodes every one, so it's slow)
+    getCheckpoints() : EmuState[] {
+        var states = [];
+        for (var i=0; i<this.numCheckpoints; i++)
+            states.push(this.getCheckpoint(i));
+        return states;
+    }
+
     getStateAtOrBefore(frame : number) : {frame : number, state : EmuState} {
+        if (this.numCheckpoints == 0)
+          return {frame:0, state:null};
         // initial frame?
-        if (frame <= 0 && this.checkpoints.length > 0)
-          return {frame:0, state:this.checkpoints[0]};
+        if (frame <= 0)
+          return {frame:0, state:this.getCheckpoint(0)};
+        var lo = this.findCheckpointAtOrBefore(frame);
+        var found = {frame:this.checkpoints[lo].frame, state:null};
+        // a prefetched state might be closer
+        for (var p of this.prefetched) {
+            if (p.frame <= frame && p.frame > found.frame)
+                found = {frame:p.frame, state:p.state};
+        }
+        if (!found.state) found.state = this.getCheckpoint(lo);
+        return found;
+    }
 
-        var bufidx = Math.floor(frame / this.checkpointInterval);
-        var foundidx = bufidx < this.checkpoints.length ? bufidx : this.checkpoints.length-1;
-        var foundframe = foundidx * this.checkpointInterval;
-        return {frame:foundframe, state:this.checkpoints[foundidx]};
+    // replays from frame to endframe, only drawing the last frame if asked to
+    replayFrames(frame : number, endframe : number, draw : boolean) : number {
+        var numSteps = 0;
+        while (frame < endframe) {
+            if (frame < this.framerecs.length - this.framerecsStart) {
+                this.loadControls(frame);
+            }
+            frame++;
+            numSteps = this.platform.advance(!draw || frame < endframe); // TODO: infinite loop?
+        }
+        return numSteps;
     }
 
     loadFrame(seekframe : number, seekstep? : number) : number {
@@ -108,13 +464,8 @@ export class StateRecorderImpl implements EmuRecorder {
             this.platform.pause();
             this.platform.loadState(state);
             // seek to frame index
-            while (frame < seekframe) {
-                if (frame < this.framerecs.length) {
-                    this.loadControls(frame);
-                }
-                frame++;
-                numSteps = this.platform.advance(frame < seekframe); // TODO: infinite loop?
-            }
+            numSteps = this.replayFrames(frame, seekframe, true);
+            frame = Math.max(frame, seekframe);
             // TODO: if first frame, we must figure out # of steps
             if (frame == 0) {
               numSteps = this.platform.advance(true);
@@ -122,7 +473,7 @@ export class StateRecorderImpl implements EmuRecorder {
             }
             // seek to step index
             // TODO: what if advance() returns clocks, but steps use insns?
-            if (seekstep > 0 && this.platform.advanceFrameClock) { 
+            if (seekstep > 0 && this.platform.advanceFrameClock) {
               seekstep = this.platform.advanceFrameClock(null, seekstep);
             }
             // record new values
@@ -134,15 +485,52 @@ export class StateRecorderImpl implements EmuRecorder {
             return -1;
         }
     }
-    
+
+    // While paused, replays toward a frame the user will probably seek to (e.g. under
+    // the mouse on the replay slider) a few frames at a time, keeping the states on
+    // the way so the seek itself only replays a few frames.
+    prefetchFrame(frame : number) {
+        this.prefetchTarget = frame;
+        if (!this.prefetchPending) {
+            this.prefetchPending = true;
+            runWhenIdle(() => this.prefetchStep());
+        }
+    }
+
+    prefetchStep() {
+        this.prefetchPending = false;
+        var target = Math.min(this.prefetchTarget, this.frameCount) - 1;
+        if (target < 0 || this.platform.isRunning()) return;
+        let {frame,state} = this.getStateAtOrBefore(target);
+        if (!state || target - frame < this.checkpointInterval) return; // close enough
+        var endframe = Math.min(target, frame + PREFETCH_FRAMES);
+        // replay without disturbing the frame being shown
+        var saved = this.platform.saveState();
+        var savedControls = this.platform.saveControlsState && this.platform.saveControlsState();
+        var savedSeed = getNoiseSeed();
+        this.platform.loadState(state);
+        this.replayFrames(frame, endframe, false);
+        var newstate = this.platform.saveState();
+        this.platform.loadState(saved);
+        if (savedControls) this.platform.loadControlsState(savedControls);
+        setNoiseSeed(savedSeed);
+        // keep the states closest to the target
+        this.prefetched.push({frame:endframe, state:newstate});
+        if (this.prefetched.length > MAX_PREFETCH_STATES) {
+            this.prefetched.sort((a,b) => Math.abs(a.frame - target) - Math.abs(b.frame - target));
+            this.prefetched.pop();
+        }
+        this.prefetchFrame(this.prefetchTarget);
+    }
+
     loadControls(frame : number) {
         if (this.platform.loadControlsState)
-            this.platform.loadControlsState(this.framerecs[frame].controls);
-        setNoiseSeed(this.framerecs[frame].seed);
+            this.platform.loadControlsState(this.framerecs[this.framerecsStart + frame].controls);
+        setNoiseSeed(this.framerecs[this.framerecsStart + frame].seed);
     }
-    
+
     getLastCheckpoint() : EmuState {
-        return this.checkpoints.length && this.checkpoints[this.checkpoints.length-1];
+        return this.lastCheckpoint;
     }
 }
 
@@ -164,23 +552,48 @@ export enum ProbeFlags {
   ILLEGAL	  = 0x09000000,
   SP_PUSH	  = 0x0a000000,
   SP_POP	  = 0x0b000000,
+  // only found in ProbeRecorder's buffer, forEachEvent() expands them
+  SP_SET    = 0x0c000000, // stack pointer, without a push or pop
+  EXEC_PUSH = 0x0d000000, // SP_PUSH by (value) bytes, then EXECUTE
+  EXEC_POP  = 0x0e000000, // SP_POP by (value) bytes, then EXECUTE
+  EXEC_FETCH= 0x20000000, // EXECUTE and opcode MEM_READ, then (op & 0xf) clocks
   SCANLINE	= 0x7e000000,
   FRAME		  = 0x7f000000,
 }
 
-class ProbeFrame {
-  data : Uint32Array;
-  len : number;
+const PROBE_MAX_FRAMES = 128;       // frames kept in the frame index
+const PROBE_MAX_LINES = 0x10000;    // scanlines kept in the scanline index (power of 2)
+
+// sp is the stack pointer when the event happened, or -1 if not known yet
+export type ProbeEventCallback = (op:number, addr:number, col:number, row:number, clk:number, value:number, sp?:number) => void;
+
+function isBusAccess(op:number) {
+  return op == ProbeFlags.MEM_READ || op == ProbeFlags.MEM_WRITE;
 }
 
+// Logs bus activity into a ring buffer, so the last few frames stay around.
+// idx counts every word ever logged; word i lives at buf[i & mask] until it's
+// overwritten, and the frame/scanline tables map frames and scanlines to indices.
+// The common instruction pattern (execute, fetch opcode, add clocks) and stack
+// pointer changes are packed into single words; use forEachEvent() to read them.
 export class ProbeRecorder implements ProbeAll {
 
   m : Probeable;      // machine to probe
-  buf : Uint32Array;  // buffer
-  idx : number = 0;   // index into buffer
+  buf : Uint32Array;  // ring buffer (power of 2 length)
+  mask : number;      // buf.length-1
+  idx : number = 0;   // total number of words logged
+  base : number = 0;  // index of first word after last clear()
   sl : number = 0;    // scanline
   cur_sp = -1;        // last stack pointer
-  singleFrame : boolean = true; // clear between frames
+  logSP = true;       // log the absolute SP before the next instruction
+  execIdx = -1;       // EXECUTE word of the current instruction, if we can still fuse
+  fusedIdx = -1;      // EXEC_FETCH word holding the last clocks logged, if nothing since
+  singleFrame : boolean = true; // views only show the last frame
+  numFrames : number = 0;
+  numLines : number = 0;
+  frameIdx = new Float64Array(PROBE_MAX_FRAMES);  // index of each FRAME word
+  frameLine = new Float64Array(PROBE_MAX_FRAMES); // value of numLines at each frame
+  lineIdx = new Float64Array(PROBE_MAX_LINES);    // index of each SCANLINE word
 
   constructor(m:Probeable, buflen?:number) {
     this.m = m;
@@ -193,74 +606,197 @@ export class ProbeRecorder implements ProbeAll {
     this.m.connectProbe(null);
   }
   reset(newbuflen? : number) {
-    if (newbuflen) this.buf = new Uint32Array(newbuflen);
+    if (newbuflen) {
+      var len = 1;
+      while (len < newbuflen) len <<= 1;
+      this.buf = new Uint32Array(len);
+      this.mask = len - 1;
+    }
     this.sl = 0;
     this.cur_sp = -1;
+    this.execIdx = -1;
+    this.fusedIdx = -1;
+    this.idx = 0;
+    this.numFrames = 0;
+    this.numLines = 0;
     this.clear();
   }
+  // forget everything logged so far (but keep counting frames)
   clear() {
-    this.idx = 0;
+    this.base = this.idx;
+    this.logSP = true;
+  }
+  // index of the oldest word still in the buffer
+  firstIdx() : number {
+    return Math.max(this.base, this.idx - this.buf.length);
+  }
+  get(i:number) : number {
+    return this.buf[i & this.mask];
+  }
+  // oldest frame still in the frame index (its data might be partly overwritten)
+  firstFrame() : number {
+    return Math.max(0, this.numFrames - PROBE_MAX_FRAMES + 1);
+  }
+  // index of the FRAME word that started frame n (counting from reset), or -1 if gone
+  getFrameStart(n:number) : number {
+    if (n < 0 || n >= this.numFrames || n <= this.numFrames - PROBE_MAX_FRAMES) return -1;
+    var i = this.frameIdx[n % PROBE_MAX_FRAMES];
+    return i >= this.firstIdx() ? i : -1;
+  }
+  getFrameEnd(n:number) : number {
+    return n+1 < this.numFrames ? this.frameIdx[(n+1) % PROBE_MAX_FRAMES] : this.idx;
+  }
+  // index of the word that started scanline sl of frame n, or -1 if gone
+  getScanlineStart(n:number, sl:number) : number {
+    var start = this.getFrameStart(n);
+    if (start < 0 || sl == 0) return start;
+    var line = this.frameLine[n % PROBE_MAX_FRAMES] + sl - 1;
+    var endline = n+1 < this.numFrames ? this.frameLine[(n+1) % PROBE_MAX_FRAMES] : this.numLines;
+    if (sl < 0 || line >= endline || line < this.numLines - PROBE_MAX_LINES) return -1;
+    var i = this.lineIdx[line & (PROBE_MAX_LINES-1)];
+    return i >= this.firstIdx() ? i : -1;
+  }
+  // range of words the views show: the last frame, or everything since clear()
+  // (starting at a frame, so rows line up, once the oldest words are overwritten)
+  getVisibleRange(framesBack?:number) : [number,number] {
+    var start = this.firstIdx();
+    var end = this.idx;
+    if (this.singleFrame && this.numFrames > 0) {
+      var n = this.numFrames - 1 - (framesBack|0);
+      start = this.getFrameStart(n);
+      end = this.getFrameEnd(n);
+      if (start < 0 || start >= end) return [0,0];
+    } else if (start > this.base) {
+      for (var n = this.firstFrame(); n < this.numFrames && this.getFrameStart(n) < 0; n++) ;
+      if (n >= this.numFrames) return [0,0];
+      start = this.getFrameStart(n);
+    }
+    return [start,end];
   }
   logData(a:number) {
     this.log(a);
   }
   log(a:number) {
-    // TODO: coalesce READ and EXECUTE and PUSH/POP
-    if (this.idx >= this.buf.length) return;
-    this.buf[this.idx++] = a;
+    var op = a & 0xff000000;
+    if (!isBusAccess(op)) {
+      this.execIdx = -1;
+    } else if (this.fusedIdx >= 0) {
+      // bus access after the clocks, so they need their own word after all
+      var w = this.buf[this.fusedIdx & this.mask];
+      this.buf[this.fusedIdx & this.mask] = w & 0xf0ffffff;
+      this.buf[(this.idx++) & this.mask] = ProbeFlags.CLOCKS | ((w >>> 24) & 0xf);
+    }
+    this.fusedIdx = -1;
+    this.buf[(this.idx++) & this.mask] = a;
   }
   relog(a:number) {
-    this.buf[this.idx-1] = a;
+    this.buf[(this.idx-1) & this.mask] = a;
   }
   lastOp() {
-    if (this.idx > 0)
-      return this.buf[this.idx-1] & 0xff000000;
+    if (this.idx > this.base)
+      return this.buf[(this.idx-1) & this.mask] & 0xff000000;
     else
       return -1;
   }
   lastAddr() {
-    if (this.idx > 0)
-      return this.buf[this.idx-1] & 0xffffff;
+    if (this.idx > this.base)
+      return this.buf[(this.idx-1) & this.mask] & 0xffffff;
     else
       return -1;
   }
+  // adds unpacked words (e.g. from a WASM machine), packing them as we go
   addLogBuffer(src: Uint32Array) {
-    if (this.idx + src.length > this.buf.length) {
-      src = src.slice(0, this.buf.length - this.idx);
+    for (var i=0; i<src.length; i++) {
+      var word = src[i];
+      switch (word & 0xff000000) {
+        case ProbeFlags.CLOCKS:
+          this.logClocks(word & 0xffffff);
+          break;
+        case ProbeFlags.EXECUTE:
+          this.log(word);
+          if ((word & 0xffffff) <= 0xffff) this.execIdx = this.idx - 1;
+          break;
+        case ProbeFlags.MEM_READ:
+          this.logRead(word & 0xffff, word >> 16);
+          break;
+        case ProbeFlags.SCANLINE:
+          this.logNewScanline();
+          break;
+        case ProbeFlags.FRAME:
+          this.logNewFrame();
+          break;
+        default:
+          this.log(word);
+          break;
+      }
     }
-    this.buf.set(src, this.idx);
-    this.idx += src.length;
-}
+  }
   logClocks(clocks:number) {
     clocks |= 0;
-    if (clocks > 0) {
-      if (this.lastOp() == ProbeFlags.CLOCKS)
-        this.relog((this.lastAddr() + clocks) | ProbeFlags.CLOCKS); // coalesce clocks
-      else
-        this.log(clocks | ProbeFlags.CLOCKS);
+    if (clocks <= 0) return;
+    // add to the instruction's EXEC_FETCH word, if no bus access came after the clocks
+    var fi = this.fusedIdx >= 0 ? this.fusedIdx : this.execIdx;
+    if (fi >= 0 && this.idx - fi <= this.buf.length) {
+      var w = this.buf[fi & this.mask];
+      var n = ((w >>> 24) & 0xf) + clocks;
+      if ((w & 0xf0000000) == ProbeFlags.EXEC_FETCH && n <= 0xf) {
+        this.buf[fi & this.mask] = (w & 0xf0ffffff) | (n << 24);
+        this.execIdx = -1;
+        this.fusedIdx = fi;
+        return;
+      }
     }
+    if (this.lastOp() == ProbeFlags.CLOCKS)
+      this.relog((this.lastAddr() + clocks) | ProbeFlags.CLOCKS); // coalesce clocks
+    else
+      this.log(clocks | ProbeFlags.CLOCKS);
   }
+
   logNewScanline() {
+    this.lineIdx[(this.numLines++) & (PROBE_MAX_LINES-1)] = this.idx;
     this.log(ProbeFlags.SCANLINE);
     this.sl++;
   }
   logNewFrame() {
+    var f = this.numFrames++ % PROBE_MAX_FRAMES;
+    this.frameIdx[f] = this.idx;
+    this.frameLine[f] = this.numLines;
     this.log(ProbeFlags.FRAME);
     this.sl = 0;
-    if (this.singleFrame) this.clear();
+    this.logSP = true; // so each frame decodes on its own
   }
   logExecute(address:number, SP:number) {
     // record stack pushes/pops (from last instruction)
-    if (this.cur_sp !== SP) {
-      if (SP < this.cur_sp) {
-        this.log(ProbeFlags.SP_PUSH | SP);
-      }
-      if (SP > this.cur_sp) {
-        this.log(ProbeFlags.SP_POP | SP);
+    var delta = 0;
+    if (this.cur_sp < 0) {
+      this.log(ProbeFlags.SP_SET | SP);
+    } else {
+      if (this.logSP) this.log(ProbeFlags.SP_SET | this.cur_sp);
+      delta = SP - this.cur_sp;
+    }
+    this.logSP = false;
+    this.cur_sp = SP;
+    if (delta != 0) {
+      if (delta >= -0xff && delta <= 0xff && address <= 0xffff) {
+        this.log(address | (delta < 0 ? ProbeFlags.EXEC_PUSH : ProbeFlags.EXEC_POP) | (Math.abs(delta) << 16));
+        return;
       }
-      this.cur_sp = SP;
+      this.log(SP | (delta < 0 ? ProbeFlags.SP_PUSH : ProbeFlags.SP_POP));
+    }
+    // the 6502 fetches the next opcode at the end of the last instruction,
+    // so move that read into this instruction's EXEC_FETCH word
+    var fetch = this.idx - 1;
+    var clocks = this.buf[fetch & this.mask];
+    if ((clocks & 0xff000000) == ProbeFlags.CLOCKS) fetch--; else clocks = 0;
+    var last = this.buf[fetch & this.mask];
+    if (delta == 0 && fetch >= this.base && (last & 0xff00ffff) == (address | ProbeFlags.MEM_READ)) {
+      this.idx = fetch;
+      if (clocks) this.log(clocks);
+      this.log(address | (last & 0xff0000) | ProbeFlags.EXEC_FETCH);
+    } else {
+      this.log(address | ProbeFlags.EXECUTE);
     }
-    this.log(address | ProbeFlags.EXECUTE);
+    if (address <= 0xffff) this.execIdx = this.idx - 1;
   }
   logInterrupt(type:number) {
     this.log(type | ProbeFlags.INTERRUPT);
@@ -269,6 +805,12 @@ export class ProbeRecorder implements ProbeAll {
     this.log((address & 0xffff) | ((value & 0xff)<<16) | op);
   }
   logRead(address:number, value:number) {
+    // opcode fetch right after EXECUTE? fuse them
+    var ei = this.execIdx;
+    if (ei == this.idx - 1 && this.buf[ei & this.mask] == (address | ProbeFlags.EXECUTE)) {
+      this.buf[ei & this.mask] = address | ((value & 0xff)<<16) | ProbeFlags.EXEC_FETCH;
+      return;
+    }
     this.logValue(address, value, ProbeFlags.MEM_READ);
   }
   logWrite(address:number, value:number) {
@@ -289,21 +831,255 @@ export class ProbeRecorder implements ProbeAll {
   logIllegal(address:number) {
     this.log(address | ProbeFlags.ILLEGAL);
   }
+  // Calls fn for each event in words [start,end), expanding the packed words,
+  // and tracking the scanline (row), clocks into the scanline (col), total clocks and SP.
+  // Returns the total clocks.
+  forEachEvent(start:number, end:number, fn:ProbeEventCallback) : number {
+    var row=0;
+    var col=0;
+    var clk=0;
+    var sp=-1;
+    var pending=0; // clocks of the last EXEC_FETCH, added after its bus accesses
+    for (var i=start; i<end; i++) {
+      var word = this.buf[i & this.mask];
+      var addr = word & 0xffff;
+      var value = (word >> 16) & 0xff;
+      var op = word & 0xff000000;
+      if (pending && !isBusAccess(op)) {
+        col += pending;
+        clk += pending;
+        pending = 0;
+      }
+      switch (op) {
+        case ProbeFlags.SCANLINE:	row++; col=0; break;
+        case ProbeFlags.FRAME:		row=0; col=0; break;
+        case ProbeFlags.CLOCKS:		col += word & 0xffffff; clk += word & 0xffffff; break;
+        case ProbeFlags.SP_SET:		sp = word & 0xffffff; break;
+        case ProbeFlags.SP_PUSH:
+        case ProbeFlags.SP_POP:
+          sp = word & 0xffffff;
+          fn(op, addr, col, row, clk, value, sp);
+          break;
+        case ProbeFlags.EXEC_PUSH:
+          sp -= value;
+          fn(ProbeFlags.SP_PUSH, sp & 0xffff, col, row, clk, (sp >> 16) & 0xff, sp);
+          fn(ProbeFlags.EXECUTE, addr, col, row, clk, 0, sp);
+          break;
+        case ProbeFlags.EXEC_POP:
+          sp += value;
+          fn(ProbeFlags.SP_POP, sp & 0xffff, col, row, clk, (sp >> 16) & 0xff, sp);
+          fn(ProbeFlags.EXECUTE, addr, col, row, clk, 0, sp);
+          break;
+        default:
+          if ((word & 0xf0000000) == ProbeFlags.EXEC_FETCH) {
+            fn(ProbeFlags.EXECUTE, addr, col, row, clk, 0, sp);
+            fn(ProbeFlags.MEM_READ, addr, col, row, clk, value, sp);
+            pending = (word >>> 24) & 0xf;
+          } else {
+            fn(op, addr, col, row, clk, value, sp);
+          }
+          break;
+      }
+    }
+    return clk + pending;
+  }
   countEvents(op : number) : number {
     var count = 0;
-    for (var i=0; i<this.idx; i++) {
-      if ((this.buf[i] & 0xff000000) == op)
-        count++;
-    }
+    this.forEachEvent(this.firstIdx(), this.idx, (op2) => { if (op2 == op) count++; });
     return count;
   }
   countClocks() : number {
-    var count = 0;
-    for (var i=0; i<this.idx; i++) {
-      if ((this.buf[i] & 0xff000000) == ProbeFlags.CLOCKS)
-        count += this.buf[i] & 0xffff;
+    return this.forEachEvent(this.firstIdx(), this.idx, () => {});
+  }
+
+}
+
+/// SAMPLING PROFILER
+
+// Notes where the CPU is every few hundred clocks, cheaply enough to leave on
+// at full speed. It only needs logExecute() and logClocks(), so the machine
+// keeps its fast memory paths while it's connected.
+export class SamplingProbe implements ProbeAll {
+
+  m : Probeable;
+  interval : number;      // clocks between samples
+  countdown : number;     // clocks until the next sample
+  pc : number = 0;        // last instruction executed
+  sp : number = 0;
+  numSamples : number;
+  pcs : Map<number,Uint32Array>;  // samples at each PC, one histogram per bank
+  sps : Uint32Array;              // samples at each SP
+  getBank : (address:number) => number = null;
+  cpuOnly = true;
+  symbolCache : {addr2symbol:{}, include:(sym:string) => boolean, names:string[], index:Int32Array};
+
+  constructor(m:Probeable, interval?:number) {
+    this.m = m;
+    this.interval = interval || 499; // odd, so it doesn't line up with loops
+    this.reset();
+  }
+  start() {
+    this.m.connectProbe(this);
+  }
+  stop() {
+    this.m.connectProbe(null);
+  }
+  reset() {
+    this.pcs = new Map();
+    this.sps = new Uint32Array(0x10000);
+    this.numSamples = 0;
+    this.countdown = this.interval;
+  }
+  logExecute(address:number, SP:number) {
+    this.pc = address;
+    this.sp = SP;
+  }
+  logClocks(clocks:number) {
+    if (clocks > 0) {
+      this.countdown -= clocks;
+      while (this.countdown <= 0) {
+        this.sample();
+        this.countdown += this.interval;
+      }
     }
-    return count;
   }
+  sample() {
+    var bank = this.getBank ? this.getBank(this.pc) : 0;
+    var hist = this.pcs.get(bank);
+    if (!hist) {
+      hist = new Uint32Array(0x10000);
+      this.pcs.set(bank, hist);
+    }
+    hist[this.pc & 0xffff]++;
+    this.sps[this.sp & 0xffff]++;
+    this.numSamples++;
+  }
+  addLogBuffer(src: Uint32Array) {
+    for (var i=0; i<src.length; i++) {
+      var word = src[i];
+      switch (word & 0xff000000) {
+        case ProbeFlags.EXECUTE:  this.pc = word & 0xffffff; break;
+        case ProbeFlags.CLOCKS:   this.logClocks(word & 0xffffff); break;
+      }
+    }
+  }
+  logNewScanline()  {}
+  logNewFrame()     {}
+  logInterrupt()    {}
+  logRead()         {}
+  logWrite()        {}
+  logIORead()       {}
+  logIOWrite()      {}
+  logVRAMRead()     {}
+  logVRAMWrite()    {}
+  logIllegal()      {}
+  logData()         {}
+  // Samples per symbol, counting each PC toward the nearest symbol at or below it
+  // (all banks together, since symbols are 16-bit addresses).
+  getSymbolProfile(addr2symbol:{[address:number]:string}, include?:(sym:string) => boolean) : {[sym:string]:number} {
+    var cache = this.symbolCache;
+    if (!cache || cache.addr2symbol !== addr2symbol || cache.include !== include) {
+      var addrs = Object.keys(addr2symbol).map((a) => parseInt(a))
+        .filter((a) => a >= 0 && a <= 0xffff && !(include && !include(addr2symbol[a])));
+      addrs.sort((a,b) => a-b);
+      var names = addrs.map((a) => addr2symbol[a]);
+      var index = new Int32Array(0x10000).fill(-1);
+      for (var i=0; i<addrs.length; i++)
+        index.fill(i, addrs[i], i+1 < addrs.length ? addrs[i+1] : 0x10000);
+      cache = this.symbolCache = {addr2symbol:addr2symbol, include:include, names:names, index:index};
+    }
+    var profile = {};
+    this.pcs.forEach((hist) => {
+      for (var a=0; a<0x10000; a++) {
+        var n = hist[a];
+        var si = cache.index[a];
+        if (n && si >= 0) {
+          var sym = cache.names[si];
+          profile[sym] = (profile[sym] | 0) + n;
+        }
+      }
+    });
+    return profile;
+  }
+}
 
+/// CODE COVERAGE
+
+// Marks every PC the CPU executes in a bitset, one per bank, so it can be left
+// on for a whole play session. Like the sampling probe it only hooks logExecute().
+export class CoverageProbe implements ProbeAll {
+
+  m : Probeable;
+  bits : Map<number,Uint32Array>;  // executed PCs, one bit per address
+  bank0 : Uint32Array;             // bits for bank 0, when there's no getBank
+  getBank : (address:number) => number = null;
+  cpuOnly = true;
+
+  constructor(m:Probeable) {
+    this.m = m;
+    this.reset();
+  }
+  start() {
+    this.m.connectProbe(this);
+  }
+  stop() {
+    this.m.connectProbe(null);
+  }
+  reset() {
+    this.bits = new Map();
+    this.bank0 = this.getBits(0);
+  }
+  getBits(bank:number) : Uint32Array {
+    var bits = this.bits.get(bank);
+    if (!bits) {
+      bits = new Uint32Array(0x10000 >> 5);
+      this.bits.set(bank, bits);
+    }
+    return bits;
+  }
+  logExecute(address:number, SP:number) {
+    var bits = this.getBank ? this.getBits(this.getBank(address)) : this.bank0;
+    address &= 0xffff;
+    bits[address >> 5] |= 1 << (address & 31);
+  }
+  // was address executed? (in any bank, unless one is given)
+  wasHit(address:number, bank?:number) : boolean {
+    var word = (address & 0xffff) >> 5;
+    var bit = 1 << (address & 31);
+    if (bank != null) {
+      var bits = this.bits.get(bank);
+      return bits != null && (bits[word] & bit) != 0;
+    }
+    var hit = false;
+    this.bits.forEach((bits) => { if (bits[word] & bit) hit = true; });
+    return hit;
+  }
+  // number of distinct addresses executed
+  countHits() : number {
+    var n = 0;
+    this.bits.forEach((bits) => {
+      for (var i=0; i<bits.length; i++) {
+        for (var w = bits[i]; w; w &= w-1) n++;
+      }
+    });
+    return n;
+  }
+  addLogBuffer(src: Uint32Array) {
+    for (var i=0; i<src.length; i++) {
+      var word = src[i];
+      if ((word & 0xff000000) == ProbeFlags.EXECUTE) this.logExecute(word & 0xffffff, 0);
+    }
+  }
+  logClocks()       {}
+  logNewScanline()  {}
+  logNewFrame()     {}
+  logInterrupt()    {}
+  logRead()         {}
+  logWrite()        {}
+  logIORead()       {}
+  logIOWrite()      {}
+  logVRAMRead()     {}
+  logVRAMWrite()    {}
+  logIllegal()      {}
+  logData()         {}
 }
@@ -10,6 +10,7 @@
  */
 
 import { hex, lpad, RGBA } from "../util";
+import { saveBytesInto, loadBytesFrom } from "../devices";
 import { ProbeVRAM, NullProbe } from "../devices";
 
 enum TMS9918A_Mode {
@@ -670,6 +671,64 @@ export class TMS9918A {
         this.flicker = state.flicker;
         this.redrawRequired = true;
     }
+
+    // same fields as getState(), in a fixed binary layout
+    getBinaryStateSize() : number {
+        return this.ram.length + this.registers.length + 14*4 + 6;
+    }
+
+    saveStateInto(buf:DataView, ofs:number) : number {
+        ofs = saveBytesInto(buf, ofs, this.ram);
+        ofs = saveBytesInto(buf, ofs, this.registers);
+        buf.setInt32(ofs, this.addressRegister);
+        buf.setInt32(ofs+4, this.statusRegister);
+        buf.setInt32(ofs+8, this.prefetchByte);
+        buf.setInt32(ofs+12, this.screenMode);
+        buf.setInt32(ofs+16, this.colorTable);
+        buf.setInt32(ofs+20, this.nameTable);
+        buf.setInt32(ofs+24, this.charPatternTable);
+        buf.setInt32(ofs+28, this.spriteAttributeTable);
+        buf.setInt32(ofs+32, this.spritePatternTable);
+        buf.setInt32(ofs+36, this.colorTableMask);
+        buf.setInt32(ofs+40, this.patternTableMask);
+        buf.setInt32(ofs+44, this.ramMask);
+        buf.setInt32(ofs+48, this.fgColor);
+        buf.setInt32(ofs+52, this.bgColor);
+        buf.setUint8(ofs+56, this.latch ? 1 : 0);
+        buf.setUint8(ofs+57, this.displayOn ? 1 : 0);
+        buf.setUint8(ofs+58, this.interruptsOn ? 1 : 0);
+        buf.setUint8(ofs+59, this.bitmapMode ? 1 : 0);
+        buf.setUint8(ofs+60, this.textMode ? 1 : 0);
+        buf.setUint8(ofs+61, this.flicker ? 1 : 0);
+        return ofs + 62;
+    }
+
+    loadStateFrom(buf:DataView, ofs:number) : number {
+        ofs = loadBytesFrom(buf, ofs, this.ram);
+        ofs = loadBytesFrom(buf, ofs, this.registers);
+        this.addressRegister = buf.getInt32(ofs);
+        this.statusRegister = buf.getInt32(ofs+4);
+        this.prefetchByte = buf.getInt32(ofs+8);
+        this.screenMode = buf.getInt32(ofs+12);
+        this.colorTable = buf.getInt32(ofs+16);
+        this.nameTable = buf.getInt32(ofs+20);
+        this.charPatternTable = buf.getInt32(ofs+24);
+        this.spriteAttributeTable = buf.getInt32(ofs+28);
+        this.spritePatternTable = buf.getInt32(ofs+32);
+        this.colorTableMask = buf.getInt32(ofs+36);
+        this.patternTableMask = buf.getInt32(ofs+40);
+        this.ramMask = buf.getInt32(ofs+44);
+        this.fgColor = buf.getInt32(ofs+48);
+        this.bgColor = buf.getInt32(ofs+52);
+        this.latch = buf.getUint8(ofs+56) != 0;
+        this.displayOn = buf.getUint8(ofs+57) != 0;
+        this.interruptsOn = buf.getUint8(ofs+58) != 0;
+        this.bitmapMode = buf.getUint8(ofs+59) != 0;
+        this.textMode = buf.getUint8(ofs+60) != 0;
+        this.flicker = buf.getUint8(ofs+61) != 0;
+        this.redrawRequired = true;
+        return ofs + 62;
+    }
 };
 
 export class SMSVDP extends TMS9918A {
@@ -760,6 +819,15 @@ export class SMSVDP extends TMS9918A {
         super.restoreState(state);
         this.cram.set(state.cram);
     }
+    getBinaryStateSize() : number {
+        return super.getBinaryStateSize() + this.cram.length;
+    }
+    saveStateInto(buf:DataView, ofs:number) : number {
+        return saveBytesInto(buf, super.saveStateInto(buf, ofs), this.cram);
+    }
+    loadStateFrom(buf:DataView, ofs:number) : number {
+        return loadBytesFrom(buf, super.loadStateFrom(buf, ofs), this.cram);
+    }
     drawScanline(y:number) {
         if (this.screenMode == TMS9918A_Mode.MODE4)
             this.rasterize_line(y);	// special mode 4
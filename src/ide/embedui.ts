@@ -81,6 +81,7 @@ function enableRecording() {
   stateRecorder.reset();
   stateRecorder.checkpointInterval = 60*5; // every 5 sec
   stateRecorder.maxCheckpoints = 360; // 30 minutes
+  stateRecorder.checkpointsPerTier = 360; // evenly spaced, for getReplay
   platform.setRecorder(stateRecorder);
   console.log('start recording');
 }
@@ -226,8 +227,8 @@ function receiveMessage(event) {
     else if (cmd == 'getReplay') {
       var replay = {
         frameCount: stateRecorder.frameCount,
-        checkpoints: stateRecorder.checkpoints,
-        framerecs: stateRecorder.framerecs,
+        checkpoints: stateRecorder.getCheckpoints(),
+        framerecs: stateRecorder.framerecs.slice(stateRecorder.framerecsStart),
         checkpointInterval: stateRecorder.checkpointInterval,
         maxCheckpoints: stateRecorder.maxCheckpoints,
       }
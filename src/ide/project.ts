@@ -350,6 +350,17 @@ export class CodeProject {
     }
   }
   
+  // the reverse of getListingForFile(): the project file a listing was built from
+  getFileForListing(lstfn:string) : string {
+    var fnprefix = getFilenamePrefix(lstfn);
+    for (var path in this.filedata) {
+      if (path.toLowerCase().endsWith('.h') || path.toLowerCase().endsWith('.inc'))
+        continue;
+      if (getFilenamePrefix(this.stripLocalPath(path)) == fnprefix)
+        return path;
+    }
+  }
+
   stripLocalPath(path : string) : string {
     if (this.mainPath) {
       var folder = getFolderForPath(this.mainPath);
@@ -13,6 +13,9 @@ import { createNewPersistentStore } from "./store";
 import { getFilenameForPath, getFilenamePrefix, highlightDifferences, invertMap, byteArrayToString, compressLZG, stringToByteArray,
          byteArrayToUTF8, isProbablyBinary, getWithBinary, getBasePlatform, getRootBasePlatform, hex } from "../common/util";
 import { StateRecorderImpl } from "../common/recorder";
+import { MovieWriter, StoreMovieSink, loadMovieFromStore } from "../common/movie";
+import { toLcov } from "../common/profiler";
+import { CodeAnalyzer } from "../common/analysis";
 import { GHSession, GithubService, getRepos, parseGithubURL } from "./services";
 
 // external libs (TODO)
@@ -49,11 +52,13 @@ var store;			// persistent store
 
 export var compparams;			// received build params from worker
 export var lastDebugState : EmuState;	// last debug state (object)
+export var timingResult : CodeAnalyzer;	// static timing of the last build
 
 var lastDebugInfo;		// last debug info (CPU text)
 var debugCategory;		// current debug category
 var debugTickPaused = false;
 var recorderActive = false;
+var movieStore;      // input movies of recording sessions, see _startMovie()
 var lastViewClicked = null;
 
 var lastBreakExpr = "c.PC == 0x6000";
@@ -307,12 +312,30 @@ function refreshWindowList() {
     addWindowItem("#callstack", "Call Stack", () => {
       return new Views.CallStackView();
     });
+    addWindowItem("#irqbudget", "Interrupt Budget", () => {
+      return new Views.InterruptBudgetView();
+    });
     /*
     addWindowItem("#framecalls", "Frame Profiler", () => {
       return new Views.FrameCallsView();
     });
     */
   }
+  if (platform.startSampling) {
+    addWindowItem("#sampleprofile", "Sampling Profiler", () => {
+      return new Views.ProbeSymbolView(true);
+    });
+  }
+  if (platform.startCoverage) {
+    addWindowItem("#coverage", "Code Coverage", () => {
+      return new Views.CoverageView();
+    });
+  }
+  if (platform.getTraceLog) {
+    addWindowItem("#tracelog", "Trace Log", () => {
+      return new Views.TraceLogView();
+    });
+  }
   if (platform.getDebugTree) {
     addWindowItem("#debugview", "Debug Tree", () => {
       return new Views.DebugBrowserView();
@@ -957,6 +980,54 @@ function _downloadSourceFile(e) {
   saveAs(blob, getCurrentEditorFilename(), {autoBom:false});
 }
 
+function getMovieName() : string {
+  return "movie/" + platform_id;
+}
+
+function _downloadInputMovie(e) {
+  if (!movieStore) {
+    alertError("Start replay recording first, then download the movie.");
+    return true;
+  }
+  if (stateRecorder.movie) stateRecorder.movie.flush();
+  loadMovieFromStore(movieStore, getMovieName()).then( (data) => {
+    if (!data) return;
+    var blob = new Blob([data], {type: "application/octet-stream"});
+    saveAs(blob, getFilenamePrefix(getCurrentMainFilename()) + ".8bwm");
+  });
+}
+
+function getCallStackView() : Views.CallStackView {
+  var wnd = projectWindows.id2window["#callstack"];
+  return (wnd instanceof Views.CallStackView) ? wnd : null;
+}
+
+function _downloadCallTrace(speedscope:boolean) {
+  var view = getCallStackView();
+  if (!view || !view.trace.events.length) {
+    alertError("Open the Call Stack window and run the program first, then download the profile.");
+    return true;
+  }
+  var prefix = getFilenamePrefix(getCurrentMainFilename());
+  var machine = platform['machine'];
+  var json = speedscope ? view.trace.toSpeedscope(prefix)
+                        : view.trace.toChromeTrace((machine && machine.cpuFrequency) || 1000000);
+  var blob = new Blob([JSON.stringify(json)], {type: "application/json"});
+  saveAs(blob, prefix + (speedscope ? ".speedscope.json" : ".trace.json"));
+}
+
+function _downloadCoverage() {
+  var wnd = projectWindows.id2window["#coverage"];
+  var view = (wnd instanceof Views.CoverageView) ? wnd : null;
+  if (!view || !view.probe || !view.probe.countHits()) {
+    alertError("Open the Code Coverage window and run the program first, then download the coverage.");
+    return true;
+  }
+  var prefix = getFilenamePrefix(getCurrentMainFilename());
+  var blob = new Blob([toLcov(view.getCoverage(), prefix)], {type: "text/plain"});
+  saveAs(blob, prefix + ".lcov.info");
+}
+
 function _downloadProjectZipFile(e) {
   loadScript('lib/jszip.min.js').then( () => {
     var zip = new JSZip();
@@ -1142,12 +1213,13 @@ function setCompileOutput(data: WorkerResult) {
     if (rom) {
       try {
         clearBreakpoint(); // so we can replace memory (TODO: change toolbar btn)
-        _resetRecording();
         platform.loadROM(getCurrentPresetTitle(), rom);
         current_output = rom;
+        _resetRecording(); // after current_output, which the movie saves
         if (!userPaused) _resume();
         measureBuildTime();
         writeOutputROMFile();
+        analyzeTiming();
       } catch (e) {
         console.log(e);
         toolbar.addClass("has-errors");
@@ -1364,6 +1436,18 @@ function runToCursor() {
   runToPC(getEditorPC());
 }
 
+// only goes back as far as the start of the frame, and only from a breakpoint
+function runBackToCursor() {
+  var pc = getEditorPC();
+  if (!checkRunReady() || !(pc >= 0)) return;
+  setupBreakpoint("backtoline");
+  console.log("Run back to", pc.toString(16));
+  if (!platform.runBackToPC(pc)) {
+    setDebugButtonState("pause", "stopped");
+    alertInfo("Can only run backwards after stopping at a breakpoint.");
+  }
+}
+
 function runUntilReturn() {
   if (!checkRunReady()) return;
   setupBreakpoint("stepout");
@@ -1425,6 +1509,12 @@ function getDebugExprExamples() : string {
   var cpu = state.c;
   console.log(cpu, state);
   var s = '';
+  if (platform.setExpressionBreakpoint && cpu.PC != null) {
+    s += "at $" + hex(cpu.PC) + " if hits > 10\n";
+    if (cpu.A != null) s += "A == 0 && mem[$80] > 10\n";
+    s += "trace SP, mem[$80] at $" + hex(cpu.PC) + "\n";
+    if (platform.canWatchMemory && platform.canWatchMemory()) s += "watch $80 w\n";
+  }
   if (cpu.PC) s += "c.PC == 0x" + hex(cpu.PC) + "\n";
   if (cpu.SP) s += "c.SP < 0x" + hex(cpu.SP) + "\n";
   if (cpu['HL']) s += "c.HL == 0x4000\n";
@@ -1435,7 +1525,24 @@ function getDebugExprExamples() : string {
 }
 
 function breakExpression(exprs : string) {
-  var fn = new Function('c', 'return (' + exprs + ');').bind(platform);
+  // compiled conditions and tracepoints, or else a JS expression on the CPU state
+  var compileError = null;
+  if (platform.setExpressionBreakpoint) {
+    try {
+      setupBreakpoint();
+      platform.setExpressionBreakpoint('debug', exprs);
+      lastBreakExpr = exprs;
+      return;
+    } catch (e) {
+      compileError = e;
+    }
+  }
+  try {
+    var fn = new Function('c', 'return (' + exprs + ');').bind(platform);
+  } catch (e) {
+    alertError((compileError || e).message);
+    return;
+  }
   setupBreakpoint();
   platform.runEval(fn as DebugEvalCondition);
   lastBreakExpr = exprs;
@@ -1550,18 +1657,44 @@ function _fastestFrameRate() {
   setFrameRateUI(60);
 }
 
+// after each build, so the editors can show clocks for every line
+function analyzeTiming() {
+  if (platform.newCodeAnalyzer) {
+    var analyzer = platform.newCodeAnalyzer();
+    analyzer.analyzeProgram();
+    timingResult = analyzer;
+  }
+}
+
+// again, in case the code in memory has changed (e.g. bank switching)
 function traceTiming() {
+  analyzeTiming();
   projectWindows.refresh(false);
-  var wnd = projectWindows.getActive();
-  if (wnd.getSourceFile && wnd.setTimingResult) { // is editor active?
-    var analyzer = platform.newCodeAnalyzer();
-    analyzer.showLoopTimingForPC(0);
-    wnd.setTimingResult(analyzer);
+}
+
+// streams the recording into IndexedDB as it goes, one movie per platform
+function _startMovie() {
+  if (stateRecorder.movie) stateRecorder.movie.close();
+  if (!movieStore) movieStore = createNewPersistentStore("movies");
+  var rom = current_output instanceof Uint8Array ? current_output : null;
+  var sink = new StoreMovieSink(movieStore, getMovieName());
+  sink.onerror = (e) => {
+    if (stateRecorder.movie && stateRecorder.movie.sink === sink) _stopMovie();
+    alertError("Could not save the input movie: " + e);
+  };
+  stateRecorder.movie = new MovieWriter(sink, {platform:platform_id, title:getCurrentMainFilename()}, rom);
+}
+
+function _stopMovie() {
+  if (stateRecorder.movie) {
+    stateRecorder.movie.close();
+    stateRecorder.movie = null;
   }
 }
 
 function _disableRecording() {
   if (recorderActive) {
+    _stopMovie();
     platform.setRecorder(null);
     $("#dbg_record").removeClass("btn_recording");
     $("#replaydiv").hide();
@@ -1572,11 +1705,13 @@ function _disableRecording() {
 function _resetRecording() {
   if (recorderActive) {
     stateRecorder.reset();
+    _startMovie();
   }
 }
 
 function _enableRecording() {
   stateRecorder.reset();
+  _startMovie();
   platform.setRecorder(stateRecorder);
   $("#dbg_record").addClass("btn_recording");
   $("#replaydiv").show();
@@ -1685,6 +1820,9 @@ function setupDebugControls() {
   if ((platform.runEval || platform.runToPC) && !platform_id.startsWith('verilog')) {
     uitoolbar.add('ctrl+alt+l', 'Run To Line', 'glyphicon-save', runToCursor).prop('id','dbg_toline');
   }
+  if (platform.runBackToPC) {
+    uitoolbar.add('ctrl+alt+k', 'Run Back To Line', 'glyphicon-open', runBackToCursor).prop('id','dbg_backtoline');
+  }
   uitoolbar.newGroup();
   // add menu clicks
   $(".dropdown-menu").collapse({toggle: false});
@@ -1709,6 +1847,10 @@ function setupDebugControls() {
   $("#item_download_file").click(_downloadSourceFile);
   $("#item_download_zip").click(_downloadProjectZipFile);
   $("#item_download_allzip").click(_downloadAllFilesZipFile);
+  $("#item_download_movie").click(_downloadInputMovie);
+  $("#item_download_trace").click(() => _downloadCallTrace(false));
+  $("#item_download_speedscope").click(() => _downloadCallTrace(true));
+  $("#item_download_coverage").click(_downloadCoverage);
   $("#item_record_video").click(_recordVideo);
   if (platform_id.startsWith('apple2') || platform_id.startsWith('vcs')) // TODO: look for function
     $("#item_export_cassette").click(_downloadCassetteFile);
@@ -1785,6 +1927,11 @@ function setupReplaySlider() {
     };
     replayslider.on('input', sliderChanged);
     clockslider.on('input', sliderChanged);
+    // get the frame under the mouse ready in idle time, in case we seek there
+    replayslider.on('mousemove', (e) => {
+      var frac = e.offsetX / replayslider.width();
+      stateRecorder.prefetchFrame(Math.round(frac * stateRecorder.numFrames()));
+    });
     //replayslider.on('change', sliderChanged);
     $("#replay_min").click(() => { setFrameTo(1) });
     $("#replay_max").click(() => { setFrameTo(stateRecorder.numFrames()); });
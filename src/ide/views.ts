@@ -1,11 +1,13 @@
 
 //import CodeMirror = require("codemirror");
-import { SourceFile, WorkerError, Segment, FileData, SourceLocation, SourceLine } from "../common/workertypes";
+import { SourceFile, WorkerError, Segment, FileData, SourceLocation, SourceLine, CodeListingMap } from "../common/workertypes";
 import { Platform, EmuState, lookupSymbol, BaseDebugPlatform, BaseZ80MachinePlatform, BaseZ80Platform, CpuState } from "../common/baseplatform";
 import { hex, lpad, rpad, safeident, rgb2bgr } from "../common/util";
 import { CodeAnalyzer } from "../common/analysis";
-import { platform, platform_id, compparams, current_project, lastDebugState, projectWindows, runToPC } from "./ui";
-import { ProbeRecorder, ProbeFlags } from "../common/recorder";
+import { platform, platform_id, compparams, current_project, lastDebugState, projectWindows, runToPC, timingResult } from "./ui";
+import { ProbeRecorder, ProbeFlags, ProbeEventCallback, SamplingProbe, CoverageProbe } from "../common/recorder";
+import { CallTraceLog, InterruptBudgetAnalyzer, INTERRUPT_REPORT_HEADER, MAX_INTERRUPT_RUNS } from "../common/profiler";
+import { FileCoverage, getListingCoverage } from "../common/profiler";
 import { getMousePos, dumpRAM, Toolbar } from "../common/emu";
 import * as pixed from "./pixeleditor";
 declare var Mousetrap;
@@ -25,6 +27,7 @@ export interface ProjectView {
   markErrors?(errors:WorkerError[]) : void;
   clearErrors?() : void;
   setTimingResult?(result:CodeAnalyzer) : void;
+  setCoverage?(coverage:FileCoverage) : void;
   recreateOnResize? : boolean;
   undoStep?() : void;
 };
@@ -94,6 +97,8 @@ export class SourceEditor implements ProjectView {
   errorwidgets = [];
   errormarks = [];
   inspectWidget;
+  coverageLines : {[line:number]:string} = {}; // line -> coverage class
+  timing : CodeAnalyzer; // last timing result shown
 
   createDiv(parent:HTMLElement) {
     var div = document.createElement('div');
@@ -118,6 +123,7 @@ export class SourceEditor implements ProjectView {
     var lineNums = !modedef.noLineNumbers;
     var gutters = ["CodeMirror-linenumbers", "gutter-offset", "gutter-info"];
     if (isAsm) gutters = ["CodeMirror-linenumbers", "gutter-offset", "gutter-bytes", "gutter-clock", "gutter-info"];
+    if (platform.newCodeAnalyzer) gutters.splice(gutters.length-1, 0, "gutter-timing");
     if (modedef.noGutters) gutters = ["gutter-info"];
     this.editor = CodeMirror(parent, {
       theme: theme,
@@ -321,12 +327,14 @@ export class SourceEditor implements ProjectView {
     this.setGutter("gutter-bytes", line-1, s);
   }
 
+  // min-max clocks at each line, from the analysis of the whole program
   setTimingResult(result:CodeAnalyzer) : void {
-    this.editor.clearGutter("gutter-bytes");
-    if (this.sourcefile == null) return;
+    this.editor.clearGutter("gutter-timing");
+    this.timing = result;
+    if (this.sourcefile == null || result == null) return;
     // show the lines
     for (const line of Object.keys(this.sourcefile.line2offset)) {
-      var pc = this.sourcefile.line2offset[line];
+      var pc = this.sourcefile.line2offset[line] & 0xffff;
       var minclocks = result.pc2minclocks[pc];
       var maxclocks = result.pc2maxclocks[pc];
       if (minclocks>=0 && maxclocks>=0) {
@@ -337,11 +345,30 @@ export class SourceEditor implements ProjectView {
           s = minclocks + "-" + maxclocks;
         if (maxclocks == result.MAX_CLOCKS)
           s += "+";
-        this.setGutterBytes(parseInt(line), s);
+        this.setGutter("gutter-timing", parseInt(line)-1, s);
       }
     }
   }
 
+  // highlights lines as hit or never hit, or clears them if coverage is null
+  setCoverage(coverage:FileCoverage) : void {
+    var classes = {};
+    if (coverage) {
+      for (var lc of coverage.lines) classes[lc.line-1] = lc.hit ? 'coverage-hit' : 'coverage-miss';
+    }
+    this.editor.operation(() => {
+      for (var line in this.coverageLines) {
+        if (classes[line] != this.coverageLines[line])
+          this.editor.removeLineClass(parseInt(line), "background", this.coverageLines[line]);
+      }
+      for (var line in classes) {
+        if (classes[line] != this.coverageLines[line])
+          this.editor.addLineClass(parseInt(line), "background", classes[line]);
+      }
+    });
+    this.coverageLines = classes;
+  }
+
   setCurrentLine(line:SourceLocation, moveCursor:boolean) {
     var blocked = platform.isBlocked && platform.isBlocked();
 
@@ -411,9 +438,15 @@ export class SourceEditor implements ProjectView {
       this.sourcefile = lst.sourcefile;
       this.dirtylisting = true;
     }
-    if (!this.sourcefile || !this.dirtylisting) return;
-    this.updateListing();
-    this.dirtylisting = false;
+    if (!this.sourcefile) return;
+    if (this.dirtylisting) {
+      this.updateListing();
+      this.dirtylisting = false;
+      this.timing = null;
+    }
+    if (timingResult !== this.timing && platform.newCodeAnalyzer) {
+      this.setTimingResult(timingResult);
+    }
   }
 
   refresh(moveCursor: boolean) {
@@ -680,6 +713,10 @@ function ignoreSymbol(sym:string) {
   || sym.startsWith('l__') || sym.startsWith('s__') || sym.startsWith('.__.');
 }
 
+function includeSymbol(sym:string) {
+  return !ignoreSymbol(sym);
+}
+
 // TODO: make it use debug state
 // TODO: make it safe (load/restore state?)
 // TODO: refactor w/ VirtualTextLine
@@ -973,6 +1010,7 @@ abstract class ProbeViewBaseBase {
   probe : ProbeRecorder;
   tooldiv : HTMLElement;
   cumulativeData : boolean = false;
+  framesBack : number = 0; // which of the recorded frames to show, while paused
 
   abstract tick() : void;
 
@@ -1014,26 +1052,13 @@ abstract class ProbeViewBaseBase {
     }
   }
 
-  redraw( eventfn:(op,addr,col,row,clk,value) => void ) {
+  // returns the number of clocks covered
+  redraw( eventfn:ProbeEventCallback ) : number {
     var p = this.probe;
-    if (!p || !p.idx) return; // if no probe, or if empty
-    var row=0;
-    var col=0;
-    var clk=0;
-    for (var i=0; i<p.idx; i++) {
-      var word = p.buf[i];
-      var addr = word & 0xffff;
-      var value = (word >> 16) & 0xff;
-      var op = word & 0xff000000;
-      switch (op) {
-        case ProbeFlags.SCANLINE:	row++; col=0; break;
-        case ProbeFlags.FRAME:		row=0; col=0; break;
-        case ProbeFlags.CLOCKS:		col += addr; clk += addr; break;
-        default:
-          eventfn(op, addr, col, row, clk, value);
-          break;
-      }
-    }
+    if (!p || !p.idx) return 0; // if no probe, or if empty
+    if (platform.isRunning()) this.framesBack = 0;
+    var [start,end] = p.getVisibleRange(this.framesBack);
+    return p.forEachEvent(start, end, eventfn);
   }
 
   opToString(op:number, addr?:number, value?:number) {
@@ -1100,6 +1125,16 @@ abstract class ProbeViewBase extends ProbeViewBaseBase {
     canvas.onmouseout = (e) => {
       $(this.tooldiv).hide();
     }
+    // scroll wheel steps through earlier frames while paused
+    canvas.onwheel = (e) => {
+      if (!this.probe || platform.isRunning()) return;
+      var n = this.framesBack + (e.deltaY > 0 ? 1 : -1);
+      if (n >= 0 && this.probe.getFrameStart(this.probe.numFrames - 1 - n) >= 0) {
+        this.framesBack = n;
+        this.tick();
+      }
+      e.preventDefault();
+    }
     parent.appendChild(div);
     div.appendChild(canvas);
     this.canvas = canvas;
@@ -1318,6 +1353,13 @@ export class ProbeSymbolView extends ProbeViewBaseBase {
   recreateOnResize = true;
   dumplines;
   cumulativeData = true;
+  sampling : boolean; // flat profile from the sampling probe, instead of reads/writes
+  sampler : SamplingProbe;
+
+  constructor(sampling? : boolean) {
+    super();
+    this.sampling = !!sampling;
+  }
 
   // TODO: auto resize
   createDiv(parent : HTMLElement) {
@@ -1333,6 +1375,7 @@ export class ProbeSymbolView extends ProbeViewBaseBase {
   }
 
   getMemoryLineAt(row : number) : VirtualTextLine {
+    if (this.sampling) return this.getSampleLineAt(row);
     // header line
     if (row == 0) {
       return {text: lpad("Symbol",35)+lpad("Reads",8)+lpad("Writes",8)};
@@ -1366,7 +1409,39 @@ export class ProbeSymbolView extends ProbeViewBaseBase {
     this.tick();
   }
 
+  getSampleLineAt(row : number) : VirtualTextLine {
+    if (row == 0) {
+      return {text: lpad("Symbol",35)+lpad("Samples",10)+lpad("%",8)};
+    }
+    var sym = this.keys[row-1];
+    var n = (this.dumplines && this.dumplines[sym]) | 0;
+    var total = this.sampler ? this.sampler.numSamples : 0;
+    if (n && total) {
+      var pct = (n * 100 / total).toFixed(1);
+      return {text: lpad(sym, 35) + lpad(n.toString(), 10) + lpad(pct, 8), clas:'seg_code'};
+    } else {
+      return {text: lpad(sym, 35), clas:'seg_unknown'};
+    }
+  }
+
+  setVisible(showing : boolean) : void {
+    if (!this.sampling) {
+      super.setVisible(showing);
+    } else if (showing) {
+      this.sampler = platform.startSampling();
+      this.sampler.reset();
+      this.tick();
+    } else {
+      platform.stopSampling();
+      this.sampler = null;
+    }
+  }
+
   tick() {
+    if (this.sampling) {
+      this.tickSamples();
+      return;
+    }
     // cache each line in frame
     this.dumplines = {};
     this.redraw((op,addr,col,row,clk,value) => {
@@ -1383,6 +1458,179 @@ export class ProbeSymbolView extends ProbeViewBaseBase {
     this.vlist.refresh();
     if (this.probe) this.probe.clear(); // clear cumulative data (TODO: doesnt work with seeking or debugging)
   }
+
+  // samples keep adding up while the view is open, busiest symbols first
+  tickSamples() {
+    if (!this.sampler || !platform.debugSymbols) return;
+    this.dumplines = this.sampler.getSymbolProfile(platform.debugSymbols.addr2symbol, includeSymbol);
+    this.keys.sort((a,b) => ((this.dumplines[b]|0) - (this.dumplines[a]|0)) || (a < b ? -1 : a > b ? 1 : 0));
+    this.vlist.refresh();
+  }
+}
+
+///
+
+// lines logged by tracepoints (see debugexpr.ts), newest last
+export class TraceLogView implements ProjectView {
+  vlist : VirtualTextScroller;
+  recreateOnResize = true;
+  numLines : number = -1;
+
+  createDiv(parent : HTMLElement) {
+    this.vlist = new VirtualTextScroller(parent);
+    this.vlist.create(parent, 1000, this.getLineAt.bind(this));
+    return this.vlist.maindiv;
+  }
+  getLineAt(row : number) : VirtualTextLine {
+    var log = platform.getTraceLog();
+    return {text:log[row] || "", clas:'seg_code'};
+  }
+  refresh() {
+    this.vlist.refresh();
+  }
+  tick() {
+    var log = platform.getTraceLog();
+    if (log.length != this.numLines || log.length >= 1000) {
+      this.numLines = log.length;
+      this.vlist.refresh();
+    }
+  }
+}
+
+///
+
+// how long each interrupt handler ran, newest first, flagging the ones that
+// started in vblank but were still running once the visible scanlines began
+export class InterruptBudgetView extends ProbeViewBaseBase {
+  vlist : VirtualTextScroller;
+  recreateOnResize = true;
+  cumulativeData = true;
+  analyzer : InterruptBudgetAnalyzer;
+
+  createDiv(parent : HTMLElement) {
+    this.vlist = new VirtualTextScroller(parent);
+    this.vlist.create(parent, MAX_INTERRUPT_RUNS + 2, this.getLineAt.bind(this));
+    return this.vlist.maindiv;
+  }
+
+  newAnalyzer() : InterruptBudgetAnalyzer {
+    var m = platform['machine'] || {};
+    var firstVisible = m.firstVisibleScanline || 0;
+    var numVisible = m.numVisibleScanlines || (m.getVideoParams && m.getVideoParams().height) || 0;
+    return new InterruptBudgetAnalyzer(firstVisible, numVisible);
+  }
+
+  getLineAt(row : number) : VirtualTextLine {
+    var a = this.analyzer;
+    if (!a) return {text:""};
+    if (row == 0) return {text:a.getSummary(), clas:a.getSpilledFrames().length ? 'seg_io' : 'seg_code'};
+    if (row == 1) return {text:INTERRUPT_REPORT_HEADER};
+    var run = a.runs[a.runs.length - row + 1];
+    if (!run) return {text:""};
+    return {text:a.formatRun(run), clas:run.spillCycles ? 'seg_io' : 'seg_data'};
+  }
+
+  refresh() {
+    this.tick();
+  }
+
+  setVisible(showing : boolean) : void {
+    this.analyzer = null;
+    super.setVisible(showing);
+  }
+
+  tick() {
+    if (!this.probe) return;
+    // start over if the probe was cleared
+    if (!this.analyzer || this.probe.numFrames < this.analyzer.nextFrame) {
+      this.analyzer = this.newAnalyzer();
+    }
+    this.analyzer.addFrames(this.probe);
+    this.vlist.refresh();
+  }
+}
+
+///
+
+const COVERAGE_UPDATE_MSEC = 1000;
+
+// which listing lines have executed since the view was first opened, which
+// are also highlighted in the source editors; the bits are kept when it's
+// closed, and collection picks up again when it's reopened (until a rebuild)
+export class CoverageView implements ProjectView {
+  vlist : VirtualTextScroller;
+  recreateOnResize = true;
+  probe : CoverageProbe;
+  listings : CodeListingMap;
+  coverage : FileCoverage[] = [];
+  lines : VirtualTextLine[] = [];
+  lastUpdate : number = 0;
+
+  createDiv(parent : HTMLElement) {
+    this.vlist = new VirtualTextScroller(parent);
+    this.vlist.create(parent, 10000, this.getLineAt.bind(this));
+    return this.vlist.maindiv;
+  }
+
+  getLineAt(row : number) : VirtualTextLine {
+    return this.lines[row] || {text:""};
+  }
+
+  getCoverage() : FileCoverage[] {
+    var probe = this.probe;
+    var listings = current_project.getListings();
+    if (!probe || !listings) return [];
+    // addresses are meaningless after a rebuild
+    if (listings !== this.listings) {
+      if (this.listings) probe.reset();
+      this.listings = listings;
+    }
+    return getListingCoverage(listings, (a) => probe.wasHit(a), (lstfn) => current_project.getFileForListing(lstfn));
+  }
+
+  update() {
+    this.coverage = this.getCoverage();
+    var lines = [];
+    var hilite = {};
+    for (var file of this.coverage) {
+      var pct = (file.numHit * 100 / file.lines.length).toFixed(1);
+      lines.push({text:file.path + ": " + file.numHit + " of " + file.lines.length + " lines hit (" + pct + "%)",
+        clas:file.numHit == file.lines.length ? 'seg_code' : 'seg_data'});
+      for (var lc of file.lines) {
+        if (!lc.hit) lines.push({text:"  never hit: line " + lc.line + " $" + hex(lc.offset & 0xffff, 4), clas:'seg_unknown'});
+      }
+      hilite[current_project.filename2path[file.path] || file.path] = file;
+    }
+    this.lines = lines;
+    this.highlight(hilite);
+    this.vlist.refresh();
+    this.lastUpdate = Date.now();
+  }
+
+  highlight(hilite : {[path:string]:FileCoverage}) {
+    for (var id in projectWindows.id2window) {
+      var wnd = projectWindows.id2window[id];
+      if (wnd.setCoverage) wnd.setCoverage(hilite[id] || null);
+    }
+  }
+
+  refresh() {
+    this.update();
+  }
+
+  setVisible(showing : boolean) : void {
+    if (showing) {
+      this.probe = platform.startCoverage();
+      this.update();
+    } else {
+      platform.stopCoverage();
+      this.highlight({});
+    }
+  }
+
+  tick() {
+    if (Date.now() - this.lastUpdate >= COVERAGE_UPDATE_MSEC) this.update();
+  }
 }
 
 ///
@@ -1583,7 +1831,10 @@ export class DebugBrowserView extends TreeViewBase implements ProjectView {
 interface CallGraphNode {
   $$SP : number;
   $$PC : number;
+  $$Name : string;
   count : number;
+  cycles : number;      // inclusive
+  selfCycles : number;  // exclusive
   startLine : number;
   endLine : number;
   calls : {[id:string] : CallGraphNode};
@@ -1599,6 +1850,8 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
   jsr : boolean;
   rts : boolean;
   cumulativeData = true;
+  clock : number;       // clocks seen since the view was cleared
+  trace : CallTraceLog = new CallTraceLog();
 
   createDiv(parent : HTMLElement) : HTMLElement {
     this.clear();
@@ -1617,6 +1870,8 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
 
   clear() {
     this.graph = null;
+    this.clock = 0;
+    this.trace.reset();
     this.reset();
   }
 
@@ -1628,8 +1883,21 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
     this.rts = false;
   }
 
-  newNode(pc : number, sp : number) {
-    return {$$SP:sp, $$PC:pc, count:0, startLine:null, endLine:null, calls:{}};
+  newNode(pc : number, sp : number) : CallGraphNode {
+    var name = pc == null ? null : (this.addr2symbol(pc) || '$' + hex(pc));
+    return {$$SP:sp, $$PC:pc, $$Name:name, count:0, cycles:0, selfCycles:0, startLine:null, endLine:null, calls:{}};
+  }
+
+  // the routine on top of the stack gets the clocks since the last event
+  addCycles(clock : number) {
+    if (this.stack.length) this.stack[this.stack.length-1].selfCycles += clock - this.clock;
+    this.clock = clock;
+  }
+
+  sumCycles(node : CallGraphNode) : number {
+    var cycles = node.selfCycles;
+    for (var id in node.calls) cycles += this.sumCycles(node.calls[id]);
+    return node.cycles = cycles;
   }
 
   newRoot(pc : number, sp : number) {
@@ -1645,7 +1913,9 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
 
   getRootObject() : Object {
     // TODO: we don't capture every frame, so if we don't start @ the top frame we may have problems
-    this.redraw((op,addr,col,row,clk,value) => {
+    var base = this.clock;
+    var clocks = this.redraw((op,addr,col,row,clk,value) => {
+      this.addCycles(base + clk);
       switch (op) {
         case ProbeFlags.SP_POP:
           this.newRoot(this.lastpc, this.lastsp);
@@ -1677,10 +1947,13 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
               this.stack.push(child);
               child.count++;
               child.startLine = row;
+              this.trace.enter(child.$$Name, this.clock);
             }
             this.jsr = false;
             if (this.rts && this.stack.length) {
-              this.stack.pop().endLine = row;
+              let node = this.stack.pop();
+              node.endLine = row;
+              this.trace.exit(node.$$Name, this.clock);
             }
             this.rts = false;
           }
@@ -1688,7 +1961,11 @@ export class CallStackView extends ProbeViewBaseBase implements ProjectView {
           break;
       }
     });
-    if (this.graph) this.graph['$$Stack'] = this.stack;
+    this.addCycles(base + clocks);
+    if (this.graph) {
+      this.sumCycles(this.graph);
+      this.graph['$$Stack'] = this.stack;
+    }
     return TREE_SHOW_DOLLAR_IDENTS ? this.graph : this.graph && this.graph.calls;
   }
 }
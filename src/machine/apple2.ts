@@ -1,6 +1,7 @@
 
-import { MOS6502, MOS6502State } from "../common/cpu/MOS6502";
-import { Bus, BasicScanlineMachine, xorshift32, SavesState } from "../common/devices";
+import { MOS6502State } from "../common/cpu/MOS6502";
+import { MOS6502JIT } from "../common/cpu/MOS6502JIT";
+import { Bus, BasicScanlineMachine, xorshift32, SavesState, SavesBinaryState, saveBytesInto, loadBytesFrom, checkStateTag } from "../common/devices";
 import { KeyFlags } from "../common/emu"; // TODO
 import { hex, lzgmini, stringToByteArray, RGBA, printFlags } from "../common/util";
 
@@ -44,10 +45,11 @@ export class AppleII extends BasicScanlineMachine {
   numVisibleScanlines = 192;
   numTotalScanlines = 262;
   defaultROMSize = 0xbf00-0x803; // TODO
+  binaryStateTag = 0x41503201; // 'AP2' v1
 
   ram = new Uint8Array(0x13000); // 64K + 16K LC RAM - 4K hardware + 12K ROM
   bios : Uint8Array;
-  cpu = new MOS6502();
+  cpu = new MOS6502JIT();
   grdirty = new Array(0xc000 >> 7);
   grparams = {dirty:this.grdirty, grswitch:GR_TXMODE, mem:this.ram};
   ap2disp;
@@ -70,8 +72,10 @@ export class AppleII extends BasicScanlineMachine {
         // JMP VM_BASE
         case 0: {
           // load program into RAM
-          if (this.rom)
+          if (this.rom) {
             this.ram.set(this.rom.slice(HDR_SIZE), PGM_BASE);
+            this.cpu.invalidate(PGM_BASE, PGM_BASE + this.rom.length);
+          }
           return 0x4c;
         }
         case 1: return VM_BASE&0xff;
@@ -94,6 +98,8 @@ export class AppleII extends BasicScanlineMachine {
     this.ram[0xbf00] = 0x4c; // fake DOS detect for C
     this.ram[0xbf6f] = 0x01; // fake DOS detect for C
     this.connectCPUMemoryBus(this);
+    this.cpu.setRAMRange(0x0000, 0xbfff, this.ram);
+    this.cpu.setIORange(0xc000, 0xcfff);
   }
   saveState() : AppleIIState {
     // TODO: automagic
@@ -125,6 +131,54 @@ export class AppleII extends BasicScanlineMachine {
           this.slots[i]['loadState'](s.slots[i]);
     this.ap2disp.invalidate(); // repaint entire screen
   }
+  // 0 (unsupported) if a card can only save its state as an object
+  getBinaryStateSize() : number {
+    var size = 4 + this.cpu.getBinaryStateSize() + this.ram.length + 18;
+    for (var i=0; i<this.slots.length; i++) {
+      var slot = this.slots[i] as any;
+      if (slot && slot.saveState) {
+        if (!slot.getBinaryStateSize) return 0;
+        size += slot.getBinaryStateSize();
+      }
+    }
+    return size;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    buf.setUint32(ofs, this.binaryStateTag);
+    ofs = this.cpu.saveStateInto(buf, ofs + 4);
+    ofs = saveBytesInto(buf, ofs, this.ram);
+    buf.setInt32(ofs, this.kbdlatch);
+    buf.setInt32(ofs+4, this.soundstate);
+    buf.setInt32(ofs+8, this.grparams.grswitch);
+    buf.setInt32(ofs+12, this.auxRAMbank);
+    buf.setUint8(ofs+16, this.auxRAMselected ? 1 : 0);
+    buf.setUint8(ofs+17, this.writeinhibit ? 1 : 0);
+    ofs += 18;
+    for (var i=0; i<this.slots.length; i++) {
+      var slot = this.slots[i] as any;
+      if (slot && slot.saveState) ofs = slot.saveStateInto(buf, ofs);
+    }
+    return ofs;
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = checkStateTag(buf, ofs, this.binaryStateTag);
+    ofs = this.cpu.loadStateFrom(buf, ofs);
+    ofs = loadBytesFrom(buf, ofs, this.ram);
+    this.kbdlatch = buf.getInt32(ofs);
+    this.soundstate = buf.getInt32(ofs+4);
+    this.grparams.grswitch = buf.getInt32(ofs+8);
+    this.auxRAMbank = buf.getInt32(ofs+12);
+    this.auxRAMselected = buf.getUint8(ofs+16) != 0;
+    this.writeinhibit = buf.getUint8(ofs+17) != 0;
+    ofs += 18;
+    this.setupLanguageCardConstants();
+    for (var i=0; i<this.slots.length; i++) {
+      var slot = this.slots[i] as any;
+      if (slot && slot.loadState) ofs = slot.loadStateFrom(buf, ofs);
+    }
+    this.ap2disp.invalidate(); // repaint entire screen
+    return ofs;
+  }
   saveControlsState() : AppleIIControlsState {
     return {inputs:null,kbdlatch:this.kbdlatch};
   }
@@ -150,12 +204,12 @@ export class AppleII extends BasicScanlineMachine {
   skipboot() {
     // execute until $c600 boot
     for (var i=0; i<2000000; i++) {
-      this.cpu.advanceClock();
+      this.cpu.advanceInsn();
       if ((this.cpu.getPC()>>8) == 0xc6) break;
     }
     // get out of $c600 boot
     for (var i=0; i<2000000; i++) {
-      this.cpu.advanceClock();
+      this.cpu.advanceInsn();
       if ((this.cpu.getPC()>>8) < 0xc6) break;
     }
   }
@@ -272,13 +326,16 @@ export class AppleII extends BasicScanlineMachine {
     // TODO: draw scanline via ap2disp
   }
   advanceFrame(trap) : number {
+    // translated code can't stop at a breakpoint or report each instruction to a probe
+    this.cpu.jitEnabled = !trap && this.probe === this.nullProbe;
     var clocks = super.advanceFrame(trap);
     this.ap2disp && this.ap2disp.updateScreen();
     return clocks;
   }
   advanceCPU() {
-    this.audio.feedSample(this.soundstate, 1);
-    return super.advanceCPU();
+    var n = super.advanceCPU();
+    this.audio.feedSample(this.soundstate, n);
+    return n;
   }
 
   setKeyInput(key:number, code:number, flags:number) : void {
@@ -310,6 +367,7 @@ export class AppleII extends BasicScanlineMachine {
   }
   
   doLanguageCardIO(address:number) {
+     var oldrdoffset = this.auxRAMselected ? this.bank2rdoffset : -1;
      switch (address & 0x0f) {
          // Select aux RAM bank 2, write protected.
         case 0x0:
@@ -363,6 +421,9 @@ export class AppleII extends BasicScanlineMachine {
            break;
      }
      this.setupLanguageCardConstants();
+     // different code is visible at $D000-$FFFF now
+     if ((this.auxRAMselected ? this.bank2rdoffset : -1) != oldrdoffset)
+        this.cpu.invalidate(0xd000, 0xffff);
      return this.floatbus();
   }
 
@@ -1052,17 +1113,26 @@ class DiskIIState {
     track_index : number = 0;
 }
 
-class DiskII extends DiskIIState implements SlotDevice, SavesState<DiskIIState> {
+class DiskII extends DiskIIState implements SlotDevice, SavesState<DiskIIState>, SavesBinaryState {
     emu : AppleII;
     track_data : Uint8Array;
+    // Snapshots share track buffers: shared[i] is the copy of track i last handed
+    // out (or loaded) by saveState()/loadState(), and is never modified afterwards.
+    // dirty[i] is set when track i has been written since then.
+    shared : Uint8Array[];
+    dirty : boolean[];
     
     constructor(emu : AppleII, image : Uint8Array) {
         super();
         this.emu = emu;
         this.data = new Array(NUM_TRACKS);
+        this.shared = new Array(NUM_TRACKS);
+        this.dirty = new Array(NUM_TRACKS);
         for (var i=0; i<NUM_TRACKS; i++) {
            var ofs = i*16*256;
            this.data[i] = nibblizeTrack(254, i, image.slice(ofs, ofs+16*256));
+           this.shared[i] = null;
+           this.dirty[i] = false;
         }
     }
     
@@ -1075,14 +1145,24 @@ class DiskII extends DiskIIState implements SlotDevice, SavesState<DiskIIState>
           motor: this.motor,
           track_index: this.track_index
        };
-       for (var i=0; i<NUM_TRACKS; i++)
-          s.data[i] = this.data[i].slice(0);
+       for (var i=0; i<NUM_TRACKS; i++) {
+          if (this.dirty[i] || !this.shared[i]) {
+             this.shared[i] = this.data[i].slice(0);
+             this.dirty[i] = false;
+          }
+          s.data[i] = this.shared[i];
+       }
        return s;
     }
     
     loadState(s: DiskIIState) {
-       for (var i=0; i<NUM_TRACKS; i++)
-          this.data[i].set(s.data[i]);
+       for (var i=0; i<NUM_TRACKS; i++) {
+          if (this.dirty[i] || s.data[i] !== this.shared[i]) {
+             this.data[i].set(s.data[i]);
+             this.shared[i] = s.data[i];
+             this.dirty[i] = false;
+          }
+       }
        this.track = s.track;
        this.read_mode = s.read_mode;
        this.write_protect = s.write_protect;
@@ -1093,6 +1173,41 @@ class DiskII extends DiskIIState implements SlotDevice, SavesState<DiskIIState>
        else
           this.track_data = null;
     }
+
+    getBinaryStateSize() : number {
+       var size = 11;
+       for (var i=0; i<NUM_TRACKS; i++)
+          size += this.data[i].length;
+       return size;
+    }
+
+    saveStateInto(buf:DataView, ofs:number) : number {
+       for (var i=0; i<NUM_TRACKS; i++)
+          ofs = saveBytesInto(buf, ofs, this.data[i]);
+       buf.setInt32(ofs, this.track_index);
+       buf.setInt32(ofs+4, this.track);
+       buf.setUint8(ofs+8, this.read_mode ? 1 : 0);
+       buf.setUint8(ofs+9, this.write_protect ? 1 : 0);
+       buf.setUint8(ofs+10, this.motor ? 1 : 0);
+       return ofs + 11;
+    }
+
+    loadStateFrom(buf:DataView, ofs:number) : number {
+       for (var i=0; i<NUM_TRACKS; i++) {
+          ofs = loadBytesFrom(buf, ofs, this.data[i]);
+          this.dirty[i] = true;
+       }
+       this.track_index = buf.getInt32(ofs);
+       this.track = buf.getInt32(ofs+4);
+       this.read_mode = buf.getUint8(ofs+8) != 0;
+       this.write_protect = buf.getUint8(ofs+9) != 0;
+       this.motor = buf.getUint8(ofs+10) != 0;
+       if ((this.track & 1) == 0)
+          this.track_data = this.data[this.track>>1];
+       else
+          this.track_data = null;
+       return ofs + 11;
+    }
     
     toLongString() {
        return "Track:  " + (this.track / 2) +
@@ -1113,8 +1228,10 @@ class DiskII extends DiskIIState implements SlotDevice, SavesState<DiskIIState>
 
    write_latch(value: number) {
       this.track_index = (this.track_index + 1) % TRACK_SIZE;
-      if (this.track_data != null)
+      if (this.track_data != null) {
          this.track_data[this.track_index] = value;
+         this.dirty[this.track>>1] = true;
+      }
    }
    
    readROM(address)      { return DISKII_PROM[address]; }
@@ -1,5 +1,5 @@
 
-import { MOS6502, MOS6502State } from "../common/cpu/MOS6502";
+import { MOS6502Fast, MOS6502State } from "../common/cpu/MOS6502";
 import { BasicMachine, RasterFrameBased, Bus, ProbeAll } from "../common/devices";
 import { KeyFlags, newAddressDecoder, padBytes, Keys, makeKeycodeMap, newKeyboardHandler, EmuHalt, dumpRAM } from "../common/emu";
 import { TssChannelAdapter, MasterAudio, POKEYDeviceChannel } from "../common/audio";
@@ -309,7 +309,7 @@ export class Atari7800 extends BasicMachine implements RasterFrameBased {
   cpuCyclesPerLine = 113.5;
   sampleRate = audioSampleRate;
 
-  cpu : MOS6502;
+  cpu : MOS6502Fast;
   ram : Uint8Array = new Uint8Array(0x1000);
   regs6532 = new Uint8Array(4);
   tia : TIA = new TIA();
@@ -327,7 +327,7 @@ export class Atari7800 extends BasicMachine implements RasterFrameBased {
 
   constructor() {
     super();
-    this.cpu = new MOS6502();
+    this.cpu = new MOS6502Fast();
     this.read = newAddressDecoder([
         [0x0008, 0x000d,   0x0f, (a) => { this.xtracyc++; return this.readInput(a); }],
         [0x0000, 0x001f,   0x1f, (a) => { this.xtracyc++; return this.tia.read(a); }],
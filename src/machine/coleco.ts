@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine } from "../common/devices";
+import { BasicScanlineMachine, MemoryPageTable } from "../common/devices";
 import { BaseZ80VDPBasedMachine } from "./vdp_z80";
 import { KeyFlags, newAddressDecoder, padBytes, Keys, makeKeycodeMap, newKeyboardHandler } from "../common/emu";
 import { hex, lzgmini, stringToByteArray } from "../common/util";
@@ -44,6 +44,7 @@ var COLECOVISION_KEYCODE_MAP = makeKeycodeMap([
 export class ColecoVision extends BaseZ80VDPBasedMachine {
 
   defaultROMSize = 0x8000;
+  binaryStateTag = 0x434f4c01; // 'COL' v1
   ram = new Uint8Array(0x400);
   bios: Uint8Array;
   keypadMode: boolean;
@@ -51,7 +52,7 @@ export class ColecoVision extends BaseZ80VDPBasedMachine {
   constructor() {
     super();
     this.init(this, this.newIOBus(), new SN76489_Audio(new MasterAudio()));
-    this.bios = new lzgmini().decode(stringToByteArray(atob(COLECO_BIOS_LZG)));
+    this.bios = new Uint8Array(new lzgmini().decode(stringToByteArray(atob(COLECO_BIOS_LZG))));
   }
   
   getKeyboardMap() { return COLECOVISION_KEYCODE_MAP; }
@@ -71,6 +72,14 @@ export class ColecoVision extends BaseZ80VDPBasedMachine {
     [0x6000, 0x7fff, 0x03ff, (a, v) => { this.ram[a] = v; }],
   ]);
 
+  newMemoryPages() : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRead(0x0000, 0x1fff, this.bios, 0x1fff);
+    pages.mapRAM(0x6000, 0x7fff, this.ram, 0x03ff);
+    pages.mapRead(0x8000, 0xffff, this.rom, 0x7fff);
+    return pages;
+  }
+
   newIOBus() {
     return {
       read: (addr:number):number => {
@@ -115,6 +124,19 @@ export class ColecoVision extends BaseZ80VDPBasedMachine {
     state['kpm'] = this.keypadMode;
     return state;
   }
+  getBinaryStateSize() : number {
+    return this.getVDPMachineStateSize() + 1;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    ofs = super.saveStateInto(buf, ofs);
+    buf.setUint8(ofs, this.keypadMode ? 1 : 0);
+    return ofs + 1;
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = super.loadStateFrom(buf, ofs);
+    this.keypadMode = buf.getUint8(ofs) != 0;
+    return ofs + 1;
+  }
   reset() {
     super.reset();
     this.keypadMode = false;
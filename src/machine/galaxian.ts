@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine } from "../common/devices";
+import { BasicScanlineMachine, MemoryPageTable } from "../common/devices";
 import { KeyFlags, newAddressDecoder, padBytes, noise, Keys, makeKeycodeMap, newKeyboardHandler, EmuHalt } from "../common/emu";
 import { TssChannelAdapter, MasterAudio, AY38910_Audio } from "../common/audio";
 import { hex } from "../common/util";
@@ -182,6 +182,7 @@ export class GalaxianMachine extends BasicScanlineMachine {
     sampleRate = audioSampleRate * audioOversample;
     cpuCyclesPerLine = cpuCyclesPerLine | 0;
     rotate = 90;
+    skipIdleLoops = true;
 
     cpu: Z80 = new Z80();
     ram = new Uint8Array(0x800);
@@ -211,6 +212,7 @@ export class GalaxianMachine extends BasicScanlineMachine {
         this.gfx = new GalaxianVideo(this.rom, this.vram, this.oram, this.palette, this.options);
         this.connectCPUMemoryBus(this);
         this.connectCPUIOBus(this.newIOBus());
+        this.connectCPUMemoryPages(this.newMemoryPages());
         this.inputs.set(this.defaultInputs);
         this.handler = newKeyboardHandler(this.inputs, this.keyMap);
     }
@@ -242,6 +244,15 @@ export class GalaxianMachine extends BasicScanlineMachine {
         [0x7004, 0x7004, 0, (a, v) => { this.gfx.starsEnabled = v & 1; }],
     ]);
 
+    newMemoryPages() : MemoryPageTable {
+        var pages = new MemoryPageTable();
+        pages.mapRead(0x0000, 0x3fff, this.rom);
+        pages.mapRAM(0x4000, 0x47ff, this.ram, 0x3ff);
+        pages.mapRAM(0x5000, 0x57ff, this.vram, 0x3ff);
+        pages.mapRAM(0x5800, 0x5fff, this.oram, 0xff);
+        return pages;
+    }
+
     newIOBus() {
         return {
             read: (addr) => {
@@ -377,6 +388,15 @@ export class GalaxianScrambleMachine extends GalaxianMachine {
         //[0, 0xffff, 0, function(a,v) { console.log(hex(a),hex(v)); }]
     ]);
 
+    newMemoryPages() : MemoryPageTable {
+        var pages = new MemoryPageTable();
+        pages.mapRead(0x0000, 0x3fff, this.rom);
+        pages.mapRAM(0x4000, 0x47ff, this.ram, 0x7ff);
+        pages.mapRAM(0x4800, 0x4fff, this.vram, 0x3ff);
+        pages.mapRAM(0x5000, 0x5fff, this.oram, 0xff);
+        return pages;
+    }
+
     m_protection_state = 0;
     m_protection_result = 0;
     scramble_protection_w(addr, data) {
@@ -1,6 +1,6 @@
 
-import { MOS6502, MOS6502State } from "../common/cpu/MOS6502";
-import { BasicHeadlessMachine } from "../common/devices";
+import { MOS6502Fast, MOS6502State } from "../common/cpu/MOS6502";
+import { BasicHeadlessMachine, EventScheduler, ScheduledEvent } from "../common/devices";
 import { padBytes, Keys, KeyFlags, newAddressDecoder } from "../common/emu"; // TODO
 import { hex, stringToByteArray, lzgmini } from "../common/util";
 
@@ -17,20 +17,97 @@ const KIM1_KEYMATRIX_NOSHIFT = [
 
 const KEYBOARD_ROW_0 = 0;
 
+const TIMER_DIVIDERS = [1, 8, 64, 1024];
+
 class RRIOT_6530 {
 
   regs = new Uint8Array(16);
   ina : number = 0;
   inb : number = 0;
 
+  // interval timer, counted from the scheduler clock instead of every cycle
+  sched : EventScheduler;
+  irq : () => void;
+  timerStart : number = 0;  // clock when the timer was written
+  timerValue : number = 0;  // value written
+  timerDiv : number = 1;
+  timerIRQEnable : boolean = false;
+  timerFlag : boolean = false;
+  timerEvent = new ScheduledEvent((time) => this.timerExpired(time));
+
+  constructor(sched:EventScheduler, irq?:() => void) {
+    this.sched = sched;
+    this.irq = irq;
+  }
+
   read(a:number) : number {
     //console.log('read', hex(a), hex(this.regs[a]));
+    if (a & 4) {
+      if (a & 1) return this.timerFlag ? 0x80 : 0;
+      // reading the counter clears the flag
+      this.timerIRQEnable = (a & 8) != 0;
+      this.timerFlag = false;
+      return this.getTimer();
+    }
     return this.regs[a];
   }
 
   write(a:number,v:number) {
     this.regs[a] = v;
     //console.log('write', hex(a), hex(v));
+    if (a & 4) {
+      this.timerStart = this.sched.clock;
+      this.timerValue = v;
+      this.timerDiv = TIMER_DIVIDERS[a & 3];
+      this.timerIRQEnable = (a & 8) != 0;
+      this.timerFlag = false;
+      this.sched.schedule(this.timerEvent, this.getTimerExpiry());
+    }
+  }
+
+  // counts down once per divider period, then once per cycle after it underflows
+  getTimer() : number {
+    var expiry = this.getTimerExpiry();
+    var clock = this.sched.clock;
+    if (clock < expiry)
+      return this.timerValue - Math.floor((clock - this.timerStart) / this.timerDiv);
+    else
+      return (0xff - (clock - expiry)) & 0xff;
+  }
+  getTimerExpiry() : number {
+    return this.timerStart + (this.timerValue + 1) * this.timerDiv;
+  }
+  timerExpired(time:number) {
+    this.timerFlag = true;
+    if (this.timerIRQEnable && this.irq) this.irq();
+  }
+  // PB7 is low until the flag is cleared
+  isIRQ() : boolean {
+    return this.timerFlag && this.timerIRQEnable;
+  }
+
+  saveState() {
+    return {
+      regs: this.regs.slice(0),
+      tstart: this.timerStart,
+      tval: this.timerValue,
+      tdiv: this.timerDiv,
+      tie: this.timerIRQEnable,
+      tflag: this.timerFlag,
+    };
+  }
+  loadState(s) {
+    this.regs.set(s.regs);
+    this.timerStart = s.tstart;
+    this.timerValue = s.tval;
+    this.timerDiv = s.tdiv;
+    this.timerIRQEnable = s.tie;
+    this.timerFlag = s.tflag;
+    var expiry = this.getTimerExpiry();
+    if (expiry > this.sched.clock)
+      this.sched.schedule(this.timerEvent, expiry);
+    else
+      this.sched.cancel(this.timerEvent);
   }
   
   input_a() { return this.ina & ~this.regs[1]; }
@@ -43,12 +120,15 @@ export class KIM1 extends BasicHeadlessMachine {
   cpuFrequency = 1000000;
   defaultROMSize = 0x1000;
   
-  cpu = new MOS6502();
+  cpu = new MOS6502Fast();
   ram = new Uint8Array(0x1800);
   bios : Uint8Array;
 
-  rriot1 : RRIOT_6530 = new RRIOT_6530();
-  rriot2 : RRIOT_6530 = new RRIOT_6530();
+  // PB7 (the timer output) isn't connected to IRQ on a stock KIM-1; the kim1-irq platform jumpers it
+  timerIRQ : boolean = false;
+  irqPending : boolean = false;
+  rriot1 : RRIOT_6530 = new RRIOT_6530(this.scheduler, () => this.raiseTimerIRQ());
+  rriot2 : RRIOT_6530 = new RRIOT_6530(this.scheduler, () => this.raiseTimerIRQ());
   digits = [];
 
   constructor() {
@@ -103,6 +183,18 @@ export class KIM1 extends BasicHeadlessMachine {
     console.log(digit, segments);
   }
   
+  raiseTimerIRQ() {
+    if (this.timerIRQ) this.irqPending = true;
+  }
+  // a pending IRQ waits for the I flag, and is dropped if the timer flag gets cleared first
+  advanceCPU() {
+    if (this.irqPending && !this.cpu.isIRQMasked()) {
+      this.irqPending = false;
+      if (this.rriot1.isIRQ() || this.rriot2.isIRQ()) this.cpu.IRQ();
+    }
+    return super.advanceCPU();
+  }
+
   loadROM(data) {
     super.loadROM(data);
     this.ram.set(this.rom, 0x400);
@@ -134,12 +226,25 @@ export class KIM1 extends BasicHeadlessMachine {
   }
   
   advanceFrame(trap) : number {
-    var clock = 0;
-    while (clock < this.cpuFrequency/60) {
-      if (trap && trap()) break;
-      clock += this.advanceCPU();
-    }
-    return clock;
+    var start = this.scheduler.clock;
+    this.advanceScheduled(start + this.cpuFrequency/60, trap);
+    return this.scheduler.clock - start;
+  }
+
+  loadState(state) {
+    super.loadState(state);
+    this.scheduler.clock = state.clk || 0; // older states don't have timers
+    if (state.r1) this.rriot1.loadState(state.r1);
+    if (state.r2) this.rriot2.loadState(state.r2);
+    this.irqPending = !!state.irq;
+  }
+  saveState() {
+    var state = super.saveState();
+    state['clk'] = this.scheduler.clock;
+    state['r1'] = this.rriot1.saveState();
+    state['r2'] = this.rriot2.saveState();
+    state['irq'] = this.irqPending;
+    return state;
   }
 }
 
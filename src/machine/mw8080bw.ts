@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine } from "../common/devices";
+import { BasicScanlineMachine, MemoryPageTable } from "../common/devices";
 import { KeyFlags, newAddressDecoder, padBytes, Keys, makeKeycodeMap, newKeyboardHandler } from "../common/emu";
 import { TssChannelAdapter, MasterAudio, AY38910_Audio } from "../common/audio";
 
@@ -38,6 +38,7 @@ export class Midway8080 extends BasicScanlineMachine {
   defaultROMSize = 0x2000;
   rotate = -90;
   sampleRate = 1;
+  skipIdleLoops = true;
 
   bitshift_offset = 0;
   bitshift_register = 0;
@@ -69,6 +70,19 @@ export class Midway8080 extends BasicScanlineMachine {
         }],
   ]);
 
+  newMemoryPages() : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRead(0x0000, 0x1fff, this.rom, 0x1fff);
+    pages.mapRead(0x2000, 0x3fff, this.ram, 0x1fff);
+    pages.mapWrite(0x2000, 0x23ff, this.ram, 0x3ff); // rest of RAM is the frame buffer
+    return pages;
+  }
+
+  loadROM(data:Uint8Array) {
+    super.loadROM(data);
+    this.connectCPUMemoryPages(this.newMemoryPages());
+  }
+
   newIOBus() {
     return {
       read: (addr) => {
@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine } from "../common/devices";
+import { BasicScanlineMachine, MemoryPageTable, BankSwitched, saveBytesInto, loadBytesFrom } from "../common/devices";
 import { BaseZ80VDPBasedMachine } from "./vdp_z80";
 import { KeyFlags, newAddressDecoder, padBytes, Keys, makeKeycodeMap, newKeyboardHandler } from "../common/emu";
 import { hex, lzgmini, stringToByteArray } from "../common/util";
@@ -34,6 +34,7 @@ export class SG1000 extends BaseZ80VDPBasedMachine {
 
   numVisibleScanlines = 240;
   defaultROMSize = 0xc000;
+  binaryStateTag = 0x53473101; // 'SG1' v1
   ram = new Uint8Array(0x400);
   
   constructor() {
@@ -56,6 +57,17 @@ export class SG1000 extends BaseZ80VDPBasedMachine {
      [0xc000, 0xffff,  0x3ff, (a,v) => { this.ram[a] = v; }],
    ]);
   
+  newMemoryPages() : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRAM(0xc000, 0xffff, this.ram, 0x3ff);
+    pages.mapRead(0x0000, 0xbfff, this.rom);
+    return pages;
+  }
+
+  getBinaryStateSize() : number {
+    return this.getVDPMachineStateSize();
+  }
+
   getVCounter() : number { return 0; }
   getHCounter() : number { return 0; }
   setMemoryControl(v:number) { }
@@ -96,13 +108,16 @@ export class SG1000 extends BaseZ80VDPBasedMachine {
 
 ///
 
-export class SMS extends SG1000 {
+const SMS_CART_RAM_BANK = 0x100; // above any ROM page number
+
+export class SMS extends SG1000 implements BankSwitched {
 
   cartram = new Uint8Array(0);
   pagingRegisters = new Uint8Array(4);
   romPageMask : number;
   latchedHCounter = 0;
   ioControlFlags = 0;
+  binaryStateTag = 0x534d5301; // 'SMS' v1
   // TODO: hide bottom scanlines
   ram = new Uint8Array(0x2000);
   
@@ -110,6 +125,10 @@ export class SMS extends SG1000 {
     return new SMSVDP(frameData, cru, flicker);
   }
 
+  newMemoryPages() : MemoryPageTable {
+    return null; // ROM and cartridge RAM are bank-switched
+  }
+
   reset() {
     super.reset();
     this.pagingRegisters.set([0,0,1,2]);
@@ -139,6 +158,14 @@ export class SMS extends SG1000 {
   }
   
   
+  getBankAt(a:number) : number {
+    if (a < 0x400 || a >= 0xc000) return 0;
+    var reg0 = this.pagingRegisters[0];
+    if (a >= 0x8000 && (reg0 & 0x8))
+      return SMS_CART_RAM_BANK + ((reg0 >> 2) & 1); // cartridge RAM, not a ROM page
+    return this.pagingRegisters[(a >> 14) + 1] & this.romPageMask;
+  }
+
   getPagedROM(a:number, reg:number) {
     //if (!(a&0xff)) console.log(hex(a), reg, this.pagingRegisters[reg], this.romPageMask);
     return this.rom && this.rom[a + ((this.pagingRegisters[reg] & this.romPageMask) << 14)]; // * $4000
@@ -213,6 +240,24 @@ export class SMS extends SG1000 {
     state['iocf'] = this.ioControlFlags;
     return state;
   }
+  getBinaryStateSize() : number {
+    return this.getVDPMachineStateSize() + this.pagingRegisters.length + 12 + this.cartram.length;
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    ofs = saveBytesInto(buf, super.saveStateInto(buf, ofs), this.pagingRegisters);
+    buf.setInt32(ofs, this.latchedHCounter);
+    buf.setInt32(ofs+4, this.ioControlFlags);
+    buf.setUint32(ofs+8, this.cartram.length);
+    return saveBytesInto(buf, ofs+12, this.cartram);
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    ofs = loadBytesFrom(buf, super.loadStateFrom(buf, ofs), this.pagingRegisters);
+    this.latchedHCounter = buf.getInt32(ofs);
+    this.ioControlFlags = buf.getInt32(ofs+4);
+    var cartramlen = buf.getUint32(ofs+8);
+    if (cartramlen != this.cartram.length) this.cartram = new Uint8Array(cartramlen);
+    return loadBytesFrom(buf, ofs+12, this.cartram);
+  }
   getDebugInfo(category, state) {
     switch (category) {
       case 'SMS': // TODO
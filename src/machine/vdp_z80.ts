@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine, Bus, ProbeAll } from "../common/devices";
+import { BasicScanlineMachine, Bus, ProbeAll, MemoryPageTable } from "../common/devices";
 import { newAddressDecoder, newKeyboardHandler } from "../common/emu";
 import { TssChannelAdapter } from "../common/audio";
 import { TMS9918A } from "../common/video/tms9918a";
@@ -16,6 +16,7 @@ export abstract class BaseZ80VDPBasedMachine extends BasicScanlineMachine {
   cpuCyclesPerLine = this.cpuFrequency / (262*60);
   sampleRate = 262*60*audioOversample;
   overscan = true;
+  skipIdleLoops = true;
 
   cpu: Z80 = new Z80();
   vdp: TMS9918A;
@@ -34,6 +35,16 @@ export abstract class BaseZ80VDPBasedMachine extends BasicScanlineMachine {
     this.audioadapter = psg && new TssChannelAdapter(psg.psg, audioOversample, this.sampleRate);
   }
   
+  // plain RAM/ROM the CPU can reach without the memory bus, or null if it's all banked
+  newMemoryPages() : MemoryPageTable {
+    return null;
+  }
+
+  loadROM(data:Uint8Array, title?:string) {
+    super.loadROM(data, title);
+    this.connectCPUMemoryPages(this.newMemoryPages());
+  }
+
   connectVideo(pixels) {
     super.connectVideo(pixels);
     var cru = {
@@ -74,6 +85,15 @@ export abstract class BaseZ80VDPBasedMachine extends BasicScanlineMachine {
     state['vdp'] = this.vdp.getState();
     return state;
   }
+  getVDPMachineStateSize() : number {
+    return this.getHeadlessStateSize() + this.vdp.getBinaryStateSize();
+  }
+  saveStateInto(buf:DataView, ofs:number) : number {
+    return this.vdp.saveStateInto(buf, super.saveStateInto(buf, ofs));
+  }
+  loadStateFrom(buf:DataView, ofs:number) : number {
+    return this.vdp.loadStateFrom(buf, super.loadStateFrom(buf, ofs));
+  }
   reset() {
     super.reset();
     this.vdp.reset();
@@ -1,6 +1,6 @@
 
 import { Z80, Z80State } from "../common/cpu/ZilogZ80";
-import { BasicScanlineMachine } from "../common/devices";
+import { BasicScanlineMachine, MemoryPageTable } from "../common/devices";
 import { KeyFlags, newAddressDecoder, padBytes, Keys, makeKeycodeMap, newKeyboardHandler } from "../common/emu";
 import { TssChannelAdapter, MasterAudio, AY38910_Audio } from "../common/audio";
 
@@ -40,6 +40,7 @@ export class VicDual extends BasicScanlineMachine {
   sampleRate = audioSampleRate * audioOversample;
   cpuCyclesPerLine = cpuCyclesPerLine|0;
   rotate = -90;
+  skipIdleLoops = true;
   
   cpu: Z80 = new Z80();
   ram = new Uint8Array(0x1000);
@@ -78,6 +79,13 @@ export class VicDual extends BasicScanlineMachine {
     [0x8000, 0xffff, 0x0fff, (a, v) => { this.ram[a] = v; }],
   ]);
 
+  newMemoryPages() : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRead(0x0000, 0x7fff, this.rom, 0x3fff);
+    pages.mapRAM(0x8000, 0xffff, this.ram, 0x0fff);
+    return pages;
+  }
+
   newIOBus() {
     return {
       read: (addr) => {
@@ -111,6 +119,7 @@ export class VicDual extends BasicScanlineMachine {
 
   loadROM(data) {
     super.loadROM(data);
+    this.connectCPUMemoryPages(this.newMemoryPages());
     if (data.length >= 0x4020 && (data[0x4000] || data[0x401f])) {
       this.display.colorprom = data.slice(0x4000, 0x4020);
     }
@@ -16,6 +16,7 @@ class GalaxianPlatform extends BaseZ80MachinePlatform<GalaxianMachine> implement
   getDefaultExtension() { return ".c"; };
   readAddress(a)        { return this.machine.readConst(a); }
   readVRAMAddress(a)    { return (a < 0x800) ? this.machine.vram[a] : this.machine.oram[a-0x800]; }
+  nmiFrameInterrupt     = true;
   // TODO loadBIOS(bios)	{ this.machine.loadBIOS(a); }
   getMemoryMap = function() { return { main:[
     {name:'Video RAM',start:0x5000,size:0x400,type:'ram'},
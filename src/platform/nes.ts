@@ -79,7 +79,8 @@ class JSNESPlatform extends Base6502Platform implements Platform, Probeable {
   ntvideo;
   ntlastbuf;
   
-  machine = { cpuCyclesPerLine: 114 }; // TODO: hack for width of probe scope
+  // TODO: hack for width of probe scope (and visible area for the interrupt budget)
+  machine = { cpuCyclesPerLine: 114, numTotalScanlines: 262, numVisibleScanlines: 240, firstVisibleScanline: 21 };
   
   constructor(mainElement) {
     super();
@@ -137,6 +138,10 @@ class JSNESPlatform extends Base6502Platform implements Platform, Probeable {
     // insert debug hook
     this.nes.cpu._emulate = this.nes.cpu.emulate;
     this.nes.cpu.emulate = () => {
+      var cpu = this.nes.cpu;
+      // NMI, or IRQ if not masked, will be taken by this call
+      if (cpu.irqRequested && (cpu.irqType == 1 || (cpu.irqType == 0 && !cpu.F_INTERRUPT)))
+        this.probe.logInterrupt(cpu.irqType);
       this.probe.logExecute(this.nes.cpu.REG_PC+1, this.nes.cpu.REG_SP);
       var cycles = this.nes.cpu._emulate();
       this.evalDebugCondition();
@@ -294,6 +299,11 @@ class JSNESPlatform extends Base6502Platform implements Platform, Probeable {
     return this.nes.ppu.scanline;
   }
 
+  // without building the whole CPU state, for the breakpoint checks
+  getPC() { return (this.nes.cpu.REG_PC + this.debugPCDelta) & 0xffff; }
+  getSP() { return this.nes.cpu.REG_SP & 0xff; }
+  isStable() { return true; }
+
   getCPUState() {
     var c = this.nes.cpu.toJSON();
     this.copy6502REGvars(c);
@@ -4,7 +4,7 @@ import { PLATFORMS, newAddressDecoder, padBytes, noise, setKeyboardFromMap, Anim
 import { hex, lzgmini, stringToByteArray, safe_extend } from "../common/util";
 import { MasterAudio, AY38910_Audio } from "../common/audio";
 import { ProbeRecorder } from "../common/recorder";
-import { NullProbe, Probeable, ProbeAll } from "../common/devices";
+import { NullProbe, Probeable, ProbeAll, MemoryPageTable } from "../common/devices";
 
 // emulator from https://github.com/raz0red/jsvecx
 // https://roadsidethoughts.com/vectrex/vectrex-memory-map.htm
@@ -820,6 +820,7 @@ class VectrexPlatform extends Base6809Platform {
       write: (a,v) => { this.probe.logWrite(a,v); mbus.write(a,v); }
     };
     this._cpu = this.newCPU(this.bus);
+    this.connectMemoryPages();
     // create video/audio
     this.video = new VectorVideo(this.mainElement, Globals.SCREEN_X_DEFAULT, Globals.SCREEN_Y_DEFAULT);
     this.video.persistenceAlpha = 0.2;
@@ -899,14 +900,29 @@ class VectrexPlatform extends Base6809Platform {
 
   loadROM(title, data) {
     this.rom = padBytes(data, 0x8000);
+    this.connectMemoryPages();
     this.reset();
   }
 
   loadBIOS(title, data) {
     this.bios = padBytes(data, 0x2000);
+    this.connectMemoryPages();
     this.reset();
   }
 
+  newMemoryPages() : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRead(0x0000, 0x7fff, this.rom);
+    pages.mapRAM(0xc800, 0xcfff, this.ram, 0x3ff);
+    pages.mapRead(0xe000, 0xffff, this.bios, 0x1fff);
+    return pages;
+  }
+  // the page table bypasses this.bus, so the CPU only gets it while nothing is probing
+  connectMemoryPages() {
+    var probing = this.probe !== this.nullProbe && !this.probe.cpuOnly;
+    this._cpu.connectMemoryPages(probing ? null : this.newMemoryPages());
+  }
+
   isRunning() {
     return this.timer.isRunning();
   }
@@ -988,6 +1004,7 @@ class VectrexPlatform extends Base6809Platform {
   }
   connectProbe(probe:ProbeAll) {
     this.probe = probe || this.nullProbe;
+    this.connectMemoryPages();
   }
 }
 
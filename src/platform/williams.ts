@@ -1,8 +1,10 @@
 
-import { Platform, BaseZ80Platform, Base6809Platform } from "../common/baseplatform";
+import { Platform, BaseZ80Platform, Base6809Platform, getOpcodeMetadata_z80 } from "../common/baseplatform";
+import { CodeAnalyzer_z80 } from "../common/analysis";
 import { PLATFORMS, RAM, newAddressDecoder, padBytes, noise, setKeyboardFromMap, AnimationTimer, RasterVideo, Keys, makeKeycodeMap } from "../common/emu";
 import { hex } from "../common/util";
 import { MasterAudio, WorkerSoundChannel } from "../common/audio";
+import { MemoryPageTable } from "../common/devices";
 
 var WILLIAMS_PRESETS = [
   { id: 'gfxtest.c', name: 'Graphics Test' },
@@ -139,7 +141,7 @@ var WilliamsPlatform = function(mainElement, proto) {
     [0x80c, 0x80c, 0xf, function(a, v) { if (worker) worker.postMessage({ command: v }); }],
     //[0x804, 0x807, 0x3,   function(a,v) { console.log('iowrite',a); }], // TODO: sound
     //[0x80c, 0x80f, 0x3,   function(a,v) { console.log('iowrite',a+4); }], // TODO: sound
-    [0x900, 0x9ff, 0, function(a, v) { banksel = v & 0x1; }],
+    [0x900, 0x9ff, 0, function(a, v) { banksel = v & 0x1; connectMemoryPages(); }],
     [0xa00, 0xa07, 0x7, setBlitter],
     [0xbff, 0xbff, 0, function(a, v) { if (v == 0x39) watchdog_counter = INITIAL_WATCHDOG; }],
     [0xc00, 0xfff, 0x3ff, function(a, v) { nvram.mem[a] = v; }],
@@ -162,6 +164,24 @@ var WilliamsPlatform = function(mainElement, proto) {
 
   // d1d6 ldu $11 / beq $d1ed
 
+  // what memread_williams/memwrite_williams do for plain RAM and ROM, for each banksel
+  var memoryPages : MemoryPageTable[];
+
+  function newMemoryPages(bank: number) : MemoryPageTable {
+    var pages = new MemoryPageTable();
+    pages.mapRead(0x0000, 0x8fff, bank ? rom : ram.mem);
+    pages.mapRead(0x9000, 0xbfff, ram.mem);
+    pages.mapWrite(0x9800, 0xbfff, ram.mem);
+    pages.mapRead(0xd000, 0xdfff, rom.subarray(0x9000, 0xa000), 0x0fff);
+    pages.mapRead(0xe000, 0xffff, rom.subarray(0xa000, 0xc000), 0x1fff);
+    return pages;
+  }
+
+  function connectMemoryPages() {
+    if (!memoryPages) memoryPages = [newMemoryPages(0), newMemoryPages(1)];
+    cpu.connectMemoryPages(memoryPages[banksel]);
+  }
+
   function setPalette(a, v) {
     // RRRGGGBB
     var color = 0xff000000 | ((v & 7) << 5) | (((v >> 3) & 7) << 13) | (((v >> 6) << 22));
@@ -358,6 +378,7 @@ var WilliamsPlatform = function(mainElement, proto) {
         self.loadSoundROM(data.slice(0x9000));
       }
       rom = padBytes(data, 0xc000);
+      memoryPages = null;
     }
     self.reset();
   }
@@ -371,6 +392,7 @@ var WilliamsPlatform = function(mainElement, proto) {
     watchdog_counter = state.wdc;
     banksel = state.bs;
     portsel = state.ps;
+    connectMemoryPages();
   }
   this.saveState = function() {
     return {
@@ -411,6 +433,7 @@ var WilliamsPlatform = function(mainElement, proto) {
     cpu.reset();
     watchdog_counter = INITIAL_WATCHDOG;
     banksel = 1;
+    connectMemoryPages();
   }
   this.scaleCPUFrequency = function(scale) {
     cpuScale = scale;
@@ -430,6 +453,13 @@ var WilliamsZ80Platform = function(mainElement) {
   // also scale bitblt clocks
   this.scaleCPUFrequency(4);
 
+  this.getOpcodeMetadata = function(opcode, offset) {
+    return getOpcodeMetadata_z80(opcode, offset, (a) => this.readAddress(a));
+  }
+  this.newCodeAnalyzer = function() {
+    return new CodeAnalyzer_z80(this);
+  }
+
   this.ramStateToLongString = function(state) {
     var blt = state.blt;
     var sstart = (blt[2] << 8) + blt[3];
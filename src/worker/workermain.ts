@@ -270,6 +270,7 @@ var PLATFORM_PARAMS = {
 };
 
 PLATFORM_PARAMS['sms-sms-libcv'] = PLATFORM_PARAMS['sms-sg1000-libcv'];
+PLATFORM_PARAMS['kim1-irq'] = PLATFORM_PARAMS['kim1'];
 
 var _t1;
 function starttime() { _t1 = new Date(); }
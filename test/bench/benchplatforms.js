@@ -0,0 +1,118 @@
+
+// Emulation throughput benchmark.
+// Runs every ROM in test/roms/<platform>/ headless for a fixed number of frames
+// and prints a JSON report on stdout (progress and emulator chatter go to stderr).
+//
+//   npm run bench -- [--frames N] [--warmup N] [--only platid,...]
+//                    [--output results.json] [--baseline results.json]
+//
+// With --baseline, each result also gets a "speedup" ratio (fps / baseline fps).
+
+var fs = require('fs');
+
+// keep stdout clean for the report
+var log = console.log;
+console.log = console.info = console.warn = console.error;
+
+require('../cli/headless.js');
+var emu = require('gen/common/emu.js');
+
+//
+
+function parseArgs(argv) {
+  var opts = { frames: 600, warmup: 60, only: null, output: null, baseline: null };
+  for (var i=0; i<argv.length; i++) {
+    switch (argv[i]) {
+      case '--frames': opts.frames = parseInt(argv[++i]); break;
+      case '--warmup': opts.warmup = parseInt(argv[++i]); break;
+      case '--only': opts.only = argv[++i].split(','); break;
+      case '--output': opts.output = argv[++i]; break;
+      case '--baseline': opts.baseline = argv[++i]; break;
+      default: throw new Error("unknown option: " + argv[i]);
+    }
+  }
+  return opts;
+}
+
+function heapUsed() {
+  if (global.gc) global.gc();
+  return process.memoryUsage().heapUsed;
+}
+
+// emulated CPU cycles per frame, if the platform can tell us
+function getCyclesPerFrame(platform) {
+  var m = platform.machine;
+  if (!m) return null;
+  if (m.cpuCyclesPerLine && m.numTotalScanlines) return m.cpuCyclesPerLine * m.numTotalScanlines;
+  if (m.cpuCyclesPerFrame) return m.cpuCyclesPerFrame;
+  if (m.cpuFrequency) return m.cpuFrequency / 60;
+  return null;
+}
+
+async function benchPlatform(platid, romname, opts) {
+  var platform = new emu.PLATFORMS[platid](document.getElementById('emulator'));
+  await platform.start();
+  var rom = new Uint8Array(fs.readFileSync('./test/roms/' + platid + '/' + romname));
+  platform.loadROM("ROM", rom);
+  platform.resume();
+  for (var i=0; i<opts.warmup; i++)
+    platform.nextFrame();
+  var heap0 = heapUsed();
+  var t0 = process.hrtime.bigint();
+  for (var i=0; i<opts.frames; i++)
+    platform.nextFrame();
+  var secs = Number(process.hrtime.bigint() - t0) / 1e9;
+  var heap1 = heapUsed();
+  platform.pause();
+  var fps = opts.frames / secs;
+  var cpf = getCyclesPerFrame(platform);
+  return {
+    platform: platid,
+    rom: romname,
+    frames: opts.frames,
+    seconds: secs,
+    fps: fps,
+    cpuMHz: cpf ? fps * cpf / 1e6 : null,
+    heapGrowth: heap1 - heap0,
+  };
+}
+
+async function main() {
+  var opts = parseArgs(process.argv.slice(2));
+  var baseline = {};
+  if (opts.baseline) {
+    for (var r of JSON.parse(fs.readFileSync(opts.baseline, 'utf-8')).results)
+      baseline[r.platform + '/' + r.rom] = r;
+  }
+  var results = [];
+  for (var platid of fs.readdirSync('./test/roms').sort()) {
+    if (opts.only && opts.only.indexOf(platid) < 0) continue;
+    for (var romname of fs.readdirSync('./test/roms/' + platid).sort()) {
+      var result;
+      if (!emu.PLATFORMS[platid]) {
+        result = { platform: platid, rom: romname, error: "no such platform" };
+      } else {
+        try {
+          result = await benchPlatform(platid, romname, opts);
+        } catch (e) {
+          result = { platform: platid, rom: romname, error: e + "" };
+        }
+      }
+      var base = baseline[platid + '/' + romname];
+      if (base && base.fps && result.fps) result.speedup = result.fps / base.fps;
+      console.error(platid, romname, result.error || (result.fps.toFixed(1) + " fps"));
+      results.push(result);
+    }
+  }
+  var report = JSON.stringify({
+    date: new Date().toISOString(),
+    node: process.version,
+    frames: opts.frames,
+    warmup: opts.warmup,
+    results: results
+  }, null, 2);
+  if (opts.output) fs.writeFileSync(opts.output, report);
+  log(report);
+}
+
+main().then(() => process.exit(0), (e) => { console.error(e); process.exit(1); });
@@ -4,6 +4,7 @@ var fs = require('fs');
 
 var emu = require("gen/common/devices.js");
 var MOS6502 = require("gen/common/cpu/MOS6502.js");
+var MOS6502JIT = require("gen/common/cpu/MOS6502JIT.js");
 var testbin = fs.readFileSync('test/cli/6502/6502_functional_test.bin', null);
 
 describe('MOS6502', function() {
@@ -46,5 +47,85 @@ describe('MOS6502', function() {
       logWrite:   function(a) { pcs.push(a); },
     };
   });
+  it('Fast engine should match per-cycle engine', function() {
+    var mem1 = new Uint8Array(testbin);
+    var mem2 = new Uint8Array(testbin);
+    var cpu1 = new MOS6502.MOS6502();
+    var cpu2 = new MOS6502.MOS6502Fast();
+    cpu1.connectMemoryBus({ read: (a) => { return mem1[a]; }, write: (a,v) => { mem1[a] = v; } });
+    cpu2.connectMemoryBus({ read: (a) => { return mem2[a]; }, write: (a,v) => { mem2[a] = v; } });
+    cpu1.reset();
+    cpu2.reset();
+    var s0 = cpu1.saveState();
+    s0.PC = 0x400;
+    cpu1.loadState(s0);
+    cpu2.loadState(s0);
+    var clk1 = 0;
+    var clk2 = 0;
+    // compare every instruction's PC and clock, and the full state every 64K
+    for (var i=0; i<100000000; i++) {
+      clk1 += cpu1.advanceInsn();
+      clk2 += cpu2.advanceInsn();
+      var pc = cpu1.getPC();
+      if (cpu2.getPC() != pc || clk2 != clk1) {
+        assert.equal(cpu2.getPC(), pc);
+        assert.equal(clk2, clk1);
+      }
+      if ((i & 0xffff) == 0) assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+      if (pc == 0x3469) break; // success!
+    }
+    console.log(i+' instructions, '+clk1+' cycles, PC = $'+pc.toString(16));
+    assert.equal(pc, 0x3469);
+    assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+    assert.deepEqual(mem2, mem1);
+    // NMI trap
+    cpu1.interrupt(1);
+    cpu2.interrupt(1);
+    assert.equal(cpu2.advanceInsn(), cpu1.advanceInsn());
+    assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+  });
+  it('JIT should match interpreter', function() {
+    var mem1 = new Uint8Array(testbin);
+    var mem2 = new Uint8Array(testbin);
+    var cpu1 = new MOS6502.MOS6502Fast();
+    var cpu2 = new MOS6502JIT.MOS6502JIT();
+    cpu1.connectMemoryBus({ read: (a) => { return mem1[a]; }, write: (a,v) => { mem1[a] = v; } });
+    cpu2.connectMemoryBus({ read: (a) => { return mem2[a]; }, write: (a,v) => { mem2[a] = v; } });
+    cpu2.setRAMRange(0x0000, 0x7fff, mem2);
+    cpu1.reset();
+    cpu2.reset();
+    var s0 = cpu1.saveState();
+    s0.PC = 0x400;
+    cpu1.loadState(s0);
+    cpu2.loadState(s0);
+    var clk1 = 0;
+    var clk2 = 0;
+    // the JIT runs a whole block per call, so catch the interpreter up after each one;
+    // the test ends in a JMP to itself, which is also the end of a block
+    while (clk2 < 200000000 && cpu2.getPC() != 0x3469) {
+      clk2 += cpu2.advanceInsn();
+      while (clk1 < clk2) clk1 += cpu1.advanceInsn();
+      if (cpu2.getPC() != cpu1.getPC() || clk2 != clk1) {
+        assert.equal(cpu2.getPC(), cpu1.getPC());
+        assert.equal(clk2, clk1);
+      }
+    }
+    console.log(clk2+' cycles, PC = $'+cpu2.getPC().toString(16));
+    assert.equal(cpu2.getPC(), 0x3469);
+    assert.equal(clk2, clk1);
+    // internal latches (AD, BA...) are not kept by translated code
+    var regs = ['PC','A','X','Y','SP','N','V','D','I','Z','C','T','o'];
+    var st1 = cpu1.saveState();
+    var st2 = cpu2.saveState();
+    for (var r of regs) assert.equal(st2[r], st1[r], r);
+    assert.deepEqual(mem2, mem1);
+    // back to the interpreter
+    cpu1.interrupt(1);
+    cpu2.interrupt(1);
+    assert.equal(cpu2.advanceInsn(), cpu1.advanceInsn());
+    st1 = cpu1.saveState();
+    st2 = cpu2.saveState();
+    for (var r of regs) assert.equal(st2[r], st1[r], r);
+  });
 });
 
@@ -0,0 +1,95 @@
+var assert = require('assert');
+var fs = require('fs');
+
+var emu = require("gen/common/devices.js");
+var MC6809 = require("gen/common/cpu/MC6809.js");
+
+// the original global-script core, as the reference for the lockstep test
+var CPU6809 = new Function(fs.readFileSync('test/cli/6809/6809.js', 'utf-8') + '\nreturn CPU6809;')();
+
+describe('MC6809', function() {
+  it('Should execute instructions with datasheet timing', function() {
+    var mem = new Uint8Array(0x10000);
+    mem.set([
+      0x86, 0x12,       // LDA #$12     2
+      0xc6, 0x03,       // LDB #$03     2
+      0x8e, 0x20, 0x00, // LDX #$2000   3
+      0xed, 0x84,       // STD ,X       5
+      0xc3, 0x00, 0x01, // ADDD #$0001  4
+      0x30, 0x01,       // LEAX 1,X     5
+      0x5a,             // DECB         2
+      0x26, 0xfd,       // BNE *-1      3
+    ], 0x1000);
+    mem[0xfffe] = 0x10;
+    mem[0xffff] = 0x00;
+    var cpu = new MC6809.MC6809();
+    cpu.connectMemoryBus({ read: (a) => { return mem[a]; }, write: (a,v) => { mem[a] = v; } });
+    cpu.reset();
+    assert.equal(cpu.getPC(), 0x1000);
+    var cycles = [];
+    for (var i=0; i<8; i++) cycles.push(cpu.advanceInsn());
+    assert.deepEqual(cycles, [2,2,3,5,4,5,2,3]);
+    assert.equal(cpu.getPC(), 0x100e);
+    // DECB loop runs out
+    while (cpu.getPC() != 0x1011) cpu.advanceInsn();
+    var s = cpu.saveState();
+    assert.equal(s.A, 0x12);
+    assert.equal(s.B, 0);
+    assert.equal(s.X, 0x2001);
+    assert.equal(mem[0x2000], 0x12);
+    assert.equal(mem[0x2001], 0x03);
+  });
+  it('Should match the original core on random code', function() {
+    var seed = 1;
+    for (var run=0; run<20; run++) {
+      var mem1 = new Uint8Array(0x10000);
+      for (var i=0; i<mem1.length; i++) {
+        seed = emu.xorshift32(seed);
+        mem1[i] = seed & 0xff;
+      }
+      var mem2 = new Uint8Array(mem1);
+      var cpu1 = CPU6809();
+      cpu1.init((a,v) => { mem1[a] = v; }, (a) => { return mem1[a]; }, 0);
+      var cpu2 = new MC6809.MC6809();
+      cpu2.connectMemoryBus({ read: (a) => { return mem2[a]; }, write: (a,v) => { mem2[a] = v; } });
+      // half of the pages go straight to memory, the other half through the bus
+      var pages = new emu.MemoryPageTable();
+      for (var p=0; p<0x10000; p+=0x200) pages.mapRAM(p, p+0xff, mem2);
+      cpu2.connectMemoryPages(pages);
+      cpu2.reset();
+      assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+      var buf = new DataView(new ArrayBuffer(cpu2.getBinaryStateSize()));
+      for (var i=0; i<20000; i++) {
+        // every kind of interrupt, with and without the masks
+        switch (i % 1000) {
+          case 250: cpu1.interrupt(); cpu2.IRQ(); break;
+          case 500: cpu1.firq(); cpu2.interrupt(MC6809.MC6809Interrupts.FIRQ); break;
+          case 750: cpu1.nmi(); cpu2.NMI(); break;
+        }
+        var n1 = cpu1.advanceInsn();
+        var n2 = cpu2.advanceInsn();
+        if (n2 != n1 || cpu2.getPC() != cpu1.getPC()) {
+          assert.equal(n2, n1);
+          assert.equal(cpu2.getPC(), cpu1.getPC());
+        }
+        if ((i & 0xff) == 0) {
+          assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+          // round trip through the binary state, into a CPU that uses the bus only
+          cpu2.saveStateInto(buf, 0);
+          var cpu3 = new MC6809.MC6809();
+          cpu3.connectMemoryBus({ read: (a) => { return mem2[a]; }, write: (a,v) => { mem2[a] = v; } });
+          assert.equal(cpu3.loadStateFrom(buf, 0), buf.byteLength);
+          assert.deepEqual(cpu3.saveState(), cpu1.saveState());
+          cpu2 = cpu3;
+          cpu2.connectMemoryPages((i & 0x100) ? null : pages);
+        }
+      }
+      assert.deepEqual(cpu2.saveState(), cpu1.saveState());
+      assert.deepEqual(mem2, mem1);
+    }
+  });
+  it('Should disassemble', function() {
+    assert.deepEqual(MC6809.disassemble6809(0x86, 0x12, 0, 0, 0, 0x1000), {line:"LDA\t#$12", nbytes:2});
+    assert.equal(MC6809.disassemble6809(0x10, 0x00, 0, 0, 0, 0x1000).line, "???");
+  });
+});
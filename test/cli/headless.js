@@ -0,0 +1,101 @@
+// Headless stand-ins for the browser pieces the platforms use (DOM, canvas,
+// RasterVideo, VectorVideo, Worker, Mousetrap), with every platform loaded.
+// Shared by testplatforms.js and test/bench/benchplatforms.js.
+
+require('./workertestutils.js'); // globals: createTestDOM(), includeInThisContext()
+
+const dom = createTestDOM();
+includeInThisContext("javatari.js/release/javatari/javatari.js");
+Javatari.AUTO_START = false;
+includeInThisContext('tss/js/Log.js');
+//global.Log = require('tss/js/Log.js').Log;
+includeInThisContext('tss/js/tss/PsgDeviceChannel.js');
+includeInThisContext('tss/js/tss/MasterChannel.js');
+includeInThisContext('tss/js/tss/AudioLooper.js');
+//includeInThisContext("jsnes/dist/jsnes.min.js");
+global.jsnes = require("jsnes/dist/jsnes.min.js");
+
+var emu = require('gen/common/emu.js');
+require('gen/platform/apple2.js');
+require('gen/platform/vcs.js');
+require('gen/platform/nes.js');
+require('gen/platform/vicdual.js');
+require('gen/platform/mw8080bw.js');
+require('gen/platform/galaxian.js');
+require('gen/platform/vector.js');
+require('gen/platform/williams.js');
+require('gen/platform/sound_williams.js');
+require('gen/platform/astrocade.js');
+require('gen/platform/atari8.js');
+require('gen/platform/atari7800.js');
+require('gen/platform/coleco.js');
+require('gen/platform/sms.js');
+require('gen/platform/c64.js');
+require('gen/platform/vectrex.js');
+require('gen/platform/zx.js');
+
+//
+
+dom.window.HTMLCanvasElement.prototype.getContext = function() {
+  return {
+    getImageData: function(x,y,w,h) { return {data: new Uint32Array(w*h) }; },
+    fillRect: function(x,y,w,h) { },
+    drawImage: function(img,x,y,w,h) { },
+    putImageData: function(data,w,h) { },
+  };
+}
+global.navigator = {};
+
+// keyboard handler of the last video created, so tests can press keys
+exports.keycallback = null;
+// last RasterVideo created, so tests can grab the frame
+exports.lastrastervideo = null;
+
+emu.RasterVideo = function(mainElement, width, height, options) {
+  var buffer;
+  var datau8;
+  var datau32;
+  this.create = function() {
+    this.width = width;
+    this.height = height;
+    buffer = new ArrayBuffer(width*height*4);
+    datau8 = new Uint8Array(buffer);
+    datau32 = new Uint32Array(buffer);
+    exports.lastrastervideo = this;
+  }
+  this.setKeyboardEvents = function(callback) {
+    exports.keycallback = callback;
+  }
+  this.getFrameData = function() { return datau32; }
+  this.getImageData = function() { return {data:datau8, width:width, height:height}; }
+  this.updateFrame = function() {}
+  this.clearRect = function() {}
+  this.setupMouseEvents = function() { }
+  this.canvas = this;
+  this.getContext = function() { return this; }
+  this.fillRect = function() { }
+  this.fillStyle = '';
+  this.putImageData = function() { }
+}
+
+emu.VectorVideo = function(mainElement, width, height, options) {
+  this.create = function() {
+    this.drawops = 0;
+  }
+  this.setKeyboardEvents = function(callback) {
+    exports.keycallback = callback;
+  }
+  this.clear = function() { }
+  this.drawLine = function() { this.drawops++; }
+}
+
+global.Worker = function() {
+  this.msgcount = 0;
+  this.postMessage = function() { this.msgcount++; }
+}
+
+global.Mousetrap = function() {
+  this.bind = function() { }
+}
+
+exports.dom = dom;
@@ -0,0 +1,173 @@
+var assert = require('assert');
+var fs = require('fs');
+var vm = require('vm');
+
+// the ColecoVision's sound chip uses tss, which is loaded as a script
+for (var path of ['tss/js/Log.js', 'tss/js/tss/PsgDeviceChannel.js', 'tss/js/tss/MasterChannel.js'])
+  vm.runInThisContext(fs.readFileSync(path), path);
+
+var analysis = require("gen/common/analysis.js");
+var baseplatform = require("gen/common/baseplatform.js");
+var coleco = require("gen/machine/coleco.js");
+
+// platform with a ROM at $F000 and NMI and reset vectors pointing to it
+// (or the reset vector to resetpc)
+function newPlatform(code, resetpc) {
+  var mem = new Uint8Array(0x10000);
+  mem.set(code, 0xf000);
+  mem[0xfffa] = 0x00;
+  mem[0xfffb] = 0xf0;
+  mem[0xfffc] = (resetpc || 0xf000) & 0xff;
+  mem[0xfffd] = (resetpc || 0xf000) >> 8;
+  return {
+    readAddress: function(a) { return mem[a & 0xffff]; },
+    getOpcodeMetadata: baseplatform.getOpcodeMetadata_6502,
+    getOriginPC: function() { return 0xf000; },
+  };
+}
+
+function clocks(analyzer, pc) {
+  return analyzer.pc2minclocks[pc] + '-' + analyzer.pc2maxclocks[pc];
+}
+
+describe('6502 timing analysis', function() {
+
+  it('Should time every instruction from the reset vector', function() {
+    var platform = newPlatform([
+      0x85, 0x02,         // f000: STA WSYNC
+      0x20, 0x10, 0xf0,   // f002: JSR $f010
+      0xea,               // f005: NOP
+      0x90, 0x02,         // f006: BCC $f00a
+      0xb0, 0xf6,         // f008: BCS $f000 (always taken)
+      0x4c, 0x00, 0xf0,   // f00a: JMP $f000
+      0, 0, 0,
+      0xea,               // f010: NOP
+      0x60,               // f011: RTS
+    ]);
+    var a = new analysis.CodeAnalyzer_vcs(platform);
+    a.analyzeProgram();
+    assert.equal('21-152', clocks(a, 0xf000)); // starts unknown, or back from the loop
+    assert.equal('0-0', clocks(a, 0xf002));
+    assert.equal('6-6', clocks(a, 0xf010));
+    assert.equal('8-8', clocks(a, 0xf011));
+    assert.equal('14-14', clocks(a, 0xf005)); // after the RTS
+    assert.equal('16-16', clocks(a, 0xf006));
+    assert.equal('18-18', clocks(a, 0xf008));
+    assert.equal('19-19', clocks(a, 0xf00a)); // only from the taken BCC
+    assert.equal(-1, a.pc2minclocks[0xf00d]);
+  });
+
+  it('Should return to every caller of code reached by a tail call', function() {
+    var platform = newPlatform([
+      0x85, 0x02,         // f000: STA WSYNC
+      0x20, 0x10, 0xf0,   // f002: JSR $f010
+      0x20, 0x20, 0xf0,   // f005: JSR $f020
+      0x4c, 0x00, 0xf0,   // f008: JMP $f000
+      0, 0, 0, 0, 0,
+      0xea,               // f010: NOP
+      0x4c, 0x20, 0xf0,   // f011: JMP $f020 (tail call)
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0xea,               // f020: NOP
+      0x60,               // f021: RTS
+    ]);
+    var a = new analysis.CodeAnalyzer_vcs(platform);
+    a.analyzeProgram();
+    assert.equal('11-25', clocks(a, 0xf020)); // from the JMP, or the second JSR
+    assert.equal('13-27', clocks(a, 0xf021));
+    assert.equal('19-19', clocks(a, 0xf005)); // back from $f010 through the RTS at $f021
+    assert.equal('33-33', clocks(a, 0xf008)); // back from $f020
+  });
+
+  it('Should stop widening loops that wrap around', function() {
+    var platform = newPlatform([
+      0xa2, 0x05,         // f000: LDX #5
+      0xca,               // f002: DEX
+      0xd0, 0xfd,         // f003: BNE $f002
+      0x4c, 0x00, 0xf0,   // f005: JMP $f000
+      0xea,               // f008: NOP
+    ], 0xf008);
+    var a = new analysis.CodeAnalyzer_nes(platform);
+    a.analyzeProgram();
+    assert.equal(114, a.MAX_CLOCKS);
+    assert.equal('9-114', clocks(a, 0xf002)); // 7-13 at the NMI, then LDX
+    assert.equal(-1, a.pc2minclocks[0xf008]);  // only reached from reset
+    assert.ok(a.work < 1000);
+  });
+
+});
+
+describe('Z80 timing analysis', function() {
+
+  // code at 0, and optionally more at other addresses
+  function newZ80Platform(code, more) {
+    var mem = new Uint8Array(0x10000);
+    mem.set(code, 0);
+    for (var addr in more || {}) mem.set(more[addr], parseInt(addr));
+    var platform = {
+      readAddress: function(a) { return mem[a & 0xffff]; },
+      getOpcodeMetadata: function(op, a) { return baseplatform.getOpcodeMetadata_z80(op, a, platform.readAddress); },
+    };
+    return platform;
+  }
+
+  it('Should read T-states for prefixed instructions', function() {
+    var p = newZ80Platform([0xdd, 0xcb, 0x05, 0x06, 0xed, 0xb0, 0x20, 0x00, 0xdd, 0x00]);
+    var meta = function(a) { var m = p.getOpcodeMetadata(p.readAddress(a), a); return [m.insnlength, m.minCycles, m.maxCycles]; };
+    assert.deepEqual([4, 23, 23], meta(0));  // RLC (IX+5)
+    assert.deepEqual([2, 16, 21], meta(4));  // LDIR
+    assert.deepEqual([2, 7, 12], meta(6));   // JR NZ
+    assert.deepEqual([1, 4, 4], meta(8));    // DD acting as a NOP
+    assert.equal(null, baseplatform.getOpcodeMetadata_z80(0xed, 0));
+  });
+
+  it('Should time loops, calls and HALT', function() {
+    var p = newZ80Platform([
+      0xed, 0x56,         // 0000: IM 1
+      0xfb,               // 0002: EI
+      0x76,               // 0003: HALT
+      0x06, 0x04,         // 0004: LD B,4
+      0x10, 0xfe,         // 0006: DJNZ $0006
+      0xcd, 0x20, 0x00,   // 0008: CALL $0020
+      0x20, 0x03,         // 000b: JR NZ,$0010
+      0x28, 0xf4,         // 000d: JR Z,$0003 (always taken)
+      0x00,               // 000f: NOP (never reached)
+      0x18, 0xf1,         // 0010: JR $0003
+    ], {
+      0x20: [0x00, 0xc9],         // NOP, RET
+      0x38: [0xfb, 0xed, 0x4d],   // EI, RETI
+    });
+    var a = new analysis.CodeAnalyzer_z80(p, 1000);
+    a.analyzeProgram();
+    assert.equal('0-0', clocks(a, 0x0000));
+    assert.equal('12-1000', clocks(a, 0x0003));
+    assert.equal('13-13', clocks(a, 0x0038));   // IM 1 handler, after HALT
+    assert.equal('31-31', clocks(a, 0x0004));   // back from the handler
+    assert.equal('46-1000', clocks(a, 0x0008)); // after DJNZ
+    assert.equal('63-1000', clocks(a, 0x0020));
+    assert.equal('77-1000', clocks(a, 0x000b)); // after the RET
+    assert.equal('89-1000', clocks(a, 0x0010));
+    assert.equal(-1, a.pc2minclocks[0x000f]);
+  });
+
+  it('Should widen loops in a ColecoVision ROM without running out of work', function() {
+    var machine = new coleco.ColecoVision();
+    machine.loadROM(new Uint8Array(fs.readFileSync('test/roms/coleco/shoot.c.rom')));
+    var platform = {
+      readAddress: function(a) { return machine.read(a & 0xffff); },
+      getOpcodeMetadata: function(op, a) { return baseplatform.getOpcodeMetadata_z80(op, a, platform.readAddress); },
+    };
+    var frameClocks = Math.round(machine.cpuCyclesPerLine * machine.numTotalScanlines);
+    var a = new analysis.CodeAnalyzer_z80(platform, frameClocks, true);
+    var start = machine.read(0x800a) + (machine.read(0x800b) << 8); // cartridge start address
+    a.getEntryPoints = function() { return [0, start]; };
+    a.analyzeProgram();
+    assert.ok(a.work < analysis.MAX_WORK);
+    assert.ok(a.work < a.states.size * 10, a.work + " steps for " + a.states.size + " states");
+    assert.equal(0, a.pc2minclocks[start]);
+    var loops = 0;
+    for (var pc=0; pc<0x10000; pc++)
+      if (a.pc2maxclocks[pc] == frameClocks) loops++;
+    assert.ok(loops > 0);
+  });
+
+});
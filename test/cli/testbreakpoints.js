@@ -0,0 +1,76 @@
+var assert = require('assert');
+
+var baseplatform = require("gen/common/baseplatform.js");
+var kim1 = require("gen/machine/kim1.js");
+
+class KIM1TestPlatform extends baseplatform.Base6502MachinePlatform {
+  newMachine() { return new kim1.KIM1(); }
+}
+
+var program = [
+  0xa2, 0x00,         // 0200: LDX #0
+  0xe8,               // 0202: INX
+  0x86, 0x80,         // 0203: STX $80
+  0xa5, 0x81,         // 0205: LDA $81
+  0x4c, 0x02, 0x02,   // 0207: JMP $0202
+];
+
+// a KIM-1 running the program, with the reason for each stop in stops[]
+function newPlatform() {
+  var platform = new KIM1TestPlatform(null);
+  platform.timer = { start: function() { }, stop: function() { }, isRunning: function() { return false; } };
+  var machine = platform.machine;
+  machine.reset();
+  machine.ram.set(program, 0x200);
+  machine.advanceCPU(); // finish the reset sequence
+  var state = machine.cpu.saveState();
+  state.PC = 0x200;
+  state.o = machine.ram[0x200]; // opcode at PC
+  machine.cpu.loadState(state);
+  platform.stops = [];
+  platform.setupDebug(function(state, reason) {
+    platform.stops.push({PC:state.c.PC, X:state.c.X, reason:reason});
+  });
+  return platform;
+}
+
+// breakpointHit() logs every stop
+function quietly(fn) {
+  return function() {
+    var log = console.log;
+    console.log = function() { };
+    try { fn(); } finally { console.log = log; }
+  };
+}
+
+describe('Breakpoints', function() {
+
+  it('Should stop at a PC breakpoint', quietly(function() {
+    var platform = newPlatform();
+    platform.setExpressionBreakpoint('debug', 'at $0207 if X == 3');
+    platform.nextFrame(true);
+    assert.deepEqual([{PC:0x207, X:3, reason:null}], platform.stops);
+    assert.equal(0x207, platform.getPC());
+  }));
+
+  it('Should stop after a write to a watched address', quietly(function() {
+    var platform = newPlatform();
+    assert.ok(platform.canWatchMemory());
+    platform.setExpressionBreakpoint('debug', 'watch $80 w');
+    platform.nextFrame(true);
+    assert.deepEqual([{PC:0x205, X:1, reason:"Write $0080"}], platform.stops);
+    assert.equal(1, platform.machine.ram[0x80]);
+  }));
+
+  it('Should only stop for the watched kind of access', quietly(function() {
+    var platform = newPlatform();
+    platform.setExpressionBreakpoint('debug', 'watch $80 r');
+    platform.nextFrame(true);
+    assert.deepEqual([], platform.stops);
+    platform = newPlatform();
+    platform.setExpressionBreakpoint('debug', 'watch $81 r');
+    platform.nextFrame(true);
+    assert.deepEqual([{PC:0x207, X:1, reason:"Read $0081"}], platform.stops);
+  }));
+
+});
@@ -0,0 +1,64 @@
+var assert = require('assert');
+
+var debugexpr = require("gen/common/debugexpr.js");
+
+describe('Debug expressions', function() {
+
+  var mem = function(a) { return a & 0xff; };
+
+  it('Should compile conditions against a register array', function() {
+    var regs = new Int32Array(32);
+    regs[1] = 0; regs[2] = 9;   // A, X
+    var getRegs = function() { return regs; };
+    var e = debugexpr.compileDebugExpression('A==0 && mem[$80]>10 && x >= 8', debugexpr.REGS_6502);
+    assert.equal(true, e.fn(getRegs, mem, 1, 0x1234, 0xff));
+    regs[1] = 1;
+    assert.equal(false, e.fn(getRegs, mem, 1, 0x1234, 0xff));
+    var z = debugexpr.compileDebugExpression('H == $12 && L == 0x34 && HL == 4660', debugexpr.REGS_Z80);
+    regs[5] = 0x1234;
+    assert.equal(true, z.fn(getRegs, mem, 1, 0, 0));
+  });
+
+  it('Should only read registers when needed', function() {
+    var reads = 0;
+    var getRegs = function() { reads++; return {A:5}; };
+    var e = debugexpr.compileDebugExpression('PC == $1000 && A == 5', null);
+    assert.equal(false, e.fn(getRegs, mem, 1, 0x2000, 0));
+    assert.equal(0, reads);
+    assert.equal(true, e.fn(getRegs, mem, 1, 0x1000, 0));
+    assert.equal(1, reads);
+  });
+
+  it('Should parse breakpoints and tracepoints', function() {
+    var bp = debugexpr.parseBreakpoint('at main if hits>100', debugexpr.REGS_6502, {_main:0x8000});
+    assert.equal(0x8000, bp.pc);
+    assert.equal(false, bp.expr.fn(null, mem, 100, 0, 0));
+    assert.equal(true, bp.expr.fn(null, mem, 101, 0, 0));
+    var tp = debugexpr.parseBreakpoint('trace A, mem[$80] at $1234 if sp < $f0', debugexpr.REGS_6502);
+    assert.equal(0x1234, tp.pc);
+    assert.deepEqual(['A', 'mem[$80]'], tp.traceLabels);
+    var regs = new Int32Array(32);
+    regs[1] = 7;
+    var values = tp.trace.fn(function() { return regs; }, mem, 1, 0x1234, 0xe0);
+    assert.equal("$1234 A=$07 mem[$80]=$80", debugexpr.formatTraceLine(0x1234, tp.traceLabels, values));
+    assert.equal(true, tp.expr.fn(null, mem, 1, 0x1234, 0xe0));
+  });
+
+  it('Should parse watchpoints', function() {
+    var bp = debugexpr.parseBreakpoint('watch $80 w', null);
+    assert.equal(0x80, bp.watchAddr);
+    assert.equal(2, bp.watchFlags); // WATCH_WRITE
+    bp = debugexpr.parseBreakpoint('watch counter', null, {_counter:0x1234});
+    assert.equal(0x1234, bp.watchAddr);
+    assert.equal(3, bp.watchFlags);
+    assert.equal(1, debugexpr.parseBreakpoint('watch 128 R', null).watchFlags);
+    assert.throws(function() { debugexpr.parseBreakpoint('watch $80 x', null); }, /must be r, w or rw/);
+  });
+
+  it('Should reject anything but expressions', function() {
+    assert.throws(function() { debugexpr.parseBreakpoint('A = 0', debugexpr.REGS_6502); }, /Unexpected '='/);
+    assert.throws(function() { debugexpr.parseBreakpoint('HL == 0', debugexpr.REGS_6502); }, /Unknown register 'HL'/);
+    assert.throws(function() { debugexpr.parseBreakpoint('alert(1)', null); }, /Unexpected/);
+    assert.throws(function() { debugexpr.parseBreakpoint('at nowhere', null, {}); }, /Unknown address/);
+  });
+});
@@ -0,0 +1,59 @@
+var assert = require('assert');
+
+var movie = require("gen/common/movie.js");
+
+describe('Input movies', function() {
+
+  it('Should round-trip states with typed arrays and DataViews', function() {
+    var buf = new ArrayBuffer(32);
+    new Uint8Array(buf).forEach(function(v, i, a) { a[i] = i; });
+    var state = {
+      c: {PC:0x1234},
+      ram: new Uint8Array([1,2,3]),
+      words: new Uint16Array([0xffff, 2]),
+      view: new DataView(buf, 8, 4),
+      list: [1, 2, 3],
+    };
+    var dec = movie.decodeObject(movie.encodeObject(state));
+    assert.deepEqual(dec.c, state.c);
+    assert.deepEqual(dec.list, state.list);
+    assert.ok(dec.ram instanceof Uint8Array);
+    assert.deepEqual(Array.from(dec.ram), [1,2,3]);
+    assert.ok(dec.words instanceof Uint16Array);
+    assert.deepEqual(Array.from(dec.words), [0xffff, 2]);
+    assert.ok(dec.view instanceof DataView);
+    assert.equal(dec.view.byteLength, 4);
+    assert.equal(dec.view.getUint32(0), 0x08090a0b);
+  });
+
+  it('Should write movies to a store and report failed writes', async function() {
+    var items = {};
+    var store = {
+      setItem: function(k, v) { items[k] = v; return Promise.resolve(v); },
+      getItem: function(k) { return Promise.resolve(items[k]); },
+    };
+    var mem = new movie.MemoryMovieSink();
+    var sink = new movie.StoreMovieSink(store, 'test');
+    [mem, sink].forEach(function(s) {
+      var w = new movie.MovieWriter(s, {platform:'test'}, new Uint8Array(16));
+      w.flushInterval = 10;
+      w.addKeyframe({c:{T:0}});
+      for (var i=0; i<50; i++) w.addFrame({keys:i>>3}, 1);
+      w.close();
+    });
+    await sink.pending;
+    assert.equal(sink.error, null);
+    assert.deepEqual(await movie.loadMovieFromStore(store, 'test'), mem.getData());
+    // a store that's full
+    var errors = [];
+    store.setItem = function(k, v) { return Promise.reject(new Error("quota")); };
+    sink = new movie.StoreMovieSink(store, 'full');
+    sink.onerror = function(e) { errors.push(e); };
+    sink.write(new Uint8Array(4));
+    sink.write(new Uint8Array(4));
+    await sink.pending;
+    assert.equal(errors.length, 1);
+    assert.equal(sink.error.message, "quota");
+  });
+
+});
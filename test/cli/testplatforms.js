@@ -1,108 +1,15 @@
 
 var assert = require('assert');
 var fs = require('fs');
-var wtu = require('./workertestutils.js');
 var PNG = require('pngjs').PNG;
 
-const dom = createTestDOM();
-includeInThisContext('src/common/cpu/6809.js');
-includeInThisContext("javatari.js/release/javatari/javatari.js");
-Javatari.AUTO_START = false;
-includeInThisContext('tss/js/Log.js');
-//global.Log = require('tss/js/Log.js').Log;
-includeInThisContext('tss/js/tss/PsgDeviceChannel.js');
-includeInThisContext('tss/js/tss/MasterChannel.js');
-includeInThisContext('tss/js/tss/AudioLooper.js');
-//includeInThisContext("jsnes/dist/jsnes.min.js");
-global.jsnes = require("jsnes/dist/jsnes.min.js");
+var headless = require('./headless.js');
 
-//var devices = require('gen/common/devices.js');
 var emu = require('gen/common/emu.js');
 var Keys = emu.Keys;
 var audio = require('gen/common/audio.js');
 var recorder = require('gen/common/recorder.js');
-//var _6502 = require('gen/common/cpu/MOS6502.js');
-var _apple2 = require('gen/platform/apple2.js');
-//var m_apple2 = require('gen/machine/apple2.js');
-var _vcs = require('gen/platform/vcs.js');
-var _nes = require('gen/platform/nes.js');
-var _vicdual = require('gen/platform/vicdual.js');
-var _mw8080bw = require('gen/platform/mw8080bw.js');
-var _galaxian = require('gen/platform/galaxian.js');
-var _vector = require('gen/platform/vector.js');
-var _williams = require('gen/platform/williams.js');
-var _sound_williams = require('gen/platform/sound_williams.js');
-var _astrocade = require('gen/platform/astrocade.js');
-var _atari8 = require('gen/platform/atari8.js');
-var _atari7800 = require('gen/platform/atari7800.js');
-var _coleco = require('gen/platform/coleco.js');
-var _sms = require('gen/platform/sms.js');
-var _c64 = require('gen/platform/c64.js');
-var _vectrex = require('gen/platform/vectrex.js');
-var _zx = require('gen/platform/zx.js');
-
-
-//
-
-dom.window.HTMLCanvasElement.prototype.getContext = function() {
-  return {
-    getImageData: function(x,y,w,h) { return {data: new Uint32Array(w*h) }; },
-    fillRect: function(x,y,w,h) { },
-    drawImage: function(img,x,y,w,h) { },
-    putImageData: function(data,w,h) { },
-  };
-}
-global.navigator = {};
-
-var keycallback;
-var lastrastervideo;
-
-emu.RasterVideo = function(mainElement, width, height, options) {
-  var buffer;
-  var datau8;
-  var datau32;
-  this.create = function() {
-    this.width = width;
-    this.height = height;
-    buffer = new ArrayBuffer(width*height*4);
-    datau8 = new Uint8Array(buffer);
-    datau32 = new Uint32Array(buffer);
-    lastrastervideo = this;
-  }
-  this.setKeyboardEvents = function(callback) {
-    keycallback = callback;
-  }
-  this.getFrameData = function() { return datau32; }
-  this.getImageData = function() { return {data:datau8, width:width, height:height}; }
-  this.updateFrame = function() {}
-  this.clearRect = function() {}
-  this.setupMouseEvents = function() { }
-  this.canvas = this;
-  this.getContext = function() { return this; }
-  this.fillRect = function() { }
-  this.fillStyle = '';
-  this.putImageData = function() { }
-}
-
-emu.VectorVideo = function(mainElement, width, height, options) {
-  this.create = function() {
-    this.drawops = 0;
-  }
-  this.setKeyboardEvents = function(callback) {
-    keycallback = callback;
-  }
-  this.clear = function() { }
-  this.drawLine = function() { this.drawops++; }
-}
-
-global.Worker = function() {
-  this.msgcount = 0;
-  this.postMessage = function() { this.msgcount++; }
-}
-
-global.Mousetrap = function() {
-  this.bind = function() { }
-}
+var movie = require('gen/common/movie.js');
 
 //
 
@@ -159,6 +66,15 @@ async function testPlatform(platid, romname, maxframes, callback) {
       if (platform.readAddress) platform.readAddress(i);
     var state3 = platform.saveState();
     assert.deepEqual(state2, state3);
+    // binary snapshots must match the object state
+    var binsize = platform.getBinaryStateSize ? platform.getBinaryStateSize() : 0;
+    if (binsize > 0) {
+      var binstate = new DataView(new ArrayBuffer(binsize));
+      assert.equal(binsize, platform.saveStateInto(binstate, 0));
+      platform.nextFrame();
+      assert.equal(binsize, platform.loadStateFrom(binstate, 0));
+      assert.deepEqual(state3, platform.saveState());
+    }
     // test debug info
     var debugs = platform.getDebugCategories();
     for (var dcat of debugs) {
@@ -170,9 +86,9 @@ async function testPlatform(platid, romname, maxframes, callback) {
       assert.ok(dinfo.indexOf('Display On:  false') < 0, dcat + " display off");
     }
     // record video to file
-    if (lastrastervideo) {
-      var png = new PNG({width:lastrastervideo.width, height:lastrastervideo.height});
-      png.data = lastrastervideo.getImageData().data;
+    if (headless.lastrastervideo) {
+      var png = new PNG({width:headless.lastrastervideo.width, height:headless.lastrastervideo.height});
+      png.data = headless.lastrastervideo.getImageData().data;
       var pngbuffer = PNG.sync.write(png);
       assert(pngbuffer.length > 500); // make sure PNG is big enough
       try { fs.mkdirSync("./test"); } catch(e) { }
@@ -213,7 +129,7 @@ describe('Platform Replay', () => {
   it('Should run apple2', async () => {
     var platform = await testPlatform('apple2', 'cosmic.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(32, 32, 128); // space bar
+        headless.keycallback(32, 32, 128); // space bar
       }
     });
     assert.equal(platform.saveState().kbdlatch, 0x20); // strobe cleared
@@ -239,7 +155,7 @@ describe('Platform Replay', () => {
   it('Should run nes', async () => {
     var platform = await testPlatform('nes', 'shoot2.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
     assert.equal(120-10, platform.readAddress(0x41d)); // player x pos
@@ -248,7 +164,7 @@ describe('Platform Replay', () => {
   it('Should run vicdual', async () => {
     var platform = await testPlatform('vicdual', 'snake1.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
+        headless.keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
       }
     });
   });
@@ -256,7 +172,7 @@ describe('Platform Replay', () => {
   it('Should run mw8080bw', async () => {
     var platform = await testPlatform('mw8080bw', 'game2.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
     assert.equal(96-9*2, platform.readAddress(0x2006)); // player x pos
@@ -265,7 +181,7 @@ describe('Platform Replay', () => {
   it('Should run galaxian', async () => {
     var platform = await testPlatform('galaxian-scramble', 'shoot2.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
     assert.equal(112-10, platform.readAddress(0x4074)); // player x pos
@@ -274,7 +190,7 @@ describe('Platform Replay', () => {
   it('Should run vector', async () => {
     var platform = await testPlatform('vector-z80color', 'game.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_UP.c, Keys.VK_UP.c, 1);
+        headless.keycallback(Keys.VK_UP.c, Keys.VK_UP.c, 1);
       }
     });
   });
@@ -282,7 +198,7 @@ describe('Platform Replay', () => {
   it('Should run williams 6809', async () => {
     var platform = await testPlatform('williams', 'vidfill.asm.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
   });
@@ -290,14 +206,14 @@ describe('Platform Replay', () => {
   it('Should run williams-z80', async () => {
     var platform = await testPlatform('williams-z80', 'game1.c.rom', 72, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
   });
   it('Should run sound_williams', async () => {
     var platform = await testPlatform('sound_williams-z80', 'swave.c.rom', 72, (platform, frameno) => {
       if (frameno == 60) {
-        keycallback(Keys.VK_2.c, Keys.VK_2.c, 1);
+        headless.keycallback(Keys.VK_2.c, Keys.VK_2.c, 1);
       }
     });
   });
@@ -305,35 +221,35 @@ describe('Platform Replay', () => {
   it('Should run astrocade', async () => {
     var platform = await testPlatform('astrocade', 'cosmic.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
+        headless.keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
       }
     });
   });
   it('Should run coleco', async () => {
     var platform = await testPlatform('coleco', 'shoot.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
+        headless.keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
       }
     });
   });
   it('Should run sms-sg1000-libcv', async () => {
     var platform = await testPlatform('sms-sg1000-libcv', 'shoot.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
+        headless.keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
       }
     });
   });
   it('Should run sms-sms-libcv', async () => {
     var platform = await testPlatform('sms-sms-libcv', 'climber.c-sms-sms-libcv.rom', 200, (platform, frameno) => {
       if (frameno == 122) {
-        keycallback(Keys.RIGHT.c, Keys.VK_RIGHT.c, 1);
+        headless.keycallback(Keys.RIGHT.c, Keys.VK_RIGHT.c, 1);
       }
     });
   });
   it('Should run atari7800', async () => {
     var platform = await testPlatform('atari7800', 'sprites.dasm.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
+        headless.keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
       }
     });
     assert.equal(0x1800, platform.saveState().maria.dll);
@@ -342,22 +258,75 @@ describe('Platform Replay', () => {
   it('Should run vectrex', async () => {
     var platform = await testPlatform('vectrex', 'joystick.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
+        headless.keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
       }
     });
   });
   it('Should run c64', async () => {
     await testPlatform('c64', 'climber.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
+        headless.keycallback(Keys.VK_DOWN.c, Keys.VK_DOWN.c, 1);
       }
     });
   });
   it('Should run zx spectrum', async () => {
     await testPlatform('zx', 'cosmic.c.rom', 92, (platform, frameno) => {
       if (frameno == 62) {
-        keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
+        headless.keycallback(Keys.VK_LEFT.c, Keys.VK_LEFT.c, 1);
       }
     });
   });
 });
+
+// records a movie while running a ROM, with keyframes more often than usual
+async function recordMovie(platid, romname, maxframes, callback) {
+  var platform = new emu.PLATFORMS[platid](document.getElementById('emulator'));
+  await platform.start();
+  var rom = new Uint8Array(fs.readFileSync('./test/roms/' + platid + '/' + romname));
+  platform.loadROM("ROM", rom);
+  var rec = new recorder.StateRecorderImpl(platform);
+  var sink = new movie.MemoryMovieSink();
+  rec.movie = new movie.MovieWriter(sink, {platform:platid, title:romname}, rom);
+  rec.movie.keyframeInterval = 30;
+  platform.resume(); // so that recorder works
+  platform.setRecorder(rec);
+  for (var i=0; i<maxframes; i++) {
+    if (callback) callback(platform, i);
+    platform.nextFrame();
+  }
+  platform.pause();
+  rec.movie.close();
+  return sink.getData();
+}
+
+async function replayMovie(data) {
+  var reader = new movie.MovieReader(data);
+  var platform = new emu.PLATFORMS[reader.meta.platform](document.getElementById('emulator'));
+  await platform.start();
+  platform.loadROM(reader.meta.title, reader.rom);
+  return movie.playMovie(platform, data);
+}
+
+describe('Input Movies', () => {
+
+  it('Should replay a recorded movie', async () => {
+    var data = await recordMovie('coleco', 'shoot.c.rom', 92, (platform, frameno) => {
+      if (frameno == 62) {
+        headless.keycallback(Keys.VK_SPACE.c, Keys.VK_SPACE.c, 1);
+      }
+    });
+    var result = await replayMovie(data);
+    assert.equal(92, result.frames);
+    assert.equal(-1, result.diverged);
+  });
+
+  // movies attached to bug reports go in test/movies
+  var moviedir = './test/movies';
+  var moviefiles = fs.existsSync(moviedir) ? fs.readdirSync(moviedir) : [];
+  moviefiles.forEach((fn) => {
+    it('Should replay ' + fn, async () => {
+      var result = await replayMovie(new Uint8Array(fs.readFileSync(moviedir + '/' + fn)));
+      assert.equal(-1, result.diverged, "diverged at frame " + result.diverged);
+    });
+  });
+});
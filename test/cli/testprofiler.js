@@ -0,0 +1,133 @@
+var assert = require('assert');
+
+var profiler = require("gen/common/profiler.js");
+var recorder = require("gen/common/recorder.js");
+
+describe('CallTraceLog', function() {
+
+  it('Should export nested calls', function() {
+    var log = new profiler.CallTraceLog();
+    log.exit('stray', 0);     // exit before any entry is dropped
+    log.enter('main', 10);
+    log.enter('sub', 20);
+    log.exit('sub', 50);
+    log.enter('sub', 60);     // still running at the end
+    log.exit('main', 100);    // pops sub, not main
+    var chrome = log.toChromeTrace(1000000);
+    assert.deepEqual(['B main 10', 'B sub 20', 'E sub 50', 'B sub 60', 'E sub 100', 'E main 100'],
+      chrome.traceEvents.map(function(ev) { return ev.ph + ' ' + ev.name + ' ' + ev.ts; }));
+    var ss = log.toSpeedscope('test');
+    assert.deepEqual([{name:'main'},{name:'sub'}], ss.shared.frames);
+    var prof = ss.profiles[0];
+    assert.equal('evented', prof.type);
+    assert.equal(10, prof.startValue);
+    assert.equal(100, prof.endValue);
+    assert.deepEqual(['O0@10','O1@20','C1@50','O1@60','C1@100','C0@100'],
+      prof.events.map(function(ev) { return ev.type + ev.frame + '@' + ev.at; }));
+  });
+
+  it('Should stop logging when full', function() {
+    var log = new profiler.CallTraceLog(3);
+    log.enter('a', 1);
+    log.enter('b', 2);
+    log.exit('b', 3);
+    log.exit('a', 4);
+    assert.ok(log.isFull());
+    assert.equal(3, log.events.length);
+    assert.equal(4, log.toChromeTrace(1000000).traceEvents.length);
+  });
+});
+
+describe('InterruptBudgetAnalyzer', function() {
+
+  // 8 scanlines per frame, 2..5 visible, one 10-clock instruction per scanline
+  function runFrames(probe, script) {
+    var sp = 0xff;
+    for (var f=0; f<script.length; f++) {
+      probe.logNewFrame();
+      for (var row=0; row<8; row++) {
+        if (row) probe.logNewScanline();
+        var act = script[f][row];
+        if (act == 'irq') { probe.logInterrupt(1); sp -= 3; }
+        if (act == 'jsr') sp -= 2;
+        if (act == 'rts') sp += 2;
+        if (act == 'rti') sp += 3;
+        probe.logExecute(0x1000 + row, sp);
+        probe.logClocks(10);
+      }
+    }
+  }
+
+  it('Should time handlers and flag vblank overruns', function() {
+    var probe = new recorder.ProbeRecorder({connectProbe: function() { }});
+    runFrames(probe, [
+      {6:'irq', 7:'rti'},           // fits in vblank
+      {7:'irq'},                    // still running...
+      {0:'jsr', 1:'rts', 3:'rti'},  // ...into the visible area
+      {},
+    ]);
+    var a = profiler.analyzeInterrupts(probe, 2, 4);
+    assert.equal(2, a.runs.length);
+    var r0 = a.runs[0];
+    assert.deepEqual([0,1,6,0,7,10,true,0], [r0.frame, r0.type, r0.startRow, r0.endFrame, r0.endRow, r0.cycles, r0.inVblank, r0.spillCycles]);
+    var r1 = a.runs[1];
+    assert.deepEqual([1,7,2,3,40,true,10], [r1.frame, r1.startRow, r1.endFrame, r1.endRow, r1.cycles, r1.inVblank, r1.spillCycles]);
+    assert.deepEqual([1], a.getSpilledFrames());
+    var report = a.getReport().split('\n');
+    assert.equal(profiler.INTERRUPT_REPORT_HEADER, report[0]);
+    assert.ok(report[2].endsWith('SPILL'));
+    assert.equal("2 interrupts, longest 40 cycles, 1 frame(s) spilled into the visible area: 1", report[3]);
+  });
+
+  it('Should pick up new frames as they are recorded', function() {
+    var probe = new recorder.ProbeRecorder({connectProbe: function() { }});
+    var a = new profiler.InterruptBudgetAnalyzer(2, 4);
+    runFrames(probe, [{6:'irq', 7:'rti'}, {}]);
+    a.addFrames(probe);
+    a.addFrames(probe);   // the last frame isn't analyzed until it's done
+    assert.equal(1, a.runs.length);
+    runFrames(probe, [{6:'irq'}, {}]);
+    a.addFrames(probe);
+    assert.equal(2, a.runs.length);
+    assert.equal(-1, a.runs[1].endFrame);
+  });
+});
+
+describe('Code coverage', function() {
+
+  it('Should mark executed lines and export lcov', function() {
+    var probe = new recorder.CoverageProbe({connectProbe:function() {}});
+    probe.logExecute(0x1000, 0);
+    probe.logExecute(0x1005, 0);   // middle of line 3
+    probe.addLogBuffer(new Uint32Array([recorder.ProbeFlags.EXECUTE | 0x1020]));
+    assert.ok(probe.wasHit(0x1000));
+    assert.ok(!probe.wasHit(0x1001));
+    assert.equal(3, probe.countHits());
+    var listings = {
+      'main.lst': {
+        lines: [
+          {line:2, offset:0x1000},
+          {line:3, offset:0x1003},
+          {line:4, offset:0x1010},
+          {line:4, offset:0x1020},   // same line again
+          {line:5, offset:0x1030, iscode:false},
+          {line:6, offset:-1},
+        ],
+        asmlines: [
+          {line:10, offset:0x1000, iscode:true},
+          {line:11, offset:0x1003, iscode:true},
+        ]
+      }
+    };
+    var files = profiler.getListingCoverage(listings, function(a) { return probe.wasHit(a); },
+      function(lstfn) { return 'main.c'; });
+    assert.deepEqual(['main.c', 'main.lst'], files.map(function(f) { return f.path; }));
+    assert.deepEqual(['2:true', '3:true', '4:true'], files[0].lines.map(function(lc) { return lc.line + ':' + lc.hit; }));
+    assert.deepEqual(['10:true', '11:false'], files[1].lines.map(function(lc) { return lc.line + ':' + lc.hit; }));
+    assert.equal(
+      'TN:test\nSF:main.c\nDA:2,1\nDA:3,1\nDA:4,1\nLF:3\nLH:3\nend_of_record\n' +
+      'TN:test\nSF:main.lst\nDA:10,1\nDA:11,0\nLF:2\nLH:1\nend_of_record\n',
+      profiler.toLcov(files, 'test'));
+  });
+
+});
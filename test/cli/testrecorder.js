@@ -0,0 +1,276 @@
+var assert = require('assert');
+
+var recorder = require("gen/common/recorder.js");
+
+describe('StateRecorderImpl', function() {
+
+  it('Should round-trip XOR deltas', function() {
+    var key = new Uint8Array(1000);
+    for (var i=0; i<key.length; i++) key[i] = (i * 7) & 0xff;
+    var cur = key.slice(0);
+    cur[0] ^= 1; cur[2] ^= 1; cur[500] = 0x55; cur[999] = 0;
+    var delta = recorder.encodeXORDelta(cur, key);
+    assert.ok(delta.length < 20);
+    var dest = new Uint8Array(1000);
+    recorder.decodeXORDelta(delta, key, dest);
+    assert.deepEqual(dest, cur);
+  });
+
+  it('Should keep a bounded history of delta checkpoints', function() {
+    var ram = new Uint8Array(0x10000);
+    var clk = 0;
+    var platform = {
+      saveState: function() { return {c:{T:clk}, ram:ram.slice(0), x:[1,2]}; },
+      loadState: function(s) { clk = s.c.T; ram.set(s.ram); },
+      saveControlsState: function() { return {}; },
+      loadControlsState: function() { },
+      pause: function() { },
+      advance: function() { ram[clk & 0xffff] = clk & 0xff; clk++; return 1; },
+    };
+    var rec = new recorder.StateRecorderImpl(platform);
+    rec.checkpointsPerTier = 10;
+    rec.maxCheckpoints = 40;
+    for (var i=0; i<30000; i++) {
+      if (rec.frameRequested()) rec.recordFrame(platform.saveState());
+      platform.advance();
+    }
+    assert.equal(40, rec.numCheckpoints);
+    // newest tier every 10 frames, then 20, 40...
+    var frames = rec.checkpoints.map(function(cp) { return cp.frame; });
+    var n = frames.length;
+    assert.equal(rec.numFrames() - 10, frames[n-1]);
+    assert.equal(10, frames[n-1] - frames[n-2]);
+    assert.ok(frames[2] - frames[1] >= 40);
+    for (var i=2; i<n; i++)
+      assert.ok(frames[i] - frames[i-1] <= frames[i-1] - frames[i-2]);
+    // replaying from any checkpoint must reach the same state as the next one
+    for (var i=0; i<n-1; i++) {
+      platform.loadState(rec.getCheckpoint(i));
+      for (var j=frames[i]; j<frames[i+1]; j++) platform.advance();
+      assert.deepEqual(platform.saveState(), rec.getCheckpoint(i+1));
+    }
+    assert.equal(frames[n-1], rec.getStateAtOrBefore(rec.numFrames() + 5000).frame);
+    assert.equal(frames[5], rec.getStateAtOrBefore(frames[5] + 1).frame);
+    assert.equal(500, rec.loadFrame(500));
+  });
+
+  it('Should give checkpoints a new keyframe in idle time', function(done) {
+    var ram = new Uint8Array(0x1000);
+    var clk = 0;
+    var platform = {
+      saveState: function() { return {c:{T:clk}, ram:ram.slice(0)}; },
+      loadState: function(s) { clk = s.c.T; ram.set(s.ram); },
+      saveControlsState: function() { return {}; },
+      loadControlsState: function() { },
+      pause: function() { },
+      advance: function() { ram[clk & 0xfff] = clk & 0xff; clk++; return 1; },
+    };
+    var rec = new recorder.StateRecorderImpl(platform);
+    rec.checkpointsPerTier = 10;
+    rec.maxCheckpoints = 40;
+    for (var i=0; i<5000; i++) {
+      if (rec.frameRequested()) rec.recordFrame(platform.saveState());
+      platform.advance();
+    }
+    function removedKeys() {
+      var keys = rec.checkpoints.filter(function(cp) { return cp.key == null; }).map(function(cp) { return cp.delta; });
+      return rec.checkpoints.filter(function(cp) { return cp.key != null && keys.indexOf(cp.key) < 0; }).length;
+    }
+    // thinning out keyframes leaves their checkpoints pointing at them for now
+    assert.ok(removedKeys() > 0);
+    var states = rec.getCheckpoints();
+    setTimeout(function() {
+      assert.equal(0, removedKeys());
+      assert.deepEqual(rec.getCheckpoints(), states);
+      done();
+    }, 100);
+  });
+
+  it('Should prefetch states toward a seek target', function(done) {
+    var clk = 0;
+    var platform = {
+      saveState: function() { return {c:{T:clk}}; },
+      loadState: function(s) { clk = s.c.T; },
+      saveControlsState: function() { return {}; },
+      loadControlsState: function() { },
+      isRunning: function() { return false; },
+      pause: function() { },
+      advance: function() { clk++; return 1; },
+    };
+    var rec = new recorder.StateRecorderImpl(platform);
+    rec.checkpointsPerTier = 10;
+    for (var i=0; i<5000; i++) {
+      if (rec.frameRequested()) rec.recordFrame(platform.saveState());
+      platform.advance();
+    }
+    var target = rec.checkpoints[1].frame + 100;
+    rec.prefetchFrame(target);
+    setTimeout(function() {
+      assert.equal(5000, clk); // current state untouched
+      var found = rec.getStateAtOrBefore(target-1);
+      assert.ok(target-1 - found.frame < rec.checkpointInterval);
+      assert.equal(found.frame, found.state.c.T);
+      done();
+    }, 100);
+  });
+
+  it('Should share unchanged buffers with the keyframe', function() {
+    var track = new Uint8Array(6656);
+    var clk = 0;
+    var platform = {
+      saveState: function() { return {c:{T:clk}, disk:[track]}; },
+      loadState: function(s) { clk = s.c.T; },
+      saveControlsState: function() { return {}; },
+      loadControlsState: function() { },
+      pause: function() { },
+      advance: function() { clk++; return 1; },
+    };
+    var rec = new recorder.StateRecorderImpl(platform);
+    for (var i=0; i<100; i++) {
+      if (rec.frameRequested()) rec.recordFrame(platform.saveState());
+      platform.advance();
+    }
+    assert.strictEqual(track, rec.getCheckpoint(rec.numCheckpoints-1).disk[0]);
+  });
+
+  it('Should delta-encode plain number arrays', function() {
+    var mem = [];
+    for (var i=0; i<4096; i++) mem.push(i & 0xff);
+    var clk = 0;
+    var platform = {
+      saveState: function() { return {c:{T:clk}, mem:mem.slice(0), regs:[clk,2,3]}; },
+      loadState: function(s) { clk = s.c.T; mem = s.mem.slice(0); },
+      saveControlsState: function() { return {}; },
+      loadControlsState: function() { },
+      pause: function() { },
+      advance: function() { mem[clk & 0xfff] = -clk; clk++; return 1; },
+    };
+    var rec = new recorder.StateRecorderImpl(platform);
+    for (var i=0; i<100; i++) {
+      if (rec.frameRequested()) rec.recordFrame(platform.saveState());
+      platform.advance();
+    }
+    var cp = rec.checkpoints[rec.numCheckpoints-1];
+    assert.ok(cp.key != null);
+    assert.ok(cp.delta.mem.data.length < 1000);
+    var state = rec.getCheckpoint(rec.numCheckpoints-1);
+    assert.ok(Array.isArray(state.mem));
+    platform.loadState(rec.getCheckpoint(0));
+    for (var i=0; i<cp.frame; i++) platform.advance();
+    assert.deepEqual(platform.saveState(), state);
+  });
+
+});
+
+describe('ProbeRecorder', function() {
+
+  it('Should keep the last frames in a ring buffer', function() {
+    var probe = new recorder.ProbeRecorder({connectProbe: function() { }}, 1000);
+    assert.equal(1024, probe.buf.length);
+    probe.singleFrame = false;
+    for (var f=0; f<20; f++) {
+      probe.logNewFrame();
+      for (var sl=0; sl<4; sl++) {
+        if (sl) probe.logNewScanline();
+        probe.logExecute(f*16 + sl, 0xff);
+        probe.logClocks(10);
+        probe.logClocks(10);
+      }
+    }
+    // each frame is FRAME, SP_SET, 3 SCANLINEs and 4 EXECUTE + CLOCKS
+    assert.equal(20*13, probe.idx);
+    assert.equal(20*4*20, probe.countClocks());
+    // frames and scanlines found without scanning
+    var i = probe.getScanlineStart(17, 2);
+    assert.equal(recorder.ProbeFlags.SCANLINE, probe.get(i));
+    assert.equal(recorder.ProbeFlags.EXECUTE | (17*16 + 2), probe.get(i+1));
+    assert.equal(recorder.ProbeFlags.FRAME, probe.get(probe.getFrameStart(19)));
+    assert.equal(-1, probe.getScanlineStart(19, 4));
+    // older frames get overwritten
+    for (var j=0; j<1024-2*13; j++) probe.logData(j | recorder.ProbeFlags.EXECUTE);
+    assert.equal(-1, probe.getFrameStart(17));
+    assert.equal(18*13, probe.getFrameStart(18));
+    assert.equal(1024-2*13 + 2*4, probe.countEvents(recorder.ProbeFlags.EXECUTE));
+    // views see the last frame only
+    probe.singleFrame = true;
+    var range = probe.getVisibleRange(0);
+    assert.equal(probe.getFrameStart(19), range[0]);
+    assert.equal(probe.idx, range[1]);
+    assert.deepEqual([probe.getFrameStart(18), range[0]], probe.getVisibleRange(1));
+    assert.deepEqual([0,0], probe.getVisibleRange(2));
+    // a frame whose start was overwritten isn't shown from the middle
+    for (var j=0; j<5; j++) probe.logData(j | recorder.ProbeFlags.EXECUTE);
+    assert.equal(-1, probe.getFrameStart(18));
+    assert.deepEqual([0,0], probe.getVisibleRange(1));
+    probe.singleFrame = false;
+    assert.deepEqual([probe.getFrameStart(19), probe.idx], probe.getVisibleRange());
+  });
+
+  it('Should pack instructions and stack ops into single words', function() {
+    var probe = new recorder.ProbeRecorder({connectProbe: function() { }});
+    var F = recorder.ProbeFlags;
+    probe.singleFrame = false;
+    probe.logNewFrame();
+    probe.logExecute(0x1000, 0x1ff);  // SP_SET, then fused exec+fetch+clocks
+    probe.logRead(0x1000, 0x20);
+    probe.logRead(0x1001, 0x34);
+    probe.logWrite(0x1ff, 0x10);
+    probe.logWrite(0x1fe, 0x02);
+    probe.logClocks(6);
+    probe.logRead(0x2000, 0x55);      // after the clocks
+    probe.logExecute(0x1234, 0x1fd);  // push, fused with exec
+    probe.logRead(0x1234, 0x60);
+    probe.logClocks(100);             // too many to fuse
+    probe.logExecute(0x2002, 0x1ff);  // pop
+    probe.logClocks(2);
+    probe.logNewScanline();
+    assert.equal(14, probe.idx); // 17 words unpacked
+    var events = [];
+    var clk = probe.forEachEvent(0, probe.idx, function(op,addr,col,row,clk,value) {
+      events.push([op,addr,col,row,value]);
+    });
+    assert.equal(6+100+2, clk);
+    assert.deepEqual([
+      [F.EXECUTE,0x1000,0,0,0],
+      [F.MEM_READ,0x1000,0,0,0x20],
+      [F.MEM_READ,0x1001,0,0,0x34],
+      [F.MEM_WRITE,0x1ff,0,0,0x10],
+      [F.MEM_WRITE,0x1fe,0,0,0x02],
+      [F.MEM_READ,0x2000,6,0,0x55],
+      [F.SP_PUSH,0x1fd,6,0,0],
+      [F.EXECUTE,0x1234,6,0,0],
+      [F.MEM_READ,0x1234,6,0,0x60],
+      [F.SP_POP,0x1ff,106,0,0],
+      [F.EXECUTE,0x2002,106,0,0],
+    ], events);
+    // unpacked words from a WASM machine get packed too
+    var probe2 = new recorder.ProbeRecorder({connectProbe: function() { }});
+    probe2.singleFrame = false;
+    probe2.addLogBuffer(new Uint32Array([F.FRAME, F.EXECUTE|0x1000, F.MEM_READ|0x1000|(0x20<<16), F.CLOCKS|6, F.SCANLINE]));
+    assert.equal(3, probe2.idx);
+    assert.equal(6, probe2.countClocks());
+    assert.equal(1, probe2.countEvents(F.MEM_READ));
+  });
+});
+
+describe('SamplingProbe', function() {
+
+  it('Should build a flat profile by symbol', function() {
+    var probe = new recorder.SamplingProbe({connectProbe: function() { }}, 7);
+    probe.getBank = function(a) { return a >= 0x8000 ? 1 : 0; };
+    for (var i=0; i<1000; i++) {
+      probe.logExecute(0x1000 + (i & 3), 0x1ff);  // main, 4 clocks
+      probe.logClocks(4);
+      probe.logExecute(0x8010, 0x1fd);            // sub, 16 clocks
+      probe.logClocks(16);
+    }
+    assert.equal(Math.floor(20000/7), probe.numSamples);
+    assert.equal(2, probe.pcs.size);
+    var profile = probe.getSymbolProfile({0x1000:'main', 0x1002:'l__skip', 0x8000:'sub', 0x9000:'other'},
+      function(sym) { return !sym.startsWith('l__'); });
+    assert.deepEqual(['main','sub'], Object.keys(profile).sort());
+    assert.equal(probe.numSamples, profile.main + profile.sub);
+    assert.ok(Math.abs(profile.main - probe.numSamples/5) < 10); // 4 of every 20 clocks
+    assert.equal(profile.sub, probe.sps[0x1fd]);
+  });
+});
@@ -0,0 +1,124 @@
+var assert = require('assert');
+
+var devices = require("gen/common/devices.js");
+var kim1 = require("gen/machine/kim1.js");
+
+describe('EventScheduler', function() {
+
+  it('Should fire events in time order', function() {
+    var sched = new devices.EventScheduler();
+    var fired = [];
+    var newEvent = function(name) {
+      return new devices.ScheduledEvent(function(time) { fired.push(name + '@' + time); });
+    };
+    var a = newEvent('a'), b = newEvent('b'), c = newEvent('c'), d = newEvent('d');
+    sched.schedule(a, 30);
+    sched.schedule(b, 10);
+    sched.schedule(c, 20);
+    sched.schedule(d, 20); // same time, fires after c
+    assert.equal(10, sched.nextTime);
+    sched.clock = 25;
+    sched.runDueEvents();
+    assert.deepEqual(['b@10', 'c@20', 'd@20'], fired);
+    assert.equal(30, sched.nextTime);
+    // rescheduling moves an event, cancelling removes it
+    sched.schedule(b, 28);
+    sched.schedule(a, 40);
+    sched.scheduleIn(c, 10);
+    sched.cancel(b);
+    assert.equal(35, sched.nextTime);
+    sched.clock = 50;
+    sched.runDueEvents();
+    assert.deepEqual(['b@10', 'c@20', 'd@20', 'c@35', 'a@40'], fired);
+    assert.equal(Infinity, sched.nextTime);
+  });
+
+  it('Should fire events scheduled by a callback', function() {
+    var sched = new devices.EventScheduler();
+    var times = [];
+    var periodic = new devices.ScheduledEvent(function(time) {
+      times.push(time);
+      if (times.length < 4) sched.schedule(periodic, time + 7);
+    });
+    sched.schedule(periodic, 5);
+    sched.clock = 20;
+    sched.runDueEvents();
+    assert.deepEqual([5, 12, 19], times);
+    assert.equal(26, sched.nextTime);
+  });
+
+});
+
+describe('KIM-1 6530 timer', function() {
+
+  // program in RAM at $0200, with SEI/CLI as given and an IRQ handler
+  // at $0300 that counts interrupts in $10 and acknowledges the timer
+  function newKIM1(timerIRQ, code) {
+    var machine = new kim1.KIM1();
+    machine.timerIRQ = timerIRQ;
+    machine.reset();
+    machine.ram.set(code, 0x200);
+    machine.ram.set([
+      0xe6, 0x10,         // 0300: INC $10
+      0xad, 0x0e, 0x17,   // 0302: LDA $170E (clears the flag)
+      0x40,               // 0305: RTI
+    ], 0x300);
+    machine.ram[0x17fe] = 0x00; // the BIOS jumps through $17FE on IRQ
+    machine.ram[0x17ff] = 0x03;
+    machine.advanceCPU(); // finish the reset sequence
+    var state = machine.cpu.saveState();
+    state.PC = 0x200;
+    state.o = machine.ram[0x200]; // opcode at PC
+    machine.cpu.loadState(state);
+    return machine;
+  }
+
+  it('Should count down and set the flag on underflow', function() {
+    var machine = newKIM1(false, []);
+    var sched = machine.scheduler;
+    machine.write(0x1705, 100); // divide by 8, no IRQ
+    assert.equal(100, machine.read(0x1704));
+    sched.clock += 8*10 + 3;
+    assert.equal(90, machine.read(0x1704));
+    assert.equal(0, machine.read(0x1707));
+    sched.clock = 8*101;
+    sched.runDueEvents();
+    assert.equal(0x80, machine.read(0x1707));
+    // counts once per cycle after underflow
+    sched.clock += 5;
+    assert.equal(0xff - 5, machine.read(0x1706));
+    assert.equal(0, machine.read(0x1707)); // reading the counter cleared the flag
+  });
+
+  var program = [
+    0xa9, 0x10,         // 0200: LDA #$10
+    0x8d, 0x0f, 0x17,   // 0202: STA $170F (17*1024 cycles, IRQ on)
+    0x58,               // 0205: CLI
+    0x4c, 0x06, 0x02,   // 0206: JMP $0206
+  ];
+
+  it('Should interrupt when PB7 is jumpered to IRQ', function() {
+    var machine = newKIM1(true, program);
+    machine.advanceFrame(null);
+    assert.equal(0, machine.ram[0x10]);
+    machine.advanceFrame(null);
+    assert.equal(1, machine.ram[0x10]);
+    assert.ok(!machine.rriot1.isIRQ());
+    machine.advanceFrame(null);
+    assert.equal(1, machine.ram[0x10]); // one-shot
+  });
+
+  it('Should not interrupt a stock KIM-1 or with I set', function() {
+    var machine = newKIM1(false, program);
+    for (var i=0; i<3; i++) machine.advanceFrame(null);
+    assert.equal(0, machine.ram[0x10]);
+    assert.ok(machine.rriot1.isIRQ());
+    // same with the IRQ line connected, but I flag set
+    var masked = program.slice(0);
+    masked[5] = 0x78; // SEI
+    machine = newKIM1(true, masked);
+    for (var i=0; i<3; i++) machine.advanceFrame(null);
+    assert.equal(0, machine.ram[0x10]);
+  });
+
+});
@@ -0,0 +1,246 @@
+var assert = require('assert');
+var fs = require('fs');
+var vm = require('vm');
+
+// the ColecoVision's sound chip uses tss, which is loaded as a script
+for (var path of ['tss/js/Log.js', 'tss/js/tss/PsgDeviceChannel.js', 'tss/js/tss/MasterChannel.js'])
+  vm.runInThisContext(fs.readFileSync(path), path);
+
+var devices = require("gen/common/devices.js");
+var baseplatform = require("gen/common/baseplatform.js");
+var coleco = require("gen/machine/coleco.js");
+
+var ROM = new Uint8Array(fs.readFileSync('test/roms/coleco/shoot.c.rom'));
+
+// a CPU whose whole state is one counter
+function newCounterCPU() {
+  return {
+    count: 0,
+    getBinaryStateSize: function() { return 4; },
+    saveStateInto: function(buf, ofs) { buf.setUint32(ofs, this.count); return ofs + 4; },
+    loadStateFrom: function(buf, ofs) { this.count = buf.getUint32(ofs); return ofs + 4; },
+  };
+}
+
+describe('UndoLog', function() {
+
+  it('Should keep only the newest UNDO_MAX_INSNS instructions', function() {
+    var cpu = newCounterCPU();
+    var log = new devices.UndoLog(cpu);
+    var n = devices.UNDO_MAX_INSNS + 100;
+    for (cpu.count=0; cpu.count<n; cpu.count++)
+      log.logInstruction();
+    assert.equal(devices.UNDO_MAX_INSNS, log.numUndoable());
+    while (log.undo())
+      assert.equal(log.head, cpu.count);
+    assert.equal(100, cpu.count);
+    assert.equal(0, log.numUndoable());
+  });
+
+  it('Should forget the oldest instructions when out of write room', function() {
+    var cpu = newCounterCPU();
+    var log = new devices.UndoLog(cpu);
+    var page = new Uint8Array(0x100);
+    var pages = []; // the page before each instruction
+    var n = devices.UNDO_MAX_WRITES / 3 + 1000;
+    for (cpu.count=0; cpu.count<n; cpu.count++) {
+      pages.push(page.slice(0));
+      log.logInstruction();
+      for (var j=0; j<3; j++) {
+        var ofs = (cpu.count*3 + j) & 0xff;
+        log.logWrite(page, ofs);
+        page[ofs] = cpu.count + j;
+      }
+    }
+    assert.ok(log.writeHead - log.writeStart[log.tail & (devices.UNDO_MAX_INSNS-1)] <= devices.UNDO_MAX_WRITES);
+    assert.equal(Math.floor(devices.UNDO_MAX_WRITES / 3), log.numUndoable());
+    var tail = log.tail;
+    while (log.undo()) {
+      if (log.head % 1000 == 0 || log.head == tail)
+        assert.deepEqual(pages[log.head], page);
+      assert.equal(log.head, cpu.count);
+    }
+    assert.equal(tail, cpu.count);
+  });
+
+  it('Should stop at a barrier', function() {
+    var cpu = newCounterCPU();
+    var log = new devices.UndoLog(cpu);
+    var page = new Uint8Array(0x100);
+    for (cpu.count=0; cpu.count<5; cpu.count++)
+      log.logInstruction();
+    log.logBarrier();
+    assert.equal(0, log.numUndoable());
+    assert.ok(!log.undo());
+    // writes by the instruction that hit the barrier are not logged
+    log.logWrite(page, 0);
+    assert.equal(0, log.writeHead);
+    log.logInstruction();
+    log.logWrite(page, 1);
+    page[1] = 0x55;
+    assert.equal(1, log.numUndoable());
+    assert.ok(log.undo());
+    assert.equal(0, page[1]);
+    assert.equal(5, cpu.count);
+  });
+
+});
+
+function newColecoVision() {
+  var machine = new coleco.ColecoVision();
+  var vp = machine.getVideoParams();
+  machine.connectVideo(new Uint32Array(vp.width * vp.height));
+  return machine;
+}
+
+function newColeco(frames) {
+  var machine = newColecoVision();
+  machine.loadROM(ROM);
+  machine.reset();
+  for (var i=0; i<frames; i++)
+    machine.advanceFrame(null);
+  return machine;
+}
+
+describe('ColecoVision undo', function() {
+
+  it('Should undo instructions back to the recorded CPU and RAM', function() {
+    var machine = newColeco(30);
+    assert.ok(machine.canUndo());
+    var log = new devices.UndoLog(machine.cpu);
+    machine.connectUndoLog(log);
+    var states = [];
+    for (var i=0; i<20000; i++) {
+      states.push({c:machine.cpu.saveState(), ram:machine.ram.slice(0)});
+      machine.advanceCPU();
+    }
+    assert.equal(20000, log.numUndoable());
+    assert.ok(log.writeHead > 1000);
+    while (states.length) {
+      assert.ok(log.undo());
+      var s = states.pop();
+      assert.deepEqual(s.c, machine.cpu.saveState());
+      assert.deepEqual(s.ram, machine.ram);
+    }
+    assert.ok(!log.undo());
+  });
+
+  it('Should not undo past a write outside the page table', function() {
+    var machine = newColeco(30);
+    machine.ram.set([0, 0], 0x0);
+    machine.ram.set([
+      0x3e, 0x12,         // 7100: LD A,$12
+      0x32, 0x00, 0x60,   // 7102: LD ($6000),A
+      0x32, 0x00, 0x00,   // 7105: LD ($0000),A (BIOS ROM)
+      0x32, 0x01, 0x60,   // 7108: LD ($6001),A
+    ], 0x100);
+    var state = machine.cpu.saveState();
+    state.PC = 0x7100;
+    machine.cpu.loadState(state);
+    var log = new devices.UndoLog(machine.cpu);
+    machine.connectUndoLog(log);
+    machine.advanceCPU();
+    machine.advanceCPU();
+    assert.equal(2, log.numUndoable());
+    machine.advanceCPU();
+    assert.equal(0, log.numUndoable());
+    machine.advanceCPU();
+    assert.equal(1, log.numUndoable());
+    assert.equal(0x12, machine.ram[1]);
+    assert.ok(log.undo());
+    assert.equal(0x7108, machine.cpu.getPC());
+    assert.equal(0x12, machine.ram[0]);
+    assert.equal(0, machine.ram[1]);
+    assert.ok(!log.undo());
+  });
+
+});
+
+class ColecoTestPlatform extends baseplatform.BaseZ80MachinePlatform {
+  newMachine() { return newColecoVision(); }
+}
+
+function newPlatform() {
+  var platform = new ColecoTestPlatform(null);
+  platform.timer = { start: function() { }, stop: function() { }, isRunning: function() { return false; } };
+  platform.loadROM('shoot', ROM);
+  for (var i=0; i<30; i++)
+    platform.nextFrame(true);
+  return platform;
+}
+
+// runs the frame from the debug state up to the given clock
+function breakAtClock(platform, clock) {
+  platform.runToFrameClock(clock);
+  platform.nextFrame(true);
+  assert.equal(clock, platform.debugClock);
+  return platform.debugBreakState;
+}
+
+// breakpointHit() logs every stop
+function quietly(fn) {
+  return function() {
+    var log = console.log;
+    console.log = function() { };
+    try { fn(); } finally { console.log = log; }
+  };
+}
+
+describe('Platform stepBack', function() {
+
+  it('Should step back to the same state as replaying the frame', quietly(function() {
+    var platform = newPlatform();
+    var replayed = [];
+    platform.setupDebug(function() { });
+    for (var clock=1990; clock<=2000; clock++)
+      replayed[clock] = breakAtClock(platform, clock);
+    assert.equal(platform.debugClock - 1, platform.undoLog.head);
+    for (var clock=1999; clock>=1990; clock--) {
+      platform.stepBack();
+      assert.equal(clock, platform.debugClock);
+      assert.equal(platform.debugClock - 1, platform.undoLog.head);
+      assert.deepEqual(replayed[clock].c, platform.debugBreakState.c);
+      assert.deepEqual(replayed[clock].ram, platform.debugBreakState.ram);
+    }
+    assert.ok(platform.debugUndone);
+  }));
+
+  it('Should run back to the last time the PC was hit', quietly(function() {
+    var platform = newPlatform();
+    platform.setupDebug(function() { });
+    // the PC at each clock up to a break at 2000
+    var pcs = [];
+    platform.runToFrameClock(0);
+    platform.runEval(function(c) {
+      pcs[platform.debugClock] = c.PC;
+      return platform.debugClock >= 2000;
+    });
+    platform.nextFrame(true);
+    var pc = pcs[1500];
+    var last = 1500;
+    for (var clock=1500; clock<2000; clock++)
+      if (pcs[clock] == pc) last = clock;
+    assert.ok(last > 1500);
+    var expect = breakAtClock(platform, last);
+    breakAtClock(platform, 2000);
+    assert.ok(platform.runBackToPC(pc));
+    assert.equal(last, platform.debugClock);
+    assert.deepEqual(expect.c, platform.debugBreakState.c);
+    assert.deepEqual(expect.ram, platform.debugBreakState.ram);
+  }));
+
+  it('Should only undo while the log matches the debug clock', quietly(function() {
+    var platform = newPlatform();
+    platform.setupDebug(function() { });
+    breakAtClock(platform, 100);
+    platform.debugClock++;
+    assert.ok(!platform.undoUntil(function() { return true; }));
+    platform.debugClock--;
+    assert.ok(platform.undoUntil(function() { return true; }));
+    assert.equal(99, platform.debugClock);
+    // nothing to undo before the first instruction of the frame
+    breakAtClock(platform, 1);
+    assert.ok(!platform.runBackToPC(0));
+  }));
+
+});
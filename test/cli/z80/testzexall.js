@@ -55,5 +55,39 @@ describe('ZilogZ80', function() {
     console.log("runall", runall);
     assert.equal(finish, runall);
   });
+  it('Should match bus with page table', function() {
+    function run(paged) {
+      var mem = new Uint8Array(65536);
+      mem.set(testbin, 0x100);
+      mem[0] = 0xC3;
+      mem[1] = 0x00;
+      mem[2] = 0x01;
+      mem[5] = 0xC9;
+      var bus = {
+        read:  (a)   => { return mem[a]; },
+        write: (a,v) => { mem[a] = v; }
+      };
+      var cpu = new ZilogZ80.Z80();
+      cpu.connectMemoryBus(bus);
+      cpu.connectIOBus(bus);
+      if (paged) {
+        var pages = new emu.MemoryPageTable();
+        pages.mapRead(0x0000, 0xffff, mem);
+        pages.mapWrite(0x8000, 0xffff, mem); // lower half still writes through the bus
+        cpu.connectMemoryPages(pages);
+      }
+      cpu.reset();
+      var cycles = 0;
+      for (var i=0; i<1000000; i++) {
+        cycles += cpu.advanceInsn(1);
+      }
+      return {cycles:cycles, state:cpu.saveState(), mem:mem};
+    }
+    var a = run(false);
+    var b = run(true);
+    assert.equal(a.cycles, b.cycles);
+    assert.deepEqual(a.state, b.state);
+    assert.deepEqual(a.mem, b.mem);
+  });
 });
 